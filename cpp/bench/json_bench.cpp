@@ -0,0 +1,137 @@
+/**
+ * Throughput benchmark for UTF-8 validation and JSON parsing.
+ *
+ * Compares the SIMD validator against the scalar fallback on ASCII-heavy and
+ * multilingual text, and reports what validation costs relative to a full
+ * json::parse of the same document, and DOM-free path extraction against
+ * parsing plus lookup for the config library's name/description scan.
+ *
+ *   make bench
+ */
+
+#include "json_utils.h"
+#include "json_cbor.h"
+#include "utf8.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+namespace {
+
+constexpr int ROUNDS = 5;
+
+double bestSeconds(const std::function<void()>& fn) {
+    double best = 1e9;
+    for (int i = 0; i < ROUNDS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+double megabytesPerSecond(size_t bytes, double seconds) {
+    return bytes / seconds / (1024.0 * 1024.0);
+}
+
+std::string repeatTo(const std::string& unit, size_t size) {
+    std::string text;
+    text.reserve(size + unit.size());
+    while (text.size() < size) {
+        text += unit;
+    }
+    return text;
+}
+
+// Truncates without splitting a UTF-8 sequence
+std::string prefix(const std::string& text, size_t length) {
+    while (length > 0 && length < text.size() && (text[length] & 0xC0) == 0x80) {
+        length--;
+    }
+    return text.substr(0, length);
+}
+
+// A config library bundle: many agents with long instructions
+std::string makeDocument(const std::string& filler, size_t agents) {
+    std::string doc = "[";
+    for (size_t i = 0; i < agents; ++i) {
+        if (i > 0) doc += ",";
+        doc += "{\"name\":\"Agent " + std::to_string(i) + "\",";
+        doc += "\"description\":\"" + prefix(filler, 120) + "\",";
+        doc += "\"instructions\":\"" + filler + "\",";
+        doc += "\"conversation_starters\":[\"How can I help?\",\"" + prefix(filler, 60) + "\"],";
+        doc += "\"conversation_memory\":5,\"temperature\":0.7}";
+    }
+    doc += "]";
+    return doc;
+}
+
+void benchValidators(const char* label, const std::string& text) {
+    volatile bool sink = false;
+    double simd = bestSeconds([&] { sink = utf8::isValid(text.data(), text.size()); });
+    double scalar = bestSeconds([&] { sink = utf8::isValidScalar(text.data(), text.size()); });
+    (void)sink;
+    std::printf("  %-14s %8.0f MB/s (%s)  %8.0f MB/s (scalar)  %5.1fx\n", label,
+                megabytesPerSecond(text.size(), simd), utf8::implementation(),
+                megabytesPerSecond(text.size(), scalar), scalar / simd);
+}
+
+void benchParse(const char* label, const std::string& doc) {
+    double parse = bestSeconds([&] { json::parse(doc); });
+    double validate = bestSeconds([&] { utf8::isValid(doc.data(), doc.size()); });
+    std::printf("  %-14s parse %6.0f MB/s, validation %7.0f MB/s, validation share %4.1f%%\n", label,
+                megabytesPerSecond(doc.size(), parse), megabytesPerSecond(doc.size(), validate),
+                100.0 * validate / parse);
+}
+
+void benchExtract(const char* label, const std::string& doc) {
+    static const std::vector<json::Path> paths = {json::Path("/name"), json::Path("/description")};
+    double parse = bestSeconds([&] {
+        auto config = json::parse(doc);
+        paths[0].evaluate(*config);
+        paths[1].evaluate(*config);
+    });
+    double extract = bestSeconds([&] { json::extract(doc, paths); });
+    std::printf("  %-14s parse+lookup %8.3f ms, extract %8.3f ms  %5.1fx\n", label,
+                parse * 1000, extract * 1000, parse / extract);
+}
+
+void benchCbor(const char* label, const std::string& doc) {
+    static const json::Path name("/name");
+    std::string binary = json::textToCbor(doc);
+    double parse = bestSeconds([&] { name.evaluate(*json::parse(doc)); });
+    double decode = bestSeconds([&] { json::fromCbor(binary.data(), binary.size()); });
+    double view = bestSeconds([&] { json::CborView::open(binary.data(), binary.size()).find(name); });
+    std::printf("  %-14s text parse %8.3f ms, CBOR decode %8.3f ms, CBOR view %8.3f ms  %5.1fx\n", label,
+                parse * 1000, decode * 1000, view * 1000, parse / view);
+}
+
+} // namespace
+
+int main() {
+    const size_t size = 32 * 1024 * 1024;
+    std::string ascii = repeatTo("The quick brown fox jumps over the lazy dog. ", size);
+    std::string mixed = repeatTo("Grüße, мир, 世界, 🌍! Plain ASCII follows here. ", size);
+
+    std::printf("UTF-8 validation (%zu MB)\n", size / (1024 * 1024));
+    benchValidators("ascii", ascii);
+    benchValidators("multilingual", mixed);
+
+    std::printf("\njson::parse vs validation\n");
+    benchParse("ascii", makeDocument(prefix(ascii, 4000), 4000));
+    benchParse("multilingual", makeDocument(prefix(mixed, 4000), 4000));
+
+    // Single config file: instructions first, as the editor saves them
+    std::printf("\nname/description lookup on one config\n");
+    std::string config = "{\"instructions\":\"" + prefix(ascii, 256 * 1024) + "\","
+                         "\"conversation_starters\":[\"a\",\"b\"],\"description\":\"Desc\",\"name\":\"Agent\"}";
+    benchExtract("256KB config", config);
+
+    std::printf("\nstate file load: text vs CBOR\n");
+    benchCbor("4000 records", makeDocument(prefix(mixed, 4000), 4000));
+
+    return 0;
+}
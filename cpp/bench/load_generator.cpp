@@ -0,0 +1,503 @@
+/**
+ * Closed-loop load generator for the agent core.
+ *
+ * Simulated users each own a ClaudeAgent and loop: think, send a message,
+ * wait for the answer. The backend is the bundled stub CLI (stub_cli),
+ * put first on PATH as "claude", so the run measures the core (context
+ * building, spawning, pipes, logging) against a predictable model.
+ *
+ * By default the user count doubles every step until throughput stops
+ * growing or tail latency degrades, and the last healthy step is reported
+ * as the saturation point. Every interval prints throughput, latency
+ * percentiles, CPU (this process, and the whole host since the CLI
+ * children belong to the fork server) and RSS.
+ *
+ *   make loadgen
+ *   ./bin/load_generator --max-users=128 --think-ms=500 --history=8
+ *   ./bin/load_generator --users=16 --step-seconds=60     # fixed load
+ *   ./bin/load_generator --help
+ */
+
+#include "claude_agent.h"
+#include "diagnostics.h"
+#include "logger.h"
+#include "process_spawner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    size_t users = 0;               // fixed user count; 0 ramps to saturation
+    size_t start_users = 1;
+    size_t max_users = 256;
+    double step_seconds = 10;
+    double interval_seconds = 1;
+    double think_ms = 1000;         // mean of an exponential distribution
+    double message_bytes = 300;     // median of a log-normal distribution
+    double message_sigma = 0.8;
+    int history = 5;                // turns per conversation before it restarts
+    double latency_limit = 2.0;     // p99 over the first step's p99 that counts as degraded
+    double min_gain = 0.1;          // throughput growth per step below which it counts as flat
+    double cli_latency_ms = 200;
+    double cli_ms_per_kb = 1;
+    double reply_bytes = 800;
+    bool fork_server = true;
+    std::string cli;                // stub CLI; defaults to stub_cli next to this binary
+    unsigned seed = 1;
+};
+
+void printUsage() {
+    std::printf(
+        "Usage: load_generator [options]\n"
+        "\n"
+        "Load:\n"
+        "  --users=N            run N users for one step instead of ramping\n"
+        "  --start-users=N      first ramp step (default 1); the count doubles per step\n"
+        "  --max-users=N        last ramp step (default 256)\n"
+        "  --step-seconds=S     length of each step (default 10)\n"
+        "  --interval=S         report interval (default 1)\n"
+        "\n"
+        "Simulated users:\n"
+        "  --think-ms=MS        mean think time between turns, exponential (default 1000)\n"
+        "  --message-bytes=B    median message size, log-normal (default 300)\n"
+        "  --message-sigma=S    spread of the message size (default 0.8)\n"
+        "  --history=N          turns per conversation before it starts over (default 5)\n"
+        "\n"
+        "Stub CLI backend:\n"
+        "  --cli-latency-ms=MS  time to first byte (default 200)\n"
+        "  --cli-ms-per-kb=MS   extra time to first byte per KB of prompt (default 1)\n"
+        "  --reply-bytes=B      reply size (default 800)\n"
+        "  --cli=PATH           stub executable (default: stub_cli beside this binary)\n"
+        "  --no-fork-server     spawn children with posix_spawn\n"
+        "\n"
+        "Saturation:\n"
+        "  --latency-limit=X    degraded once p99 exceeds X times the first step's (default 2)\n"
+        "  --min-gain=F         flat once throughput grows by less than F per step (default 0.1)\n"
+        "  --seed=N\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string name = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        double number = value.empty() ? 0 : std::atof(value.c_str());
+
+        if (name == "--help" || name == "-h") {
+            printUsage();
+            std::exit(0);
+        } else if (name == "--no-fork-server") {
+            options.fork_server = false;
+        } else if (value.empty()) {
+            std::fprintf(stderr, "Expected --option=value: %s (see --help)\n", arg.c_str());
+            return false;
+        } else if (name == "--users") {
+            options.users = static_cast<size_t>(number);
+        } else if (name == "--start-users") {
+            options.start_users = std::max<size_t>(1, static_cast<size_t>(number));
+        } else if (name == "--max-users") {
+            options.max_users = static_cast<size_t>(number);
+        } else if (name == "--step-seconds") {
+            options.step_seconds = number;
+        } else if (name == "--interval") {
+            options.interval_seconds = number;
+        } else if (name == "--think-ms") {
+            options.think_ms = number;
+        } else if (name == "--message-bytes") {
+            options.message_bytes = number;
+        } else if (name == "--message-sigma") {
+            options.message_sigma = number;
+        } else if (name == "--history") {
+            options.history = std::max(1, static_cast<int>(number));
+        } else if (name == "--cli-latency-ms") {
+            options.cli_latency_ms = number;
+        } else if (name == "--cli-ms-per-kb") {
+            options.cli_ms_per_kb = number;
+        } else if (name == "--reply-bytes") {
+            options.reply_bytes = number;
+        } else if (name == "--cli") {
+            options.cli = value;
+        } else if (name == "--latency-limit") {
+            options.latency_limit = number;
+        } else if (name == "--min-gain") {
+            options.min_gain = number;
+        } else if (name == "--seed") {
+            options.seed = static_cast<unsigned>(number);
+        } else {
+            std::fprintf(stderr, "Unknown option: %s (see --help)\n", arg.c_str());
+            return false;
+        }
+    }
+    if (options.step_seconds <= 0 || options.interval_seconds <= 0 || options.message_bytes < 1) {
+        std::fprintf(stderr, "--step-seconds, --interval and --message-bytes must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+std::string makeMessage(std::mt19937_64& random, size_t bytes) {
+    static const char* const words[] = {"please", "review", "this", "function", "and", "explain", "why", "the",
+                                        "test", "fails", "when", "input", "is", "empty", "config", "agent"};
+    std::uniform_int_distribution<size_t> pick(0, sizeof(words) / sizeof(words[0]) - 1);
+    std::string message;
+    while (message.size() < bytes) {
+        message += words[pick(random)];
+        message += ' ';
+    }
+    message.resize(bytes);
+    return message;
+}
+
+// Simulated users, each on its own thread with its own agent
+class Load {
+public:
+    Load(const Options& options, const std::string& config_file)
+        : options_(options), config_file_(config_file) {}
+    ~Load() { stop(); }
+
+    void addUsers(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            size_t id = threads_.size();
+            threads_.emplace_back([this, id]() { run(id); });
+        }
+    }
+
+    size_t users() const { return threads_.size(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    Histogram latency_us;
+    std::atomic<uint64_t> errors{0};
+
+private:
+    // Sleeps for ms unless stopped first; false once stopping
+    bool pause(double ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return !wake_.wait_for(lock, std::chrono::microseconds(static_cast<long long>(ms * 1000)),
+                               [this]() { return stopping_; });
+    }
+
+    void run(size_t id) {
+        std::mt19937_64 random(options_.seed * 1000003ULL + id);
+        std::exponential_distribution<double> think(options_.think_ms > 0 ? 1.0 / options_.think_ms : 1.0);
+        std::lognormal_distribution<double> size(std::log(options_.message_bytes), options_.message_sigma);
+
+        ClaudeAgent agent(config_file_, CliProvider::CLAUDE);
+        if (!agent.initializeCli()) {
+            errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        int turn = 0;
+        while (pause(options_.think_ms > 0 ? think(random) : 0)) {
+            if (turn == options_.history) {
+                agent.clearConversationHistory();
+                turn = 0;
+            }
+            std::string message = makeMessage(random, static_cast<size_t>(std::clamp(size(random), 1.0, 65536.0)));
+
+            auto start = std::chrono::steady_clock::now();
+            std::string response = agent.sendToCli(message);
+            latency_us.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count()));
+            if (response.compare(0, 5, "Error") == 0) {
+                errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            turn++;
+        }
+    }
+
+    const Options& options_;
+    std::string config_file_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+Histogram::Snapshot difference(const Histogram::Snapshot& now, const Histogram::Snapshot& before) {
+    Histogram::Snapshot result;
+    for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+        result.counts[i] = now.counts[i] - before.counts[i];
+    }
+    result.count = now.count - before.count;
+    result.sum = now.sum - before.sum;
+    return result;
+}
+
+// Everything a report line needs, taken at one instant
+struct Sample {
+    std::chrono::steady_clock::time_point time;
+    Histogram::Snapshot latency_us;
+    Histogram::Snapshot spawn_us;
+    uint64_t errors = 0;
+    double cpu_seconds = 0;         // this process
+    uint64_t host_busy = 0;         // /proc/stat jiffies, all cores
+    uint64_t host_total = 0;
+
+    static Sample take(const Load& load) {
+        Sample sample;
+        sample.time = std::chrono::steady_clock::now();
+        sample.latency_us = load.latency_us.snapshot();
+        sample.spawn_us = Diagnostics::getInstance().snapshot().spawn_us;
+        sample.errors = load.errors.load(std::memory_order_relaxed);
+        sample.cpu_seconds = cpuSeconds(RUSAGE_SELF);
+        hostJiffies(sample.host_busy, sample.host_total);
+        return sample;
+    }
+
+    static void hostJiffies(uint64_t& busy, uint64_t& total) {
+        unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+        if (FILE* stat = std::fopen("/proc/stat", "r")) {
+            if (std::fscanf(stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle,
+                            &iowait, &irq, &softirq, &steal) < 4) {
+                idle = 0;
+            }
+            std::fclose(stat);
+        }
+        total = user + nice + system + idle + iowait + irq + softirq + steal;
+        busy = total - idle - iowait;
+    }
+
+    static double cpuSeconds(int who) {
+        struct rusage usage{};
+        ::getrusage(who, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+};
+
+struct Period {
+    size_t users = 0;
+    double seconds = 0;
+    double throughput = 0;          // turns per second
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double spawn_p99_ms = 0;
+    uint64_t errors = 0;
+    double cpu_percent = 0;         // of one core
+    double host_cpu_percent = 0;    // of all cores
+    double rss_mb = 0;
+
+    static Period between(const Sample& before, const Sample& now, size_t users) {
+        Period period;
+        period.users = users;
+        period.seconds = std::chrono::duration<double>(now.time - before.time).count();
+        Histogram::Snapshot latency = difference(now.latency_us, before.latency_us);
+        period.throughput = latency.count / period.seconds;
+        period.p50_ms = latency.percentile(0.50) / 1000.0;
+        period.p90_ms = latency.percentile(0.90) / 1000.0;
+        period.p99_ms = latency.percentile(0.99) / 1000.0;
+        period.spawn_p99_ms = difference(now.spawn_us, before.spawn_us).percentile(0.99) / 1000.0;
+        period.errors = now.errors - before.errors;
+        period.cpu_percent = 100 * (now.cpu_seconds - before.cpu_seconds) / period.seconds;
+        uint64_t host_total = now.host_total - before.host_total;
+        period.host_cpu_percent = host_total ? 100.0 * (now.host_busy - before.host_busy) / host_total : 0;
+        period.rss_mb = Diagnostics::residentBytes() / (1024.0 * 1024.0);
+        return period;
+    }
+
+    void print(const char* label) const {
+        std::printf("  %8s  %5zu  %8.1f  %7.0f  %7.0f  %7.0f  %7.1f  %6llu  %5.0f%%  %5.0f%%  %7.1f\n", label, users,
+                    throughput, p50_ms, p90_ms, p99_ms, spawn_p99_ms, static_cast<unsigned long long>(errors),
+                    cpu_percent, host_cpu_percent, rss_mb);
+        std::fflush(stdout);
+    }
+};
+
+void printHeader() {
+    std::printf("  %8s  %5s  %8s  %7s  %7s  %7s  %7s  %6s  %6s  %6s  %7s\n", "time", "users", "turns/s", "p50 ms",
+                "p90 ms", "p99 ms", "spawn99", "errors", "cpu", "host", "rss MB");
+}
+
+// Runs the current users for one step, printing every interval; returns the whole step
+Period runStep(const Load& load, const Options& options, std::chrono::steady_clock::time_point origin) {
+    Sample start = Sample::take(load);
+    Sample previous = start;
+    auto end = start.time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.step_seconds));
+    while (previous.time < end) {
+        auto next = std::min(end, previous.time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(options.interval_seconds)));
+        std::this_thread::sleep_until(next);
+        Sample now = Sample::take(load);
+        char label[32];
+        std::snprintf(label, sizeof(label), "%.1fs", std::chrono::duration<double>(now.time - origin).count());
+        Period::between(previous, now, load.users()).print(label);
+        previous = now;
+    }
+    return Period::between(start, previous, load.users());
+}
+
+// Why a step counts as past saturation; nullptr while it still scales
+const char* degradation(const std::vector<Period>& steps, const Options& options) {
+    const Period& step = steps.back();
+    if (step.errors > 0) {
+        return "turns failing";
+    }
+    if (steps.size() < 2) {
+        return nullptr;
+    }
+    if (step.p99_ms > steps.front().p99_ms * options.latency_limit) {
+        return "p99 latency degraded";
+    }
+    if (step.throughput < steps[steps.size() - 2].throughput * (1 + options.min_gain)) {
+        return "throughput flat";
+    }
+    return nullptr;
+}
+
+std::string defaultCliPath() {
+    char path[4096];
+    ssize_t n = ::readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n <= 0) {
+        return "stub_cli";
+    }
+    path[n] = '\0';
+    return (std::filesystem::path(path).parent_path() / "stub_cli").string();
+}
+
+// Private config dir and PATH entry so the agents see only the stub
+std::string prepareEnvironment(const Options& options, const std::filesystem::path& dir) {
+    std::filesystem::create_directories(dir / "bin");
+    std::filesystem::create_symlink(std::filesystem::absolute(options.cli), dir / "bin" / "claude");
+
+    std::string config_file = (dir / "loadgen.json").string();
+    std::ofstream config(config_file);
+    config << "{\"name\": \"Load Generator User\", \"description\": \"Simulated user\", "
+           << "\"instructions\": \"Answer briefly.\", \"conversation_memory\": " << options.history
+           << ", \"timeout_seconds\": 60}\n";
+
+    std::string path = (dir / "bin").string();
+    const char* inherited = std::getenv("PATH");
+    if (inherited) {
+        path += ":" + std::string(inherited);
+    }
+    ::setenv("PATH", path.c_str(), 1);
+    ::setenv("CLAUDE_AGENT_CONFIG_DIR", dir.c_str(), 1);
+    ::setenv("STUB_CLI_LATENCY_MS", std::to_string(options.cli_latency_ms).c_str(), 1);
+    ::setenv("STUB_CLI_MS_PER_KB", std::to_string(options.cli_ms_per_kb).c_str(), 1);
+    ::setenv("STUB_CLI_REPLY_BYTES", std::to_string(options.reply_bytes).c_str(), 1);
+    return config_file;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    // The agents talk to stdout and the console log; only the report goes there
+    Logger::getInstance().enableConsoleOutput(false);
+    std::cout.rdbuf(nullptr);
+    if (options.cli.empty()) {
+        options.cli = defaultCliPath();
+    }
+    if (::access(options.cli.c_str(), X_OK) != 0) {
+        std::fprintf(stderr, "Stub CLI not found: %s (build it with make loadgen, or pass --cli)\n",
+                     options.cli.c_str());
+        return 1;
+    }
+
+    char dir_template[] = "/tmp/claude_loadgen_XXXXXX";
+    if (!::mkdtemp(dir_template)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    std::filesystem::path dir = dir_template;
+    std::string config_file = prepareEnvironment(options, dir);
+
+    // As in the app: the fork server starts before any thread, after PATH is set
+    if (options.fork_server) {
+        ProcessSpawner::getInstance().startForkServer();
+    }
+
+    std::printf("Load generator: %s users, think %.0f ms, messages ~%.0f B, history %d, "
+                "stub CLI %.0f ms + %.1f ms/KB, %s\n\n",
+                options.users ? std::to_string(options.users).c_str() : "ramping", options.think_ms,
+                options.message_bytes, options.history, options.cli_latency_ms, options.cli_ms_per_kb,
+                ProcessSpawner::getInstance().usingForkServer() ? "fork server" : "posix_spawn");
+    printHeader();
+
+    Load load(options, config_file);
+    std::vector<Period> steps;
+    size_t healthy_users = 0;
+    const char* reason = nullptr;
+    auto origin = std::chrono::steady_clock::now();
+
+    size_t target = options.users ? options.users : options.start_users;
+    while (true) {
+        load.addUsers(target - load.users());
+        steps.push_back(runStep(load, options, origin));
+        if (options.users) {
+            break;
+        }
+        reason = degradation(steps, options);
+        if (reason) {
+            break;
+        }
+        healthy_users = target;
+        if (target >= options.max_users) {
+            break;
+        }
+        target = std::min(target * 2, options.max_users);
+    }
+    load.stop();
+
+    std::printf("\nSteps:\n");
+    printHeader();
+    for (const auto& step : steps) {
+        step.print("step");
+    }
+
+    if (!options.users) {
+        if (reason) {
+            std::printf("\nSaturation: %s at %zu users; ", reason, steps.back().users);
+            if (healthy_users) {
+                const Period& last = steps[steps.size() - 2];
+                std::printf("sustained %zu users at %.1f turns/s, p99 %.0f ms\n", healthy_users, last.throughput,
+                            last.p99_ms);
+            } else {
+                std::printf("no step was healthy\n");
+            }
+        } else {
+            std::printf("\nNo saturation up to %zu users (raise --max-users)\n", steps.back().users);
+        }
+    }
+
+    ProcessSpawner::getInstance().stopForkServer();
+    std::error_code ignored;
+    std::filesystem::remove_all(dir, ignored);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Scaling benchmark for the work-stealing TaskScheduler.
+ *
+ * Runs the same workloads with 1, 2, 4, ... workers up to the hardware
+ * thread count and reports speedup and parallel efficiency against one
+ * worker: a recursively split computation (coarse tasks, nested group
+ * joins, mostly stealing) and a flood of tiny tasks submitted from outside
+ * the pool (scheduling overhead, shared queue contention).
+ *
+ *   make bench
+ */
+
+#include "task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int ROUNDS = 3;
+
+double bestSeconds(const std::function<void()>& fn) {
+    double best = 1e9;
+    for (int i = 0; i < ROUNDS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+uint64_t fib(uint64_t n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+// fib(n) split into tasks down to the cutoff, then computed serially
+uint64_t parallelFib(TaskScheduler& scheduler, uint64_t n, uint64_t cutoff) {
+    if (n <= cutoff) {
+        return fib(n);
+    }
+    uint64_t left = 0;
+    TaskGroup group(scheduler);
+    group.run([&]() { left = parallelFib(scheduler, n - 1, cutoff); });
+    uint64_t right = parallelFib(scheduler, n - 2, cutoff);
+    group.wait();
+    return left + right;
+}
+
+void floodTasks(TaskScheduler& scheduler, size_t tasks) {
+    std::atomic<uint64_t> sink{0};
+    TaskGroup group(scheduler);
+    for (size_t i = 0; i < tasks; ++i) {
+        group.run([&sink, i]() {
+            uint64_t x = i;
+            for (int k = 0; k < 64; ++k) {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            }
+            sink.fetch_add(x & 1, std::memory_order_relaxed);
+        });
+    }
+    group.wait();
+}
+
+std::vector<size_t> workerCounts() {
+    size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> counts;
+    for (size_t n = 1; n < hardware; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(hardware);
+    return counts;
+}
+
+} // namespace
+
+int main() {
+    const uint64_t fib_n = 34;
+    const uint64_t cutoff = 18;
+    const size_t flood = 200000;
+
+    std::printf("Task scheduler scaling (%u hardware threads)\n\n", std::thread::hardware_concurrency());
+    std::printf("  %7s  %22s  %8s  %6s  %26s  %8s\n", "workers", "fib(34) split to 18", "speedup", "eff.",
+                "200k tiny tasks", "speedup");
+
+    double fib_base = 0;
+    double flood_base = 0;
+    for (size_t workers : workerCounts()) {
+        TaskScheduler scheduler(workers);
+        volatile uint64_t result = 0;
+        double fib_seconds = bestSeconds([&] { result = parallelFib(scheduler, fib_n, cutoff); });
+        double flood_seconds = bestSeconds([&] { floodTasks(scheduler, flood); });
+        (void)result;
+        if (workers == 1) {
+            fib_base = fib_seconds;
+            flood_base = flood_seconds;
+        }
+        double speedup = fib_base / fib_seconds;
+        std::printf("  %7zu  %19.1f ms  %7.2fx  %5.0f%%  %14.2f Mtasks/s      %7.2fx\n", workers,
+                    fib_seconds * 1000, speedup, 100.0 * speedup / workers,
+                    flood / flood_seconds / 1e6, flood_base / flood_seconds);
+    }
+    return 0;
+}
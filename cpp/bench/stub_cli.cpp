@@ -0,0 +1,90 @@
+/**
+ * Stand-in for the claude CLI, used as the backend by load_generator.
+ *
+ * Accepts the arguments ClaudeAgent passes (--print, --append-system-prompt,
+ * the prompt or "-" for stdin), reads the prompt, waits as a model would
+ * and writes a reply in chunks. Timing comes from the environment so the
+ * load generator can set it once for every child:
+ *
+ *   STUB_CLI_LATENCY_MS   time to the first byte (default 200)
+ *   STUB_CLI_MS_PER_KB    extra time to first byte per KB of prompt (default 1)
+ *   STUB_CLI_REPLY_BYTES  reply size (default 800)
+ *   STUB_CLI_CHUNKS       writes the reply is split into (default 4)
+ *   STUB_CLI_CHUNK_MS     pause between chunks (default 20)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+double setting(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    return value && *value ? std::atof(value) : fallback;
+}
+
+void pause(double ms) {
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(ms * 1000)));
+    }
+}
+
+std::string readAll(int fd) {
+    std::string text;
+    char buffer[16384];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, n);
+    }
+    return text;
+}
+
+void writeAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(STDOUT_FILENO, data, size);
+        if (n <= 0) {
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--version") == 0) {
+        std::printf("stub-cli 1.0 (load generator backend)\n");
+        return 0;
+    }
+
+    std::string prompt = argc > 1 && std::strcmp(argv[argc - 1], "-") != 0 ? argv[argc - 1] : readAll(STDIN_FILENO);
+
+    pause(setting("STUB_CLI_LATENCY_MS", 200) + setting("STUB_CLI_MS_PER_KB", 1) * prompt.size() / 1024.0);
+
+    static const char words[] = "the agent answers with a steady stream of plausible words ";
+    size_t reply_bytes = static_cast<size_t>(std::max(1.0, setting("STUB_CLI_REPLY_BYTES", 800)));
+    std::string reply;
+    while (reply.size() < reply_bytes) {
+        reply += words;
+    }
+    reply.resize(reply_bytes - 1);
+    reply += '\n';
+
+    size_t chunks = static_cast<size_t>(std::max(1.0, setting("STUB_CLI_CHUNKS", 4)));
+    double chunk_ms = setting("STUB_CLI_CHUNK_MS", 20);
+    size_t chunk_size = (reply.size() + chunks - 1) / chunks;
+    for (size_t at = 0; at < reply.size(); at += chunk_size) {
+        if (at > 0) {
+            pause(chunk_ms);
+        }
+        writeAll(reply.data() + at, std::min(chunk_size, reply.size() - at));
+    }
+    return 0;
+}
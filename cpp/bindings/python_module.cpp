@@ -0,0 +1,837 @@
+/**
+ * Python extension module "claude_agent_core": the C++ ClaudeAgent, JSON
+ * reader/writer and process runner, for Python front ends and scripts.
+ *
+ *   make python-module
+ *   PYTHONPATH=bin python3 -c "import claude_agent_core"
+ *
+ * Every call that waits on a CLI child (send, stream, initialize_cli, run)
+ * releases the GIL, so other Python threads keep running while a turn is
+ * in flight. Agent.stream() runs the turn on its own thread and yields the
+ * answer as the CLI produces it. An agent runs one call at a time; a second
+ * thread calling into the same agent waits for the first.
+ *
+ * The module does not start the fork server (it has to run before any
+ * thread exists), so children are started with posix_spawn.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "claude_agent.h"
+#include "json_utils.h"
+#include "process_spawner.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <sys/wait.h>
+
+namespace {
+
+PyObject* g_agent_type = nullptr;
+PyObject* g_stream_type = nullptr;
+
+// ---- conversions ---------------------------------------------------------
+
+PyObject* toPython(const std::string& text) {
+    return PyUnicode_DecodeUTF8(text.data(), static_cast<Py_ssize_t>(text.size()), "replace");
+}
+
+bool fromPython(PyObject* object, std::string& text) {
+    Py_ssize_t size;
+    const char* data = PyUnicode_AsUTF8AndSize(object, &size);
+    if (!data) {
+        return false;
+    }
+    text.assign(data, size);
+    return true;
+}
+
+bool fromPython(PyObject* sequence, std::vector<std::string>& items, const char* what) {
+    PyObject* fast = PySequence_Fast(sequence, what);
+    if (!fast) {
+        return false;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(fast);
+    items.clear();
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        std::string item;
+        if (!fromPython(PySequence_Fast_GET_ITEM(fast, i), item)) {
+            Py_DECREF(fast);
+            return false;
+        }
+        items.push_back(std::move(item));
+    }
+    Py_DECREF(fast);
+    return true;
+}
+
+// Integral numbers come back as int, the rest as float: the C++ DOM keeps
+// doubles, so "1" and "1.0" read the same.
+PyObject* toPython(const json::Value& value) {
+    switch (value.getType()) {
+        case json::Type::STRING:
+            return toPython(value.asString());
+        case json::Type::NUMBER: {
+            double number = value.asNumber();
+            if (std::isfinite(number) && number == std::floor(number) && std::fabs(number) < 9007199254740992.0) {
+                return PyLong_FromLongLong(static_cast<long long>(number));
+            }
+            return PyFloat_FromDouble(number);
+        }
+        case json::Type::BOOLEAN:
+            return PyBool_FromLong(value.asBoolean());
+        case json::Type::NULL_VALUE:
+            Py_RETURN_NONE;
+        case json::Type::ARRAY: {
+            const json::Array& items = value.asArray();
+            PyObject* list = PyList_New(static_cast<Py_ssize_t>(items.size()));
+            if (!list) {
+                return nullptr;
+            }
+            for (size_t i = 0; i < items.size(); ++i) {
+                PyObject* item = items[i] ? toPython(*items[i]) : Py_NewRef(Py_None);
+                if (!item) {
+                    Py_DECREF(list);
+                    return nullptr;
+                }
+                PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+            }
+            return list;
+        }
+        case json::Type::OBJECT: {
+            PyObject* dict = PyDict_New();
+            if (!dict) {
+                return nullptr;
+            }
+            for (const auto& [key, member] : value.asObject()) {
+                PyObject* item = member ? toPython(*member) : Py_NewRef(Py_None);
+                if (!item || PyDict_SetItemString(dict, key.c_str(), item) < 0) {
+                    Py_XDECREF(item);
+                    Py_DECREF(dict);
+                    return nullptr;
+                }
+                Py_DECREF(item);
+            }
+            return dict;
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+std::shared_ptr<json::Value> fromPythonValue(PyObject* object);
+
+std::shared_ptr<json::Value> fromPythonContainer(PyObject* object) {
+    if (PyDict_Check(object)) {
+        auto result = json::object();
+        auto* target = static_cast<json::ObjectValue*>(result.get());
+        PyObject* key;
+        PyObject* member;
+        Py_ssize_t position = 0;
+        while (PyDict_Next(object, &position, &key, &member)) {
+            std::string name;
+            if (!PyUnicode_Check(key)) {
+                PyErr_SetString(PyExc_TypeError, "JSON object keys must be str");
+                return nullptr;
+            }
+            auto converted = fromPythonValue(member);
+            if (!fromPython(key, name) || !converted) {
+                return nullptr;
+            }
+            target->set(name, converted);
+        }
+        return result;
+    }
+
+    PyObject* fast = PySequence_Fast(object, "not JSON serializable");
+    if (!fast) {
+        return nullptr;
+    }
+    auto result = json::array();
+    auto* target = static_cast<json::ArrayValue*>(result.get());
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(fast); ++i) {
+        auto converted = fromPythonValue(PySequence_Fast_GET_ITEM(fast, i));
+        if (!converted) {
+            Py_DECREF(fast);
+            return nullptr;
+        }
+        target->push(converted);
+    }
+    Py_DECREF(fast);
+    return result;
+}
+
+// Sets a Python exception and returns nullptr for anything JSON cannot hold
+std::shared_ptr<json::Value> fromPythonValue(PyObject* object) {
+    if (object == Py_None) {
+        return json::null();
+    }
+    if (PyBool_Check(object)) {
+        return json::boolean(object == Py_True);
+    }
+    if (PyLong_Check(object) || PyFloat_Check(object)) {
+        double number = PyFloat_AsDouble(object);
+        if (number == -1.0 && PyErr_Occurred()) {
+            return nullptr;
+        }
+        return json::number(number);
+    }
+    if (PyUnicode_Check(object)) {
+        std::string text;
+        return fromPython(object, text) ? json::string(text) : nullptr;
+    }
+    if (PyDict_Check(object) || PyList_Check(object) || PyTuple_Check(object)) {
+        if (Py_EnterRecursiveCall(" while converting to JSON")) {
+            return nullptr;
+        }
+        auto result = fromPythonContainer(object);
+        Py_LeaveRecursiveCall();
+        return result;
+    }
+    PyErr_Format(PyExc_TypeError, "Object of type %s is not JSON serializable", Py_TYPE(object)->tp_name);
+    return nullptr;
+}
+
+PyObject* raise(const std::exception& e) {
+    if (auto* parse_error = dynamic_cast<const json::ParseError*>(&e)) {
+        return PyErr_Format(PyExc_ValueError, "%s (line %zu, column %zu)", parse_error->message().c_str(),
+                            parse_error->line(), parse_error->column());
+    }
+    return PyErr_Format(PyExc_RuntimeError, "%s", e.what());
+}
+
+// ---- Agent ---------------------------------------------------------------
+
+struct AgentObject {
+    PyObject_HEAD
+    ClaudeAgent* agent;
+    std::mutex* mutex;      // one call at a time, shared with running streams
+};
+
+// Locks the agent without holding the GIL while waiting for a stream
+class AgentLock {
+public:
+    explicit AgentLock(AgentObject* self) : lock_(*self->mutex, std::defer_lock) {
+        Py_BEGIN_ALLOW_THREADS
+        lock_.lock();
+        Py_END_ALLOW_THREADS
+    }
+
+private:
+    std::unique_lock<std::mutex> lock_;
+};
+
+bool parseProvider(const char* name, CliProvider& provider) {
+    std::string text = name ? name : "auto";
+    if (text == "auto") {
+        provider = CliProvider::AUTO;
+    } else if (text == "claude") {
+        provider = CliProvider::CLAUDE;
+    } else if (text == "gemini") {
+        provider = CliProvider::GEMINI;
+    } else {
+        PyErr_Format(PyExc_ValueError, "Unknown provider '%s' (expected auto, claude or gemini)", name);
+        return false;
+    }
+    return true;
+}
+
+int agentInit(PyObject* object, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"config_file", "provider", nullptr};
+    const char* config_file = "agent_config.json";
+    const char* provider_name = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sz", const_cast<char**>(keywords), &config_file,
+                                     &provider_name)) {
+        return -1;
+    }
+    CliProvider provider;
+    if (!parseProvider(provider_name, provider)) {
+        return -1;
+    }
+
+    auto* self = reinterpret_cast<AgentObject*>(object);
+    if (self->agent) {
+        PyErr_SetString(PyExc_RuntimeError, "Agent is already initialized");
+        return -1;
+    }
+    try {
+        self->agent = new ClaudeAgent(config_file, provider);
+        self->mutex = new std::mutex;
+    } catch (const std::exception& e) {
+        delete self->agent;
+        self->agent = nullptr;
+        raise(e);
+        return -1;
+    }
+    return 0;
+}
+
+void agentDealloc(PyObject* object) {
+    auto* self = reinterpret_cast<AgentObject*>(object);
+    PyTypeObject* type = Py_TYPE(object);
+    delete self->agent;
+    delete self->mutex;
+    type->tp_free(object);
+    Py_DECREF(type);
+}
+
+ClaudeAgent* agentOf(PyObject* object) {
+    auto* self = reinterpret_cast<AgentObject*>(object);
+    if (!self->agent) {
+        PyErr_SetString(PyExc_RuntimeError, "Agent is not initialized");
+    }
+    return self->agent;
+}
+
+PyObject* agentInitializeCli(PyObject* object, PyObject*) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    bool found;
+    Py_BEGIN_ALLOW_THREADS
+    found = agent->initializeCli();
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(found);
+}
+
+PyObject* agentSend(PyObject* object, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"message", "use_system_prompt", nullptr};
+    const char* message;
+    Py_ssize_t length;
+    int use_system_prompt = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|p", const_cast<char**>(keywords), &message, &length,
+                                     &use_system_prompt)) {
+        return nullptr;
+    }
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+
+    std::string text(message, length);
+    std::string response;
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    Py_BEGIN_ALLOW_THREADS
+    response = agent->sendToCli(text, use_system_prompt);
+    Py_END_ALLOW_THREADS
+    return toPython(response);
+}
+
+PyObject* agentHistory(PyObject* object, PyObject*) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    auto history = agent->getConversationHistory();
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(history.size()));
+    if (!list) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < history.size(); ++i) {
+        PyObject* user = toPython(history[i].user);
+        PyObject* assistant = toPython(history[i].assistant);
+        PyObject* pair = user && assistant ? PyTuple_Pack(2, user, assistant) : nullptr;
+        Py_XDECREF(user);
+        Py_XDECREF(assistant);
+        if (!pair) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), pair);
+    }
+    return list;
+}
+
+PyObject* agentClearHistory(PyObject* object, PyObject*) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    agent->clearConversationHistory();
+    Py_RETURN_NONE;
+}
+
+PyObject* agentLoadConfigFile(PyObject* object, PyObject* args) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return nullptr;
+    }
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    return PyBool_FromLong(agent->loadConfigFromFile(path));
+}
+
+PyObject* agentSaveConfig(PyObject* object, PyObject*) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    return PyBool_FromLong(agent->saveConfig());
+}
+
+PyObject* agentSwitchProvider(PyObject* object, PyObject* args) {
+    const char* name;
+    CliProvider provider;
+    if (!PyArg_ParseTuple(args, "s", &name) || !parseProvider(name, provider)) {
+        return nullptr;
+    }
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    bool switched;
+    Py_BEGIN_ALLOW_THREADS
+    switched = agent->switchCliProvider(provider);
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(switched);
+}
+
+PyObject* agentStream(PyObject* object, PyObject* args, PyObject* kwargs);
+
+PyObject* agentGetConfig(PyObject* object, void*) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    auto config = agent->getConfig();
+    if (!config) {
+        Py_RETURN_NONE;
+    }
+    return toPython(*config);
+}
+
+int agentSetConfig(PyObject* object, PyObject* value, void*) {
+    if (!value || !PyDict_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "config must be a dict");
+        return -1;
+    }
+    ClaudeAgent* agent = agentOf(object);
+    auto config = agent ? fromPythonValue(value) : nullptr;
+    if (!config) {
+        return -1;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    agent->setConfig(config);
+    return 0;
+}
+
+template <typename Getter>
+PyObject* agentProperty(PyObject* object, Getter getter) {
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+    AgentLock lock(reinterpret_cast<AgentObject*>(object));
+    try {
+        return getter(*agent);
+    } catch (const std::exception& e) {
+        return raise(e);
+    }
+}
+
+PyObject* agentName(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) { return toPython(agent.getName()); });
+}
+
+PyObject* agentDescription(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) { return toPython(agent.getDescription()); });
+}
+
+PyObject* agentInstructions(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) { return toPython(agent.getInstructions()); });
+}
+
+PyObject* agentConversationStarters(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) -> PyObject* {
+        auto starters = agent.getConversationStarters();
+        PyObject* list = PyList_New(static_cast<Py_ssize_t>(starters.size()));
+        for (size_t i = 0; list && i < starters.size(); ++i) {
+            PyObject* item = toPython(starters[i]);
+            if (!item) {
+                Py_CLEAR(list);
+                break;
+            }
+            PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), item);
+        }
+        return list;
+    });
+}
+
+PyObject* agentActiveProvider(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) { return toPython(agent.getActiveProviderName()); });
+}
+
+PyObject* agentContextBudget(PyObject* object, void*) {
+    return agentProperty(object, [](ClaudeAgent& agent) { return PyLong_FromSize_t(agent.getContextBudget()); });
+}
+
+PyMethodDef agent_methods[] = {
+    {"initialize_cli", agentInitializeCli, METH_NOARGS,
+     "Detects the claude or gemini CLI; returns whether one was found."},
+    {"send", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(agentSend)),
+     METH_VARARGS | METH_KEYWORDS,
+     "send(message, use_system_prompt=True) -> str\n\nRuns one turn and returns the answer."},
+    {"stream", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(agentStream)),
+     METH_VARARGS | METH_KEYWORDS,
+     "stream(message, use_system_prompt=True) -> Stream\n\n"
+     "Runs one turn in the background and iterates over the answer as it arrives."},
+    {"history", agentHistory, METH_NOARGS, "Conversation so far as a list of (user, assistant) pairs."},
+    {"clear_history", agentClearHistory, METH_NOARGS, "Forgets the conversation."},
+    {"load_config_file", agentLoadConfigFile, METH_VARARGS, "load_config_file(path) -> bool"},
+    {"save_config", agentSaveConfig, METH_NOARGS, "Saves the current config to its file."},
+    {"switch_provider", agentSwitchProvider, METH_VARARGS, "switch_provider('claude' | 'gemini' | 'auto') -> bool"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef agent_getset[] = {
+    {"config", agentGetConfig, agentSetConfig, "The agent's config as a dict.", nullptr},
+    {"name", agentName, nullptr, nullptr, nullptr},
+    {"description", agentDescription, nullptr, nullptr, nullptr},
+    {"instructions", agentInstructions, nullptr, nullptr, nullptr},
+    {"conversation_starters", agentConversationStarters, nullptr, nullptr, nullptr},
+    {"active_provider", agentActiveProvider, nullptr, nullptr, nullptr},
+    {"context_budget", agentContextBudget, nullptr, "Bytes of history sent with each message.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot agent_slots[] = {
+    {Py_tp_doc, const_cast<char*>("Agent(config_file='agent_config.json', provider='auto')\n\n"
+                                  "A ClaudeAgent; call initialize_cli() before sending.")},
+    {Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew)},
+    {Py_tp_init, reinterpret_cast<void*>(agentInit)},
+    {Py_tp_dealloc, reinterpret_cast<void*>(agentDealloc)},
+    {Py_tp_methods, agent_methods},
+    {Py_tp_getset, agent_getset},
+    {0, nullptr}
+};
+
+PyType_Spec agent_spec = {"claude_agent_core.Agent", sizeof(AgentObject), 0, Py_TPFLAGS_DEFAULT, agent_slots};
+
+// ---- Stream --------------------------------------------------------------
+
+// Shared by the Python iterator and the thread running the turn
+struct StreamState {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::string> chunks;
+    std::string response;
+    bool done = false;
+    bool cancelled = false;
+    int cancel_pipe[2] = {-1, -1};  // written on cancel; communicate() polls the read end
+
+    StreamState() {
+        if (::pipe2(cancel_pipe, O_CLOEXEC) != 0) {
+            cancel_pipe[0] = cancel_pipe[1] = -1;
+        }
+    }
+    ~StreamState() {
+        for (int fd : cancel_pipe) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+};
+
+struct StreamObject {
+    PyObject_HEAD
+    PyObject* agent;        // keeps the agent alive while the turn runs
+    StreamState* state;
+    std::thread* worker;
+    bool yielded;           // any chunk handed out yet
+};
+
+void streamStop(StreamObject* self) {
+    if (!self->worker) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(self->state->mutex);
+        self->state->cancelled = true;
+    }
+    // Wakes communicate() even while the CLI is silent, so the child is terminated right away
+    if (self->state->cancel_pipe[1] >= 0) {
+        char byte = 0;
+        (void)!::write(self->state->cancel_pipe[1], &byte, 1);
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->worker->join();
+    Py_END_ALLOW_THREADS
+    delete self->worker;
+    self->worker = nullptr;
+}
+
+PyObject* agentStream(PyObject* object, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"message", "use_system_prompt", nullptr};
+    const char* message;
+    Py_ssize_t length;
+    int use_system_prompt = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|p", const_cast<char**>(keywords), &message, &length,
+                                     &use_system_prompt)) {
+        return nullptr;
+    }
+    ClaudeAgent* agent = agentOf(object);
+    if (!agent) {
+        return nullptr;
+    }
+
+    auto* self = reinterpret_cast<StreamObject*>(PyType_GenericAlloc(reinterpret_cast<PyTypeObject*>(g_stream_type), 0));
+    if (!self) {
+        return nullptr;
+    }
+    Py_INCREF(object);
+    self->agent = object;
+    self->state = new StreamState;
+
+    StreamState* state = self->state;
+    std::mutex* agent_mutex = reinterpret_cast<AgentObject*>(object)->mutex;
+    std::string text(message, length);
+    bool system_prompt = use_system_prompt;
+    self->worker = new std::thread([state, agent, agent_mutex, text, system_prompt]() {
+        auto on_output = [state](const std::string& chunk) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->chunks.push_back(chunk);
+            state->ready.notify_one();
+            return !state->cancelled;
+        };
+        std::string response;
+        {
+            std::lock_guard<std::mutex> lock(*agent_mutex);
+            response = agent->sendToCli(text, system_prompt, on_output, state->cancel_pipe[0]);
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->response = response;
+        state->done = true;
+        state->ready.notify_one();
+    });
+    return reinterpret_cast<PyObject*>(self);
+}
+
+// Chunks as the CLI writes them. A turn that streamed nothing (no CLI, an
+// error) yields its final response once instead.
+PyObject* streamNext(PyObject* object) {
+    auto* self = reinterpret_cast<StreamObject*>(object);
+    StreamState* state = self->state;
+    std::string chunk;
+    bool have_chunk = false;
+
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->ready.wait(lock, [state]() { return !state->chunks.empty() || state->done; });
+        if (!state->chunks.empty()) {
+            chunk = std::move(state->chunks.front());
+            state->chunks.pop_front();
+            have_chunk = true;
+        } else if (!self->yielded && !state->response.empty()) {
+            chunk = state->response;
+            have_chunk = true;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!have_chunk) {
+        return nullptr;     // StopIteration
+    }
+    self->yielded = true;
+    return toPython(chunk);
+}
+
+PyObject* streamClose(PyObject* object, PyObject*) {
+    streamStop(reinterpret_cast<StreamObject*>(object));
+    Py_RETURN_NONE;
+}
+
+PyObject* streamResponse(PyObject* object, void*) {
+    auto* self = reinterpret_cast<StreamObject*>(object);
+    std::lock_guard<std::mutex> lock(self->state->mutex);
+    if (!self->state->done) {
+        Py_RETURN_NONE;
+    }
+    return toPython(self->state->response);
+}
+
+void streamDealloc(PyObject* object) {
+    auto* self = reinterpret_cast<StreamObject*>(object);
+    PyTypeObject* type = Py_TYPE(object);
+    streamStop(self);
+    delete self->state;
+    Py_XDECREF(self->agent);
+    type->tp_free(object);
+    Py_DECREF(type);
+}
+
+PyMethodDef stream_methods[] = {
+    {"close", streamClose, METH_NOARGS,
+     "Cancels the turn if still running, terminating the CLI, and waits for it to end."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef stream_getset[] = {
+    {"response", streamResponse, nullptr,
+     "The turn's final answer as recorded in the history; None while it runs.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot stream_slots[] = {
+    {Py_tp_doc, const_cast<char*>("Iterator over an answer as the CLI produces it.")},
+    {Py_tp_iter, reinterpret_cast<void*>(PyObject_SelfIter)},
+    {Py_tp_iternext, reinterpret_cast<void*>(streamNext)},
+    {Py_tp_dealloc, reinterpret_cast<void*>(streamDealloc)},
+    {Py_tp_methods, stream_methods},
+    {Py_tp_getset, stream_getset},
+    {0, nullptr}
+};
+
+PyType_Spec stream_spec = {"claude_agent_core.Stream", sizeof(StreamObject), 0,
+                           Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION, stream_slots};
+
+// ---- module functions ----------------------------------------------------
+
+PyObject* jsonLoads(PyObject*, PyObject* args) {
+    const char* text;
+    Py_ssize_t length;
+    if (!PyArg_ParseTuple(args, "s#", &text, &length)) {
+        return nullptr;
+    }
+    try {
+        auto value = json::parse(std::string(text, length));
+        return toPython(*value);
+    } catch (const std::exception& e) {
+        return raise(e);
+    }
+}
+
+PyObject* jsonDumps(PyObject*, PyObject* object) {
+    auto value = fromPythonValue(object);
+    return value ? toPython(value->toString()) : nullptr;
+}
+
+// Exit code, or minus the signal number, as subprocess reports it
+int exitCode(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return -WTERMSIG(status);
+    }
+    return status;
+}
+
+PyObject* run(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"argv", "input", "env", "timeout", "max_bytes", nullptr};
+    PyObject* argv_object;
+    const char* input = "";
+    Py_ssize_t input_length = 0;
+    PyObject* env_object = Py_None;
+    double timeout = 0;
+    Py_ssize_t max_bytes = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|s#Odn", const_cast<char**>(keywords), &argv_object, &input,
+                                     &input_length, &env_object, &timeout, &max_bytes)) {
+        return nullptr;
+    }
+
+    std::vector<std::string> argv;
+    std::vector<std::string> env;
+    if (!fromPython(argv_object, argv, "argv must be a sequence of str") ||
+        (env_object != Py_None && !fromPython(env_object, env, "env must be a sequence of 'NAME=value' str"))) {
+        return nullptr;
+    }
+    if (argv.empty()) {
+        PyErr_SetString(PyExc_ValueError, "argv must not be empty");
+        return nullptr;
+    }
+
+    OutputLimits limits;
+    limits.timeout_ms = timeout > 0 ? static_cast<int>(std::min(timeout * 1000, 2147483647.0)) : 0;
+    limits.max_bytes = max_bytes > 0 ? static_cast<size_t>(max_bytes) : 0;
+    std::string stdin_input(input, input_length);
+    std::string output;
+    OutputEnd end = OutputEnd::COMPLETE;
+    int status = -1;
+    bool spawned;
+
+    Py_BEGIN_ALLOW_THREADS
+    {
+        auto& spawner = ProcessSpawner::getInstance();
+        ChildProcess child;
+        spawned = spawner.spawn(argv, child, env);
+        if (spawned) {
+            output = spawner.communicate(child, stdin_input, limits, &end);
+            if (end != OutputEnd::COMPLETE) {
+                spawner.terminate(child);
+            }
+            status = spawner.wait(child);
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!spawned) {
+        return PyErr_Format(PyExc_OSError, "Failed to start %s", argv[0].c_str());
+    }
+    if (end == OutputEnd::TIMEOUT) {
+        std::string message = argv[0] + " timed out after " + std::to_string(limits.timeout_ms) + " ms";
+        PyErr_SetString(PyExc_TimeoutError, message.c_str());
+        return nullptr;
+    }
+    PyObject* text = toPython(output);
+    if (!text) {
+        return nullptr;
+    }
+    return Py_BuildValue("(iN)", exitCode(status), text);
+}
+
+PyMethodDef module_methods[] = {
+    {"json_loads", jsonLoads, METH_VARARGS, "json_loads(text) -> object\n\nParses with the C++ JSON reader."},
+    {"json_dumps", jsonDumps, METH_O, "json_dumps(object) -> str\n\nCanonical JSON text (sorted keys, no spaces)."},
+    {"run", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(run)), METH_VARARGS | METH_KEYWORDS,
+     "run(argv, input='', env=None, timeout=0, max_bytes=0) -> (returncode, output)\n\n"
+     "Runs argv without a shell, feeding input to stdin. env entries ('NAME=value') are added to the\n"
+     "environment. Raises TimeoutError when timeout seconds pass first; output beyond max_bytes is cut."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT,
+    "claude_agent_core",
+    "C++ core of the agent: ClaudeAgent, JSON and the CLI process runner.",
+    -1,
+    module_methods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_claude_agent_core() {
+    PyObject* module = PyModule_Create(&module_def);
+    if (!module) {
+        return nullptr;
+    }
+    g_agent_type = PyType_FromSpec(&agent_spec);
+    g_stream_type = PyType_FromSpec(&stream_spec);
+    if (!g_agent_type || !g_stream_type || PyModule_AddObjectRef(module, "Agent", g_agent_type) < 0 ||
+        PyModule_AddObjectRef(module, "Stream", g_stream_type) < 0) {
+        Py_XDECREF(g_agent_type);
+        Py_XDECREF(g_stream_type);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
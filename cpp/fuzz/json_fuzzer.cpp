@@ -0,0 +1,132 @@
+/**
+ * libFuzzer harness for the JSON parser.
+ *
+ * Besides crashes (run under AddressSanitizer), it flags performance cliffs:
+ * inputs whose parse time grows super-linearly with their length, and inputs
+ * that get disproportionately slower when fed to the streaming reader in
+ * small chunks. Either case aborts so libFuzzer saves the input.
+ *
+ *   make fuzz && ./bin/json_fuzzer -max_len=65536 corpus/
+ *
+ * Built with -DJSON_FUZZ_STANDALONE it becomes a replay tool that runs the
+ * same checks over files given on the command line.
+ */
+
+#include "json_utils.h"
+#include "json_reader.h"
+#include "json_cbor.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+
+// Linear parsing of a quarter-size prefix should take ~1/4 of the time; allow
+// generous slack for noise before calling it a cliff.
+constexpr double CLIFF_RATIO = 16.0;
+constexpr double CHUNKED_RATIO = 64.0;
+constexpr int64_t NOISE_FLOOR_NS = 2000000; // below 2ms timings are unreliable
+constexpr size_t MIN_CLIFF_SIZE = 256;
+
+void parseWhole(const char* data, size_t size) {
+    try {
+        json::Reader reader(data, size, true);
+        json::DomBuilder builder;
+        json::Event event;
+        while (reader.next(event) == json::Reader::Status::EVENT) {
+            if (builder.handle(event)) {
+                builder.take();
+            }
+        }
+    } catch (const json::ParseError&) {
+        // Malformed input is expected; only crashes and slowness matter
+    }
+}
+
+void parseChunked(const char* data, size_t size, size_t chunk) {
+    try {
+        json::StreamParser parser;
+        for (size_t offset = 0; offset < size; offset += chunk) {
+            parser.feed(data + offset, std::min(chunk, size - offset));
+            while (parser.nextDocument()) {}
+        }
+        parser.finish();
+        while (parser.nextDocument()) {}
+    } catch (const json::ParseError&) {
+    }
+}
+
+template <typename Fn>
+int64_t bestOfThree(Fn fn) {
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < 3; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, static_cast<int64_t>(elapsed));
+    }
+    return best;
+}
+
+[[noreturn]] void reportCliff(const char* kind, size_t size, int64_t slow_ns, int64_t base_ns) {
+    std::fprintf(stderr, "PERFORMANCE CLIFF (%s): %zu bytes, %lld ns vs %lld ns baseline\n",
+                 kind, size, static_cast<long long>(slow_ns), static_cast<long long>(base_ns));
+    std::abort();
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t size) {
+    const char* data = reinterpret_cast<const char*>(bytes);
+
+    // Crash detection: the plain entry point plus a chunked stream
+    try {
+        json::parse(std::string(data, size));
+    } catch (const json::ParseError&) {
+    }
+    parseChunked(data, size, 7);
+    try {
+        json::CborView::open(data, size).materialize();
+    } catch (const json::ParseError&) {
+    }
+
+    if (size < MIN_CLIFF_SIZE) {
+        return 0;
+    }
+
+    int64_t full = bestOfThree([&] { parseWhole(data, size); });
+    if (full < NOISE_FLOOR_NS) {
+        return 0;
+    }
+
+    int64_t quarter = bestOfThree([&] { parseWhole(data, size / 4); });
+    if (full > quarter * CLIFF_RATIO) {
+        reportCliff("size scaling", size, full, quarter);
+    }
+
+    int64_t chunked = bestOfThree([&] { parseChunked(data, size, 1); });
+    if (chunked > full * CHUNKED_RATIO) {
+        reportCliff("chunked feed", size, chunked, full);
+    }
+
+    return 0;
+}
+
+#ifdef JSON_FUZZ_STANDALONE
+#include <fstream>
+#include <iterator>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i], std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+        std::printf("%s: ok\n", argv[i]);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+class ClaudeAgent;
+
+// Value that notifies its observers when it is set to something different
+template <typename T>
+class Observable {
+public:
+    using Observer = std::function<void(const T&)>;
+
+    const T& get() const { return value_; }
+
+    // Returns whether the value changed (and observers were called)
+    bool set(const T& value) {
+        if (value == value_) {
+            return false;
+        }
+        value_ = value;
+        for (const auto& observer : observers_) {
+            observer(value_);
+        }
+        return true;
+    }
+
+    void observe(Observer observer) { observers_.push_back(std::move(observer)); }
+
+private:
+    T value_{};
+    std::vector<Observer> observers_;
+};
+
+// One step of a list edit script. Steps apply in order, and each index
+// refers to the list as the previous steps left it.
+template <typename T>
+struct ListChange {
+    enum class Kind { INSERT, REMOVE, UPDATE };
+
+    Kind kind;
+    size_t index;
+    T value;    // the new item, for INSERT and UPDATE
+};
+
+// List that notifies its observers with the shortest edit script (inserts,
+// removals and in-place updates) from its previous contents, so a bound
+// widget list changes only where the items did.
+template <typename T>
+class ObservableList {
+public:
+    using Observer = std::function<void(const std::vector<ListChange<T>>&)>;
+
+    const std::vector<T>& get() const { return items_; }
+
+    // Returns whether the list changed (and observers were called)
+    bool set(const std::vector<T>& items) {
+        auto changes = diff(items_, items);
+        if (changes.empty()) {
+            return false;
+        }
+        items_ = items;
+        for (const auto& observer : observers_) {
+            observer(changes);
+        }
+        return true;
+    }
+
+    void observe(Observer observer) { observers_.push_back(std::move(observer)); }
+
+    // Edit distance over the suffixes of both lists, then one forward walk
+    // choosing at each step a move that keeps the remaining cost minimal.
+    // Quadratic, which suits the short lists bound to widgets.
+    static std::vector<ListChange<T>> diff(const std::vector<T>& from, const std::vector<T>& to) {
+        size_t n = from.size();
+        size_t m = to.size();
+        std::vector<std::vector<size_t>> cost(n + 1, std::vector<size_t>(m + 1, 0));
+        for (size_t i = n + 1; i-- > 0;) {
+            for (size_t j = m + 1; j-- > 0;) {
+                if (i == n || j == m) {
+                    cost[i][j] = (n - i) + (m - j);
+                } else if (from[i] == to[j]) {
+                    cost[i][j] = cost[i + 1][j + 1];
+                } else {
+                    cost[i][j] = 1 + std::min({cost[i + 1][j + 1], cost[i + 1][j], cost[i][j + 1]});
+                }
+            }
+        }
+
+        using Kind = typename ListChange<T>::Kind;
+        std::vector<ListChange<T>> changes;
+        size_t i = 0, j = 0, position = 0;
+        while (i < n || j < m) {
+            if (i < n && j < m && from[i] == to[j] && cost[i][j] == cost[i + 1][j + 1]) {
+                i++, j++, position++;
+            } else if (i < n && j < m && cost[i][j] == cost[i + 1][j + 1] + 1) {
+                changes.push_back({Kind::UPDATE, position++, to[j++]});
+                i++;
+            } else if (i < n && cost[i][j] == cost[i + 1][j] + 1) {
+                changes.push_back({Kind::REMOVE, position, T()});
+                i++;
+            } else {
+                changes.push_back({Kind::INSERT, position++, to[j++]});
+            }
+        }
+        return changes;
+    }
+
+private:
+    std::vector<T> items_;
+    std::vector<Observer> observers_;
+};
+
+// Agent state shown by the main window. update() copies it from the agent
+// after anything that may have changed it (a dialog closing, a provider
+// switch); observers hear only about what actually changed.
+class AgentViewModel {
+public:
+    Observable<std::string>& name() { return name_; }
+    Observable<std::string>& description() { return description_; }
+    Observable<std::string>& provider() { return provider_; }
+    ObservableList<std::string>& starters() { return starters_; }
+
+    void update(const ClaudeAgent& agent);
+
+private:
+    Observable<std::string> name_;
+    Observable<std::string> description_;
+    Observable<std::string> provider_;
+    ObservableList<std::string> starters_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Streaming BLAKE3 (unkeyed hash mode), portable implementation. Input can
+// be fed in pieces of any size. The hasher itself is small (it is nested
+// once per level when hashing JSON trees); the stack of one chaining value
+// per level of the chunk tree is only allocated for inputs over one chunk.
+class Blake3 {
+public:
+    Blake3();
+
+    void update(const void* data, size_t size);
+    void update(const std::string& text) { update(text.data(), text.size()); }
+
+    // Writes the first size bytes of the output; the hasher is not modified,
+    // so more input may follow.
+    void finalize(uint8_t* out, size_t size) const;
+
+private:
+    static constexpr size_t BLOCK_LEN = 64;
+    static constexpr size_t CHUNK_LEN = 1024;
+
+    struct Output {
+        uint32_t cv[8];
+        uint32_t block[16];
+        uint64_t counter;
+        uint32_t block_len;
+        uint32_t flags;
+    };
+
+    // Current chunk
+    uint32_t chunk_cv_[8];
+    uint64_t chunk_counter_ = 0;
+    uint8_t block_[BLOCK_LEN];
+    size_t block_len_ = 0;
+    size_t blocks_compressed_ = 0;
+
+    // Chaining values of completed subtrees, one per set bit of chunk_counter_
+    std::vector<std::array<uint32_t, 8>> cv_stack_;
+
+    void resetChunk(uint64_t counter);
+    Output chunkOutput() const;
+    void pushChunk(const uint32_t cv[8], uint64_t total_chunks);
+};
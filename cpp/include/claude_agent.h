@@ -4,7 +4,14 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <mutex>
+#include <atomic>
 #include "json_utils.h"
+#include "process_spawner.h"
+#include "history_index.h"
+#include "config_history.h"
+#include "config_resolver.h"
+#include "context_controller.h"
 
 struct ConversationEntry {
     std::string user;
@@ -31,9 +38,47 @@ public:
     bool saveConfigToFile(std::shared_ptr<json::Value> config, const std::string& filename);
     bool loadSpecificConfig(const std::string& file_path);
 
+    // Saved versions of the config file, newest first; restoring one saves
+    // it again as the newest version
+    std::vector<ConfigVersion> getConfigVersions() const;
+    bool restoreConfigVersion(const json::Hash128& hash);
+
+    // Resolves "extends" for every config the agent and its dialogs read
+    ConfigResolver& getConfigResolver() { return config_resolver_; }
+
     // Core functionality
     std::string sendToClaudeApi(const std::string& message, bool use_system_prompt = true);
-    std::string sendToCli(const std::string& message, bool use_system_prompt = true);
+    // on_output, if given, receives the answer as the CLI produces it (see
+    // ProcessSpawner::communicate); returning false cancels the turn. So
+    // does cancel_fd becoming readable, even while the CLI is silent.
+    std::string sendToCli(const std::string& message, bool use_system_prompt = true,
+                          const OutputCallback& on_output = nullptr, int cancel_fd = -1);
+
+    // A turn whose CLI child is started before its context can be built,
+    // e.g. while the previous answer is still streaming. The child reads
+    // its prompt from stdin and waits there until sendPrepared() builds the
+    // context from the history at that moment. A turn that is never sent
+    // terminates its child when destroyed. Setting discarded from another
+    // thread cuts the turn short at its next output and keeps it out of the
+    // history.
+    struct PreparedTurn {
+        std::string message;
+        bool use_system_prompt = true;
+        std::vector<std::string> command;   // empty when no CLI is available
+        std::vector<std::string> env;
+        ChildProcess child;
+        bool spawned = false;
+        std::atomic<bool> discarded{false};
+
+        PreparedTurn() = default;
+        PreparedTurn(const PreparedTurn&) = delete;
+        PreparedTurn& operator=(const PreparedTurn&) = delete;
+        ~PreparedTurn();
+
+        void discardChild();
+    };
+    std::unique_ptr<PreparedTurn> prepareTurn(const std::string& message, bool use_system_prompt = true);
+    std::string sendPrepared(PreparedTurn& turn);
 
     // CLI provider management
     bool initializeCli();
@@ -44,9 +89,9 @@ public:
     std::shared_ptr<json::Value> getConfig() const { return config_; }
     void setConfig(std::shared_ptr<json::Value> config) { config_ = config; }
 
-    // Conversation history
-    const std::vector<ConversationEntry>& getConversationHistory() const { return conversation_history_; }
-    void clearConversationHistory() { conversation_history_.clear(); }
+    // Conversation history; safe to use while another thread sends messages
+    std::vector<ConversationEntry> getConversationHistory() const;
+    void clearConversationHistory();
 
     // Utility methods
     std::string getName() const;
@@ -54,6 +99,11 @@ public:
     std::string getInstructions() const;
     std::vector<std::string> getConversationStarters() const;
     int getConversationMemory() const;
+    size_t getContextBudget() const;    // bytes of history sent per message
+    double getLatencyTarget() const;    // ms per turn; 0 when unset (fixed budget)
+    int getMaxTokens() const;           // 0 when unset
+    double getTemperature() const;      // negative when unset
+    OutputLimits getOutputLimits() const;
 
     void setName(const std::string& name);
     void setDescription(const std::string& description);
@@ -61,25 +111,53 @@ public:
     void setConversationStarters(const std::vector<std::string>& starters);
     void setConversationMemory(int memory);
 
+    // Rough output size per token, for enforcing max_tokens on raw bytes
+    static constexpr size_t APPROX_BYTES_PER_TOKEN = 4;
+
+    // History selection: newest turns always sent, and the default history budget
+    static constexpr size_t RECENCY_TAIL = 2;
+    static constexpr size_t DEFAULT_CONTEXT_BUDGET = 200000;
+
+    // Seconds a turn may take unless timeout_seconds says otherwise (0 = no
+    // limit); the same as python/claude_agent.py
+    static constexpr double DEFAULT_TIMEOUT_SECONDS = 60;
+
 private:
     std::string config_file_;
     std::string last_config_file_;
     CliProvider cli_provider_;
-    CliProvider active_provider_;
+    std::atomic<CliProvider> active_provider_;     // read by the UI while turns run
     std::string cli_path_;
     std::shared_ptr<json::Value> config_;
+    mutable std::mutex history_mutex_;    // guards conversation_history_ and history_index_
     std::vector<ConversationEntry> conversation_history_;
+    HistoryIndex history_index_;
+    std::unique_ptr<ConfigHistory> config_history_;
+    ConfigResolver config_resolver_;
+    std::string config_base_;   // canonical path of the base config_ extends, if any
+    ContextController context_controller_;  // adapts the budget to the latency target
 
     // Helper methods
     std::string findClaudeCli();
     std::string findGeminiCli();
     std::pair<std::string, CliProvider> findAvailableCli();
     std::string getSystemPrompt();
-    std::string buildConversationContext(const std::string& current_message, int max_history = -1);
+    size_t getConfiguredContextBudget() const;
+    // history_bytes, if given, receives the bytes of the context taken by earlier turns
+    std::string buildConversationContext(const std::string& current_message, int max_history = -1,
+                                         size_t* history_bytes = nullptr);
+    std::vector<std::string> buildCommand(bool use_system_prompt, std::vector<std::string>& env);
+    void recordTurn(const std::string& message, const std::string& response,
+                    const std::atomic<bool>* discarded = nullptr);
+    void recordConfigVersion(const std::string& file_path, const json::Value& config);
     void saveLastConfigPath(const std::string& config_path);
     std::string loadLastConfigPath();
     std::shared_ptr<json::Value> createDefaultConfig();
-    std::string executeCommand(const std::vector<std::string>& command, const std::string& stdin_input = "");
+    std::string executeCommand(const std::vector<std::string>& command, const std::string& stdin_input = "",
+                               const std::vector<std::string>& env = {}, ChildProcess* spawned = nullptr,
+                               const OutputCallback& on_output = nullptr, size_t history_bytes = 0,
+                               int cancel_fd = -1);
+    std::string sanitizeOutput(const std::string& output);
     std::string escapeShellArg(const std::string& arg);
     std::string providerToString(CliProvider provider) const;
     CliProvider stringToProvider(const std::string& provider) const;
@@ -2,11 +2,16 @@
 
 #include <gtkmm.h>
 #include <memory>
-#include <queue>
-#include <thread>
-#include <mutex>
-#include <atomic>
+#include <map>
+#include <chrono>
 #include "claude_agent.h"
+#include "outbound_queue.h"
+#include "agent_view_model.h"
+#include "diagnostics.h"
+#include "syntax_highlighter.h"
+#include "task_scheduler.h"
+#include "transcript_index.h"
+#include "ui_update_scheduler.h"
 
 class ConfigDialog;
 class ConfigLibraryDialog;
@@ -22,6 +27,8 @@ protected:
     void setupStyles();
     void setupHeaderArea();
     void setupChatArea();
+    void setupSearchBar();
+    void setupDiagnosticsPanel();
     void setupInputArea();
     void setupConversationStarters();
 
@@ -35,20 +42,49 @@ protected:
     void onCliProviderChanged();
     void onStarterClicked(const std::string& starter);
     bool onKeyPressed(GdkEventKey* event);
-
-    // Message handling
-    void addMessage(const std::string& sender, const std::string& message);
+    bool onWindowKeyPressed(GdkEventKey* event);
+
+    // Message handling. Messages reach the buffer on the next frame;
+    // placed is then called with the offset (in characters) where the
+    // message text starts. Transient messages ("Thinking...") are left out
+    // of the search index.
+    void addMessage(const std::string& sender, const std::string& message, bool transient = false,
+                    UiUpdateScheduler::Placed placed = nullptr);
     void showThinkingMessage();
     void removeThinkingMessage();
 
-    // Threading
-    void sendMessageBackground(const std::string& message);
-    bool checkResponseQueue();
-
-    // Configuration management
-    void refreshConversationStarters();
-    void updateHeader();
+    // Outgoing messages: sent in order by outbound_, which wakes the UI
+    // thread through outbound_dispatcher_ as turns start and answers arrive
+    void onOutboundEvents();
+
+    // Code highlighting: fenced blocks are lexed by highlight_worker_ on the
+    // TaskScheduler pool and the resulting tags applied by ui_updates_
+    // within its per-frame budget
+    void highlightCode(int offset, const std::string& text);
+    void onHighlightReady();
+    void cancelHighlighting();
+
+    // Transcript search: queries run against transcript_index_, which is
+    // updated as messages are added, and matches are mapped back to the
+    // buffer through a mark at the start of each indexed message
+    void runSearch();
+    void moveSearchMatch(int step);
+    void showSearchMatch();
+    void clearSearchTags();
+    void resetSearch();
+
+    // Diagnostics panel: while shown, refreshed from a Diagnostics snapshot
+    // once a second, with a heartbeat timer counting main-loop stalls
+    void onDiagnosticsToggled();
+    bool updateDiagnostics();
+    bool onStallHeartbeat();
+
+    // Configuration management: refreshInterface() updates the view model
+    // from the agent, and the bindings change only the affected widgets
+    void bindViewModel();
     void refreshInterface();
+    void updateTitle();
+    void applyStarterChanges(const std::vector<ListChange<std::string>>& changes);
 
     // Dialog management
     void showHistoryDialog();
@@ -56,6 +92,7 @@ protected:
 private:
     // Core components
     std::unique_ptr<ClaudeAgent> agent_;
+    AgentViewModel view_model_;
 
     // UI components
     Gtk::Box main_box_;
@@ -73,11 +110,30 @@ private:
     Gtk::Button library_button_;
     Gtk::Button copy_button_;
     Gtk::Button clear_button_;
+    Gtk::Button find_button_;
+    Gtk::ToggleButton diagnostics_button_;
 
     // Chat widgets
     Gtk::ScrolledWindow chat_scroll_;
     Gtk::TextView chat_display_;
     Glib::RefPtr<Gtk::TextBuffer> chat_buffer_;
+    UiUpdateScheduler ui_updates_;              // all chat_buffer_ changes go through it
+    Glib::RefPtr<Gtk::TextMark> thinking_mark_;
+
+    // Search widgets
+    Gtk::SearchBar search_bar_;
+    Gtk::Box search_box_;
+    Gtk::SearchEntry search_entry_;
+    Gtk::Button search_prev_button_;
+    Gtk::Button search_next_button_;
+    Gtk::Label search_count_label_;
+
+    // Diagnostics panel
+    Gtk::Frame diagnostics_frame_;
+    Gtk::Label diagnostics_label_;
+    sigc::connection diagnostics_timer_;
+    sigc::connection stall_heartbeat_;
+    std::chrono::steady_clock::time_point last_heartbeat_;
 
     // Input widgets
     Gtk::ScrolledWindow input_scroll_;
@@ -89,13 +145,32 @@ private:
 
     // Conversation starters
     Gtk::Frame starters_frame_;
-    std::vector<std::unique_ptr<Gtk::Button>> starter_buttons_;
-
-    // Threading components
-    std::queue<std::string> response_queue_;
-    std::mutex queue_mutex_;
-    std::atomic<bool> processing_message_;
-    sigc::connection timer_connection_;
+    Gtk::Label starters_placeholder_;
+    std::vector<std::unique_ptr<Gtk::Button>> starter_buttons_;   // in display order
+
+    // Outgoing messages
+    Glib::Dispatcher outbound_dispatcher_;
+    std::unique_ptr<OutboundQueue> outbound_;
+
+    // Continuations posted by TaskScheduler::postToMain()
+    Glib::Dispatcher main_tasks_dispatcher_;
+
+    // Code highlighting. Each message is tracked by a mark at its start, so
+    // edits elsewhere in the buffer do not shift its tags.
+    Glib::Dispatcher highlight_dispatcher_;
+    std::unique_ptr<highlight::Worker> highlight_worker_;
+    std::vector<Glib::RefPtr<Gtk::TextTag>> highlight_tags_;           // by highlight::TokenKind
+    std::map<uint64_t, Glib::RefPtr<Gtk::TextMark>> highlight_marks_;  // submitted, by job id
+    uint64_t next_highlight_id_ = 1;
+
+    // Transcript search
+    TranscriptIndex transcript_index_;
+    std::vector<Glib::RefPtr<Gtk::TextMark>> message_marks_;    // by index message id
+    std::vector<TranscriptIndex::Match> search_matches_;
+    bool search_stale_ = false;                 // messages added since the last query
+    size_t search_current_ = 0;
+    Glib::RefPtr<Gtk::TextTag> search_match_tag_;
+    Glib::RefPtr<Gtk::TextTag> search_current_tag_;
 
     // Dialog management
     std::unique_ptr<ConfigDialog> config_dialog_;
@@ -105,5 +180,6 @@ private:
     static constexpr int WINDOW_WIDTH = 1600;
     static constexpr int WINDOW_HEIGHT = 1200;
     static constexpr int INPUT_HEIGHT = 100;
-    static constexpr int TIMER_INTERVAL = 100; // milliseconds
+    static constexpr size_t SEARCH_LIMIT = 10000;  // matches highlighted per query
+    static constexpr int HEARTBEAT_MS = 50;         // stall detection while diagnostics are shown
 };
\ No newline at end of file
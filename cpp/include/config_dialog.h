@@ -17,6 +17,7 @@ protected:
     void onSaveClicked();
     void onSaveAsClicked();
     void onLoadClicked();
+    void onHistoryClicked();
     void onCancelClicked();
 
 private:
@@ -45,11 +46,29 @@ private:
     Gtk::Button save_button_;
     Gtk::Button save_as_button_;
     Gtk::Button load_button_;
+    Gtk::Button history_button_;
     Gtk::Button cancel_button_;
 
+    // Version list columns for the history dialog
+    class VersionColumns : public Gtk::TreeModel::ColumnRecord {
+    public:
+        VersionColumns() {
+            add(saved);
+            add(name);
+            add(hash);
+        }
+
+        Gtk::TreeModelColumn<Glib::ustring> saved;
+        Gtk::TreeModelColumn<Glib::ustring> name;
+        Gtk::TreeModelColumn<Glib::ustring> hash;
+    };
+
+    VersionColumns version_columns_;
+
     // File dialog methods
     void saveConfigAs();
     void loadConfigFrom();
+    void showHistoryDialog();
 
     static constexpr int DIALOG_WIDTH = 600;
     static constexpr int DIALOG_HEIGHT = 500;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "json_utils.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+
+struct ConfigVersion {
+    json::Hash128 hash;
+    int64_t timestamp_ms;     // wall clock time of the save
+    std::string name;         // agent name in that version
+};
+
+struct HistoryPolicy {
+    size_t max_versions = 200;   // per config file
+    int max_age_days = 90;       // older versions are dropped...
+    size_t min_versions = 20;    // ...except the newest min_versions
+    size_t max_chain = 64;       // deltas between full snapshots
+};
+
+// Version history of configuration files, kept in a content-addressed
+// object store (normally <config dir>/.history):
+//
+//   objects.pack      append-only records, each one config version stored
+//                     either in full or as a delta against the version saved
+//                     before it, keyed by json::hash of the content
+//   <file>-<key>.log  one line per save of <file>: "<time ms> <hash>",
+//                     where key is a hash of the file's canonical path
+//
+// Saving identical content adds no object (and no log line if the content
+// equals the latest version). Deltas replace changed top-level fields, and
+// changed strings are stored as a single splice, so an autosave after a
+// small edit to long instructions costs tens of bytes. A new full snapshot
+// starts after max_chain deltas, or earlier once the deltas since the last
+// one add up to its size, which bounds the work to restore any version;
+// the latest version of each file recorded by this instance is kept
+// materialized, so restoring it (and diffing against it) replays nothing.
+// Not safe for concurrent writers.
+class ConfigHistory {
+public:
+    explicit ConfigHistory(const std::string& directory, const HistoryPolicy& policy = HistoryPolicy());
+
+    // Records a save of the config stored in file_name. Returns false if it
+    // equals the latest version.
+    bool record(const std::string& file_name, const json::Value& config);
+
+    // Versions of file_name, newest first
+    std::vector<ConfigVersion> list(const std::string& file_name) const;
+
+    // Content of a version; null if unknown or unreadable
+    std::shared_ptr<json::Value> load(const json::Hash128& hash) const;
+
+    // Applies the policy to every log and rewrites the pack without the
+    // objects no longer reachable. Returns the bytes reclaimed.
+    uint64_t collectGarbage();
+
+    uint64_t packSize() const { return pack_size_; }
+    const std::string& directory() const { return directory_; }
+
+private:
+    struct Hasher {
+        size_t operator()(const json::Hash128& hash) const { return static_cast<size_t>(hash.low); }
+    };
+    struct ObjectInfo {
+        uint64_t offset;    // of the record's length prefix
+        uint32_t size;      // of the CBOR record
+        uint32_t depth;     // deltas back to a full snapshot
+        json::Hash128 base; // zero for a full snapshot
+    };
+
+    std::string directory_;
+    HistoryPolicy policy_;
+    mutable bool scanned_ = false;
+    mutable std::unordered_map<json::Hash128, ObjectInfo, Hasher> objects_;
+    mutable uint64_t pack_size_ = 0;
+    std::unordered_map<json::Hash128, std::string, Hasher> heads_;  // CBOR of each file's latest version
+
+    std::string packPath() const;
+    std::string logPath(const std::string& file_name) const;
+    void scanPack() const;
+    std::string readRecord(const ObjectInfo& info) const;
+    bool appendRecord(const json::Hash128& hash, const json::Value& record, const ObjectInfo& info);
+    std::vector<ConfigVersion> readLog(const std::string& path) const;
+    bool writeLog(const std::string& path, const std::vector<ConfigVersion>& newest_first) const;
+};
@@ -3,6 +3,7 @@
 #include <gtkmm.h>
 #include <memory>
 #include "claude_agent.h"
+#include "facet_index.h"
 
 class ConfigLibraryDialog : public Gtk::Dialog {
 public:
@@ -30,6 +31,7 @@ protected:
     void onImportBundleClicked();
     void onDuplicateCurrentClicked();
     void onResetToDefaultClicked();
+    void onFacetToggled();
 
 private:
     ClaudeAgent& agent_;
@@ -39,9 +41,25 @@ private:
 
     // Browse tab
     Gtk::Box browse_box_;
+    Gtk::Box browse_content_;
     Gtk::ScrolledWindow browse_scroll_;
     Gtk::TreeView config_tree_;
     Glib::RefPtr<Gtk::ListStore> config_store_;
+    Glib::RefPtr<Gtk::TreeModelFilter> config_filter_;
+
+    // Facet filters: one check button per category and tag value
+    struct FacetCheck {
+        std::string facet;
+        std::string value;
+        std::unique_ptr<Gtk::CheckButton> button;
+    };
+    Gtk::ScrolledWindow facet_scroll_;
+    Gtk::Box facet_box_;
+    Gtk::CheckButton match_all_tags_button_;
+    std::vector<std::unique_ptr<Gtk::Label>> facet_headers_;
+    std::vector<FacetCheck> facet_checks_;
+    FacetIndex facet_index_;
+    Bitmap facet_matches_;
     Gtk::ButtonBox browse_buttons_;
     Gtk::Button refresh_button_;
     Gtk::Button load_button_;
@@ -73,17 +91,21 @@ private:
             add(name);
             add(description);
             add(filename);
+            add(index);
         }
 
         Gtk::TreeModelColumn<Glib::ustring> name;
         Gtk::TreeModelColumn<Glib::ustring> description;
         Gtk::TreeModelColumn<Glib::ustring> filename;
+        Gtk::TreeModelColumn<unsigned int> index;   // document id in facet_index_
     };
 
     ConfigColumns config_columns_;
 
     // Helper methods
     void refreshConfigList();
+    void rebuildFacetPanel();
+    std::vector<FacetIndex::Clause> selectedFacets(const std::string& except_facet = "") const;
     void createFromTemplate(const std::string& template_name, const std::string& description);
     void showPreviewDialog(const std::string& filename);
     std::shared_ptr<json::Value> getTemplateConfig(const std::string& template_name);
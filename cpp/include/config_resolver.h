@@ -0,0 +1,78 @@
+#pragma once
+
+#include "json_utils.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <filesystem>
+#include <cstdint>
+
+// Resolves config inheritance. A config file may name a base it extends:
+//
+//   { "extends": "coding_assistant.json", "name": "Python Tutor",
+//     "conversation_starters": ["Explain decorators"] }
+//
+// The resolved config is the base's resolved config with the file's own
+// fields merged over it as a JSON Merge Patch (nested objects merge, null
+// removes a field, anything else replaces). The base is a file name relative
+// to the extending file's directory; ".json" is appended when it has no
+// extension. Bases may themselves extend other configs.
+//
+// Files are parsed once and each resolved form is kept, so resolving a
+// family of configs parses and merges each file once, and the resolved
+// configs share their inherited values (the base's instructions are one
+// string in memory however many configs extend it). A file is re-read when
+// its modification time or size changes, and that drops the resolved forms
+// of the file and its descendants only; siblings and ancestors stay cached.
+// Not safe for concurrent use.
+class ConfigResolver {
+public:
+    // Resolved content of the config in file_path. The top-level object is
+    // the caller's to modify; nested values are shared with the cache and
+    // must be replaced rather than modified in place. Throws
+    // std::runtime_error for an unreadable file, a missing base or an
+    // inheritance cycle, and json::ParseError for malformed JSON.
+    std::shared_ptr<json::Value> resolve(const std::string& file_path);
+
+    // Canonical path of the base file_path extends as of its last
+    // resolution; empty if it extends nothing
+    std::string baseOf(const std::string& file_path) const;
+
+    // Forces file_path to be re-read and its descendants re-resolved (for
+    // writes that may not change the modification time)
+    void invalidate(const std::string& file_path);
+
+    // Stored form of config when saved to file_path as a derivative of
+    // base_path: "extends" plus only the fields that differ from the base
+    // (config itself when file_path is the base)
+    std::shared_ptr<json::Value> derive(const std::string& file_path, const std::string& base_path,
+                                        const std::shared_ptr<json::Value>& config);
+
+    void clear() { nodes_.clear(); }
+
+    // Resolved forms computed so far
+    uint64_t resolutions() const { return resolutions_; }
+
+    static constexpr const char* EXTENDS_KEY = "extends";
+
+private:
+    struct Node {
+        bool loaded = false;
+        std::filesystem::file_time_type mtime;
+        uintmax_t size = 0;
+        std::shared_ptr<json::Value> own;       // file content without "extends"
+        std::string base;                       // canonical path, empty if none
+        std::set<std::string> children;         // configs extending this one
+        std::shared_ptr<json::Value> resolved;  // null until resolved
+    };
+
+    std::unordered_map<std::string, Node> nodes_;  // by canonical path
+    uint64_t resolutions_ = 0;
+
+    static std::string canonicalPath(const std::string& file_path);
+    Node& load(const std::string& path);
+    std::shared_ptr<json::Value> resolveNode(const std::string& path, std::vector<std::string>& chain);
+    void dropResolved(const std::string& path);
+};
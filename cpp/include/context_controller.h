@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Sizes the history sent with each message so turns stay inside a latency
+// target (the "latency_target_ms" config key). The configured byte budget
+// is the ceiling; the controller moves the working budget below it.
+//
+// For each provider it fits latency = fixed + per_byte * history_bytes over
+// recent turns (older turns decay by DECAY per turn) and picks the history
+// size the fit predicts at HEADROOM of the target. The rest of the prompt
+// (the message itself, a prepended system prompt) is part of the fixed
+// cost, so it is not counted twice against the target. While the fit is not
+// usable (too few turns, history sizes too alike, or latency not growing
+// with size) it steps instead: shrinking after a turn over the target, growing
+// after one well under it. A decision moves the budget by at most MAX_STEP
+// either way. Every decision is logged under the "ContextController"
+// component. Thread-safe.
+class ContextController {
+public:
+    // Working budget for provider, at most max_budget (the configured one)
+    size_t budget(const std::string& provider, size_t max_budget) const;
+
+    // Records one turn's history size and latency; returns the new budget
+    size_t observe(const std::string& provider, size_t history_bytes, double latency_ms, double target_ms,
+                   size_t max_budget);
+
+    void reset();
+
+    static constexpr size_t MIN_BUDGET = 4096;
+    static constexpr size_t MIN_SAMPLES = 4;
+    static constexpr double DECAY = 0.9;
+    static constexpr double HEADROOM = 0.9;
+    static constexpr double MAX_STEP = 1.5;
+    static constexpr double SHRINK = 0.75;         // step after a turn over the target
+    static constexpr double GROW = 1.25;           // step after a turn under GROW_BELOW of it
+    static constexpr double GROW_BELOW = 0.7;
+
+private:
+    // Decayed sums for the least-squares fit, x in KB and y in ms
+    struct Model {
+        double weight = 0;
+        double sum_x = 0;
+        double sum_y = 0;
+        double sum_xx = 0;
+        double sum_xy = 0;
+        size_t samples = 0;
+        size_t budget = 0;      // 0 until the first decision
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Model> models_;
+};
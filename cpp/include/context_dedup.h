@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Removes repeated large blocks (the same file or stack trace pasted into
+// several turns) from the conversation context before it is sent.
+//
+// Each text is split with content-defined chunking: a gear rolling hash
+// picks cut points from the bytes themselves, so a pasted block produces the
+// same chunks wherever it appears. Runs of chunks already seen earlier in the
+// context are replaced by a short back-reference naming where the original
+// is; the first occurrence is kept verbatim.
+namespace dedup {
+    struct Options {
+        size_t min_chunk = 256;
+        size_t average_chunk = 1024;   // power of two
+        size_t max_chunk = 8192;
+        size_t min_block = 1024;       // shorter repeats are left alone
+    };
+
+    struct Segment {
+        std::string label;   // how back-references name this text, e.g. "the Human message of turn 2"
+        std::string text;
+    };
+
+    // Rewrites segment texts in order; returns the number of bytes saved.
+    size_t deduplicate(std::vector<Segment>& segments, const Options& options = Options());
+
+    // Chunk end offsets for text (the last one is size). Cut points never
+    // split a UTF-8 sequence.
+    std::vector<size_t> chunkBoundaries(const char* data, size_t size, const Options& options = Options());
+}
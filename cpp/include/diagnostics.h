@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of non-negative values (latencies in microseconds, sizes in
+// bytes) in log-linear buckets: four per power of two, so percentiles are
+// within 25%. Recording is two relaxed atomic increments; any thread may
+// record while another takes a snapshot.
+class Histogram {
+public:
+    static constexpr size_t BUCKETS = 252;  // covers the whole uint64_t range
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        // Upper bound of the bucket holding the p-th percentile (0..1); 0 when empty
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+    };
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t value);
+    static uint64_t bucketLower(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Process-wide counters behind the GUI's diagnostics panel. ClaudeAgent,
+// OutboundQueue, ConfigResolver and the GUI feed it with relaxed atomic
+// updates, and snapshot() only loads them: nothing that records ever waits
+// for the panel, and a closed panel costs a few increments per turn.
+class Diagnostics {
+public:
+    struct Snapshot {
+        int64_t in_flight = 0;          // CLI turns running
+        int64_t queued = 0;             // accepted, waiting for a turn
+        uint64_t turns = 0;
+        uint64_t failed_turns = 0;
+        Histogram::Snapshot spawn_us;   // starting the CLI child
+        Histogram::Snapshot ttfb_us;    // send to first byte of the answer
+        Histogram::Snapshot context_bytes;
+        uint64_t last_context_bytes = 0;
+        uint64_t dedup_saved_bytes = 0;
+        uint64_t prespawn_used = 0;     // turns that found their child already running
+        uint64_t prespawn_missed = 0;
+        uint64_t config_hits = 0;       // resolved configs served from the cache
+        uint64_t config_misses = 0;
+        uint64_t log_suppressed = 0;    // Logger::getSuppressedCount()
+        uint64_t stalls = 0;            // main loop late by STALL_MS or more
+        uint64_t longest_stall_ms = 0;
+        size_t rss_bytes = 0;
+    };
+
+    static Diagnostics& getInstance();
+
+    static constexpr uint64_t STALL_MS = 100;
+
+    void turnStarted() { in_flight_.fetch_add(1, std::memory_order_relaxed); }
+    void turnFinished(bool ok);
+    void addQueued(int64_t delta) { queued_.fetch_add(delta, std::memory_order_relaxed); }
+    void recordSpawn(uint64_t micros) { spawn_us_.record(micros); }
+    void recordFirstByte(uint64_t micros) { ttfb_us_.record(micros); }
+    void recordContext(size_t bytes, size_t dedup_saved);
+    void recordPrespawn(bool used);
+    void recordConfigLookup(bool hit);
+    void recordStall(uint64_t late_ms);
+
+    Snapshot snapshot() const;
+
+    // Resident set size from /proc/self/statm; 0 where unavailable
+    static size_t residentBytes();
+
+private:
+    Diagnostics() = default;
+
+    std::atomic<int64_t> in_flight_{0};
+    std::atomic<int64_t> queued_{0};
+    std::atomic<uint64_t> turns_{0};
+    std::atomic<uint64_t> failed_turns_{0};
+    Histogram spawn_us_;
+    Histogram ttfb_us_;
+    Histogram context_bytes_;
+    std::atomic<uint64_t> last_context_bytes_{0};
+    std::atomic<uint64_t> dedup_saved_bytes_{0};
+    std::atomic<uint64_t> prespawn_used_{0};
+    std::atomic<uint64_t> prespawn_missed_{0};
+    std::atomic<uint64_t> config_hits_{0};
+    std::atomic<uint64_t> config_misses_{0};
+    std::atomic<uint64_t> stalls_{0};
+    std::atomic<uint64_t> longest_stall_ms_{0};
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+// Compressed set of 32-bit ids in the style of Roaring bitmaps: ids are
+// grouped by their high 16 bits, and each group stores its low halves as a
+// sorted array while it has at most ARRAY_LIMIT members and as a 65536-bit
+// bitset beyond that. Set operations work group by group on whichever
+// representations meet.
+class Bitmap {
+public:
+    static constexpr uint32_t ARRAY_LIMIT = 4096;
+
+    void add(uint32_t id);
+    bool contains(uint32_t id) const;
+    uint64_t cardinality() const;
+    bool empty() const { return containers_.empty(); }
+
+    Bitmap operator&(const Bitmap& other) const;
+    Bitmap operator|(const Bitmap& other) const;
+    uint64_t andCardinality(const Bitmap& other) const;  // |this & other| without building it
+
+    std::vector<uint32_t> toVector() const;
+
+private:
+    static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+    struct Container {
+        explicit Container(uint16_t high) : key(high) {}
+
+        uint16_t key;                   // high 16 bits
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;    // sorted, when not a bitset
+        std::vector<uint64_t> bits;     // BITSET_WORDS words, or empty
+
+        bool isBitset() const { return !bits.empty(); }
+        void toBitset();
+        void toArrayIfSmall();
+    };
+
+    std::vector<Container> containers_;  // sorted by key
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static uint32_t intersectCount(const Container& a, const Container& b);
+};
+
+// Facet values (e.g. category "Coding", tag "python") of a set of documents
+// numbered 0..n-1, one bitmap per value, built once per library scan.
+class FacetIndex {
+public:
+    // Values of one facet; documents must have all of them when match_all,
+    // any of them otherwise. An empty clause matches everything.
+    struct Clause {
+        std::string facet;
+        std::vector<std::string> values;
+        bool match_all = false;
+    };
+
+    void addDocument(uint32_t id);
+    void add(uint32_t id, const std::string& facet, const std::string& value);
+    void clear();
+
+    const Bitmap& all() const { return all_; }
+    const Bitmap* find(const std::string& facet, const std::string& value) const;
+
+    // Values of a facet in sorted order
+    std::vector<std::string> values(const std::string& facet) const;
+
+    // Documents matching every clause
+    Bitmap evaluate(const std::vector<Clause>& clauses) const;
+
+    // Documents in matches that also have the value (the live count shown
+    // next to a facet checkbox)
+    uint64_t count(const Bitmap& matches, const std::string& facet, const std::string& value) const;
+
+private:
+    Bitmap all_;
+    std::map<std::string, std::map<std::string, Bitmap>> facets_;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Incremental lexical index over conversation turns (BM25), used to choose
+// which earlier turns go into the context for a new message. Turns are
+// appended as the conversation grows; nothing is ever re-indexed.
+class HistoryIndex {
+public:
+    void add(const std::string& text);
+    void clear();
+    size_t size() const { return turn_bytes_.size(); }
+
+    // Turns in [0, limit) that share a term with the query, best first, at
+    // most top_k of them.
+    std::vector<std::pair<size_t, double>> search(const std::string& query, size_t limit, size_t top_k) const;
+
+    // Chooses up to max_turns turns: the newest recency_tail turns, then the
+    // most relevant older ones, then (if slots remain) older turns by recency,
+    // stopping at byte_budget. Returns turn indices in chronological order.
+    std::vector<size_t> select(const std::string& query, size_t max_turns, size_t recency_tail,
+                               size_t byte_budget) const;
+
+private:
+    struct Posting {
+        uint32_t turn;
+        uint32_t frequency;
+    };
+
+    std::unordered_map<std::string, uint32_t> term_ids_;
+    std::vector<std::vector<Posting>> postings_;
+    std::vector<uint32_t> turn_lengths_;  // in terms
+    std::vector<size_t> turn_bytes_;
+    uint64_t total_length_ = 0;
+
+    static std::vector<std::string> tokenize(const std::string& text);
+};
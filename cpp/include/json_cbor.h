@@ -0,0 +1,93 @@
+#pragma once
+
+#include "json_utils.h"
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// CBOR (RFC 8949) encoding of json::Value for internal state files: caches,
+// indexes and history written by the application itself. User-facing
+// configs stay text JSON.
+//
+// The writer emits definite-length items, integers for integral numbers and
+// float64 otherwise, and object keys in sorted order, so equal values encode
+// to equal bytes. The reader accepts the same subset plus half/single floats
+// and tags (ignored).
+namespace json {
+    std::string toCbor(const Value& value);
+    std::shared_ptr<Value> fromCbor(const char* data, size_t size, const ParseLimits& limits = ParseLimits());
+
+    // Text <-> binary conversion; cborToText walks the bytes without a DOM
+    std::string textToCbor(const std::string& text);
+    std::string cborToText(const char* data, size_t size);
+
+    bool saveBinaryFile(const std::string& filename, const Value& value);
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Zero-copy view of one CBOR item inside a buffer (typically a MappedFile).
+    // open() validates the whole buffer once, so navigation afterwards needs no
+    // further checks; strings are returned as views into the buffer. Lookups
+    // walk the encoded bytes, skipping over values that are not needed.
+    class CborView {
+    public:
+        CborView() = default;
+
+        // Throws ParseError if the buffer is not exactly one well-formed item
+        static CborView open(const char* data, size_t size, const ParseLimits& limits = ParseLimits());
+
+        bool valid() const { return data_ != nullptr; }
+        Type getType() const;                   // NULL_VALUE for an invalid view
+
+        std::string_view asString() const;
+        double asNumber() const;
+        bool asBoolean() const;
+
+        size_t size() const;                    // elements of an array or object
+        CborView at(size_t index) const;        // array element, invalid view if out of range
+        CborView find(std::string_view key) const;
+        CborView find(const Path& path) const;
+
+        // Visits object members in order; stops early when fn returns false
+        template <typename Fn>
+        void forEachMember(Fn fn) const {
+            if (getType() != Type::OBJECT) return;
+            const uint8_t* p = contentStart();
+            for (size_t i = 0, n = size(); i < n; ++i) {
+                CborView key(p);
+                CborView value(key.end());
+                if (!fn(key.asString(), value)) return;
+                p = value.end();
+            }
+        }
+
+        // Size of the encoded item in bytes
+        size_t encodedSize() const { return end() - data_; }
+        std::shared_ptr<Value> materialize() const;
+
+    private:
+        explicit CborView(const uint8_t* data);  // skips any tags
+
+        const uint8_t* data_ = nullptr;
+
+        uint64_t argument() const;
+        const uint8_t* contentStart() const;
+        const uint8_t* end() const;
+    };
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "json_utils.h"
+
+namespace json {
+    // Incremental pull parser. Input is fed in arbitrary chunks (e.g. as it
+    // arrives from a pipe) and events are pulled one at a time. Bytes are
+    // discarded as soon as they have been consumed, so memory is bounded by
+    // the nesting depth plus the largest single token, not the document size.
+    enum class Token {
+        START_OBJECT,
+        END_OBJECT,
+        START_ARRAY,
+        END_ARRAY,
+        KEY,
+        STRING,
+        NUMBER,
+        BOOLEAN,
+        NULL_VALUE
+    };
+
+    struct Event {
+        Token token = Token::NULL_VALUE;
+        std::string text;      // decoded key/string, or the raw number literal
+        double number = 0.0;
+        bool boolean = false;
+    };
+
+    class Reader {
+    public:
+        enum class Status {
+            EVENT,      // an event was produced
+            NEED_MORE,  // the buffered input ends inside a token; feed() more
+            END         // input finished and every document was consumed
+        };
+
+        // With multiple_documents set, whitespace-separated top-level values
+        // (line-delimited JSON) are accepted one after another.
+        explicit Reader(bool multiple_documents = false);
+        // Reads a complete caller-owned buffer in place, without copying it.
+        // The buffer must outlive the reader; feed() is not allowed. Its size
+        // is checked against limits.max_size here.
+        Reader(const char* data, size_t size, bool multiple_documents = false,
+               const ParseLimits& limits = ParseLimits());
+
+        // A borrowed buffer is checked against the new max_size as well
+        void setLimits(const ParseLimits& limits);
+
+        void feed(const char* data, size_t size);
+        void feed(const std::string& data) { feed(data.data(), data.size()); }
+        void finish();
+
+        Status next(Event& event);
+
+        // Consumes the next value without decoding it (no string copies or
+        // number conversion). On EVENT, event.token is the value's last token;
+        // if the enclosing container ends instead, its END token is consumed
+        // and depth() drops below the depth at the call.
+        Status skipValue(Event& event);
+
+        size_t depth() const { return stack_.size(); }
+        size_t offset() const { return consumed_ + pos_; }
+        bool atDocumentBoundary() const { return state_ == State::VALUE && stack_.empty(); }
+
+    private:
+        enum class State {
+            VALUE,               // expecting any value
+            VALUE_OR_END_ARRAY,  // just after '['
+            KEY_OR_END_OBJECT,   // just after '{'
+            KEY,                 // after ',' inside an object
+            COLON,               // after a key
+            COMMA_OR_END,        // after a value inside a container
+            DONE                 // single document complete
+        };
+
+        enum class Partial {
+            NONE,
+            STRING,
+            NUMBER
+        };
+
+        std::string buffer_;
+        const char* data_ = nullptr;  // buffer_ or the caller's complete input
+        size_t size_ = 0;
+        size_t pos_ = 0;
+        size_t consumed_ = 0;
+        size_t document_start_ = 0;
+        bool finished_ = false;
+        bool borrowed_ = false;
+        bool multiple_documents_;
+        ParseLimits limits_;
+
+        State state_ = State::VALUE;
+        std::vector<char> stack_;
+
+        // A string or number that straddles chunk boundaries
+        Partial partial_ = Partial::NONE;
+        bool partial_is_key_ = false;
+        std::string pending_;
+
+        // skipValue() in progress, resumable across NEED_MORE
+        bool skipping_ = false;
+        size_t skip_depth_ = 0;
+
+        void skipWhitespace();
+        void compact();
+        void afterValue();
+        [[noreturn]] void fail(const std::string& what) const;
+        void checkBorrowedSize() const;
+
+        Status readValue(Event& event);
+        Status readString(Event& event, bool is_key);
+        Status readNumber(Event& event);
+        Status readLiteral(Event& event);
+        bool skipString(const char* data, size_t size);
+        bool decodeEscape(std::string& out);
+        bool decodeUnicodeEscape(std::string& out);
+    };
+
+    // Builds DOM values from a stream of reader events.
+    class DomBuilder {
+    public:
+        // Returns true when the event completed a top-level value.
+        bool handle(const Event& event);
+        std::shared_ptr<Value> take();
+
+    private:
+        std::vector<std::shared_ptr<Value>> stack_;
+        std::string key_;
+        std::shared_ptr<Value> root_;
+
+        void attach(std::shared_ptr<Value> value);
+    };
+
+    // Reader + DomBuilder: feed chunks, collect complete documents.
+    class StreamParser {
+    public:
+        explicit StreamParser(bool multiple_documents = true) : reader_(multiple_documents) {}
+
+        void setLimits(const ParseLimits& limits) { reader_.setLimits(limits); }
+        void feed(const char* data, size_t size) { reader_.feed(data, size); }
+        void feed(const std::string& data) { reader_.feed(data); }
+        void finish() { reader_.finish(); }
+
+        // Returns the next complete document, or nullptr if more input is needed
+        // (or the stream has ended).
+        std::shared_ptr<Value> nextDocument();
+
+    private:
+        Reader reader_;
+        DomBuilder builder_;
+        Event event_;
+    };
+}
@@ -4,6 +4,9 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <cstdint>
 
 namespace json {
     class Value;
@@ -19,6 +22,51 @@ namespace json {
         NULL_VALUE
     };
 
+    // 128-bit content identity of a value (see hash() below)
+    struct Hash128 {
+        uint64_t high = 0;
+        uint64_t low = 0;
+
+        bool operator==(const Hash128& other) const { return high == other.high && low == other.low; }
+        bool operator!=(const Hash128& other) const { return !(*this == other); }
+        std::string toHex() const;
+    };
+
+    // Memoized hash stored on a node. A container's entry is stamped with the
+    // DOM mutation epoch, which set()/push() advance, so any change to any
+    // container invalidates cached container hashes; strings are immutable
+    // and stay valid. The epoch only moves when a container hash has been
+    // cached since the last move, so building documents (parsing) costs a
+    // relaxed load per insert. Copies start empty.
+    class HashCache {
+    public:
+        static constexpr uint64_t IMMUTABLE = 0;
+
+        HashCache() = default;
+        HashCache(const HashCache&) {}
+        HashCache& operator=(const HashCache&) { stamp_.store(EMPTY, std::memory_order_relaxed); return *this; }
+
+        bool get(uint64_t epoch, Hash128& hash) const;
+        void put(uint64_t epoch, const Hash128& hash) const;
+
+        static uint64_t epoch() { return mutation_epoch_.load(std::memory_order_acquire); }
+        static void touch() {
+            if (cached_since_touch_.load(std::memory_order_relaxed)) {
+                cached_since_touch_.store(false, std::memory_order_relaxed);
+                mutation_epoch_.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+
+    private:
+        static constexpr uint64_t EMPTY = UINT64_MAX;
+        static std::atomic<uint64_t> mutation_epoch_;
+        static std::atomic<bool> cached_since_touch_;
+
+        mutable std::atomic<uint64_t> stamp_{EMPTY};
+        mutable std::atomic<uint64_t> high_{0};
+        mutable std::atomic<uint64_t> low_{0};
+    };
+
     class Value {
     public:
         Value(Type type) : type_(type) {}
@@ -26,6 +74,8 @@ namespace json {
 
         Type getType() const { return type_; }
 
+        // Canonical text: no whitespace, object keys in byte order, strings
+        // escaped as by quote(), numbers as by formatNumber()
         virtual std::string toString() const = 0;
 
         // Type checking
@@ -50,11 +100,15 @@ namespace json {
     class StringValue : public Value {
     public:
         StringValue(const std::string& value) : Value(Type::STRING), value_(value) {}
-        std::string toString() const override { return "\"" + value_ + "\""; }
+        std::string toString() const override;
         std::string asString() const override { return value_; }
+        const std::string& text() const { return value_; }
 
     private:
+        friend Hash128 hash(const Value& value);
+
         std::string value_;
+        HashCache hash_;
     };
 
     class NumberValue : public Value {
@@ -85,6 +139,7 @@ namespace json {
         const Object& asObject() const override { return value_; }
 
         void set(const std::string& key, std::shared_ptr<Value> value) {
+            HashCache::touch();
             value_[key] = value;
         }
 
@@ -98,7 +153,10 @@ namespace json {
         }
 
     private:
+        friend Hash128 hash(const Value& value);
+
         Object value_;
+        HashCache hash_;
     };
 
     class ArrayValue : public Value {
@@ -109,6 +167,7 @@ namespace json {
         const Array& asArray() const override { return value_; }
 
         void push(std::shared_ptr<Value> value) {
+            HashCache::touch();
             value_.push_back(value);
         }
 
@@ -118,7 +177,10 @@ namespace json {
         }
 
     private:
+        friend Hash128 hash(const Value& value);
+
         Array value_;
+        HashCache hash_;
     };
 
     class NullValue : public Value {
@@ -127,9 +189,111 @@ namespace json {
         std::string toString() const override { return "null"; }
     };
 
+    // Guards against pathological input. The parser keeps its own explicit
+    // stack, so max_depth bounds memory rather than protecting the C++ stack,
+    // but it also keeps the recursive toString()/destructor paths safe.
+    struct ParseLimits {
+        size_t max_depth = 512;
+        size_t max_size = 64 * 1024 * 1024;          // bytes per document
+        size_t max_string_length = 16 * 1024 * 1024; // bytes per string/number token
+    };
+
+    // Thrown for malformed or over-limit input. line() and column() are
+    // 1-based, and zero when the input text was not retained (streaming).
+    class ParseError : public std::runtime_error {
+    public:
+        ParseError(const std::string& message, size_t offset, size_t line = 0, size_t column = 0);
+
+        const std::string& message() const { return message_; }
+        size_t offset() const { return offset_; }
+        size_t line() const { return line_; }
+        size_t column() const { return column_; }
+
+    private:
+        std::string message_;
+        size_t offset_;
+        size_t line_;
+        size_t column_;
+    };
+
+    // Quotes and escapes a string for output: '"', '\\' and control
+    // characters are escaped, other UTF-8 is written as-is.
+    std::string quote(const std::string& text);
+
+    // Canonical number text, as ECMAScript (and RFC 8785) print numbers:
+    // shortest digits that round-trip, no exponent for 1e-6 <= |x| < 1e21,
+    // "-0" as "0". Non-finite values, which JSON cannot represent, are
+    // written as "null". out must hold NUMBER_BUFFER_SIZE bytes; returns the
+    // length written.
+    constexpr size_t NUMBER_BUFFER_SIZE = 32;
+    size_t formatNumber(double value, char* out);
+
+    // Content hash (BLAKE3, 128 bits) of the canonical form, streamed without
+    // building the text. Containers and long strings are hashed as nodes:
+    // a parent hashes a child node's 16-byte digest rather than its text, so
+    // node digests can be cached (see HashCache). Repeated hashing of an
+    // unchanged DOM is a lookup; after an edit, long strings such as
+    // instructions keep their digests and only the structure is re-walked.
+    // Equal values hash equal regardless of how they were written.
+    Hash128 hash(const Value& value);
+
+    // JSON Merge Patch (RFC 7386). mergePatch applies patch to target: object
+    // members are merged recursively, null members remove the field, any other
+    // patch value replaces. The result shares every value the patch leaves
+    // unchanged with target. diffPatch is the inverse, the smallest patch
+    // taking base to target (null-valued fields of target cannot be expressed
+    // and are dropped).
+    std::shared_ptr<Value> mergePatch(const std::shared_ptr<Value>& target, const std::shared_ptr<Value>& patch);
+    std::shared_ptr<Value> diffPatch(const std::shared_ptr<Value>& base, const std::shared_ptr<Value>& target);
+
+    // Precompiled JSON pointer (RFC 6901), e.g. "/conversation_starters/0".
+    // The pointer is split and its key hashes computed once; evaluation walks
+    // the steps without allocating. Typical use is a function-local static:
+    //     static const json::Path name_path("/name");
+    class Path {
+    public:
+        explicit Path(const std::string& pointer);
+
+        const Value* evaluate(const Value& root) const;
+        std::shared_ptr<Value> find(const std::shared_ptr<Value>& root) const;
+
+        // Typed lookups returning the fallback on a missing or mistyped value
+        std::string getString(const Value& root, const std::string& fallback) const;
+        double getNumber(const Value& root, double fallback) const;
+
+        const std::string& pointer() const { return pointer_; }
+        size_t size() const { return steps_.size(); }
+
+    private:
+        friend class Extraction;
+        friend class CborView;
+
+        struct Step {
+            std::string key;
+            uint64_t hash;
+            size_t index;   // SIZE_MAX when the token is not an array index
+        };
+
+        std::string pointer_;
+        std::vector<Step> steps_;
+
+        const std::shared_ptr<Value>* child(const Value& current, size_t i) const;
+        std::shared_ptr<Value> findFrom(const std::shared_ptr<Value>& root, size_t first) const;
+    };
+
+    // DOM-free extraction: scans the document once, skipping (not decoding)
+    // every value that is not on one of the paths, and stops as soon as all
+    // paths are resolved. Results are in path order; missing values are null
+    // pointers. Supports up to 64 paths. With duplicate keys the first
+    // occurrence wins (parse() keeps the last).
+    std::vector<std::shared_ptr<Value>> extract(const std::string& json, const std::vector<Path>& paths,
+                                                const ParseLimits& limits = ParseLimits());
+    std::vector<std::shared_ptr<Value>> extractFromFile(const std::string& filename, const std::vector<Path>& paths,
+                                                        const ParseLimits& limits = ParseLimits());
+
     // Parser functions
-    std::shared_ptr<Value> parse(const std::string& json);
-    std::shared_ptr<Value> parseFromFile(const std::string& filename);
+    std::shared_ptr<Value> parse(const std::string& json, const ParseLimits& limits = ParseLimits());
+    std::shared_ptr<Value> parseFromFile(const std::string& filename, const ParseLimits& limits = ParseLimits());
     bool saveToFile(const std::string& filename, std::shared_ptr<Value> value);
 
     // Helper functions for creating values
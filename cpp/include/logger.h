@@ -5,8 +5,10 @@
 #include <fstream>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <sstream>
+#include <cstdint>
 
 enum class LogLevel {
     DEBUG = 0,
@@ -25,6 +27,14 @@ public:
     void enableConsoleOutput(bool enable);
     void enableFileOutput(bool enable);
 
+    // Repetitive-message control. Each (component, message template) pair gets
+    // its own token bucket; digits are ignored when matching templates so
+    // "status 1" and "status 2" count against the same site.
+    void enableRateLimiting(bool enable);
+    void setRateLimit(double messages_per_second, int burst);
+    void setDebugSampleRate(double probability);
+    uint64_t getSuppressedCount() const { return total_suppressed_.load(std::memory_order_relaxed); }
+
     void log(LogLevel level, const std::string& message);
     void log(LogLevel level, const std::string& component, const std::string& message);
 
@@ -57,6 +67,32 @@ private:
     std::string levelToString(LogLevel level);
     std::string getCurrentTimestamp();
 
+    // Rate limiting (lock-free; only the final write takes log_mutex_)
+    struct RateLimitSlot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<int64_t> tat_ns{0};       // GCRA theoretical arrival time
+        std::atomic<uint64_t> suppressed{0};
+    };
+
+    bool admitMessage(LogLevel level, const std::string& component, const std::string& message,
+                      uint64_t& suppressed_before);
+    RateLimitSlot* findSlot(uint64_t key);
+    static uint64_t templateKey(const std::string& component, const std::string& message);
+    void writeMessage(LogLevel level, const std::string& component, const std::string& message);
+    void flushSuppressed();
+
+    static constexpr size_t RATE_LIMIT_SLOTS = 512;
+    static constexpr size_t RATE_LIMIT_PROBES = 16;
+    static constexpr size_t TEMPLATE_PREFIX = 96;
+
+    RateLimitSlot rate_slots_[RATE_LIMIT_SLOTS];
+    std::atomic<bool> rate_limiting_{true};
+    std::atomic<int64_t> emission_interval_ns_{100000000};  // 10 messages/second
+    std::atomic<int64_t> burst_tolerance_ns_{1900000000};   // burst of 20
+    std::atomic<uint32_t> debug_sample_threshold_{42949673}; // ~1% of over-limit DEBUG lines
+    std::atomic<uint64_t> total_suppressed_{0};
+    std::atomic<uint64_t> evicted_suppressed_{0};  // unreported counts of evicted slots
+
     LogLevel current_level_ = LogLevel::INFO;
     bool console_output_ = true;
     bool file_output_ = false;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "claude_agent.h"
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <sys/types.h>
+
+// Outgoing messages of one chat session. Messages are accepted at any time
+// and sent one at a time, in order, on a dispatcher thread, so each turn's
+// context includes the answers before it. While a turn is in flight the
+// next message is prepared on a second thread (its CLI child is spawned and
+// waits on stdin), so a queued turn starts as soon as the previous answer
+// lands. At most one message is prepared ahead.
+//
+// While the queue exists, changes to the agent that turns depend on (the
+// CLI provider, for one) go through enqueueChange(), which runs them on the
+// dispatcher between turns, with no message in flight or being prepared.
+//
+// on_event runs on a queue thread after each event, typically to wake the
+// UI thread (Glib::Dispatcher), which then collects them with
+// takeEvents().
+class OutboundQueue {
+public:
+    struct Event {
+        enum class Kind {
+            STARTED,    // the message was handed to the CLI
+            REPLIED,
+            CHANGED     // a change ran; response is its result
+        };
+        Kind kind;
+        uint64_t id;
+        std::string response;   // REPLIED and CHANGED only
+    };
+
+    OutboundQueue(ClaudeAgent& agent, std::function<void()> on_event);
+    ~OutboundQueue();
+
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    // Returns the message id (1, 2, ...)
+    uint64_t enqueue(const std::string& message);
+    // Runs change after the messages accepted before it; a non-empty result
+    // is reported as a CHANGED event (id 0). Changes survive cancelAll().
+    void enqueueChange(std::function<std::string()> change);
+    std::vector<Event> takeEvents();
+
+    // Messages and changes accepted but not yet done, including the turn in flight
+    size_t pending() const;
+
+    // Drops queued messages and their undelivered events. The turn in
+    // flight is discarded: its child is terminated (or, if it was spawned
+    // when the message was sent, cut off at its next output) and its answer
+    // is neither reported nor recorded in the agent's history.
+    void cancelAll();
+
+private:
+    struct Item {
+        uint64_t id;
+        std::string message;
+        std::unique_ptr<ClaudeAgent::PreparedTurn> turn;
+        bool preparing = false;
+        std::function<std::string()> change = nullptr;   // set for changes, which have no message
+    };
+
+    ClaudeAgent& agent_;
+    std::function<void()> on_event_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Item> queue_;
+    std::vector<Event> events_;
+    uint64_t next_id_ = 1;
+    uint64_t generation_ = 0;       // bumped by cancelAll()
+    uint64_t cancelled_below_ = 0;  // ids dropped by cancelAll()
+    bool in_flight_ = false;
+    pid_t in_flight_pid_ = -1;      // child of the turn in flight, if pre-spawned
+    ClaudeAgent::PreparedTurn* in_flight_turn_ = nullptr;
+    bool stopping_ = false;
+    std::thread dispatcher_;
+    std::thread preparer_;
+
+    void dispatch();
+    void prepare();
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <sys/types.h>
+
+// A CLI child started by ProcessSpawner. The caller owns the pipe fds;
+// wait() closes whatever is still open and reaps the child.
+struct ChildProcess {
+    pid_t pid = -1;
+    int stdin_fd = -1;    // write end of the child's stdin
+    int stdout_fd = -1;   // read end of the child's stdout
+    int status_fd = -1;   // fork server only: delivers the wait status
+};
+
+// Reader-side limits on a child's output. When one is hit, communicate()
+// stops reading and the caller should terminate() the child.
+struct OutputLimits {
+    size_t max_bytes = 0;                     // 0 = unlimited
+    std::vector<std::string> stop_sequences;  // output is cut before the first match
+    int timeout_ms = 0;                       // 0 = wait as long as the child runs
+    int cancel_fd = -1;                       // stop reading once this fd is readable
+};
+
+enum class OutputEnd {
+    COMPLETE,       // child closed its stdout
+    BYTE_LIMIT,
+    STOP_SEQUENCE,
+    TIMEOUT,
+    CANCELLED       // the output callback returned false or cancel_fd became readable
+};
+
+// Receives output as it arrives; return false to stop reading
+using OutputCallback = std::function<bool(const std::string& chunk)>;
+
+// Launches CLI children without forking the (large) GUI process.
+//
+// startForkServer() forks a helper while the process is still small and
+// single-threaded; it must run at the top of main(), before gtkmm or any
+// thread starts. Spawn requests then go over a Unix socket and the helper
+// hands back the child's pipe fds with SCM_RIGHTS, so spawn latency no
+// longer depends on the GUI's RSS or mapping count. Without a fork server,
+// children are started in-process with posix_spawn.
+class ProcessSpawner {
+public:
+    static ProcessSpawner& getInstance();
+
+    bool startForkServer();
+    void stopForkServer();
+    bool usingForkServer() const { return server_fd_ >= 0; }
+
+    // Runs argv[0] (PATH lookup) with argv, no shell involved. stderr is
+    // inherited; env entries ("NAME=value") are added to the environment.
+    bool spawn(const std::vector<std::string>& argv, ChildProcess& child,
+               const std::vector<std::string>& env = {});
+
+    // Writes input to the child's stdin (then closes it) while collecting
+    // its stdout, without deadlocking on full pipes. first_output, if
+    // given, receives the time the first output byte was read. on_output,
+    // if given, sees the returned text in order as it is read; bytes that
+    // could still turn out to start a stop sequence or that end mid UTF-8
+    // character are held back until that is settled.
+    std::string communicate(ChildProcess& child, const std::string& input,
+                            const OutputLimits& limits = OutputLimits(), OutputEnd* end = nullptr,
+                            std::chrono::steady_clock::time_point* first_output = nullptr,
+                            const OutputCallback& on_output = nullptr);
+
+    // SIGTERM, escalating to SIGKILL if the child is still alive after the
+    // grace period. Call wait() afterwards to reap it.
+    void terminate(ChildProcess& child, int grace_ms = 500);
+
+    // Blocks until the child exits; returns its wait status (as pclose would).
+    int wait(ChildProcess& child);
+
+private:
+    ProcessSpawner();
+    ~ProcessSpawner();
+    ProcessSpawner(const ProcessSpawner&) = delete;
+    ProcessSpawner& operator=(const ProcessSpawner&) = delete;
+
+    int server_fd_ = -1;
+    pid_t server_pid_ = -1;
+    std::mutex server_mutex_;  // one request/reply exchange at a time
+
+    bool spawnViaServer(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                        ChildProcess& child);
+    bool spawnLocally(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                      ChildProcess& child);
+    bool hasExited(const ChildProcess& child, int timeout_ms);
+};
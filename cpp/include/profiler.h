@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Sampling CPU profiler for the shipping binary.
+//
+// While running, an ITIMER_PROF timer delivers SIGPROF to whichever thread
+// is using CPU, and the handler records that thread's call stack into a
+// chunk of a preallocated arena owned by the thread (no locks, no
+// allocation). Stacks are symbolized only when the profile is exported, as
+// folded stacks ("root;caller;leaf count" per line) for flamegraph.pl or
+// speedscope.
+//
+// Nothing is installed until the first start(): no timer, no thread, no
+// work on any code path. After stop() the handler stays installed but the
+// timer is disarmed.
+class Profiler {
+public:
+    static Profiler& getInstance();
+
+    static constexpr int DEFAULT_HZ = 199;   // off the 100/250/1000 Hz ticks
+
+    // Starts a new profile, discarding the previous one. False if already
+    // running or the timer could not be armed.
+    bool start(int hz = DEFAULT_HZ);
+    // Stops sampling; returns once no handler is still writing
+    void stop();
+    bool running() const { return recording_.load(); }
+
+    size_t sampleCount() const { return samples_.load(std::memory_order_relaxed); }
+    size_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // Folded stacks of the current (or last) profile, heaviest first.
+    // Frames without a dynamic symbol appear as module+0xoffset, which
+    // addr2line -e module resolves.
+    std::string foldedStacks() const;
+    bool writeFolded(const std::string& path) const;
+
+    // claude_agent_profile_<pid>_<time>.folded in the working directory
+    static std::string defaultOutputPath();
+
+private:
+    Profiler() = default;
+
+    static constexpr size_t ARENA_WORDS = size_t(1) << 20;  // 8 MB, ~2 min of one busy core
+    static constexpr size_t CHUNK_WORDS = size_t(1) << 12;  // claimed by one thread at a time
+    static constexpr size_t CHUNK_COUNT = ARENA_WORDS / CHUNK_WORDS;
+    static constexpr int MAX_DEPTH = 64;
+
+    // Samples are stored as [depth, leaf, ..., root] in a chunk; a chunk's
+    // used count is published after each complete sample.
+    std::unique_ptr<uintptr_t[]> arena_;
+    std::unique_ptr<std::atomic<size_t>[]> chunk_used_;
+    std::atomic<size_t> next_chunk_{0};
+    std::atomic<uint64_t> session_{0};
+    std::atomic<size_t> samples_{0};
+    std::atomic<size_t> dropped_{0};      // arena full
+    std::atomic<bool> recording_{false};
+    std::atomic<int> in_handler_{0};
+    bool handler_installed_ = false;
+    mutable std::mutex mutex_;   // start/stop/export
+
+    static void onSignal(int signo, siginfo_t* info, void* context);
+    void sample(void* context);
+};
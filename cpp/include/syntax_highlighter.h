@@ -0,0 +1,100 @@
+#pragma once
+
+#include "task_scheduler.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace highlight {
+
+    enum class TokenKind {
+        CODE_BLOCK,     // the whole content of a fenced block
+        KEYWORD,
+        TYPE,
+        LITERAL,        // true, false, null, None, ...
+        STRING,
+        NUMBER,
+        COMMENT,
+        PREPROCESSOR,   // C/C++ directives, Python decorators
+        VARIABLE,       // shell $name and ${...}
+        PROPERTY        // JSON object keys
+    };
+    constexpr size_t TOKEN_KIND_COUNT = static_cast<size_t>(TokenKind::PROPERTY) + 1;
+
+    // Range of a message, in characters (not bytes) from its start, so it
+    // can be applied directly to a GtkTextBuffer. Spans are ordered by begin;
+    // a CODE_BLOCK span precedes the tokens inside it.
+    struct TokenSpan {
+        size_t begin;
+        size_t end;
+        TokenKind kind;
+    };
+
+    // Fenced code block (``` or ~~~, CommonMark rules) in byte offsets.
+    // language is the first word of the info string, lower-cased; content
+    // runs from the line after the opening fence to the closing fence, or
+    // to the end of the text when the block is not closed.
+    struct CodeBlock {
+        std::string language;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<CodeBlock> findCodeBlocks(const std::string& text);
+
+    // Whether a fence language (e.g. "cpp", "py", "bash") has a lexer
+    bool isSupported(const std::string& language);
+
+    // Spans of every fenced block in a message and of the tokens in blocks
+    // whose language has a lexer. Lexers are table driven: one generic
+    // scanner parameterised per language by keyword sets, comment and string
+    // syntax. Linear in the text size.
+    std::vector<TokenSpan> highlight(const std::string& text);
+
+    // Highlights messages on the TaskScheduler pool. on_ready runs on a pool
+    // thread after each message is done, typically to wake the UI thread
+    // (Glib::Dispatcher), which then collects the results with
+    // takeResults(). Jobs run one at a time in submission order: a single
+    // drain task is queued while there is work.
+    class Worker {
+    public:
+        struct Result {
+            uint64_t id;
+            std::vector<TokenSpan> spans;
+        };
+
+        explicit Worker(std::function<void()> on_ready,
+                        TaskScheduler& scheduler = TaskScheduler::getInstance());
+        ~Worker();  // drops queued jobs and waits for the one in progress
+
+        Worker(const Worker&) = delete;
+        Worker& operator=(const Worker&) = delete;
+
+        void submit(uint64_t id, std::string text);
+        std::vector<Result> takeResults();
+
+        // Drops queued jobs and undelivered results
+        void cancelAll();
+
+    private:
+        struct Job {
+            uint64_t id;
+            std::string text;
+        };
+
+        std::function<void()> on_ready_;
+        std::mutex mutex_;
+        std::deque<Job> jobs_;
+        std::vector<Result> results_;
+        uint64_t generation_ = 0;   // bumped by cancelAll()
+        bool draining_ = false;     // drain task queued or running
+        bool stopping_ = false;
+        TaskGroup tasks_;           // last, so it is waited for before the rest goes
+
+        void drain();
+    };
+}
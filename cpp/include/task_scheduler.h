@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// Order in which ready tasks run: every worker drains the interactive lane
+// (its own, the shared queue, then other workers') before looking at
+// normal work, and normal before background.
+enum class TaskPriority {
+    INTERACTIVE,
+    NORMAL,
+    BACKGROUND
+};
+constexpr size_t TASK_PRIORITY_COUNT = 3;
+
+// Shared flag for stopping work that has not finished. Copies refer to the
+// same flag; tasks check it at convenient points.
+class CancellationToken {
+public:
+    CancellationToken() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { flag_->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return flag_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+// Process-wide pool for background work. Each worker owns one deque per
+// priority lane: it pushes and pops its own tasks at the back (most recent
+// first, for locality), and idle workers steal from the front of others'
+// deques (oldest first, the larger pieces of split work). Tasks submitted
+// from other threads go to a shared queue per lane. Idle workers sleep
+// until work arrives.
+//
+// Work for the GTK thread is posted with postToMain(); the GUI installs a
+// wake-up (Glib::Dispatcher::emit) and runs the queued continuations with
+// runMainTasks() from its handler.
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    static TaskScheduler& getInstance();
+
+    // 0 = one worker per hardware thread
+    explicit TaskScheduler(size_t workers = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Exceptions escaping a task are logged and dropped; use a TaskGroup
+    // to receive them
+    void submit(Task task, TaskPriority priority = TaskPriority::NORMAL);
+
+    // Runs one ready task on the calling thread, if there is one. Lets a
+    // thread that waits on other tasks help instead of blocking.
+    bool runOne();
+
+    size_t workerCount() const { return workers_.size(); }
+
+    // Continuations for the main (GTK) thread
+    void setMainWakeup(std::function<void()> wakeup);
+    void postToMain(Task task);
+    size_t runMainTasks();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> lanes[TASK_PRIORITY_COUNT];
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex shared_mutex_;
+    std::deque<Task> shared_lanes_[TASK_PRIORITY_COUNT];
+    std::atomic<size_t> queued_{0};     // tasks in any deque
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> sleeping_{0};
+    bool stopping_ = false;
+
+    std::mutex main_mutex_;
+    std::vector<Task> main_tasks_;
+    std::function<void()> main_wakeup_;
+
+    void run(size_t index);
+    bool take(size_t self, Task& task);
+    static void execute(Task& task);
+};
+
+// Tasks that are waited for together. wait() returns when every task run
+// through the group has finished, running queued tasks on the calling
+// thread meanwhile (so waiting from inside a task cannot deadlock the
+// pool), and rethrows the first exception a task threw. Tasks not yet
+// started when the token is cancelled are skipped.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::getInstance(),
+                       CancellationToken token = CancellationToken());
+    ~TaskGroup();   // waits, discarding exceptions
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(TaskScheduler::Task task, TaskPriority priority = TaskPriority::NORMAL);
+    void wait();
+
+    void cancel() { token_.cancel(); }
+    const CancellationToken& token() const { return token_; }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t pending = 0;
+        std::exception_ptr error;
+    };
+
+    TaskScheduler& scheduler_;
+    CancellationToken token_;
+    std::shared_ptr<State> state_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "facet_index.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Substring index over the chat transcript, updated as messages are added.
+// The text is kept once, ASCII case-folded, and divided into BLOCK_SIZE
+// byte blocks; each trigram maps to the bitmap of blocks containing it.
+// A query intersects the bitmaps of its trigrams (rarest first) and
+// verifies only the surviving blocks, so it reads a few blocks rather than
+// the whole transcript. Queries shorter than three bytes scan the text.
+// Matching is case-insensitive for ASCII letters and exact otherwise.
+class TranscriptIndex {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    // Occurrence of a query, in characters from the start of a message
+    struct Match {
+        size_t message;
+        size_t offset;
+        size_t length;
+    };
+
+    // Adds the next message; returns its id (0, 1, ... since the last clear)
+    size_t add(const std::string& text);
+    void clear();
+
+    // Non-overlapping occurrences in transcript order, at most limit of them
+    std::vector<Match> find(const std::string& query, size_t limit = SIZE_MAX) const;
+
+    size_t messageCount() const { return message_starts_.size(); }
+    size_t textBytes() const { return text_.size(); }
+
+private:
+    struct Postings {
+        Bitmap blocks;
+        int64_t last_block = -1;    // blocks are added in order; skips repeats
+    };
+
+    std::string text_;                          // folded messages, each followed by '\0'
+    std::vector<size_t> message_starts_;        // byte offset of each message
+    std::vector<uint64_t> message_chars_;       // characters before each message
+    std::vector<uint64_t> block_chars_;         // characters before each block
+    std::unordered_map<uint32_t, Postings> trigrams_;
+    uint64_t chars_ = 0;
+    size_t indexed_ = 0;                        // trigrams starting before this are indexed
+
+    void scan(const std::string& query, size_t from, size_t to, size_t& next, std::vector<size_t>& hits,
+              size_t limit) const;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <deque>
+#include <vector>
+#include <functional>
+
+// Batches changes to a TextView's buffer and applies them once per display
+// frame, from a tick callback on the view's GdkFrameClock. Within a frame,
+// queued edits run in order, consecutive appends become a single insert,
+// tag ranges are applied up to a fixed budget (the rest carry over to the
+// next frame) and any number of scroll requests become one scroll to the
+// end. Everything runs inside one user-action block, so the buffer is
+// relaid out once per frame however fast updates arrive. The tick callback
+// is registered only while work is pending.
+class UiUpdateScheduler {
+public:
+    // Called with the character offset where appended text starts, when
+    // it is inserted
+    using Placed = std::function<void(int offset)>;
+
+    // Range of a tag, in characters from an origin mark
+    struct TagRange {
+        Glib::RefPtr<Gtk::TextTag> tag;
+        int begin;
+        int end;
+    };
+
+    static constexpr size_t TAG_BUDGET = 2000;     // tag ranges applied per frame
+
+    explicit UiUpdateScheduler(Gtk::TextView& view);
+    ~UiUpdateScheduler();
+
+    UiUpdateScheduler(const UiUpdateScheduler&) = delete;
+    UiUpdateScheduler& operator=(const UiUpdateScheduler&) = delete;
+
+    void append(const Glib::ustring& text, Placed placed = nullptr);
+
+    // Arbitrary buffer change, run in order with appends
+    void edit(std::function<void()> change);
+
+    // Tags applied relative to origin, after this frame's edits. With
+    // release_origin the mark is deleted once the last range is applied.
+    void applyTags(Glib::RefPtr<Gtk::TextMark> origin, std::vector<TagRange> ranges, bool release_origin);
+
+    void scrollToEnd();
+
+    // Runs after the edits of each frame that had any
+    void setAfterEdits(std::function<void()> after_edits) { after_edits_ = std::move(after_edits); }
+
+    // Applies pending edits and scrolling now, e.g. before reading the
+    // buffer; tags stay on the per-frame budget
+    void flush();
+
+    // Drops pending work; owned origin marks are deleted
+    void cancel();
+
+    bool idle() const { return edits_.empty() && tag_runs_.empty() && !scroll_pending_; }
+
+private:
+    struct Edit {
+        Glib::ustring text;                 // appended when change is empty
+        Placed placed;
+        std::function<void()> change;
+    };
+
+    struct TagRun {
+        Glib::RefPtr<Gtk::TextMark> origin;
+        std::vector<TagRange> ranges;
+        bool release_origin;
+        size_t next = 0;
+    };
+
+    Gtk::TextView& view_;
+    Glib::RefPtr<Gtk::TextMark> end_mark_;        // right gravity, stays at the end
+    std::deque<Edit> edits_;
+    std::deque<TagRun> tag_runs_;
+    std::function<void()> after_edits_;
+    bool scroll_pending_ = false;
+    guint tick_id_ = 0;
+
+    void schedule();
+    bool onTick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+    void run(size_t tag_budget);
+    void applyEdits(const Glib::RefPtr<Gtk::TextBuffer>& buffer);
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// UTF-8 validation for everything entering the application from disk or a
+// child process (GTK requires valid UTF-8). isValid() uses an SSSE3 lookup
+// validator when the CPU supports it and a scalar DFA otherwise; both reject
+// overlong forms, surrogates and code points above U+10FFFF.
+namespace utf8 {
+    bool isValid(const char* data, size_t size);
+    inline bool isValid(const std::string& text) { return isValid(text.data(), text.size()); }
+
+    bool isValidScalar(const char* data, size_t size);
+
+    // Offset of the first byte of the first invalid sequence, or size if valid.
+    size_t findInvalid(const char* data, size_t size);
+
+    // Returns text unchanged when valid, otherwise a copy with each invalid
+    // sequence replaced by U+FFFD.
+    std::string sanitize(const std::string& text);
+
+    // Appends the UTF-8 encoding of a code point (U+FFFD if out of range).
+    void encode(uint32_t code_point, std::string& out);
+
+    // Name of the validator selected at runtime ("ssse3" or "scalar").
+    const char* implementation();
+}
@@ -0,0 +1,9 @@
+#include "agent_view_model.h"
+#include "claude_agent.h"
+
+void AgentViewModel::update(const ClaudeAgent& agent) {
+    name_.set(agent.getName());
+    description_.set(agent.getDescription());
+    provider_.set(agent.getActiveProviderName());
+    starters_.set(agent.getConversationStarters());
+}
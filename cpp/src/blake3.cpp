@@ -0,0 +1,172 @@
+#include "blake3.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t IV[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                            0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+constexpr uint8_t MESSAGE_PERMUTATION[16] = {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+constexpr uint32_t CHUNK_START = 1 << 0;
+constexpr uint32_t CHUNK_END = 1 << 1;
+constexpr uint32_t PARENT = 1 << 2;
+constexpr uint32_t ROOT = 1 << 3;
+
+inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline void g(uint32_t* s, int a, int b, int c, int d, uint32_t mx, uint32_t my) {
+    s[a] = s[a] + s[b] + mx;
+    s[d] = rotr(s[d] ^ s[a], 16);
+    s[c] = s[c] + s[d];
+    s[b] = rotr(s[b] ^ s[c], 12);
+    s[a] = s[a] + s[b] + my;
+    s[d] = rotr(s[d] ^ s[a], 8);
+    s[c] = s[c] + s[d];
+    s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+void compress(const uint32_t cv[8], const uint32_t block[16], uint64_t counter, uint32_t block_len,
+              uint32_t flags, uint32_t out[16]) {
+    uint32_t s[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                      IV[0], IV[1], IV[2], IV[3],
+                      static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), block_len, flags};
+    uint32_t m[16];
+    std::memcpy(m, block, sizeof(m));
+
+    for (int round = 0; round < 7; ++round) {
+        g(s, 0, 4, 8, 12, m[0], m[1]);
+        g(s, 1, 5, 9, 13, m[2], m[3]);
+        g(s, 2, 6, 10, 14, m[4], m[5]);
+        g(s, 3, 7, 11, 15, m[6], m[7]);
+        g(s, 0, 5, 10, 15, m[8], m[9]);
+        g(s, 1, 6, 11, 12, m[10], m[11]);
+        g(s, 2, 7, 8, 13, m[12], m[13]);
+        g(s, 3, 4, 9, 14, m[14], m[15]);
+        if (round < 6) {
+            uint32_t permuted[16];
+            for (int i = 0; i < 16; ++i) permuted[i] = m[MESSAGE_PERMUTATION[i]];
+            std::memcpy(m, permuted, sizeof(m));
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        out[i] = s[i] ^ s[i + 8];
+        out[i + 8] = s[i + 8] ^ cv[i];
+    }
+}
+
+void loadBlock(const uint8_t* bytes, size_t size, uint32_t block[16]) {
+    uint8_t padded[64] = {};
+    std::memcpy(padded, bytes, size);
+    for (int i = 0; i < 16; ++i) block[i] = load32(padded + 4 * i);
+}
+
+void parentBlock(const uint32_t left[8], const uint32_t right[8], uint32_t block[16]) {
+    std::memcpy(block, left, 8 * sizeof(uint32_t));
+    std::memcpy(block + 8, right, 8 * sizeof(uint32_t));
+}
+
+} // namespace
+
+Blake3::Blake3() {
+    resetChunk(0);
+}
+
+void Blake3::resetChunk(uint64_t counter) {
+    std::memcpy(chunk_cv_, IV, sizeof(chunk_cv_));
+    chunk_counter_ = counter;
+    block_len_ = 0;
+    blocks_compressed_ = 0;
+}
+
+Blake3::Output Blake3::chunkOutput() const {
+    Output output;
+    std::memcpy(output.cv, chunk_cv_, sizeof(output.cv));
+    loadBlock(block_, block_len_, output.block);
+    output.counter = chunk_counter_;
+    output.block_len = static_cast<uint32_t>(block_len_);
+    output.flags = CHUNK_END | (blocks_compressed_ == 0 ? CHUNK_START : 0);
+    return output;
+}
+
+void Blake3::pushChunk(const uint32_t cv[8], uint64_t total_chunks) {
+    // Merge completed subtrees: one merge per trailing zero bit of the count
+    uint32_t merged[8];
+    std::memcpy(merged, cv, sizeof(merged));
+    while ((total_chunks & 1) == 0) {
+        uint32_t block[16];
+        uint32_t out[16];
+        parentBlock(cv_stack_.back().data(), merged, block);
+        cv_stack_.pop_back();
+        compress(IV, block, 0, BLOCK_LEN, PARENT, out);
+        std::memcpy(merged, out, sizeof(merged));
+        total_chunks >>= 1;
+    }
+    cv_stack_.emplace_back();
+    std::memcpy(cv_stack_.back().data(), merged, sizeof(merged));
+}
+
+void Blake3::update(const void* data, size_t size) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        // A full chunk is only finished once more input arrives, since the
+        // last chunk is compressed differently
+        if (blocks_compressed_ * BLOCK_LEN + block_len_ == CHUNK_LEN) {
+            Output output = chunkOutput();
+            uint32_t out[16];
+            compress(output.cv, output.block, output.counter, output.block_len, output.flags, out);
+            uint64_t total = chunk_counter_ + 1;
+            pushChunk(out, total);
+            resetChunk(total);
+        }
+
+        // Likewise a full block is compressed only when more input follows
+        if (block_len_ == BLOCK_LEN) {
+            uint32_t block[16];
+            uint32_t out[16];
+            loadBlock(block_, BLOCK_LEN, block);
+            compress(chunk_cv_, block, chunk_counter_, BLOCK_LEN, blocks_compressed_ == 0 ? CHUNK_START : 0, out);
+            std::memcpy(chunk_cv_, out, sizeof(chunk_cv_));
+            blocks_compressed_++;
+            block_len_ = 0;
+        }
+
+        size_t take = std::min(BLOCK_LEN - block_len_, size);
+        std::memcpy(block_ + block_len_, input, take);
+        block_len_ += take;
+        input += take;
+        size -= take;
+    }
+}
+
+void Blake3::finalize(uint8_t* out, size_t size) const {
+    Output output = chunkOutput();
+    for (size_t i = cv_stack_.size(); i-- > 0;) {
+        uint32_t words[16];
+        compress(output.cv, output.block, output.counter, output.block_len, output.flags, words);
+        parentBlock(cv_stack_[i].data(), words, output.block);
+        std::memcpy(output.cv, IV, sizeof(output.cv));
+        output.counter = 0;
+        output.block_len = BLOCK_LEN;
+        output.flags = PARENT;
+    }
+
+    // Root output: successive blocks use the output block counter
+    for (uint64_t counter = 0; size > 0; ++counter) {
+        uint32_t words[16];
+        compress(output.cv, output.block, counter, output.block_len, output.flags | ROOT, words);
+        for (size_t i = 0; i < 16 && size > 0; ++i) {
+            for (int byte = 0; byte < 4 && size > 0; ++byte, --size) {
+                *out++ = static_cast<uint8_t>(words[i] >> (8 * byte));
+            }
+        }
+    }
+}
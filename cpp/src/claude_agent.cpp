@@ -1,14 +1,36 @@
 #include "claude_agent.h"
 #include "logger.h"
+#include "utf8.h"
+#include "process_spawner.h"
+#include "context_dedup.h"
+#include "diagnostics.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <climits>
 #include <memory>
 #include <unistd.h>
 
+namespace {
+
+// A CLI turn in flight, as counted by the diagnostics panel
+struct TurnInFlight {
+    bool ok = false;
+    TurnInFlight() { Diagnostics::getInstance().turnStarted(); }
+    ~TurnInFlight() { Diagnostics::getInstance().turnFinished(ok); }
+};
+
+uint64_t microsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace
+
 ClaudeAgent::ClaudeAgent(const std::string& config_file, CliProvider cli_provider)
     : cli_provider_(cli_provider)
     , active_provider_(CliProvider::AUTO) {
@@ -25,6 +47,7 @@ ClaudeAgent::ClaudeAgent(const std::string& config_file, CliProvider cli_provide
     }
 
     last_config_file_ = config_dir + "/.last_config";
+    config_history_ = std::make_unique<ConfigHistory>(config_dir + "/.history");
 
     LOG_INFO("ClaudeAgent constructor called with config_file=" + config_file);
     LOG_DEBUG("CLI provider: " + providerToString(cli_provider));
@@ -73,7 +96,8 @@ bool ClaudeAgent::loadConfig() {
     if (std::filesystem::exists(config_file_)) {
         LOG_DEBUG("Attempting to load default config file: " + config_file_);
         try {
-            config_ = json::parseFromFile(config_file_);
+            config_ = config_resolver_.resolve(config_file_);
+            config_base_ = config_resolver_.baseOf(config_file_);
             LOG_INFO("Loaded configuration from " + config_file_);
             Logger::getInstance().logConfigChange("default", "Loaded from " + config_file_);
             return true;
@@ -85,6 +109,7 @@ bool ClaudeAgent::loadConfig() {
     // Create default config
     LOG_INFO("No configuration file found, creating default configuration");
     config_ = createDefaultConfig();
+    config_base_.clear();
     Logger::getInstance().logConfigChange("default", "Created new default configuration");
     return true;
 }
@@ -92,10 +117,23 @@ bool ClaudeAgent::loadConfig() {
 bool ClaudeAgent::saveConfig() {
     LOG_DEBUG("Attempting to save configuration to " + config_file_);
     try {
-        bool result = json::saveToFile(config_file_, config_);
+        // A config that extends a base is stored as its differences from it
+        auto stored = config_;
+        if (!config_base_.empty()) {
+            try {
+                stored = config_resolver_.derive(config_file_, config_base_, config_);
+            } catch (const std::exception& e) {
+                LOG_WARNING("Base configuration unavailable, saving in full: " + std::string(e.what()));
+                config_base_.clear();
+            }
+        }
+
+        bool result = json::saveToFile(config_file_, stored);
+        config_resolver_.invalidate(config_file_);
         if (result) {
             LOG_INFO("Configuration saved successfully to " + config_file_);
             Logger::getInstance().logConfigChange("save", "Saved to " + config_file_);
+            recordConfigVersion(config_file_, *config_);
         } else {
             LOG_ERROR("Failed to save configuration to " + config_file_);
         }
@@ -108,18 +146,21 @@ bool ClaudeAgent::saveConfig() {
 
 bool ClaudeAgent::loadConfigFromFile(const std::string& file_path) {
     try {
-        auto config = json::parseFromFile(file_path);
-
-        // Validate configuration
-        std::vector<std::string> required_keys = {"name", "description", "instructions", "conversation_starters"};
-        for (const auto& key : required_keys) {
-            if (!config->asObject().find(key)->second) {
-                std::cerr << "Invalid configuration: missing '" << key << "' field" << std::endl;
+        auto config = config_resolver_.resolve(file_path);
+
+        // Validate the resolved configuration; fields may be inherited
+        static const std::vector<json::Path> required_paths = {
+            json::Path("/name"), json::Path("/description"),
+            json::Path("/instructions"), json::Path("/conversation_starters")};
+        for (const auto& path : required_paths) {
+            if (!path.evaluate(*config)) {
+                std::cerr << "Invalid configuration: missing '" << path.pointer().substr(1) << "' field" << std::endl;
                 return false;
             }
         }
 
         config_ = config;
+        config_base_ = config_resolver_.baseOf(file_path);
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error loading config from " << file_path << ": " << e.what() << std::endl;
@@ -139,13 +180,45 @@ bool ClaudeAgent::saveConfigToFile(std::shared_ptr<json::Value> config, const st
     std::string file_path = "configs/" + full_filename;
 
     try {
-        return json::saveToFile(file_path, config);
+        bool saved = json::saveToFile(file_path, config);
+        config_resolver_.invalidate(file_path);
+        if (!saved) {
+            return false;
+        }
+        recordConfigVersion(file_path, *config);
+        return true;
     } catch (const std::exception& e) {
         std::cerr << "Error saving configuration: " << e.what() << std::endl;
         return false;
     }
 }
 
+void ClaudeAgent::recordConfigVersion(const std::string& file_path, const json::Value& config) {
+    // History is best effort: a failure here must not fail the save
+    try {
+        if (config_history_->record(file_path, config)) {
+            LOG_DEBUG("Recorded configuration version " + json::hash(config).toHex() + " of " + file_path);
+        }
+    } catch (const std::exception& e) {
+        LOG_WARNING("Unable to record configuration version: " + std::string(e.what()));
+    }
+}
+
+std::vector<ConfigVersion> ClaudeAgent::getConfigVersions() const {
+    return config_history_->list(config_file_);
+}
+
+bool ClaudeAgent::restoreConfigVersion(const json::Hash128& hash) {
+    auto config = config_history_->load(hash);
+    if (!config) {
+        LOG_ERROR("Configuration version " + hash.toHex() + " is not available");
+        return false;
+    }
+    config_ = config;
+    Logger::getInstance().logConfigChange("restore", "Restored version " + hash.toHex());
+    return saveConfig();
+}
+
 bool ClaudeAgent::loadSpecificConfig(const std::string& file_path) {
     if (loadConfigFromFile(file_path)) {
         saveLastConfigPath(file_path);
@@ -160,7 +233,8 @@ std::string ClaudeAgent::sendToClaudeApi(const std::string& message, bool use_sy
     return sendToCli(message, use_system_prompt);
 }
 
-std::string ClaudeAgent::sendToCli(const std::string& message, bool use_system_prompt) {
+std::string ClaudeAgent::sendToCli(const std::string& message, bool use_system_prompt,
+                                   const OutputCallback& on_output, int cancel_fd) {
     LOG_INFO("Sending message to CLI (length: " + std::to_string(message.length()) + " chars)");
     LOG_DEBUG("Message preview: " + message.substr(0, 100) + (message.length() > 100 ? "..." : ""));
 
@@ -171,77 +245,136 @@ std::string ClaudeAgent::sendToCli(const std::string& message, bool use_system_p
     }
 
     try {
-        std::vector<std::string> cmd;
-
         // Build conversation context
-        std::string full_message = buildConversationContext(message);
+        size_t history_bytes = 0;
+        std::string full_message = buildConversationContext(message, -1, &history_bytes);
         Logger::getInstance().logConversationContext(full_message);
 
-        if (active_provider_ == CliProvider::CLAUDE) {
-            cmd = {cli_path_, "--print"};
-
-            if (use_system_prompt) {
-                std::string system_prompt = getSystemPrompt();
-                cmd.insert(cmd.end(), {"--append-system-prompt", system_prompt});
-                LOG_DEBUG("Added system prompt (length: " + std::to_string(system_prompt.length()) + " chars)");
-            }
-
-            // For Claude CLI, use stdin instead of command line argument for complex messages
-            bool use_stdin = full_message.length() > 100 || full_message.find('\n') != std::string::npos ||
-                full_message.find('\'') != std::string::npos || full_message.find('"') != std::string::npos;
-
-            if (use_stdin) {
-                cmd.push_back("-"); // This tells claude CLI to read from stdin
-                LOG_DEBUG("Using stdin for complex message");
-            } else {
-                cmd.push_back(full_message);
-                LOG_DEBUG("Using command line argument for simple message");
-            }
-        } else if (active_provider_ == CliProvider::GEMINI) {
-            cmd = {cli_path_, "--prompt"};
-
-            if (use_system_prompt) {
-                std::string system_prompt = getSystemPrompt();
-                full_message = system_prompt + "\n\nUser: " + full_message;
-                LOG_DEBUG("Added system prompt for Gemini (total length: " + std::to_string(full_message.length()) + " chars)");
-            }
-
-            // For Gemini CLI, also use stdin for complex messages
-            bool use_stdin = full_message.length() > 100 || full_message.find('\n') != std::string::npos ||
-                full_message.find('\'') != std::string::npos || full_message.find('"') != std::string::npos;
-
-            if (use_stdin) {
-                cmd.push_back("-"); // This tells gemini CLI to read from stdin
-                LOG_DEBUG("Using stdin for complex message");
-            } else {
-                cmd.push_back(full_message);
-                LOG_DEBUG("Using command line argument for simple message");
-            }
-        } else {
+        std::vector<std::string> env;
+        std::vector<std::string> cmd = buildCommand(use_system_prompt, env);
+        if (cmd.empty()) {
             std::string error = "Error: Unknown CLI provider";
             LOG_ERROR(error);
             return error;
         }
+        if (active_provider_ == CliProvider::GEMINI && use_system_prompt) {
+            full_message = getSystemPrompt() + "\n\nUser: " + full_message;
+            LOG_DEBUG("Added system prompt for Gemini (total length: " + std::to_string(full_message.length()) + " chars)");
+        }
+
+        // Both CLIs read the prompt from stdin when given "-"; use it for complex messages
+        bool use_stdin = full_message.length() > 100 || full_message.find('\n') != std::string::npos ||
+            full_message.find('\'') != std::string::npos || full_message.find('"') != std::string::npos;
+
+        if (use_stdin) {
+            cmd.push_back("-");
+            LOG_DEBUG("Using stdin for complex message");
+        } else {
+            cmd.push_back(full_message);
+            LOG_DEBUG("Using command line argument for simple message");
+        }
 
         std::cout << "Sending to " << getActiveProviderName() << ": "
                   << message.substr(0, 100) << (message.length() > 100 ? "..." : "") << std::endl;
 
-        std::string response = executeCommand(cmd, full_message);
+        std::string response = executeCommand(cmd, full_message, env, nullptr, on_output, history_bytes,
+                                              cancel_fd);
+        recordTurn(message, response);
+        return response;
+    } catch (const std::exception& e) {
+        std::string error = "Error communicating with " + getActiveProviderName() + " CLI: " + e.what();
+        Logger::getInstance().logError("CLICommunicator", "send message", e.what());
+        return error;
+    }
+}
 
-        if (!response.empty() && response.find("Error") != 0) {
-            // Store in conversation history
-            ConversationEntry entry;
-            entry.user = message;
-            entry.assistant = response;
-            entry.timestamp = std::chrono::system_clock::now();
-            conversation_history_.push_back(entry);
+ClaudeAgent::PreparedTurn::~PreparedTurn() {
+    discardChild();
+}
 
-            LOG_INFO("Message sent successfully, response received (length: " + std::to_string(response.length()) + " chars)");
-            LOG_DEBUG("Response preview: " + response.substr(0, 100) + (response.length() > 100 ? "..." : ""));
-        } else {
-            LOG_WARNING("Received error response: " + response);
+void ClaudeAgent::PreparedTurn::discardChild() {
+    if (spawned) {
+        auto& spawner = ProcessSpawner::getInstance();
+        spawner.terminate(child);
+        spawner.wait(child);
+        spawned = false;
+    }
+}
+
+std::unique_ptr<ClaudeAgent::PreparedTurn> ClaudeAgent::prepareTurn(const std::string& message,
+                                                                    bool use_system_prompt) {
+    auto turn = std::make_unique<PreparedTurn>();
+    turn->message = message;
+    turn->use_system_prompt = use_system_prompt;
+    if (cli_path_.empty()) {
+        return turn;    // sendPrepared() reports the error
+    }
+
+    turn->command = buildCommand(use_system_prompt, turn->env);
+    if (turn->command.empty()) {
+        return turn;
+    }
+    turn->command.push_back("-");
+    turn->spawned = ProcessSpawner::getInstance().spawn(turn->command, turn->child, turn->env);
+    if (turn->spawned) {
+        LOG_DEBUG("Pre-spawned " + turn->command[0] + " (pid " + std::to_string(turn->child.pid) + ") for a queued message");
+    } else {
+        LOG_WARNING("Pre-spawning " + turn->command[0] + " failed, spawning when the message is sent");
+    }
+    return turn;
+}
+
+std::string ClaudeAgent::sendPrepared(PreparedTurn& turn) {
+    LOG_INFO("Sending prepared message to CLI (length: " + std::to_string(turn.message.length()) + " chars)");
+
+    // Settings may have changed since the child was started
+    std::vector<std::string> env;
+    std::vector<std::string> cmd = cli_path_.empty() ? std::vector<std::string>() : buildCommand(turn.use_system_prompt, env);
+    if (!cmd.empty()) {
+        cmd.push_back("-");
+    }
+    if (cmd != turn.command || env != turn.env) {
+        LOG_DEBUG("CLI settings changed since the turn was prepared, spawning afresh");
+        turn.discardChild();
+        turn.command = std::move(cmd);
+        turn.env = std::move(env);
+    }
+
+    if (cli_path_.empty()) {
+        std::string error = "Error: " + getActiveProviderName() + " CLI not available";
+        LOG_ERROR(error);
+        return error;
+    }
+    if (turn.command.empty()) {
+        std::string error = "Error: Unknown CLI provider";
+        LOG_ERROR(error);
+        return error;
+    }
+    if (turn.discarded) {
+        LOG_INFO("Prepared turn discarded before it was sent");
+        return "Error: Request cancelled";
+    }
+
+    try {
+        // Built now, so it includes every answer received before this turn
+        size_t history_bytes = 0;
+        std::string full_message = buildConversationContext(turn.message, -1, &history_bytes);
+        Logger::getInstance().logConversationContext(full_message);
+        if (active_provider_ == CliProvider::GEMINI && turn.use_system_prompt) {
+            full_message = getSystemPrompt() + "\n\nUser: " + full_message;
         }
 
+        std::cout << "Sending to " << getActiveProviderName() << ": "
+                  << turn.message.substr(0, 100) << (turn.message.length() > 100 ? "..." : "") << std::endl;
+
+        Diagnostics::getInstance().recordPrespawn(turn.spawned);
+        ChildProcess* spawned = turn.spawned ? &turn.child : nullptr;
+        turn.spawned = false;   // executeCommand reaps it
+        // A turn discarded while in flight stops at its next output
+        std::string response = executeCommand(turn.command, full_message, turn.env, spawned,
+                                              [&turn](const std::string&) { return !turn.discarded; },
+                                              history_bytes);
+        recordTurn(turn.message, response, &turn.discarded);
         return response;
     } catch (const std::exception& e) {
         std::string error = "Error communicating with " + getActiveProviderName() + " CLI: " + e.what();
@@ -250,6 +383,68 @@ std::string ClaudeAgent::sendToCli(const std::string& message, bool use_system_p
     }
 }
 
+std::vector<std::string> ClaudeAgent::buildCommand(bool use_system_prompt, std::vector<std::string>& env) {
+    // Generation settings. Neither CLI takes a temperature; the Claude CLI
+    // reads its output token cap from the environment.
+    int max_tokens = getMaxTokens();
+    if (getTemperature() >= 0) {
+        LOG_DEBUG("temperature is not supported by the " + getActiveProviderName() + " CLI, ignoring");
+    }
+
+    if (active_provider_ == CliProvider::CLAUDE) {
+        std::vector<std::string> cmd = {cli_path_, "--print"};
+        if (max_tokens > 0) {
+            env.push_back("CLAUDE_CODE_MAX_OUTPUT_TOKENS=" + std::to_string(max_tokens));
+        }
+        if (use_system_prompt) {
+            std::string system_prompt = getSystemPrompt();
+            cmd.insert(cmd.end(), {"--append-system-prompt", system_prompt});
+            LOG_DEBUG("Added system prompt (length: " + std::to_string(system_prompt.length()) + " chars)");
+        }
+        return cmd;
+    }
+    if (active_provider_ == CliProvider::GEMINI) {
+        // Gemini has no system prompt option; it is prepended to the message
+        return {cli_path_, "--prompt"};
+    }
+    return {};
+}
+
+std::vector<ConversationEntry> ClaudeAgent::getConversationHistory() const {
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    return conversation_history_;
+}
+
+void ClaudeAgent::clearConversationHistory() {
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    conversation_history_.clear();
+    history_index_.clear();
+}
+
+void ClaudeAgent::recordTurn(const std::string& message, const std::string& response,
+                             const std::atomic<bool>* discarded) {
+    if (!response.empty() && response.find("Error") != 0) {
+        // Store in conversation history. Checked under the lock: a turn
+        // discarded before a clear must not land in the cleared history
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        if (discarded && *discarded) {
+            LOG_INFO("Discarded turn not recorded");
+            return;
+        }
+        ConversationEntry entry;
+        entry.user = message;
+        entry.assistant = response;
+        entry.timestamp = std::chrono::system_clock::now();
+        conversation_history_.push_back(entry);
+        history_index_.add(entry.user + "\n" + entry.assistant);
+
+        LOG_INFO("Message sent successfully, response received (length: " + std::to_string(response.length()) + " chars)");
+        LOG_DEBUG("Response preview: " + response.substr(0, 100) + (response.length() > 100 ? "..." : ""));
+    } else {
+        LOG_WARNING("Received error response: " + response);
+    }
+}
+
 bool ClaudeAgent::switchCliProvider(CliProvider new_provider) {
     cli_provider_ = new_provider;
     auto [path, provider] = findAvailableCli();
@@ -264,30 +459,27 @@ std::string ClaudeAgent::getActiveProviderName() const {
 
 // Utility methods
 std::string ClaudeAgent::getName() const {
-    auto name_value = config_->asObject().find("name");
-    return (name_value != config_->asObject().end() && name_value->second)
-           ? name_value->second->asString() : "Custom AI Agent";
+    static const json::Path name_path("/name");
+    return name_path.getString(*config_, "Custom AI Agent");
 }
 
 std::string ClaudeAgent::getDescription() const {
-    auto desc_value = config_->asObject().find("description");
-    return (desc_value != config_->asObject().end() && desc_value->second)
-           ? desc_value->second->asString() : "A helpful AI assistant";
+    static const json::Path description_path("/description");
+    return description_path.getString(*config_, "A helpful AI assistant");
 }
 
 std::string ClaudeAgent::getInstructions() const {
-    auto inst_value = config_->asObject().find("instructions");
-    return (inst_value != config_->asObject().end() && inst_value->second)
-           ? inst_value->second->asString() : "You are a helpful AI assistant.";
+    static const json::Path instructions_path("/instructions");
+    return instructions_path.getString(*config_, "You are a helpful AI assistant.");
 }
 
 std::vector<std::string> ClaudeAgent::getConversationStarters() const {
+    static const json::Path starters_path("/conversation_starters");
     std::vector<std::string> starters;
-    auto starters_value = config_->asObject().find("conversation_starters");
+    const json::Value* starters_value = starters_path.evaluate(*config_);
 
-    if (starters_value != config_->asObject().end() && starters_value->second &&
-        starters_value->second->isArray()) {
-        const auto& array = starters_value->second->asArray();
+    if (starters_value && starters_value->isArray()) {
+        const auto& array = starters_value->asArray();
         for (const auto& item : array) {
             if (item && item->isString()) {
                 starters.push_back(item->asString());
@@ -299,9 +491,70 @@ std::vector<std::string> ClaudeAgent::getConversationStarters() const {
 }
 
 int ClaudeAgent::getConversationMemory() const {
-    auto memory_value = config_->asObject().find("conversation_memory");
-    return (memory_value != config_->asObject().end() && memory_value->second && memory_value->second->isNumber())
-           ? static_cast<int>(memory_value->second->asNumber()) : 5;
+    static const json::Path memory_path("/conversation_memory");
+    return static_cast<int>(memory_path.getNumber(*config_, 5));
+}
+
+size_t ClaudeAgent::getContextBudget() const {
+    size_t configured = getConfiguredContextBudget();
+    if (getLatencyTarget() <= 0) {
+        return configured;
+    }
+    return context_controller_.budget(getActiveProviderName(), configured);
+}
+
+size_t ClaudeAgent::getConfiguredContextBudget() const {
+    static const json::Path context_budget_path("/context_budget_bytes");
+    double budget = context_budget_path.getNumber(*config_, 0);
+    return budget > 0 ? static_cast<size_t>(budget) : DEFAULT_CONTEXT_BUDGET;
+}
+
+double ClaudeAgent::getLatencyTarget() const {
+    static const json::Path latency_target_path("/latency_target_ms");
+    return std::max(0.0, latency_target_path.getNumber(*config_, 0));
+}
+
+int ClaudeAgent::getMaxTokens() const {
+    static const json::Path max_tokens_path("/max_tokens");
+    return static_cast<int>(max_tokens_path.getNumber(*config_, 0));
+}
+
+double ClaudeAgent::getTemperature() const {
+    static const json::Path temperature_path("/temperature");
+    return temperature_path.getNumber(*config_, -1);
+}
+
+OutputLimits ClaudeAgent::getOutputLimits() const {
+    static const json::Path max_output_bytes_path("/max_output_bytes");
+    static const json::Path stop_sequences_path("/stop_sequences");
+    static const json::Path timeout_path("/timeout_seconds");
+
+    // max_tokens doubles as a reader-side budget at ~4 bytes per token, so it
+    // holds for backends without a token flag too; max_output_bytes can tighten it.
+    OutputLimits limits;
+    int max_tokens = getMaxTokens();
+    if (max_tokens > 0) {
+        limits.max_bytes = static_cast<size_t>(max_tokens) * APPROX_BYTES_PER_TOKEN;
+    }
+    double max_bytes = max_output_bytes_path.getNumber(*config_, 0);
+    if (max_bytes > 0 && (limits.max_bytes == 0 || max_bytes < limits.max_bytes)) {
+        limits.max_bytes = static_cast<size_t>(max_bytes);
+    }
+
+    const json::Value* stops = stop_sequences_path.evaluate(*config_);
+    if (stops && stops->isArray()) {
+        for (const auto& item : stops->asArray()) {
+            if (item && item->isString() && !item->asString().empty()) {
+                limits.stop_sequences.push_back(item->asString());
+            }
+        }
+    }
+
+    double timeout = timeout_path.getNumber(*config_, DEFAULT_TIMEOUT_SECONDS);
+    if (timeout > 0) {
+        limits.timeout_ms = static_cast<int>(std::min(timeout * 1000, static_cast<double>(INT_MAX)));
+    }
+    return limits;
 }
 
 void ClaudeAgent::setName(const std::string& name) {
@@ -419,16 +672,25 @@ std::pair<std::string, CliProvider> ClaudeAgent::findAvailableCli() {
 }
 
 std::string ClaudeAgent::getSystemPrompt() {
+    static const json::Path system_prompt_path("/system_prompt");
     std::ostringstream oss;
     oss << "You are " << getName() << ".\n\n";
     oss << "Description: " << getDescription() << "\n\n";
     oss << "Instructions:\n" << getInstructions() << "\n\n";
     oss << "Please follow these instructions carefully and embody the role described above.";
+
+    std::string extra = system_prompt_path.getString(*config_, "");
+    if (!extra.empty()) {
+        oss << "\n\n" << extra;
+    }
     return oss.str();
 }
 
-std::string ClaudeAgent::buildConversationContext(const std::string& current_message, int max_history) {
+std::string ClaudeAgent::buildConversationContext(const std::string& current_message, int max_history,
+                                                  size_t* history_bytes) {
+    std::lock_guard<std::mutex> lock(history_mutex_);
     if (conversation_history_.empty()) {
+        Diagnostics::getInstance().recordContext(current_message.size(), 0);
         return current_message;
     }
 
@@ -436,23 +698,44 @@ std::string ClaudeAgent::buildConversationContext(const std::string& current_mes
         max_history = getConversationMemory();
     }
 
+    // The latest turns plus the earlier turns most relevant to this message
+    std::vector<size_t> turns = history_index_.select(current_message, static_cast<size_t>(std::max(max_history, 0)),
+                                                      RECENCY_TAIL, getContextBudget());
+
+    // Repeated pastes are sent once; later copies become back-references
+    std::vector<dedup::Segment> segments;
+    for (size_t i = 0; i < turns.size(); ++i) {
+        const auto& entry = conversation_history_[turns[i]];
+        std::string turn = std::to_string(i + 1);
+        segments.push_back({"the Human message of turn " + turn, entry.user});
+        segments.push_back({"the Assistant message of turn " + turn, entry.assistant});
+    }
+    segments.push_back({"the current message", current_message});
+
+    size_t saved = dedup::deduplicate(segments);
+    if (saved > 0) {
+        LOG_DEBUG("Context deduplication saved " + std::to_string(saved) + " bytes");
+    }
+
     std::ostringstream oss;
     oss << "Previous conversation:\n";
 
-    // Get recent conversation history
-    size_t start = conversation_history_.size() > static_cast<size_t>(max_history)
-                   ? conversation_history_.size() - max_history : 0;
-
-    for (size_t i = start; i < conversation_history_.size(); ++i) {
-        const auto& entry = conversation_history_[i];
-        oss << "Human: " << entry.user << "\n";
-        oss << "Assistant: " << entry.assistant << "\n";
+    // Turns are numbered so back-references to them can be resolved
+    for (size_t i = 0; i + 1 < segments.size(); i += 2) {
+        oss << "Turn " << (i / 2 + 1) << ":\n";
+        oss << "Human: " << segments[i].text << "\n";
+        oss << "Assistant: " << segments[i + 1].text << "\n";
+    }
+    if (history_bytes) {
+        *history_bytes = static_cast<size_t>(oss.tellp());
     }
 
     oss << "\nCurrent message:\n";
-    oss << "Human: " << current_message;
+    oss << "Human: " << segments.back().text;
 
-    return oss.str();
+    std::string context = oss.str();
+    Diagnostics::getInstance().recordContext(context.size(), saved);
+    return context;
 }
 
 void ClaudeAgent::saveLastConfigPath(const std::string& config_path) {
@@ -509,13 +792,20 @@ std::shared_ptr<json::Value> ClaudeAgent::createDefaultConfig() {
     obj->set("system_prompt", json::string(""));
     obj->set("max_tokens", json::number(4000));
     obj->set("temperature", json::number(0.7));
+    obj->set("stop_sequences", json::array());
     obj->set("conversation_memory", json::number(5));
 
     return config;
 }
 
-std::string ClaudeAgent::executeCommand(const std::vector<std::string>& command, const std::string& stdin_input) {
+std::string ClaudeAgent::executeCommand(const std::vector<std::string>& command, const std::string& stdin_input,
+                                        const std::vector<std::string>& env, ChildProcess* spawned,
+                                        const OutputCallback& on_output, size_t history_bytes,
+                                        int cancel_fd) {
     Logger::getInstance().logCommand(command, stdin_input);
+    auto& spawner = ProcessSpawner::getInstance();
+    TurnInFlight in_flight;
+    auto sent = std::chrono::steady_clock::now();
 
     if (command.empty()) {
         std::string error = "Error: Empty command";
@@ -530,10 +820,14 @@ std::string ClaudeAgent::executeCommand(const std::vector<std::string>& command,
         if (use_stdin && stdin_input.empty()) {
             std::string error = "Error: Stdin input required but not provided";
             LOG_ERROR(error);
+            if (spawned) {
+                spawner.terminate(*spawned);
+                spawner.wait(*spawned);
+            }
             return error;
         }
 
-        // Build command string with proper escaping
+        // Shell-quoted form of the command, for the log only
         std::string cmd = escapeShellArg(command[0]);
         size_t end_idx = use_stdin ? command.size() - 1 : command.size();
 
@@ -548,98 +842,111 @@ std::string ClaudeAgent::executeCommand(const std::vector<std::string>& command,
 
         LOG_DEBUG("Built command string: " + cmd);
 
-        // Use popen with "w" mode if we need to write to stdin
-        FILE* pipe;
-        if (use_stdin) {
-            pipe = popen(cmd.c_str(), "w");
-            if (!pipe) {
-                return "Error: Failed to execute command";
-            }
-
-            // Write stdin input and close the pipe
-            fwrite(stdin_input.c_str(), 1, stdin_input.length(), pipe);
-            fflush(pipe);
-
-            int status = pclose(pipe);
-            if (status != 0) {
-                return "Error: Command failed with status " + std::to_string(status);
-            }
-
-            // For stdin mode, we need to capture output differently
-            // Let's use a different approach with temporary file
-            std::string temp_file = "/tmp/claude_agent_" + std::to_string(getpid()) + ".txt";
-            std::ofstream temp(temp_file);
-            if (!temp.is_open()) {
-                return "Error: Could not create temporary file";
-            }
-            temp << stdin_input;
-            temp.close();
-
-            // Execute command with file redirection
-            std::string cmd_with_redirect = cmd + " < \"" + temp_file + "\"";
-            pipe = popen(cmd_with_redirect.c_str(), "r");
-            if (!pipe) {
-                std::filesystem::remove(temp_file);
-                return "Error: Failed to execute command";
-            }
-
-            std::string result;
-            char buffer[1024];
-            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                result += buffer;
-            }
-
-            status = pclose(pipe);
-            std::filesystem::remove(temp_file);
-
-            if (status != 0) {
-                return "Error: Command failed with status " + std::to_string(status);
-            }
-
-            // Remove trailing newline
-            if (!result.empty() && result.back() == '\n') {
-                result.pop_back();
-            }
-
-            return result;
+        // Spawn directly (no shell); the fork server keeps this cheap even
+        // when the GUI process is large. A pre-spawned child of the same
+        // command is used as is.
+        ChildProcess child;
+        if (spawned) {
+            child = *spawned;
+            LOG_DEBUG("Using pre-spawned " + command[0] + " (pid " + std::to_string(child.pid) + ")");
+        } else if (!spawner.spawn(command, child, env)) {
+            std::string error = "Error: Failed to execute command: " + std::string(std::strerror(errno));
+            LOG_ERROR(error);
+            return error;
         } else {
-            // Regular command execution
-            LOG_DEBUG("Executing regular command (no stdin)");
-            pipe = popen(cmd.c_str(), "r");
-            if (!pipe) {
-                std::string error = "Error: Failed to execute command";
-                LOG_ERROR(error);
-                return error;
-            }
+            Diagnostics::getInstance().recordSpawn(microsSince(sent));
+            LOG_DEBUG("Spawned " + command[0] + " (pid " + std::to_string(child.pid) + ", " +
+                      (spawner.usingForkServer() ? "fork server" : "posix_spawn") + ")");
+        }
 
-            std::string result;
-            char buffer[1024];
-            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                result += buffer;
-            }
+        OutputLimits limits = getOutputLimits();
+        limits.cancel_fd = cancel_fd;
+        OutputEnd end;
+        std::chrono::steady_clock::time_point first_output;
+        OutputCallback forward;
+        if (on_output) {
+            forward = [&on_output](const std::string& chunk) { return on_output(utf8::sanitize(chunk)); };
+        }
+        std::string result = spawner.communicate(child, use_stdin ? stdin_input : "", limits, &end, &first_output,
+                                                 forward);
+        uint64_t first_byte_us = 0;
+        if (!result.empty()) {
+            first_byte_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(first_output - sent).count());
+            Diagnostics::getInstance().recordFirstByte(first_byte_us);
+        }
+        if (end != OutputEnd::COMPLETE) {
+            // Budget reached, stop sequence seen, out of time or cancelled: cut the turn short
+            spawner.terminate(child);
+        }
+        int status = spawner.wait(child);
+        Logger::getInstance().logResponse(result, status);
+
+        // The prompt's cost shows up before the first byte of the answer,
+        // failed turns included; a turn that timed out before answering at
+        // all counts at its full elapsed time, so the budget still shrinks.
+        // Only the history is sized by the budget, so the model is fitted on
+        // history bytes; the message and system prompt land in its fixed cost
+        double target = getLatencyTarget();
+        uint64_t latency_us = first_byte_us > 0 ? first_byte_us
+                            : end == OutputEnd::TIMEOUT ? microsSince(sent) : 0;
+        if (target > 0 && latency_us > 0 && end != OutputEnd::CANCELLED) {
+            context_controller_.observe(getActiveProviderName(), history_bytes, latency_us / 1000.0,
+                                        target, getConfiguredContextBudget());
+        }
 
-            int status = pclose(pipe);
-            Logger::getInstance().logResponse(result, status);
+        in_flight.ok = end == OutputEnd::BYTE_LIMIT || end == OutputEnd::STOP_SEQUENCE ||
+                       (end == OutputEnd::COMPLETE && status == 0);
 
-            if (status != 0) {
-                std::string error = "Error: Command failed with status " + std::to_string(status);
-                LOG_ERROR(error);
-                return error;
-            }
+        if (end == OutputEnd::TIMEOUT) {
+            std::ostringstream error;
+            error << "Error: " << getActiveProviderName() << " CLI request timed out after "
+                  << limits.timeout_ms / 1000.0 << " seconds";
+            LOG_ERROR(error.str());
+            return error.str();
+        }
+        if (end == OutputEnd::CANCELLED) {
+            LOG_INFO("Turn cancelled after " + std::to_string(result.size()) + " bytes, child terminated");
+            return "Error: Request cancelled";
+        }
 
-            // Remove trailing newline
-            if (!result.empty() && result.back() == '\n') {
-                result.pop_back();
-            }
+        if (end == OutputEnd::BYTE_LIMIT) {
+            LOG_INFO("Output budget of " + std::to_string(limits.max_bytes) + " bytes reached, child terminated");
+            result += "\n\n[Response truncated: output limit reached]";
+            return sanitizeOutput(result);
+        }
+        if (end == OutputEnd::STOP_SEQUENCE) {
+            LOG_INFO("Stop sequence reached after " + std::to_string(result.size()) + " bytes, child terminated");
+            return sanitizeOutput(result);
+        }
+
+        if (status != 0) {
+            std::string error = "Error: Command failed with status " + std::to_string(status);
+            LOG_ERROR(error);
+            return error;
+        }
 
-            return result;
+        // Remove trailing newline
+        if (!result.empty() && result.back() == '\n') {
+            result.pop_back();
         }
+
+        return sanitizeOutput(result);
     } catch (const std::exception& e) {
         Logger::getInstance().logError("CommandExecutor", "execute command", e.what());
         return "Error: " + std::string(e.what());
     }
 }
 
+std::string ClaudeAgent::sanitizeOutput(const std::string& output) {
+    // Child output goes straight into GTK widgets, which require valid UTF-8
+    if (utf8::isValid(output)) {
+        return output;
+    }
+    LOG_WARNING("CLI output is not valid UTF-8, replacing invalid sequences");
+    return utf8::sanitize(output);
+}
+
 std::string ClaudeAgent::escapeShellArg(const std::string& arg) {
     std::string escaped = "'";
     for (char c : arg) {
@@ -3,10 +3,55 @@
 #include "config_library_dialog.h"
 #include "logger.h"
 #include <iostream>
-#include <thread>
 #include <iomanip>
 #include <sstream>
 
+namespace {
+
+std::string formatMicros(uint64_t micros) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (micros < 1000) {
+        out << micros << " us";
+    } else if (micros < 1000000) {
+        out << micros / 1000.0 << " ms";
+    } else {
+        out << micros / 1000000.0 << " s";
+    }
+    return out.str();
+}
+
+std::string formatBytes(uint64_t bytes) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (bytes < 1024) {
+        out << bytes << " B";
+    } else if (bytes < 1024 * 1024) {
+        out << bytes / 1024.0 << " KB";
+    } else {
+        out << bytes / (1024.0 * 1024.0) << " MB";
+    }
+    return out.str();
+}
+
+std::string formatLatencies(const Histogram::Snapshot& histogram) {
+    if (histogram.count == 0) {
+        return "-";
+    }
+    return "p50 " + formatMicros(histogram.percentile(0.5)) + "  p90 " + formatMicros(histogram.percentile(0.9)) +
+           "  p99 " + formatMicros(histogram.percentile(0.99)) + "  (n=" + std::to_string(histogram.count) + ")";
+}
+
+std::string formatHitRate(uint64_t hits, uint64_t misses) {
+    if (hits + misses == 0) {
+        return "-";
+    }
+    return std::to_string(100 * hits / (hits + misses)) + "% (" + std::to_string(hits) + "/" +
+           std::to_string(hits + misses) + ")";
+}
+
+} // namespace
+
 ClaudeAgentGUI::ClaudeAgentGUI()
     : main_box_(Gtk::ORIENTATION_VERTICAL)
     , header_box_(Gtk::ORIENTATION_HORIZONTAL)
@@ -18,11 +63,18 @@ ClaudeAgentGUI::ClaudeAgentGUI()
     , library_button_("Library")
     , copy_button_("Copy All")
     , clear_button_("Clear")
+    , find_button_("Find")
+    , diagnostics_button_("Diagnostics")
+    , ui_updates_(chat_display_)
+    , search_box_(Gtk::ORIENTATION_HORIZONTAL)
+    , search_prev_button_("Previous")
+    , search_next_button_("Next")
+    , diagnostics_frame_("Diagnostics")
     , button_box_(Gtk::ORIENTATION_VERTICAL)
     , send_button_("Send")
     , history_button_("History")
     , starters_frame_("Conversation Starters")
-    , processing_message_(false) {
+    , starters_placeholder_("No conversation starters available") {
 
     LOG_INFO("Initializing ClaudeAgentGUI");
 
@@ -30,27 +82,33 @@ ClaudeAgentGUI::ClaudeAgentGUI()
     setupUi();
     setupStyles();
 
+    highlight_dispatcher_.connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onHighlightReady));
+    highlight_worker_ = std::make_unique<highlight::Worker>([this]() { highlight_dispatcher_.emit(); });
+    main_tasks_dispatcher_.connect([]() { TaskScheduler::getInstance().runMainTasks(); });
+    TaskScheduler::getInstance().setMainWakeup([this]() { main_tasks_dispatcher_.emit(); });
+    signal_key_press_event().connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onWindowKeyPressed), false);
+
     LOG_INFO("GUI setup complete, initializing agent...");
     agent_ = std::make_unique<ClaudeAgent>();
 
     LOG_INFO("Agent created, now initializing CLI...");
     agent_->initializeCli();
 
+    bindViewModel();
     refreshInterface();
 
-    LOG_INFO("ClaudeAgentGUI initialization complete");
+    outbound_dispatcher_.connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onOutboundEvents));
+    outbound_ = std::make_unique<OutboundQueue>(*agent_, [this]() { outbound_dispatcher_.emit(); });
 
-    // Start response queue timer
-    timer_connection_ = Glib::signal_timeout().connect(
-        sigc::mem_fun(*this, &ClaudeAgentGUI::checkResponseQueue),
-        TIMER_INTERVAL
-    );
+    LOG_INFO("ClaudeAgentGUI initialization complete");
 }
 
 ClaudeAgentGUI::~ClaudeAgentGUI() {
-    if (timer_connection_.connected()) {
-        timer_connection_.disconnect();
-    }
+    diagnostics_timer_.disconnect();
+    stall_heartbeat_.disconnect();
+    TaskScheduler::getInstance().setMainWakeup(nullptr);
+    outbound_.reset();
+    highlight_worker_.reset();
 }
 
 void ClaudeAgentGUI::setupUi() {
@@ -104,6 +162,11 @@ void ClaudeAgentGUI::setupStyles() {
         .description-label {
             color: #bdc3c7;
         }
+        .diagnostics-label {
+            color: #ecf0f1;
+            font-family: monospace;
+            font-size: 11px;
+        }
     )");
 
     auto screen = Gdk::Screen::get_default();
@@ -137,11 +200,18 @@ void ClaudeAgentGUI::setupHeaderArea() {
     library_button_.signal_clicked().connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onLibraryClicked));
     copy_button_.signal_clicked().connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onCopyAllClicked));
     clear_button_.signal_clicked().connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onClearClicked));
+    find_button_.signal_clicked().connect([this]() {
+        search_bar_.set_search_mode(!search_bar_.get_search_mode());
+    });
+
+    diagnostics_button_.signal_toggled().connect(sigc::mem_fun(*this, &ClaudeAgentGUI::onDiagnosticsToggled));
 
+    header_box_.pack_start(find_button_, Gtk::PACK_SHRINK, 5);
     header_box_.pack_start(config_button_, Gtk::PACK_SHRINK, 5);
     header_box_.pack_start(library_button_, Gtk::PACK_SHRINK, 5);
     header_box_.pack_start(copy_button_, Gtk::PACK_SHRINK, 5);
     header_box_.pack_start(clear_button_, Gtk::PACK_SHRINK, 5);
+    header_box_.pack_start(diagnostics_button_, Gtk::PACK_SHRINK, 5);
 
     // Description label (on second row)
     std::string description = agent_ ? agent_->getDescription() : "A helpful AI assistant";
@@ -160,11 +230,103 @@ void ClaudeAgentGUI::setupChatArea() {
     chat_display_.set_wrap_mode(Gtk::WRAP_WORD);
     chat_display_.get_style_context()->add_class("chat-display");
 
+    // Highlighting tags in highlight::TokenKind order. Tags created later
+    // take priority, so token colours apply over the code block style.
+    static const char* const token_colors[highlight::TOKEN_KIND_COUNT] = {
+        nullptr,    // CODE_BLOCK
+        "#e67e22",  // KEYWORD
+        "#1abc9c",  // TYPE
+        "#e74c3c",  // LITERAL
+        "#2ecc71",  // STRING
+        "#f1c40f",  // NUMBER
+        "#95a5a6",  // COMMENT
+        "#9b59b6",  // PREPROCESSOR
+        "#3498db",  // VARIABLE
+        "#3498db",  // PROPERTY
+    };
+    for (size_t kind = 0; kind < highlight::TOKEN_KIND_COUNT; ++kind) {
+        auto tag = chat_buffer_->create_tag();
+        if (token_colors[kind]) {
+            tag->property_foreground() = token_colors[kind];
+        } else {
+            tag->property_family() = "monospace";
+            tag->property_paragraph_background() = "#2c3e50";
+        }
+        if (kind == static_cast<size_t>(highlight::TokenKind::COMMENT)) {
+            tag->property_style() = Pango::STYLE_ITALIC;
+        }
+        highlight_tags_.push_back(tag);
+    }
+
+    // New messages re-run an open search once per frame
+    ui_updates_.setAfterEdits([this]() {
+        if (search_stale_ && search_bar_.get_search_mode() && !search_entry_.get_text().empty()) {
+            runSearch();
+        }
+        search_stale_ = false;
+    });
+
+    // Search tags last, so they show over code highlighting
+    search_match_tag_ = chat_buffer_->create_tag();
+    search_match_tag_->property_background() = "#f9e79f";
+    search_match_tag_->property_foreground() = "#000000";
+    search_current_tag_ = chat_buffer_->create_tag();
+    search_current_tag_->property_background() = "#f39c12";
+
     chat_scroll_.add(chat_display_);
     chat_scroll_.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
     chat_scroll_.set_min_content_height(400);
 
+    setupSearchBar();
+    setupDiagnosticsPanel();
+    chat_box_.pack_start(search_bar_, Gtk::PACK_SHRINK);
     chat_box_.pack_start(chat_scroll_, Gtk::PACK_EXPAND_WIDGET);
+    chat_box_.pack_start(diagnostics_frame_, Gtk::PACK_SHRINK, 5);
+}
+
+void ClaudeAgentGUI::setupSearchBar() {
+    search_entry_.set_width_chars(40);
+    search_entry_.signal_search_changed().connect([this]() {
+        search_current_ = 0;
+        runSearch();
+    });
+    search_entry_.signal_key_press_event().connect([this](GdkEventKey* event) {
+        if (event->keyval == GDK_KEY_Return || event->keyval == GDK_KEY_KP_Enter) {
+            moveSearchMatch((event->state & GDK_SHIFT_MASK) ? -1 : 1);
+            return true;
+        }
+        return false;
+    }, false);
+    search_prev_button_.signal_clicked().connect([this]() { moveSearchMatch(-1); });
+    search_next_button_.signal_clicked().connect([this]() { moveSearchMatch(1); });
+
+    search_box_.pack_start(search_entry_, Gtk::PACK_SHRINK, 2);
+    search_box_.pack_start(search_prev_button_, Gtk::PACK_SHRINK, 2);
+    search_box_.pack_start(search_next_button_, Gtk::PACK_SHRINK, 2);
+    search_box_.pack_start(search_count_label_, Gtk::PACK_SHRINK, 5);
+    search_bar_.add(search_box_);
+    search_bar_.connect_entry(search_entry_);
+    search_bar_.set_show_close_button(true);
+
+    // Closing the bar removes the match highlighting
+    search_bar_.property_search_mode_enabled().signal_changed().connect([this]() {
+        if (search_bar_.get_search_mode()) {
+            runSearch();
+        } else {
+            clearSearchTags();
+            search_matches_.clear();
+        }
+    });
+}
+
+void ClaudeAgentGUI::setupDiagnosticsPanel() {
+    diagnostics_label_.set_xalign(0);
+    diagnostics_label_.set_selectable(true);
+    diagnostics_label_.get_style_context()->add_class("diagnostics-label");
+    diagnostics_frame_.add(diagnostics_label_);
+    // Hidden until toggled on; show_all_children() leaves it alone
+    diagnostics_frame_.set_no_show_all(true);
+    diagnostics_label_.show();
 }
 
 void ClaudeAgentGUI::setupInputArea() {
@@ -190,69 +352,70 @@ void ClaudeAgentGUI::setupInputArea() {
 }
 
 void ClaudeAgentGUI::setupConversationStarters() {
-    // Add starter_box_ to frame only once during initial setup
+    // Add starter_box_ to frame only once during initial setup. The
+    // placeholder stays first in the box and is shown while there are no
+    // starter buttons after it.
     starters_frame_.add(starter_box_);
-    refreshConversationStarters();
+    starter_box_.pack_start(starters_placeholder_, Gtk::PACK_SHRINK, 2);
 }
 
-void ClaudeAgentGUI::refreshConversationStarters() {
-    // Clear existing buttons
-    starter_buttons_.clear();
-    auto children = starter_box_.get_children();
-    for (auto child : children) {
-        starter_box_.remove(*child);
-    }
-
-    if (!agent_) {
-        auto label = Gtk::manage(new Gtk::Label("Agent not initialized"));
-        starter_box_.pack_start(*label, Gtk::PACK_SHRINK, 2);
-        show_all_children();
-        return;
-    }
-
-    // Add new starter buttons
-    auto starters = agent_->getConversationStarters();
-    if (!starters.empty()) {
-        for (const auto& starter : starters) {
-            auto button = std::make_unique<Gtk::Button>(starter);
-            button->signal_clicked().connect(
-                sigc::bind(sigc::mem_fun(*this, &ClaudeAgentGUI::onStarterClicked), starter));
-            starter_box_.pack_start(*button, Gtk::PACK_SHRINK, 2);
-            starter_buttons_.push_back(std::move(button));
-        }
-    } else {
-        auto label = Gtk::manage(new Gtk::Label("No conversation starters available"));
-        starter_box_.pack_start(*label, Gtk::PACK_SHRINK, 2);
-    }
+void ClaudeAgentGUI::bindViewModel() {
+    view_model_.name().observe([this](const std::string& name) {
+        name_label_.set_text(name);
+        updateTitle();
+    });
+    view_model_.description().observe([this](const std::string& description) {
+        description_label_.set_text(description);
+    });
+    view_model_.provider().observe([this](const std::string&) {
+        updateTitle();
+    });
+    view_model_.starters().observe([this](const std::vector<ListChange<std::string>>& changes) {
+        applyStarterChanges(changes);
+    });
+}
 
-    show_all_children();
+void ClaudeAgentGUI::updateTitle() {
+    std::string provider_name = view_model_.provider().get();
+    std::transform(provider_name.begin(), provider_name.end(), provider_name.begin(), ::toupper);
+    set_title(view_model_.name().get() + " - " + provider_name + " Agent");
 }
 
-void ClaudeAgentGUI::updateHeader() {
-    if (!agent_) {
-        name_label_.set_text("No Agent");
-        description_label_.set_text("Agent not initialized");
-        set_title("Claude Agent GUI - Testing");
-        return;
+void ClaudeAgentGUI::applyStarterChanges(const std::vector<ListChange<std::string>>& changes) {
+    using Kind = ListChange<std::string>::Kind;
+    for (const auto& change : changes) {
+        auto position = starter_buttons_.begin() + static_cast<std::ptrdiff_t>(change.index);
+        switch (change.kind) {
+        case Kind::INSERT: {
+            auto button = std::make_unique<Gtk::Button>(change.value);
+            Gtk::Button* widget = button.get();
+            // Read the label at click time so updates need no rebinding
+            widget->signal_clicked().connect([this, widget]() { onStarterClicked(widget->get_label()); });
+            starter_box_.pack_start(*widget, Gtk::PACK_SHRINK, 2);
+            starter_box_.reorder_child(*widget, static_cast<int>(change.index) + 1);
+            widget->show();
+            starter_buttons_.insert(position, std::move(button));
+            break;
+        }
+        case Kind::REMOVE:
+            starter_box_.remove(**position);
+            starter_buttons_.erase(position);
+            break;
+        case Kind::UPDATE:
+            (*position)->set_label(change.value);
+            break;
+        }
     }
-    name_label_.set_text(agent_->getName());
-    description_label_.set_text(agent_->getDescription());
-    std::string provider_name = agent_->getActiveProviderName();
-    std::transform(provider_name.begin(), provider_name.end(), provider_name.begin(), ::toupper);
-    set_title(agent_->getName() + " - " + provider_name + " Agent");
+    starters_placeholder_.set_visible(starter_buttons_.empty());
 }
 
 void ClaudeAgentGUI::refreshInterface() {
-    updateHeader();
-    refreshConversationStarters();
+    if (agent_) {
+        view_model_.update(*agent_);
+    }
 }
 
 void ClaudeAgentGUI::onSendMessage() {
-    if (processing_message_.load()) {
-        LOG_DEBUG("Ignoring send request - already processing a message");
-        return; // Already processing a message
-    }
-
     auto start_iter = input_buffer_->begin();
     auto end_iter = input_buffer_->end();
     std::string user_message = input_buffer_->get_text(start_iter, end_iter);
@@ -268,17 +431,14 @@ void ClaudeAgentGUI::onSendMessage() {
     // Clear input
     input_buffer_->set_text("");
 
-    // Add user message to chat
-    addMessage("You", user_message);
-
-    // Show thinking message
-    showThinkingMessage();
-
-    // Send to Claude in background thread
-    processing_message_.store(true);
-    LOG_DEBUG("Starting background thread for message processing");
-    std::thread worker(&ClaudeAgentGUI::sendMessageBackground, this, user_message);
-    worker.detach();
+    // Add user message to chat; it waits its turn if others are pending
+    bool queued = outbound_->pending() > 0;
+    addMessage(queued ? "You (queued)" : "You", user_message);
+    uint64_t id = outbound_->enqueue(user_message);
+    if (queued) {
+        LOG_DEBUG("Message " + std::to_string(id) + " queued behind " +
+                  std::to_string(outbound_->pending() - 1) + " pending");
+    }
 }
 
 void ClaudeAgentGUI::onHistoryClicked() {
@@ -302,6 +462,7 @@ void ClaudeAgentGUI::onLibraryClicked() {
 }
 
 void ClaudeAgentGUI::onCopyAllClicked() {
+    ui_updates_.flush();
     auto start_iter = chat_buffer_->begin();
     auto end_iter = chat_buffer_->end();
     std::string chat_content = chat_buffer_->get_text(start_iter, end_iter);
@@ -314,7 +475,17 @@ void ClaudeAgentGUI::onCopyAllClicked() {
 }
 
 void ClaudeAgentGUI::onClearClicked() {
+    outbound_->cancelAll();
+    ui_updates_.cancel();
+    cancelHighlighting();
+    resetSearch();
+    if (thinking_mark_) {
+        chat_buffer_->delete_mark(thinking_mark_);
+        thinking_mark_.reset();
+    }
     chat_buffer_->set_text("");
+    // The turn in flight was discarded above, so its answer cannot be
+    // recorded into the cleared history
     agent_->clearConversationHistory();
     addMessage("System", "Chat cleared. How can I help you?");
 }
@@ -326,16 +497,15 @@ void ClaudeAgentGUI::onCliProviderChanged() {
     if (new_provider == "claude") provider = CliProvider::CLAUDE;
     else if (new_provider == "gemini") provider = CliProvider::GEMINI;
 
-    bool success = agent_->switchCliProvider(provider);
-    updateHeader();
-
-    if (success) {
+    // Switched between turns: queued and in-flight turns read the CLI path
+    outbound_->enqueueChange([this, provider, new_provider]() {
+        if (!agent_->switchCliProvider(provider)) {
+            return "Warning: " + new_provider + " CLI not found";
+        }
         std::string provider_name = agent_->getActiveProviderName();
         std::transform(provider_name.begin(), provider_name.end(), provider_name.begin(), ::toupper);
-        addMessage("System", "Switched to " + provider_name + " CLI");
-    } else {
-        addMessage("System", "Warning: " + new_provider + " CLI not found");
-    }
+        return "Switched to " + provider_name + " CLI";
+    });
 }
 
 void ClaudeAgentGUI::onStarterClicked(const std::string& starter) {
@@ -351,7 +521,17 @@ bool ClaudeAgentGUI::onKeyPressed(GdkEventKey* event) {
     return false;
 }
 
-void ClaudeAgentGUI::addMessage(const std::string& sender, const std::string& message) {
+bool ClaudeAgentGUI::onWindowKeyPressed(GdkEventKey* event) {
+    if (event->keyval == GDK_KEY_f && (event->state & GDK_CONTROL_MASK)) {
+        search_bar_.set_search_mode(true);
+        search_entry_.grab_focus();
+        return true;
+    }
+    return false;
+}
+
+void ClaudeAgentGUI::addMessage(const std::string& sender, const std::string& message, bool transient,
+                                UiUpdateScheduler::Placed placed) {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto tm = *std::localtime(&time_t);
@@ -359,86 +539,218 @@ void ClaudeAgentGUI::addMessage(const std::string& sender, const std::string& me
     std::ostringstream timestamp;
     timestamp << std::put_time(&tm, "%H:%M:%S");
 
-    std::string full_message = "[" + timestamp.str() + "] " + sender + ": " + message + "\n";
+    std::string prefix = "[" + timestamp.str() + "] " + sender + ": ";
+    std::string line = prefix + message;
+    int prefix_length = static_cast<int>(Glib::ustring(prefix).length());
 
-    auto end_iter = chat_buffer_->end();
-    chat_buffer_->insert(end_iter, full_message);
-
-    // Scroll to bottom
-    auto mark = chat_buffer_->get_insert();
-    chat_display_.scroll_to(mark);
+    // Appended, indexed and scrolled to on the next frame
+    ui_updates_.append(line + "\n", [this, line, prefix_length, transient, placed](int offset) {
+        if (!transient) {
+            message_marks_.push_back(chat_buffer_->create_mark(chat_buffer_->get_iter_at_offset(offset), true));
+            transcript_index_.add(line);
+            search_stale_ = true;
+        }
+        if (placed) {
+            placed(offset + prefix_length);
+        }
+    });
+    ui_updates_.scrollToEnd();
 }
 
 void ClaudeAgentGUI::showThinkingMessage() {
-    addMessage("System", "Thinking...");
+    addMessage("System", "Thinking...", true, [this](int offset) {
+        thinking_mark_ = chat_buffer_->create_mark(chat_buffer_->get_iter_at_offset(offset), true);
+    });
 }
 
 void ClaudeAgentGUI::removeThinkingMessage() {
-    auto text = chat_buffer_->get_text();
-    size_t pos = text.rfind("System: Thinking...");
-    if (pos != std::string::npos) {
-        // Find the start of the line
-        size_t line_start = text.rfind('\n', pos);
-        if (line_start == std::string::npos) line_start = 0;
-        else line_start++;
-
-        // Find the end of the line
-        size_t line_end = text.find('\n', pos);
-        if (line_end == std::string::npos) line_end = text.length();
-        else line_end++;
-
-        auto start_iter = chat_buffer_->get_iter_at_offset(line_start);
-        auto end_iter = chat_buffer_->get_iter_at_offset(line_end);
+    // Queued after the message itself, so its mark exists by then
+    ui_updates_.edit([this]() {
+        if (!thinking_mark_) {
+            return;
+        }
+        auto start_iter = thinking_mark_->get_iter();
+        start_iter.set_line_offset(0);
+        auto end_iter = start_iter;
+        end_iter.forward_line();
         chat_buffer_->erase(start_iter, end_iter);
-    }
+        chat_buffer_->delete_mark(thinking_mark_);
+        thinking_mark_.reset();
+    });
 }
 
-void ClaudeAgentGUI::sendMessageBackground(const std::string& message) {
-    LOG_DEBUG("Background thread started for message processing");
+void ClaudeAgentGUI::onOutboundEvents() {
+    for (auto& event : outbound_->takeEvents()) {
+        if (event.kind == OutboundQueue::Event::Kind::STARTED) {
+            showThinkingMessage();
+            continue;
+        }
+        if (event.kind == OutboundQueue::Event::Kind::CHANGED) {
+            refreshInterface();
+            addMessage("System", event.response);
+            continue;
+        }
+        LOG_DEBUG("Received response to message " + std::to_string(event.id) + " (length: " +
+                  std::to_string(event.response.length()) + " chars)");
+        removeThinkingMessage();
 
-    try {
-        std::string response = agent_->sendToClaudeApi(message);
+        // Add Claude's response; code in it is highlighted in the background
+        std::string response = std::move(event.response);
+        addMessage(agent_->getName(), response, false, [this, response](int offset) {
+            highlightCode(offset, response);
+        });
+    }
+}
 
-        LOG_DEBUG("Background thread received response (length: " + std::to_string(response.length()) + " chars)");
+void ClaudeAgentGUI::highlightCode(int offset, const std::string& text) {
+    if (text.find("```") == std::string::npos && text.find("~~~") == std::string::npos) {
+        return;
+    }
+    uint64_t id = next_highlight_id_++;
+    highlight_marks_[id] = chat_buffer_->create_mark(chat_buffer_->get_iter_at_offset(offset), true);
+    highlight_worker_->submit(id, text);
+}
 
-        // Add response to queue
-        {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            response_queue_.push(response);
-            LOG_DEBUG("Response added to queue for UI thread");
+void ClaudeAgentGUI::onHighlightReady() {
+    for (auto& result : highlight_worker_->takeResults()) {
+        auto it = highlight_marks_.find(result.id);
+        if (it == highlight_marks_.end()) {
+            continue;
         }
-    } catch (const std::exception& e) {
-        LOG_ERROR("Exception in background thread: " + std::string(e.what()));
-
-        // Add error response to queue
-        {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            response_queue_.push("Error: " + std::string(e.what()));
+        std::vector<UiUpdateScheduler::TagRange> ranges;
+        ranges.reserve(result.spans.size());
+        for (const auto& span : result.spans) {
+            ranges.push_back({highlight_tags_[static_cast<size_t>(span.kind)], static_cast<int>(span.begin),
+                              static_cast<int>(span.end)});
         }
+        ui_updates_.applyTags(it->second, std::move(ranges), true);
+        highlight_marks_.erase(it);
     }
 }
 
-bool ClaudeAgentGUI::checkResponseQueue() {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
+void ClaudeAgentGUI::cancelHighlighting() {
+    highlight_worker_->cancelAll();
+    for (const auto& [id, mark] : highlight_marks_) {
+        chat_buffer_->delete_mark(mark);
+    }
+    highlight_marks_.clear();
+}
 
-    if (!response_queue_.empty()) {
-        std::string response = response_queue_.front();
-        response_queue_.pop();
+void ClaudeAgentGUI::runSearch() {
+    clearSearchTags();
+    std::string query = search_entry_.get_text();
+    size_t previous = search_current_;
+    search_matches_ = transcript_index_.find(query, SEARCH_LIMIT);
+    if (search_matches_.empty()) {
+        search_count_label_.set_text(query.empty() ? "" : "No matches");
+        return;
+    }
+    for (const auto& match : search_matches_) {
+        int start = message_marks_[match.message]->get_iter().get_offset() + static_cast<int>(match.offset);
+        chat_buffer_->apply_tag(search_match_tag_, chat_buffer_->get_iter_at_offset(start),
+                                chat_buffer_->get_iter_at_offset(start + static_cast<int>(match.length)));
+    }
+    // Keep the position when the query is re-run for a new message
+    search_current_ = std::min(previous, search_matches_.size() - 1);
+    showSearchMatch();
+}
 
-        // Remove thinking message
-        removeThinkingMessage();
+void ClaudeAgentGUI::moveSearchMatch(int step) {
+    if (search_matches_.empty()) {
+        return;
+    }
+    size_t count = search_matches_.size();
+    search_current_ = (search_current_ + (step < 0 ? count - 1 : 1)) % count;
+    showSearchMatch();
+}
+
+void ClaudeAgentGUI::showSearchMatch() {
+    chat_buffer_->remove_tag(search_current_tag_, chat_buffer_->begin(), chat_buffer_->end());
+    const auto& match = search_matches_[search_current_];
+    int start = message_marks_[match.message]->get_iter().get_offset() + static_cast<int>(match.offset);
+    auto begin = chat_buffer_->get_iter_at_offset(start);
+    chat_buffer_->apply_tag(search_current_tag_, begin,
+                            chat_buffer_->get_iter_at_offset(start + static_cast<int>(match.length)));
+    chat_display_.scroll_to(begin, 0.2);
+
+    std::string count = std::to_string(search_matches_.size());
+    if (search_matches_.size() == SEARCH_LIMIT) {
+        count += "+";
+    }
+    search_count_label_.set_text(std::to_string(search_current_ + 1) + " of " + count);
+}
 
-        // Add Claude's response
-        addMessage(agent_->getName(), response);
+void ClaudeAgentGUI::clearSearchTags() {
+    chat_buffer_->remove_tag(search_match_tag_, chat_buffer_->begin(), chat_buffer_->end());
+    chat_buffer_->remove_tag(search_current_tag_, chat_buffer_->begin(), chat_buffer_->end());
+}
 
-        processing_message_.store(false);
+void ClaudeAgentGUI::resetSearch() {
+    clearSearchTags();
+    for (const auto& mark : message_marks_) {
+        chat_buffer_->delete_mark(mark);
     }
+    message_marks_.clear();
+    transcript_index_.clear();
+    search_matches_.clear();
+    search_current_ = 0;
+    search_count_label_.set_text("");
+}
 
-    return true; // Continue timer
+void ClaudeAgentGUI::onDiagnosticsToggled() {
+    if (!diagnostics_button_.get_active()) {
+        diagnostics_timer_.disconnect();
+        stall_heartbeat_.disconnect();
+        diagnostics_frame_.hide();
+        return;
+    }
+    diagnostics_frame_.show();
+    updateDiagnostics();
+    diagnostics_timer_ = Glib::signal_timeout().connect_seconds(
+        sigc::mem_fun(*this, &ClaudeAgentGUI::updateDiagnostics), 1);
+    last_heartbeat_ = std::chrono::steady_clock::now();
+    stall_heartbeat_ = Glib::signal_timeout().connect(
+        sigc::mem_fun(*this, &ClaudeAgentGUI::onStallHeartbeat), HEARTBEAT_MS);
+}
+
+bool ClaudeAgentGUI::onStallHeartbeat() {
+    auto now = std::chrono::steady_clock::now();
+    auto late = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_heartbeat_).count() - HEARTBEAT_MS;
+    last_heartbeat_ = now;
+    if (late >= static_cast<long>(Diagnostics::STALL_MS)) {
+        Diagnostics::getInstance().recordStall(static_cast<uint64_t>(late));
+    }
+    return true;
+}
+
+bool ClaudeAgentGUI::updateDiagnostics() {
+    Diagnostics::Snapshot stats = Diagnostics::getInstance().snapshot();
+
+    std::ostringstream text;
+    text << "Turns in flight: " << stats.in_flight << "   queued: " << stats.queued
+         << "   completed: " << stats.turns << " (" << stats.failed_turns << " failed)\n"
+         << "CLI spawn:        " << formatLatencies(stats.spawn_us) << "\n"
+         << "First byte:       " << formatLatencies(stats.ttfb_us) << "\n"
+         << "Context per turn: last " << formatBytes(stats.last_context_bytes);
+    if (stats.context_bytes.count > 0) {
+        text << "   p50 " << formatBytes(stats.context_bytes.percentile(0.5))
+             << "   p99 " << formatBytes(stats.context_bytes.percentile(0.99));
+    }
+    text << "   dedup saved " << formatBytes(stats.dedup_saved_bytes) << "\n"
+         << "Pre-spawned CLI used: " << formatHitRate(stats.prespawn_used, stats.prespawn_missed)
+         << "   config cache hits: " << formatHitRate(stats.config_hits, stats.config_misses) << "\n"
+         << "Log messages suppressed: " << stats.log_suppressed
+         << "   main-loop stalls (>= " << Diagnostics::STALL_MS << " ms, while shown): " << stats.stalls;
+    if (stats.stalls > 0) {
+        text << " (longest " << stats.longest_stall_ms << " ms)";
+    }
+    text << "   RSS: " << formatBytes(stats.rss_bytes);
+    diagnostics_label_.set_text(text.str());
+    return true;
 }
 
 void ClaudeAgentGUI::showHistoryDialog() {
-    const auto& history = agent_->getConversationHistory();
+    auto history = agent_->getConversationHistory();
 
     if (history.empty()) {
         auto dialog = Gtk::MessageDialog(*this, "No conversation history yet.",
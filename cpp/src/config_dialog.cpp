@@ -1,5 +1,8 @@
 #include "config_dialog.h"
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <ctime>
 
 ConfigDialog::ConfigDialog(Gtk::Window& parent, ClaudeAgent& agent)
     : Gtk::Dialog("Agent Configuration", parent, true)
@@ -12,6 +15,7 @@ ConfigDialog::ConfigDialog(Gtk::Window& parent, ClaudeAgent& agent)
     , save_button_("Save")
     , save_as_button_("Save As...")
     , load_button_("Load...")
+    , history_button_("History...")
     , cancel_button_("Cancel") {
 
     setupUi();
@@ -77,11 +81,13 @@ void ConfigDialog::setupUi() {
     save_button_.signal_clicked().connect(sigc::mem_fun(*this, &ConfigDialog::onSaveClicked));
     save_as_button_.signal_clicked().connect(sigc::mem_fun(*this, &ConfigDialog::onSaveAsClicked));
     load_button_.signal_clicked().connect(sigc::mem_fun(*this, &ConfigDialog::onLoadClicked));
+    history_button_.signal_clicked().connect(sigc::mem_fun(*this, &ConfigDialog::onHistoryClicked));
     cancel_button_.signal_clicked().connect(sigc::mem_fun(*this, &ConfigDialog::onCancelClicked));
 
     button_box_.pack_start(save_button_, Gtk::PACK_SHRINK);
     button_box_.pack_start(save_as_button_, Gtk::PACK_SHRINK);
     button_box_.pack_start(load_button_, Gtk::PACK_SHRINK);
+    button_box_.pack_start(history_button_, Gtk::PACK_SHRINK);
     button_box_.pack_start(cancel_button_, Gtk::PACK_SHRINK);
 
     content_area->pack_start(button_box_, Gtk::PACK_SHRINK);
@@ -133,6 +139,10 @@ void ConfigDialog::onLoadClicked() {
     loadConfigFrom();
 }
 
+void ConfigDialog::onHistoryClicked() {
+    showHistoryDialog();
+}
+
 void ConfigDialog::onCancelClicked() {
     hide();
 }
@@ -215,4 +225,59 @@ void ConfigDialog::loadConfigFrom() {
             error_dialog.run();
         }
     }
-}
\ No newline at end of file
+}
+
+void ConfigDialog::showHistoryDialog() {
+    Gtk::Dialog dialog("Configuration History", *this, true);
+    dialog.set_default_size(500, 400);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Restore", Gtk::RESPONSE_OK);
+
+    auto store = Gtk::ListStore::create(version_columns_);
+    for (const auto& version : agent_.getConfigVersions()) {
+        std::time_t seconds = static_cast<std::time_t>(version.timestamp_ms / 1000);
+        std::tm local{};
+        localtime_r(&seconds, &local);
+        std::ostringstream saved;
+        saved << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+
+        auto row = *store->append();
+        row[version_columns_.saved] = saved.str();
+        row[version_columns_.name] = version.name;
+        row[version_columns_.hash] = version.hash.toHex();
+    }
+
+    Gtk::TreeView tree(store);
+    tree.append_column("Saved", version_columns_.saved);
+    tree.append_column("Name", version_columns_.name);
+
+    Gtk::ScrolledWindow scroll;
+    scroll.add(tree);
+    scroll.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    dialog.get_content_area()->pack_start(scroll, Gtk::PACK_EXPAND_WIDGET, 10);
+    dialog.show_all_children();
+
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }
+    auto selected = tree.get_selection()->get_selected();
+    if (!selected) {
+        return;
+    }
+
+    // Hashes in the list come from toHex(), so the parse cannot fail
+    Glib::ustring value = (*selected)[version_columns_.hash];
+    std::string hex = value.raw();
+    json::Hash128 hash;
+    hash.high = std::stoull(hex.substr(0, 16), nullptr, 16);
+    hash.low = std::stoull(hex.substr(16), nullptr, 16);
+
+    if (agent_.restoreConfigVersion(hash)) {
+        loadCurrentConfig();
+    } else {
+        auto error_dialog = Gtk::MessageDialog(*this,
+            "Unable to restore that version!",
+            false, Gtk::MESSAGE_ERROR);
+        error_dialog.run();
+    }
+}
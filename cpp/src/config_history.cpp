@@ -0,0 +1,479 @@
+#include "config_history.h"
+#include "json_cbor.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+
+constexpr size_t LENGTH_PREFIX = 4;
+constexpr int64_t MS_PER_DAY = 24LL * 60 * 60 * 1000;
+
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+bool parseHex(const std::string& text, json::Hash128& hash) {
+    if (text.size() != 32) {
+        return false;
+    }
+    hash = json::Hash128();
+    for (size_t i = 0; i < 32; ++i) {
+        char c = text[i];
+        uint64_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else return false;
+        uint64_t& half = i < 16 ? hash.high : hash.low;
+        half = (half << 4) | digit;
+    }
+    return true;
+}
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string oneLine(std::string text) {
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    std::replace(text.begin(), text.end(), '\r', ' ');
+    return text;
+}
+
+// Smallest single splice turning before into after: the common prefix and
+// suffix are kept and the rest of after is stored. Cuts stay on UTF-8
+// boundaries of after so the stored text is valid on its own.
+std::shared_ptr<json::Value> splice(const std::string& before, const std::string& after) {
+    size_t limit = std::min(before.size(), after.size());
+    size_t prefix = 0;
+    while (prefix < limit && before[prefix] == after[prefix]) prefix++;
+    while (prefix > 0 && prefix < after.size() && isContinuation(after[prefix])) prefix--;
+
+    size_t suffix = 0;
+    while (suffix < limit - prefix && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) suffix++;
+    while (suffix > 0 && isContinuation(after[after.size() - suffix])) suffix--;
+
+    auto edit = json::array();
+    auto& list = static_cast<json::ArrayValue&>(*edit);
+    list.push(json::number(static_cast<double>(prefix)));
+    list.push(json::number(static_cast<double>(suffix)));
+    list.push(json::string(after.substr(prefix, after.size() - prefix - suffix)));
+    return edit;
+}
+
+// Delta record from before to after (both objects)
+std::shared_ptr<json::Value> makeDelta(const json::Value& before, const json::Value& after) {
+    auto set = json::object();
+    auto remove = json::array();
+    auto edits = json::object();
+
+    const auto& old_members = before.asObject();
+    for (const auto& [key, value] : after.asObject()) {
+        auto it = old_members.find(key);
+        if (it != old_members.end() && json::hash(*it->second) == json::hash(*value)) {
+            continue;
+        }
+        if (it != old_members.end() && it->second->isString() && value->isString()) {
+            static_cast<json::ObjectValue&>(*edits).set(key, splice(it->second->asString(), value->asString()));
+        } else {
+            static_cast<json::ObjectValue&>(*set).set(key, value);
+        }
+    }
+    for (const auto& [key, value] : old_members) {
+        if (!after.asObject().count(key)) {
+            static_cast<json::ArrayValue&>(*remove).push(json::string(key));
+        }
+    }
+
+    auto delta = json::object();
+    auto& record = static_cast<json::ObjectValue&>(*delta);
+    if (!set->asObject().empty()) record.set("set", set);
+    if (!remove->asArray().empty()) record.set("remove", remove);
+    if (!edits->asObject().empty()) record.set("splice", edits);
+    return delta;
+}
+
+void applyDelta(std::shared_ptr<json::ObjectValue>& target, const json::Value& delta) {
+    static const json::Path set_path("/set");
+    static const json::Path remove_path("/remove");
+    static const json::Path splice_path("/splice");
+
+    if (const json::Value* set = set_path.evaluate(delta)) {
+        for (const auto& [key, value] : set->asObject()) {
+            target->set(key, value);
+        }
+    }
+    if (const json::Value* edits = splice_path.evaluate(delta)) {
+        for (const auto& [key, edit] : edits->asObject()) {
+            auto current = target->get(key);
+            const auto& parts = edit->asArray();
+            if (!current || !current->isString() || parts.size() != 3) {
+                throw std::runtime_error("Invalid splice for '" + key + "'");
+            }
+            std::string text = current->asString();
+            size_t prefix = static_cast<size_t>(parts[0]->asNumber());
+            size_t suffix = static_cast<size_t>(parts[1]->asNumber());
+            if (prefix + suffix > text.size()) {
+                throw std::runtime_error("Splice out of range for '" + key + "'");
+            }
+            target->set(key, json::string(text.substr(0, prefix) + parts[2]->asString() +
+                                         text.substr(text.size() - suffix)));
+        }
+    }
+    if (const json::Value* remove = remove_path.evaluate(delta)) {
+        // No erase on ObjectValue: rebuild without the removed keys
+        json::Object members = target->asObject();
+        for (const auto& key : remove->asArray()) {
+            members.erase(key->asString());
+        }
+        target = std::make_shared<json::ObjectValue>(members);
+    }
+}
+
+} // namespace
+
+ConfigHistory::ConfigHistory(const std::string& directory, const HistoryPolicy& policy)
+    : directory_(directory)
+    , policy_(policy) {}
+
+std::string ConfigHistory::packPath() const {
+    return directory_ + "/objects.pack";
+}
+
+// Same-named configs in different directories get separate logs
+std::string ConfigHistory::logPath(const std::string& file_name) const {
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::absolute(file_name, ec), ec);
+    if (ec) {
+        path = file_name;
+    }
+    std::string key = json::hash(*json::string(path.string())).toHex().substr(0, 16);
+    return directory_ + "/" + path.filename().string() + "-" + key + ".log";
+}
+
+void ConfigHistory::scanPack() const {
+    if (scanned_) {
+        return;
+    }
+    scanned_ = true;
+    objects_.clear();
+    pack_size_ = 0;
+
+    std::error_code ec;
+    if (!std::filesystem::exists(packPath(), ec)) {
+        return;
+    }
+
+    static const json::Path hash_path("/hash");
+    static const json::Path base_path("/base");
+    static const json::Path depth_path("/depth");
+
+    uint64_t valid_end = 0;
+    try {
+        json::MappedFile pack(packPath());
+        const auto* bytes = reinterpret_cast<const unsigned char*>(pack.data());
+        while (valid_end + LENGTH_PREFIX <= pack.size()) {
+            uint32_t size = bytes[valid_end] | bytes[valid_end + 1] << 8 | bytes[valid_end + 2] << 16 |
+                            static_cast<uint32_t>(bytes[valid_end + 3]) << 24;
+            if (size > pack.size() - valid_end - LENGTH_PREFIX) {
+                break;
+            }
+            auto view = json::CborView::open(pack.data() + valid_end + LENGTH_PREFIX, size);
+            ObjectInfo info{valid_end, size, 0, json::Hash128()};
+            json::Hash128 hash;
+            if (!parseHex(std::string(view.find(hash_path).asString()), hash)) {
+                break;
+            }
+            auto base = view.find(base_path);
+            if (base.valid() && !parseHex(std::string(base.asString()), info.base)) {
+                break;
+            }
+            info.depth = static_cast<uint32_t>(view.find(depth_path).asNumber());
+            objects_[hash] = info;
+            valid_end += LENGTH_PREFIX + size;
+        }
+        if (valid_end < pack.size()) {
+            LOG_WARNING("Config history: discarding " + std::to_string(pack.size() - valid_end) +
+                        " unreadable bytes at the end of " + packPath());
+        }
+    } catch (const std::exception& e) {
+        LOG_WARNING("Config history: pack damaged after offset " + std::to_string(valid_end) + ": " + e.what());
+    }
+
+    // Appends must follow the last good record
+    if (std::filesystem::file_size(packPath(), ec) != valid_end) {
+        std::filesystem::resize_file(packPath(), valid_end, ec);
+    }
+    pack_size_ = valid_end;
+}
+
+std::string ConfigHistory::readRecord(const ObjectInfo& info) const {
+    std::ifstream pack(packPath(), std::ios::binary);
+    std::string bytes(info.size, '\0');
+    pack.seekg(static_cast<std::streamoff>(info.offset + LENGTH_PREFIX));
+    if (!pack.read(&bytes[0], info.size)) {
+        throw std::runtime_error("Unable to read history object");
+    }
+    return bytes;
+}
+
+bool ConfigHistory::appendRecord(const json::Hash128& hash, const json::Value& record, const ObjectInfo& info) {
+    std::string bytes = json::toCbor(record);
+    std::ofstream pack(packPath(), std::ios::binary | std::ios::app);
+    if (!pack.is_open()) {
+        return false;
+    }
+    uint32_t size = static_cast<uint32_t>(bytes.size());
+    char prefix[LENGTH_PREFIX] = {static_cast<char>(size), static_cast<char>(size >> 8),
+                                  static_cast<char>(size >> 16), static_cast<char>(size >> 24)};
+    pack.write(prefix, LENGTH_PREFIX);
+    pack.write(bytes.data(), bytes.size());
+    pack.flush();
+    if (!pack.good()) {
+        return false;
+    }
+
+    objects_[hash] = ObjectInfo{pack_size_, size, info.depth, info.base};
+    pack_size_ += LENGTH_PREFIX + size;
+    return true;
+}
+
+std::vector<ConfigVersion> ConfigHistory::readLog(const std::string& path) const {
+    std::vector<ConfigVersion> versions;
+    std::ifstream log(path);
+    std::string line;
+    while (std::getline(log, line)) {
+        std::istringstream fields(line);
+        ConfigVersion version;
+        std::string hex;
+        if (!(fields >> version.timestamp_ms >> hex) || !parseHex(hex, version.hash)) {
+            continue;
+        }
+        fields.get();
+        std::getline(fields, version.name);
+        versions.push_back(std::move(version));
+    }
+    std::reverse(versions.begin(), versions.end());
+    return versions;
+}
+
+bool ConfigHistory::writeLog(const std::string& path, const std::vector<ConfigVersion>& newest_first) const {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream log(temp, std::ios::trunc);
+        for (auto it = newest_first.rbegin(); it != newest_first.rend(); ++it) {
+            log << it->timestamp_ms << ' ' << it->hash.toHex() << ' ' << it->name << '\n';
+        }
+        if (!log.good()) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+bool ConfigHistory::record(const std::string& file_name, const json::Value& config) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    scanPack();
+
+    json::Hash128 hash = json::hash(config);
+    std::string log_path = logPath(file_name);
+    std::vector<ConfigVersion> versions = readLog(log_path);
+    if (!versions.empty() && versions.front().hash == hash) {
+        return false;
+    }
+
+    std::string full = json::toCbor(config);
+
+    if (!objects_.count(hash)) {
+        auto record = json::object();
+        auto& fields = static_cast<json::ObjectValue&>(*record);
+        fields.set("hash", json::string(hash.toHex()));
+        ObjectInfo info{0, 0, 0, json::Hash128()};
+
+        // Delta against the previous version of this file when it is
+        // close to a snapshot and actually smaller than the content
+        auto previous = versions.empty() ? nullptr : load(versions.front().hash);
+        if (previous && previous->isObject() && config.isObject() &&
+            objects_[versions.front().hash].depth + 1 < policy_.max_chain) {
+            size_t chain_bytes = 0;
+            for (auto it = objects_.find(versions.front().hash); it != objects_.end() && it->second.depth > 0;
+                 it = objects_.find(it->second.base)) {
+                chain_bytes += it->second.size;
+            }
+            auto delta = makeDelta(*previous, config);
+            size_t delta_bytes = json::toCbor(*delta).size();
+            if (delta_bytes * 2 < full.size() && chain_bytes + delta_bytes < full.size()) {
+                info.base = versions.front().hash;
+                info.depth = objects_[info.base].depth + 1;
+                for (const auto& [key, value] : delta->asObject()) {
+                    fields.set(key, value);
+                }
+                fields.set("base", json::string(info.base.toHex()));
+                fields.set("depth", json::number(info.depth));
+            }
+        }
+        if (info.depth == 0) {
+            fields.set("full", json::fromCbor(full.data(), full.size()));
+            fields.set("depth", json::number(0));
+        }
+
+        if (!appendRecord(hash, *record, info)) {
+            LOG_ERROR("Config history: unable to write " + packPath());
+            return false;
+        }
+    }
+
+    // The new head replaces the old one in the cache
+    if (!versions.empty()) {
+        heads_.erase(versions.front().hash);
+    }
+    heads_[hash] = std::move(full);
+
+    static const json::Path name_path("/name");
+    std::string name = config.isObject() ? name_path.getString(config, "") : "";
+    {
+        std::ofstream log(log_path, std::ios::app);
+        log << nowMs() << ' ' << hash.toHex() << ' ' << oneLine(name) << '\n';
+    }
+
+    // Amortized: collect once a log has grown a quarter past its limit
+    if (versions.size() + 1 > policy_.max_versions + policy_.max_versions / 4) {
+        collectGarbage();
+    }
+    return true;
+}
+
+std::vector<ConfigVersion> ConfigHistory::list(const std::string& file_name) const {
+    return readLog(logPath(file_name));
+}
+
+std::shared_ptr<json::Value> ConfigHistory::load(const json::Hash128& hash) const {
+    scanPack();
+    try {
+        auto head = heads_.find(hash);
+        if (head != heads_.end()) {
+            return json::fromCbor(head->second.data(), head->second.size());
+        }
+
+        // Walk back to the snapshot, then replay the deltas forwards
+        std::vector<std::string> chain;
+        json::Hash128 current = hash;
+        while (true) {
+            auto it = objects_.find(current);
+            if (it == objects_.end() || chain.size() > objects_.size()) {
+                return nullptr;
+            }
+            chain.push_back(readRecord(it->second));
+            if (it->second.depth == 0) {
+                break;
+            }
+            current = it->second.base;
+        }
+
+        static const json::Path full_path("/full");
+        auto snapshot = json::fromCbor(chain.back().data(), chain.back().size());
+        auto value = full_path.find(snapshot);
+        if (!value) {
+            return nullptr;
+        }
+        if (chain.size() > 1) {
+            auto object = std::make_shared<json::ObjectValue>(value->asObject());
+            for (size_t i = chain.size() - 1; i-- > 0;) {
+                applyDelta(object, *json::fromCbor(chain[i].data(), chain[i].size()));
+            }
+            value = object;
+        }
+
+        if (json::hash(*value) != hash) {
+            LOG_WARNING("Config history: version " + hash.toHex() + " does not match its content");
+            return nullptr;
+        }
+        return value;
+    } catch (const std::exception& e) {
+        LOG_WARNING("Config history: unable to load version " + hash.toHex() + ": " + e.what());
+        return nullptr;
+    }
+}
+
+uint64_t ConfigHistory::collectGarbage() {
+    scanPack();
+
+    // Trim every log by the policy and gather the versions still listed
+    std::vector<json::Hash128> roots;
+    std::error_code ec;
+    int64_t cutoff = nowMs() - policy_.max_age_days * MS_PER_DAY;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+        if (entry.path().extension() != ".log") {
+            continue;
+        }
+        std::vector<ConfigVersion> versions = readLog(entry.path().string());
+        std::vector<ConfigVersion> kept;
+        for (size_t i = 0; i < versions.size(); ++i) {
+            if (i < policy_.min_versions || (i < policy_.max_versions && versions[i].timestamp_ms >= cutoff)) {
+                kept.push_back(versions[i]);
+                roots.push_back(versions[i].hash);
+            }
+        }
+        if (kept.size() != versions.size()) {
+            writeLog(entry.path().string(), kept);
+        }
+    }
+
+    // Reachable objects include the bases deltas depend on
+    std::unordered_map<json::Hash128, bool, Hasher> live;
+    for (json::Hash128 hash : roots) {
+        auto it = objects_.find(hash);
+        while (it != objects_.end() && live.emplace(it->first, true).second && it->second.depth > 0) {
+            it = objects_.find(it->second.base);
+        }
+    }
+    for (auto it = heads_.begin(); it != heads_.end();) {
+        it = live.count(it->first) ? std::next(it) : heads_.erase(it);
+    }
+    if (live.size() == objects_.size()) {
+        return 0;
+    }
+
+    // Copy live records in pack order, so bases still precede their deltas
+    std::vector<std::pair<uint64_t, const ObjectInfo*>> records;
+    for (const auto& [hash, info] : objects_) {
+        if (live.count(hash)) {
+            records.emplace_back(info.offset, &info);
+        }
+    }
+    std::sort(records.begin(), records.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::string temp = packPath() + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        std::ifstream in(packPath(), std::ios::binary);
+        std::string bytes;
+        for (const auto& [offset, info] : records) {
+            bytes.resize(LENGTH_PREFIX + info->size);
+            in.seekg(static_cast<std::streamoff>(offset));
+            in.read(&bytes[0], bytes.size());
+            out.write(bytes.data(), bytes.size());
+        }
+        if (!in.good() || !out.good()) {
+            LOG_ERROR("Config history: garbage collection failed, pack left unchanged");
+            std::filesystem::remove(temp, ec);
+            return 0;
+        }
+    }
+
+    uint64_t before = pack_size_;
+    std::filesystem::rename(temp, packPath(), ec);
+    scanned_ = false;
+    scanPack();
+    LOG_INFO("Config history: collected " + std::to_string(before - pack_size_) + " bytes");
+    return before - pack_size_;
+}
@@ -2,11 +2,15 @@
 #include "logger.h"
 #include <iostream>
 #include <filesystem>
+#include <set>
 
 ConfigLibraryDialog::ConfigLibraryDialog(Gtk::Window& parent, ClaudeAgent& agent)
     : Gtk::Dialog("Configuration Library", parent, true)
     , agent_(agent)
     , browse_box_(Gtk::ORIENTATION_VERTICAL)
+    , browse_content_(Gtk::ORIENTATION_HORIZONTAL)
+    , facet_box_(Gtk::ORIENTATION_VERTICAL)
+    , match_all_tags_button_("Match all selected tags")
     , templates_box_(Gtk::ORIENTATION_VERTICAL)
     , import_export_box_(Gtk::ORIENTATION_VERTICAL)
     , management_box_(Gtk::ORIENTATION_VERTICAL)
@@ -47,9 +51,14 @@ void ConfigLibraryDialog::setupBrowseTab() {
     browse_box_.set_margin_top(10);
     browse_box_.set_margin_bottom(10);
 
-    // Create list store and tree view
+    // Create list store and tree view; the filter shows the rows whose
+    // document id is in the current facet matches
     config_store_ = Gtk::ListStore::create(config_columns_);
-    config_tree_.set_model(config_store_);
+    config_filter_ = Gtk::TreeModelFilter::create(config_store_);
+    config_filter_->set_visible_func([this](const Gtk::TreeModel::const_iterator& iter) {
+        return facet_matches_.contains((*iter)[config_columns_.index]);
+    });
+    config_tree_.set_model(config_filter_);
 
     config_tree_.append_column("Name", config_columns_.name);
     config_tree_.append_column("Description", config_columns_.description);
@@ -59,7 +68,17 @@ void ConfigLibraryDialog::setupBrowseTab() {
     browse_scroll_.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
     browse_scroll_.set_min_content_height(300);
 
-    browse_box_.pack_start(browse_scroll_, Gtk::PACK_EXPAND_WIDGET);
+    // Facet panel left of the list
+    facet_box_.set_spacing(2);
+    match_all_tags_button_.signal_toggled().connect(sigc::mem_fun(*this, &ConfigLibraryDialog::onFacetToggled));
+    facet_scroll_.add(facet_box_);
+    facet_scroll_.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    facet_scroll_.set_min_content_width(180);
+
+    browse_content_.set_spacing(10);
+    browse_content_.pack_start(facet_scroll_, Gtk::PACK_SHRINK);
+    browse_content_.pack_start(browse_scroll_, Gtk::PACK_EXPAND_WIDGET);
+    browse_box_.pack_start(browse_content_, Gtk::PACK_EXPAND_WIDGET);
 
     // Buttons
     browse_buttons_.set_spacing(5);
@@ -257,20 +276,47 @@ void ConfigLibraryDialog::refreshConfigList() {
 
     LOG_DEBUG("Total config files found: " + std::to_string(config_files.size()));
 
-    // Add to tree
+    // Add to tree. Only the summary fields are needed, so the files are
+    // scanned without building a DOM and the (large) instructions are skipped.
+    // Category and tags go into the facet index under the row's id. Configs
+    // that extend a base take the fields they do not set from the resolver,
+    // which keeps the resolved family across refreshes.
+    static const std::vector<json::Path> summary_paths = {
+        json::Path("/name"), json::Path("/description"), json::Path("/category"), json::Path("/tags"),
+        json::Path("/extends")};
+    facet_index_.clear();
+    uint32_t next_id = 0;
     for (const auto& file : config_files) {
+        uint32_t id = next_id++;
+        facet_index_.addDocument(id);
         try {
-            auto config = json::parseFromFile(file.string());
-            auto obj = config->asObject();
+            auto summary = json::extractFromFile(file.string(), summary_paths);
+            if (summary[4]) {
+                auto resolved = agent_.getConfigResolver().resolve(file.string());
+                for (size_t i = 0; i < 4; ++i) {
+                    summary[i] = summary_paths[i].find(resolved);
+                }
+            }
+
+            if (summary[2] && summary[2]->isString() && !summary[2]->asString().empty()) {
+                facet_index_.add(id, "category", summary[2]->asString());
+            }
+            if (summary[3] && summary[3]->isArray()) {
+                for (const auto& tag : summary[3]->asArray()) {
+                    if (tag->isString() && !tag->asString().empty()) {
+                        facet_index_.add(id, "tags", tag->asString());
+                    }
+                }
+            }
 
             std::string name = "Unknown";
-            if (obj.find("name") != obj.end() && obj.at("name")) {
-                name = obj.at("name")->asString();
+            if (summary[0] && summary[0]->isString()) {
+                name = summary[0]->asString();
             }
 
             std::string desc = "No description";
-            if (obj.find("description") != obj.end() && obj.at("description")) {
-                desc = obj.at("description")->asString();
+            if (summary[1] && summary[1]->isString()) {
+                desc = summary[1]->asString();
                 if (desc.length() > 50) {
                     desc = desc.substr(0, 50) + "...";
                 }
@@ -280,6 +326,7 @@ void ConfigLibraryDialog::refreshConfigList() {
             row[config_columns_.name] = name;
             row[config_columns_.description] = desc;
             row[config_columns_.filename] = file.filename().string();
+            row[config_columns_.index] = id;
             LOG_DEBUG("Added config to tree: " + name + " (" + file.filename().string() + ")");
 
         } catch (const std::exception& e) {
@@ -288,8 +335,93 @@ void ConfigLibraryDialog::refreshConfigList() {
             row[config_columns_.name] = "Error";
             row[config_columns_.description] = "Could not read: " + std::string(e.what());
             row[config_columns_.filename] = file.filename().string();
+            row[config_columns_.index] = id;
         }
     }
+
+    rebuildFacetPanel();
+}
+
+void ConfigLibraryDialog::rebuildFacetPanel() {
+    // Keep the user's selection across a refresh where the value still exists
+    std::set<std::pair<std::string, std::string>> checked;
+    for (const auto& check : facet_checks_) {
+        if (check.button->get_active()) {
+            checked.emplace(check.facet, check.value);
+        }
+    }
+
+    for (const auto& check : facet_checks_) {
+        facet_box_.remove(*check.button);
+    }
+    for (const auto& header : facet_headers_) {
+        facet_box_.remove(*header);
+    }
+    if (match_all_tags_button_.get_parent()) {
+        facet_box_.remove(match_all_tags_button_);
+    }
+    facet_checks_.clear();
+    facet_headers_.clear();
+
+    for (const auto& [facet, title] : {std::make_pair(std::string("category"), "Category"),
+                                       std::make_pair(std::string("tags"), "Tags")}) {
+        std::vector<std::string> values = facet_index_.values(facet);
+        if (values.empty()) {
+            continue;
+        }
+        auto header = std::make_unique<Gtk::Label>();
+        header->set_markup(std::string("<b>") + title + "</b>");
+        header->set_xalign(0.0);
+        facet_box_.pack_start(*header, Gtk::PACK_SHRINK);
+        facet_headers_.push_back(std::move(header));
+
+        for (const auto& value : values) {
+            auto button = std::make_unique<Gtk::CheckButton>(value);
+            button->set_active(checked.count({facet, value}) > 0);
+            button->signal_toggled().connect(sigc::mem_fun(*this, &ConfigLibraryDialog::onFacetToggled));
+            facet_box_.pack_start(*button, Gtk::PACK_SHRINK);
+            facet_checks_.push_back({facet, value, std::move(button)});
+        }
+        if (facet == "tags") {
+            facet_box_.pack_start(match_all_tags_button_, Gtk::PACK_SHRINK);
+        }
+    }
+    facet_box_.show_all_children();
+    facet_scroll_.set_visible(!facet_checks_.empty());
+
+    onFacetToggled();
+}
+
+std::vector<FacetIndex::Clause> ConfigLibraryDialog::selectedFacets(const std::string& except_facet) const {
+    FacetIndex::Clause category{"category", {}, false};
+    FacetIndex::Clause tags{"tags", {}, match_all_tags_button_.get_active()};
+    for (const auto& check : facet_checks_) {
+        if (check.button->get_active() && check.facet != except_facet) {
+            (check.facet == "category" ? category : tags).values.push_back(check.value);
+        }
+    }
+    return {category, tags};
+}
+
+void ConfigLibraryDialog::onFacetToggled() {
+    facet_matches_ = facet_index_.evaluate(selectedFacets());
+    config_filter_->refilter();
+
+    // Live counts: what checking a box would show. Checking another value
+    // of an OR clause widens it, so those counts leave that facet's own
+    // clause out; values of an AND clause narrow the current matches.
+    std::map<std::string, Bitmap> bases;
+    for (const auto& check : facet_checks_) {
+        if (bases.count(check.facet)) {
+            continue;
+        }
+        bool narrows = check.facet == "tags" && match_all_tags_button_.get_active();
+        bases[check.facet] = narrows ? facet_matches_ : facet_index_.evaluate(selectedFacets(check.facet));
+    }
+    for (const auto& check : facet_checks_) {
+        uint64_t count = facet_index_.count(bases[check.facet], check.facet, check.value);
+        check.button->set_label(check.value + " (" + std::to_string(count) + ")");
+    }
 }
 
 void ConfigLibraryDialog::onRefreshClicked() {
@@ -483,7 +615,7 @@ void ConfigLibraryDialog::showPreviewDialog(const std::string& filename) {
     }
 
     try {
-        auto config = json::parseFromFile(full_path);
+        auto config = agent_.getConfigResolver().resolve(full_path);
         auto obj = config->asObject();
 
         auto preview_dialog = std::make_unique<Gtk::Dialog>("Preview: " + filename, *this);
@@ -0,0 +1,161 @@
+#include "config_resolver.h"
+#include "diagnostics.h"
+#include "logger.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+std::string ConfigResolver::canonicalPath(const std::string& file_path) {
+    std::error_code ec;
+    fs::path path = fs::weakly_canonical(file_path, ec);
+    return ec ? fs::absolute(file_path).lexically_normal().string() : path.string();
+}
+
+ConfigResolver::Node& ConfigResolver::load(const std::string& path) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    uintmax_t size = ec ? 0 : fs::file_size(path, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot read configuration " + path + ": " + ec.message());
+    }
+
+    Node& node = nodes_[path];
+    if (node.loaded && node.mtime == mtime && node.size == size) {
+        return node;
+    }
+
+    auto content = json::parseFromFile(path);
+    std::shared_ptr<json::Value> own = content;
+    std::string base;
+    if (content->isObject()) {
+        const json::Object& fields = content->asObject();
+        auto extends = fields.find(EXTENDS_KEY);
+        if (extends != fields.end()) {
+            if (!extends->second->isString() || extends->second->asString().empty()) {
+                throw std::runtime_error("Invalid configuration " + path + ": 'extends' must name a config file");
+            }
+            fs::path base_path = extends->second->asString();
+            if (!base_path.has_extension()) {
+                base_path += ".json";
+            }
+            base = canonicalPath((fs::path(path).parent_path() / base_path).string());
+
+            json::Object without_extends = fields;
+            without_extends.erase(EXTENDS_KEY);
+            own = std::make_shared<json::ObjectValue>(without_extends);
+        }
+    }
+
+    // Edges live in both directions: base for resolution, children for
+    // invalidation. Map references stay valid as nodes are added.
+    if (node.base != base) {
+        if (!node.base.empty()) {
+            nodes_[node.base].children.erase(path);
+        }
+        if (!base.empty()) {
+            nodes_[base].children.insert(path);
+        }
+    }
+
+    bool reloaded = node.loaded;
+    node.loaded = true;
+    node.mtime = mtime;
+    node.size = size;
+    node.own = own;
+    node.base = base;
+    dropResolved(path);
+    if (reloaded) {
+        LOG_DEBUG("Configuration " + path + " changed, re-resolving it and " +
+                  std::to_string(node.children.size()) + " direct descendant(s)");
+    }
+    return node;
+}
+
+void ConfigResolver::dropResolved(const std::string& path) {
+    std::vector<std::string> pending = {path};
+    std::set<std::string> visited;
+    while (!pending.empty()) {
+        std::string current = std::move(pending.back());
+        pending.pop_back();
+        if (!visited.insert(current).second) {
+            continue;
+        }
+        auto it = nodes_.find(current);
+        if (it == nodes_.end()) {
+            continue;
+        }
+        it->second.resolved.reset();
+        pending.insert(pending.end(), it->second.children.begin(), it->second.children.end());
+    }
+}
+
+std::shared_ptr<json::Value> ConfigResolver::resolveNode(const std::string& path, std::vector<std::string>& chain) {
+    if (std::find(chain.begin(), chain.end(), path) != chain.end()) {
+        std::string cycle;
+        for (const auto& link : chain) {
+            cycle += fs::path(link).filename().string() + " -> ";
+        }
+        throw std::runtime_error("Configuration inheritance cycle: " + cycle + fs::path(path).filename().string());
+    }
+
+    Node& node = load(path);
+
+    // Resolving the base first re-reads it if it changed, which drops this
+    // node's resolved form along with the rest of the base's descendants
+    std::shared_ptr<json::Value> base;
+    if (!node.base.empty()) {
+        chain.push_back(path);
+        base = resolveNode(node.base, chain);
+        chain.pop_back();
+    }
+
+    Diagnostics::getInstance().recordConfigLookup(node.resolved != nullptr);
+    if (!node.resolved) {
+        node.resolved = base ? json::mergePatch(base, node.own) : node.own;
+        resolutions_++;
+    }
+    return node.resolved;
+}
+
+std::shared_ptr<json::Value> ConfigResolver::resolve(const std::string& file_path) {
+    std::vector<std::string> chain;
+    auto resolved = resolveNode(canonicalPath(file_path), chain);
+    if (resolved->isObject()) {
+        return std::make_shared<json::ObjectValue>(resolved->asObject());
+    }
+    return resolved;
+}
+
+std::string ConfigResolver::baseOf(const std::string& file_path) const {
+    auto it = nodes_.find(canonicalPath(file_path));
+    return it != nodes_.end() ? it->second.base : std::string();
+}
+
+void ConfigResolver::invalidate(const std::string& file_path) {
+    auto it = nodes_.find(canonicalPath(file_path));
+    if (it != nodes_.end()) {
+        it->second.loaded = false;
+        dropResolved(it->first);
+    }
+}
+
+std::shared_ptr<json::Value> ConfigResolver::derive(const std::string& file_path, const std::string& base_path,
+                                                    const std::shared_ptr<json::Value>& config) {
+    fs::path target = canonicalPath(file_path);
+    fs::path base = canonicalPath(base_path);
+    auto patch = target != base ? json::diffPatch(resolve(base_path), config) : config;
+    if (target == base || !patch->isObject()) {
+        return config;
+    }
+
+    fs::path directory = target.parent_path();
+    fs::path relative = base.parent_path() == directory ? base.filename() : base.lexically_relative(directory);
+    if (relative.empty()) {
+        relative = base;
+    }
+
+    json::Object fields = patch->asObject();
+    fields[EXTENDS_KEY] = json::string(relative.string());
+    return std::make_shared<json::ObjectValue>(fields);
+}
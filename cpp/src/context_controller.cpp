@@ -0,0 +1,70 @@
+#include "context_controller.h"
+#include "logger.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+size_t ContextController::budget(const std::string& provider, size_t max_budget) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = models_.find(provider);
+    if (it == models_.end() || it->second.budget == 0) {
+        return max_budget;
+    }
+    return std::min(it->second.budget, max_budget);
+}
+
+size_t ContextController::observe(const std::string& provider, size_t history_bytes, double latency_ms,
+                                  double target_ms, size_t max_budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Model& model = models_[provider];
+
+    double x = history_bytes / 1024.0;
+    model.weight = model.weight * DECAY + 1;
+    model.sum_x = model.sum_x * DECAY + x;
+    model.sum_y = model.sum_y * DECAY + latency_ms;
+    model.sum_xx = model.sum_xx * DECAY + x * x;
+    model.sum_xy = model.sum_xy * DECAY + x * latency_ms;
+    model.samples++;
+
+    size_t current = model.budget == 0 ? max_budget : std::min(model.budget, max_budget);
+    double proposed = static_cast<double>(current);
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(1);
+
+    // Least-squares fit; needs histories that differ by more than ~1 KB
+    double mean_x = model.sum_x / model.weight;
+    double mean_y = model.sum_y / model.weight;
+    double variance = model.sum_xx / model.weight - mean_x * mean_x;
+    double per_kb = variance > 1.0 ? (model.sum_xy / model.weight - mean_x * mean_y) / variance : 0.0;
+    double fixed = mean_y - per_kb * mean_x;
+    double aim = target_ms * HEADROOM;
+
+    if (model.samples >= MIN_SAMPLES && per_kb > 0) {
+        proposed = aim > fixed ? (aim - fixed) / per_kb * 1024.0 : 0.0;
+        reason << "fit " << fixed << " ms + " << std::setprecision(3) << per_kb << " ms/KB";
+    } else if (latency_ms > target_ms) {
+        proposed = current * SHRINK;
+        reason << "over target";
+    } else if (latency_ms < target_ms * GROW_BELOW) {
+        proposed = current * GROW;
+        reason << "under target";
+    } else {
+        reason << "near target";
+    }
+
+    proposed = std::clamp(proposed, current / MAX_STEP, current * MAX_STEP);
+    size_t next = std::clamp(static_cast<size_t>(proposed), std::min(MIN_BUDGET, max_budget), max_budget);
+    model.budget = next;
+
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(0) << provider << ": turn with " << history_bytes << " bytes of history took "
+            << latency_ms << " ms (target " << target_ms << " ms); " << reason.str() << "; budget " << current
+            << (next == current ? " bytes kept" : " -> " + std::to_string(next) + " bytes");
+    Logger::getInstance().info("ContextController", message.str());
+    return next;
+}
+
+void ContextController::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    models_.clear();
+}
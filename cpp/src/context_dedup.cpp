@@ -0,0 +1,177 @@
+#include "context_dedup.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace dedup {
+
+namespace {
+
+constexpr size_t SNIPPET_LENGTH = 40;
+
+// Random per-byte values for the gear hash; fixed seed so chunking is stable
+const std::array<uint64_t, 256>& gearTable() {
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> values{};
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (auto& value : values) {
+            // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+int log2Floor(size_t value) {
+    int bits = 0;
+    while (value > 1) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+struct ChunkRef {
+    size_t segment;
+    size_t offset;
+    size_t length;
+};
+
+// First or last SNIPPET_LENGTH bytes of a block, on one line
+std::string snippet(std::string_view block, bool from_end) {
+    size_t length = std::min(block.size(), SNIPPET_LENGTH);
+    size_t begin = from_end ? block.size() - length : 0;
+    size_t end = begin + length;
+    while (begin < end && isContinuation(block[begin])) begin++;
+    while (end < block.size() && end > begin && isContinuation(block[end])) end--;
+
+    std::string text(block.substr(begin, end - begin));
+    for (char& c : text) {
+        if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+    }
+    return text;
+}
+
+} // namespace
+
+std::vector<size_t> chunkBoundaries(const char* data, size_t size, const Options& options) {
+    const auto& gear = gearTable();
+    // Cut where the top bits of the hash are all zero: one in average_chunk positions
+    const int shift = 64 - log2Floor(options.average_chunk);
+
+    std::vector<size_t> bounds;
+    size_t start = 0;
+    uint64_t hash = 0;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash << 1) + gear[static_cast<unsigned char>(data[i])];
+        size_t length = i - start + 1;
+        if (length < options.min_chunk) {
+            continue;
+        }
+        if ((hash >> shift) == 0 || length >= options.max_chunk) {
+            size_t cut = i + 1;
+            while (cut < size && isContinuation(data[cut])) {
+                cut++;
+            }
+            bounds.push_back(cut);
+            start = cut;
+            i = cut - 1;
+            hash = 0;
+        }
+    }
+    if (start < size) {
+        bounds.push_back(size);
+    }
+    return bounds;
+}
+
+size_t deduplicate(std::vector<Segment>& segments, const Options& options) {
+    // Back-references compare against the original texts, so keep them intact
+    std::vector<std::string> originals;
+    originals.reserve(segments.size());
+    for (auto& segment : segments) {
+        originals.push_back(std::move(segment.text));
+    }
+
+    std::unordered_map<uint64_t, ChunkRef> index;
+    std::hash<std::string_view> hasher;
+    size_t saved = 0;
+
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const std::string& text = originals[s];
+        std::vector<size_t> bounds = chunkBoundaries(text.data(), text.size(), options);
+
+        // For each chunk, the earlier chunk it repeats (segment SIZE_MAX if new)
+        std::vector<ChunkRef> sources;
+        size_t offset = 0;
+        for (size_t end : bounds) {
+            std::string_view chunk(text.data() + offset, end - offset);
+            uint64_t hash = hasher(chunk);
+
+            ChunkRef source{SIZE_MAX, offset, chunk.size()};
+            auto it = index.find(hash);
+            if (it == index.end()) {
+                index.emplace(hash, ChunkRef{s, offset, chunk.size()});
+            } else {
+                const ChunkRef& earlier = it->second;
+                if (earlier.length == chunk.size() &&
+                    std::memcmp(originals[earlier.segment].data() + earlier.offset, chunk.data(), chunk.size()) == 0) {
+                    source.segment = earlier.segment;
+                }
+            }
+            sources.push_back(source);
+            offset = end;
+        }
+
+        // Replace each long enough run of repeated chunks with a reference
+        std::string rewritten;
+        rewritten.reserve(text.size());
+        for (size_t i = 0; i < sources.size();) {
+            if (sources[i].segment == SIZE_MAX) {
+                rewritten.append(text, sources[i].offset, sources[i].length);
+                i++;
+                continue;
+            }
+
+            size_t run_end = i;
+            size_t run_bytes = 0;
+            bool single_source = true;
+            while (run_end < sources.size() && sources[run_end].segment != SIZE_MAX) {
+                single_source = single_source && sources[run_end].segment == sources[i].segment;
+                run_bytes += sources[run_end].length;
+                run_end++;
+            }
+
+            std::string_view block(text.data() + sources[i].offset, run_bytes);
+            std::string where = !single_source ? "earlier in the conversation"
+                              : sources[i].segment == s ? "earlier in this message"
+                              : "in " + segments[sources[i].segment].label;
+            std::string reference = "[Repeated content omitted (" + std::to_string(run_bytes) +
+                                    " bytes): identical to the text " + where + " from \"" +
+                                    snippet(block, false) + "\" to \"" + snippet(block, true) + "\"]";
+
+            if (run_bytes >= options.min_block && reference.size() < run_bytes) {
+                rewritten += reference;
+                saved += run_bytes - reference.size();
+            } else {
+                rewritten.append(block.data(), block.size());
+            }
+            i = run_end;
+        }
+        segments[s].text = std::move(rewritten);
+    }
+
+    return saved;
+}
+
+} // namespace dedup
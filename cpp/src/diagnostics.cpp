@@ -0,0 +1,121 @@
+#include "diagnostics.h"
+#include "logger.h"
+#include <cstdio>
+#include <unistd.h>
+
+size_t Histogram::bucketOf(uint64_t value) {
+    if (value < 4) {
+        return static_cast<size_t>(value);
+    }
+    // Top bit e, then the next two bits pick the quarter
+    size_t e = 63 - static_cast<size_t>(__builtin_clzll(value));
+    size_t quarter = static_cast<size_t>(value >> (e - 2)) & 3;
+    return 4 * (e - 1) + quarter;
+}
+
+uint64_t Histogram::bucketLower(size_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    size_t e = bucket / 4 + 1;
+    return (4 + bucket % 4) << (e - 2);
+}
+
+void Histogram::record(uint64_t value) {
+    counts_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return i + 1 < BUCKETS ? bucketLower(i + 1) - 1 : UINT64_MAX;
+        }
+    }
+    return UINT64_MAX;
+}
+
+Diagnostics& Diagnostics::getInstance() {
+    static Diagnostics instance;
+    return instance;
+}
+
+void Diagnostics::turnFinished(bool ok) {
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    turns_.fetch_add(1, std::memory_order_relaxed);
+    if (!ok) {
+        failed_turns_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Diagnostics::recordContext(size_t bytes, size_t dedup_saved) {
+    context_bytes_.record(bytes);
+    last_context_bytes_.store(bytes, std::memory_order_relaxed);
+    dedup_saved_bytes_.fetch_add(dedup_saved, std::memory_order_relaxed);
+}
+
+void Diagnostics::recordPrespawn(bool used) {
+    (used ? prespawn_used_ : prespawn_missed_).fetch_add(1, std::memory_order_relaxed);
+}
+
+void Diagnostics::recordConfigLookup(bool hit) {
+    (hit ? config_hits_ : config_misses_).fetch_add(1, std::memory_order_relaxed);
+}
+
+void Diagnostics::recordStall(uint64_t late_ms) {
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t longest = longest_stall_ms_.load(std::memory_order_relaxed);
+    while (late_ms > longest &&
+           !longest_stall_ms_.compare_exchange_weak(longest, late_ms, std::memory_order_relaxed)) {
+    }
+}
+
+Diagnostics::Snapshot Diagnostics::snapshot() const {
+    Snapshot snapshot;
+    snapshot.in_flight = in_flight_.load(std::memory_order_relaxed);
+    snapshot.queued = queued_.load(std::memory_order_relaxed);
+    snapshot.turns = turns_.load(std::memory_order_relaxed);
+    snapshot.failed_turns = failed_turns_.load(std::memory_order_relaxed);
+    snapshot.spawn_us = spawn_us_.snapshot();
+    snapshot.ttfb_us = ttfb_us_.snapshot();
+    snapshot.context_bytes = context_bytes_.snapshot();
+    snapshot.last_context_bytes = last_context_bytes_.load(std::memory_order_relaxed);
+    snapshot.dedup_saved_bytes = dedup_saved_bytes_.load(std::memory_order_relaxed);
+    snapshot.prespawn_used = prespawn_used_.load(std::memory_order_relaxed);
+    snapshot.prespawn_missed = prespawn_missed_.load(std::memory_order_relaxed);
+    snapshot.config_hits = config_hits_.load(std::memory_order_relaxed);
+    snapshot.config_misses = config_misses_.load(std::memory_order_relaxed);
+    snapshot.log_suppressed = Logger::getInstance().getSuppressedCount();
+    snapshot.stalls = stalls_.load(std::memory_order_relaxed);
+    snapshot.longest_stall_ms = longest_stall_ms_.load(std::memory_order_relaxed);
+    snapshot.rss_bytes = residentBytes();
+    return snapshot;
+}
+
+size_t Diagnostics::residentBytes() {
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? static_cast<size_t>(resident) * static_cast<size_t>(::sysconf(_SC_PAGESIZE)) : 0;
+}
@@ -0,0 +1,295 @@
+#include "facet_index.h"
+#include <algorithm>
+#include <iterator>
+
+void Bitmap::Container::toBitset() {
+    bits.assign(BITSET_WORDS, 0);
+    for (uint16_t low : array) {
+        bits[low >> 6] |= 1ULL << (low & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+void Bitmap::Container::toArrayIfSmall() {
+    if (!isBitset() || cardinality > ARRAY_LIMIT) {
+        return;
+    }
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+        for (uint64_t w = bits[word]; w != 0; w &= w - 1) {
+            array.push_back(static_cast<uint16_t>(word * 64 + __builtin_ctzll(w)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+void Bitmap::add(uint32_t id) {
+    uint16_t key = static_cast<uint16_t>(id >> 16);
+    uint16_t low = static_cast<uint16_t>(id);
+
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container{key});
+    }
+
+    if (it->isBitset()) {
+        uint64_t& word = it->bits[low >> 6];
+        uint64_t bit = 1ULL << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            it->cardinality++;
+        }
+        return;
+    }
+    auto pos = std::lower_bound(it->array.begin(), it->array.end(), low);
+    if (pos != it->array.end() && *pos == low) {
+        return;
+    }
+    it->array.insert(pos, low);
+    it->cardinality++;
+    if (it->cardinality > ARRAY_LIMIT) {
+        it->toBitset();
+    }
+}
+
+bool Bitmap::contains(uint32_t id) const {
+    uint16_t key = static_cast<uint16_t>(id >> 16);
+    uint16_t low = static_cast<uint16_t>(id);
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        return false;
+    }
+    if (it->isBitset()) {
+        return (it->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(it->array.begin(), it->array.end(), low);
+}
+
+uint64_t Bitmap::cardinality() const {
+    uint64_t total = 0;
+    for (const auto& container : containers_) {
+        total += container.cardinality;
+    }
+    return total;
+}
+
+Bitmap::Container Bitmap::intersect(const Container& a, const Container& b) {
+    Container result{a.key};
+    if (a.isBitset() && b.isBitset()) {
+        result.bits.resize(BITSET_WORDS);
+        for (size_t i = 0; i < BITSET_WORDS; ++i) {
+            result.bits[i] = a.bits[i] & b.bits[i];
+            result.cardinality += __builtin_popcountll(result.bits[i]);
+        }
+        result.toArrayIfSmall();
+    } else if (a.isBitset() || b.isBitset()) {
+        const Container& bitset = a.isBitset() ? a : b;
+        const Container& array = a.isBitset() ? b : a;
+        for (uint16_t low : array.array) {
+            if ((bitset.bits[low >> 6] >> (low & 63)) & 1) {
+                result.array.push_back(low);
+            }
+        }
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    } else {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    }
+    return result;
+}
+
+Bitmap::Container Bitmap::unite(const Container& a, const Container& b) {
+    Container result{a.key};
+    if (!a.isBitset() && !b.isBitset() && a.cardinality + b.cardinality <= ARRAY_LIMIT) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+        return result;
+    }
+
+    Container left = a;
+    if (!left.isBitset()) {
+        left.toBitset();
+    }
+    result.bits = std::move(left.bits);
+    if (b.isBitset()) {
+        for (size_t i = 0; i < BITSET_WORDS; ++i) {
+            result.bits[i] |= b.bits[i];
+        }
+    } else {
+        for (uint16_t low : b.array) {
+            result.bits[low >> 6] |= 1ULL << (low & 63);
+        }
+    }
+    for (uint64_t word : result.bits) {
+        result.cardinality += __builtin_popcountll(word);
+    }
+    result.toArrayIfSmall();
+    return result;
+}
+
+uint32_t Bitmap::intersectCount(const Container& a, const Container& b) {
+    uint32_t count = 0;
+    if (a.isBitset() && b.isBitset()) {
+        for (size_t i = 0; i < BITSET_WORDS; ++i) {
+            count += __builtin_popcountll(a.bits[i] & b.bits[i]);
+        }
+    } else if (a.isBitset() || b.isBitset()) {
+        const Container& bitset = a.isBitset() ? a : b;
+        const Container& array = a.isBitset() ? b : a;
+        for (uint16_t low : array.array) {
+            count += (bitset.bits[low >> 6] >> (low & 63)) & 1;
+        }
+    } else {
+        auto i = a.array.begin();
+        auto j = b.array.begin();
+        while (i != a.array.end() && j != b.array.end()) {
+            if (*i < *j) {
+                ++i;
+            } else if (*j < *i) {
+                ++j;
+            } else {
+                ++count;
+                ++i;
+                ++j;
+            }
+        }
+    }
+    return count;
+}
+
+Bitmap Bitmap::operator&(const Bitmap& other) const {
+    Bitmap result;
+    auto i = containers_.begin();
+    auto j = other.containers_.begin();
+    while (i != containers_.end() && j != other.containers_.end()) {
+        if (i->key < j->key) {
+            ++i;
+        } else if (j->key < i->key) {
+            ++j;
+        } else {
+            Container both = intersect(*i, *j);
+            if (both.cardinality > 0) {
+                result.containers_.push_back(std::move(both));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+Bitmap Bitmap::operator|(const Bitmap& other) const {
+    Bitmap result;
+    auto i = containers_.begin();
+    auto j = other.containers_.begin();
+    while (i != containers_.end() || j != other.containers_.end()) {
+        if (j == other.containers_.end() || (i != containers_.end() && i->key < j->key)) {
+            result.containers_.push_back(*i++);
+        } else if (i == containers_.end() || j->key < i->key) {
+            result.containers_.push_back(*j++);
+        } else {
+            result.containers_.push_back(unite(*i++, *j++));
+        }
+    }
+    return result;
+}
+
+uint64_t Bitmap::andCardinality(const Bitmap& other) const {
+    uint64_t count = 0;
+    auto i = containers_.begin();
+    auto j = other.containers_.begin();
+    while (i != containers_.end() && j != other.containers_.end()) {
+        if (i->key < j->key) {
+            ++i;
+        } else if (j->key < i->key) {
+            ++j;
+        } else {
+            count += intersectCount(*i++, *j++);
+        }
+    }
+    return count;
+}
+
+std::vector<uint32_t> Bitmap::toVector() const {
+    std::vector<uint32_t> ids;
+    ids.reserve(cardinality());
+    for (const auto& container : containers_) {
+        uint32_t high = static_cast<uint32_t>(container.key) << 16;
+        if (container.isBitset()) {
+            for (size_t word = 0; word < BITSET_WORDS; ++word) {
+                for (uint64_t w = container.bits[word]; w != 0; w &= w - 1) {
+                    ids.push_back(high | static_cast<uint32_t>(word * 64 + __builtin_ctzll(w)));
+                }
+            }
+        } else {
+            for (uint16_t low : container.array) {
+                ids.push_back(high | low);
+            }
+        }
+    }
+    return ids;
+}
+
+void FacetIndex::addDocument(uint32_t id) {
+    all_.add(id);
+}
+
+void FacetIndex::add(uint32_t id, const std::string& facet, const std::string& value) {
+    all_.add(id);
+    facets_[facet][value].add(id);
+}
+
+void FacetIndex::clear() {
+    all_ = Bitmap();
+    facets_.clear();
+}
+
+const Bitmap* FacetIndex::find(const std::string& facet, const std::string& value) const {
+    auto facet_it = facets_.find(facet);
+    if (facet_it == facets_.end()) {
+        return nullptr;
+    }
+    auto value_it = facet_it->second.find(value);
+    return value_it != facet_it->second.end() ? &value_it->second : nullptr;
+}
+
+std::vector<std::string> FacetIndex::values(const std::string& facet) const {
+    std::vector<std::string> names;
+    auto it = facets_.find(facet);
+    if (it != facets_.end()) {
+        for (const auto& [value, bitmap] : it->second) {
+            names.push_back(value);
+        }
+    }
+    return names;
+}
+
+Bitmap FacetIndex::evaluate(const std::vector<Clause>& clauses) const {
+    Bitmap result = all_;
+    static const Bitmap none;
+    for (const auto& clause : clauses) {
+        if (clause.values.empty()) {
+            continue;
+        }
+        Bitmap matches = clause.match_all ? all_ : Bitmap();
+        for (const auto& value : clause.values) {
+            const Bitmap* bitmap = find(clause.facet, value);
+            const Bitmap& docs = bitmap ? *bitmap : none;
+            matches = clause.match_all ? matches & docs : matches | docs;
+        }
+        result = result & matches;
+    }
+    return result;
+}
+
+uint64_t FacetIndex::count(const Bitmap& matches, const std::string& facet, const std::string& value) const {
+    const Bitmap* bitmap = find(facet, value);
+    return bitmap ? matches.andCardinality(*bitmap) : 0;
+}
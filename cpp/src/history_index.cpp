@@ -0,0 +1,172 @@
+#include "history_index.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+
+// Standard BM25 parameters
+constexpr double K1 = 1.2;
+constexpr double B = 0.75;
+
+constexpr size_t MIN_TERM_LENGTH = 2;
+constexpr size_t MAX_TERM_LENGTH = 64;
+
+bool isStopWord(const std::string& term) {
+    static const std::unordered_set<std::string> stop_words = {
+        "an", "and", "are", "as", "at", "be", "but", "by", "can", "do", "for", "from", "has", "have",
+        "how", "if", "in", "is", "it", "me", "my", "no", "not", "of", "on", "or", "so", "that", "the",
+        "this", "to", "was", "we", "what", "with", "you", "your"};
+    return stop_words.count(term) > 0;
+}
+
+} // namespace
+
+std::vector<std::string> HistoryIndex::tokenize(const std::string& text) {
+    // Lowercased runs of ASCII letters/digits; non-ASCII bytes are kept as
+    // word characters so UTF-8 words stay whole
+    std::vector<std::string> terms;
+    std::string current;
+    auto flush = [&] {
+        if (current.size() >= MIN_TERM_LENGTH && current.size() <= MAX_TERM_LENGTH && !isStopWord(current)) {
+            terms.push_back(current);
+        }
+        current.clear();
+    };
+
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80 || c == '_') {
+            current += ch;
+        } else if (c >= 'A' && c <= 'Z') {
+            current += static_cast<char>(c - 'A' + 'a');
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return terms;
+}
+
+void HistoryIndex::add(const std::string& text) {
+    uint32_t turn = static_cast<uint32_t>(turn_bytes_.size());
+    std::vector<std::string> terms = tokenize(text);
+
+    std::unordered_map<uint32_t, uint32_t> frequencies;
+    for (const auto& term : terms) {
+        auto it = term_ids_.find(term);
+        if (it == term_ids_.end()) {
+            it = term_ids_.emplace(term, static_cast<uint32_t>(postings_.size())).first;
+            postings_.emplace_back();
+        }
+        frequencies[it->second]++;
+    }
+    for (const auto& [term_id, frequency] : frequencies) {
+        postings_[term_id].push_back({turn, frequency});
+    }
+
+    turn_lengths_.push_back(static_cast<uint32_t>(terms.size()));
+    turn_bytes_.push_back(text.size());
+    total_length_ += terms.size();
+}
+
+void HistoryIndex::clear() {
+    term_ids_.clear();
+    postings_.clear();
+    turn_lengths_.clear();
+    turn_bytes_.clear();
+    total_length_ = 0;
+}
+
+std::vector<std::pair<size_t, double>> HistoryIndex::search(const std::string& query, size_t limit,
+                                                            size_t top_k) const {
+    limit = std::min(limit, size());
+    std::vector<std::pair<size_t, double>> results;
+    if (limit == 0 || top_k == 0) {
+        return results;
+    }
+
+    std::vector<std::string> terms = tokenize(query);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    // Term-at-a-time accumulation over the postings of the query terms
+    const double turns = static_cast<double>(size());
+    const double average_length = total_length_ > 0 ? static_cast<double>(total_length_) / turns : 1.0;
+    std::vector<float> scores(limit, 0.0f);
+    for (const auto& term : terms) {
+        auto it = term_ids_.find(term);
+        if (it == term_ids_.end()) {
+            continue;
+        }
+        const auto& postings = postings_[it->second];
+        double df = static_cast<double>(postings.size());
+        double idf = std::log(1.0 + (turns - df + 0.5) / (df + 0.5));
+
+        for (const Posting& posting : postings) {
+            if (posting.turn >= limit) {
+                break;  // postings are in turn order
+            }
+            double tf = posting.frequency;
+            double norm = K1 * (1.0 - B + B * turn_lengths_[posting.turn] / average_length);
+            scores[posting.turn] += static_cast<float>(idf * tf * (K1 + 1.0) / (tf + norm));
+        }
+    }
+
+    for (size_t turn = 0; turn < limit; ++turn) {
+        if (scores[turn] > 0.0f) {
+            results.emplace_back(turn, scores[turn]);
+        }
+    }
+    auto better = [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first > b.first;  // ties go to newer turns
+    };
+    if (results.size() > top_k) {
+        std::partial_sort(results.begin(), results.begin() + top_k, results.end(), better);
+        results.resize(top_k);
+    } else {
+        std::sort(results.begin(), results.end(), better);
+    }
+    return results;
+}
+
+std::vector<size_t> HistoryIndex::select(const std::string& query, size_t max_turns, size_t recency_tail,
+                                         size_t byte_budget) const {
+    std::vector<size_t> chosen;
+    size_t used = 0;
+    auto take = [&](size_t turn) {
+        if (chosen.size() >= max_turns || used + turn_bytes_[turn] > byte_budget) {
+            return false;
+        }
+        chosen.push_back(turn);
+        used += turn_bytes_[turn];
+        return true;
+    };
+
+    // Recency tail, newest first, so the budget favours the latest turns
+    size_t tail = std::min({recency_tail, max_turns, size()});
+    size_t older = size() - tail;
+    for (size_t i = 0; i < tail; ++i) {
+        if (!take(size() - 1 - i)) {
+            break;
+        }
+    }
+
+    // Relevant older turns; a turn too big for the remaining budget is skipped
+    std::vector<bool> taken(older, false);
+    if (chosen.size() < max_turns) {
+        for (const auto& [turn, score] : search(query, older, max_turns - chosen.size())) {
+            taken[turn] = take(turn);
+        }
+    }
+
+    // Nothing (more) relevant: fall back to the most recent older turns
+    for (size_t turn = older; turn-- > 0 && chosen.size() < max_turns;) {
+        if (!taken[turn]) {
+            take(turn);
+        }
+    }
+
+    std::sort(chosen.begin(), chosen.end());
+    return chosen;
+}
@@ -0,0 +1,590 @@
+#include "json_cbor.h"
+#include "json_reader.h"
+#include "utf8.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace json {
+
+namespace {
+
+enum Major : uint8_t {
+    UNSIGNED = 0,
+    NEGATIVE = 1,
+    BYTES = 2,
+    TEXT = 3,
+    ARRAY = 4,
+    MAP = 5,
+    TAG = 6,
+    SIMPLE = 7
+};
+
+constexpr uint8_t SIMPLE_FALSE = 20;
+constexpr uint8_t SIMPLE_TRUE = 21;
+constexpr uint8_t SIMPLE_NULL = 22;
+constexpr uint8_t FLOAT16 = 25;
+constexpr uint8_t FLOAT32 = 26;
+constexpr uint8_t FLOAT64 = 27;
+
+// Writing
+
+void writeHeader(std::string& out, uint8_t major, uint64_t argument) {
+    uint8_t type = static_cast<uint8_t>(major << 5);
+    if (argument < 24) {
+        out += static_cast<char>(type | argument);
+        return;
+    }
+
+    int bytes;
+    if (argument <= 0xFF) {
+        out += static_cast<char>(type | 24);
+        bytes = 1;
+    } else if (argument <= 0xFFFF) {
+        out += static_cast<char>(type | 25);
+        bytes = 2;
+    } else if (argument <= 0xFFFFFFFFULL) {
+        out += static_cast<char>(type | 26);
+        bytes = 4;
+    } else {
+        out += static_cast<char>(type | 27);
+        bytes = 8;
+    }
+    for (int i = bytes - 1; i >= 0; --i) {
+        out += static_cast<char>((argument >> (i * 8)) & 0xFF);
+    }
+}
+
+void writeNumber(std::string& out, double value) {
+    // Integral values in range become CBOR integers, everything else float64
+    if (std::isfinite(value) && value == std::floor(value) && std::fabs(value) < 9.2e18) {
+        int64_t integer = static_cast<int64_t>(value);
+        if (integer >= 0) {
+            writeHeader(out, UNSIGNED, static_cast<uint64_t>(integer));
+        } else {
+            writeHeader(out, NEGATIVE, static_cast<uint64_t>(-1 - integer));
+        }
+        return;
+    }
+
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out += static_cast<char>((SIMPLE << 5) | FLOAT64);
+    for (int i = 7; i >= 0; --i) {
+        out += static_cast<char>((bits >> (i * 8)) & 0xFF);
+    }
+}
+
+void writeText(std::string& out, const std::string& text) {
+    writeHeader(out, TEXT, text.size());
+    out += text;
+}
+
+void writeValue(std::string& out, const Value& value) {
+    switch (value.getType()) {
+        case Type::STRING:
+            writeText(out, value.asString());
+            break;
+        case Type::NUMBER:
+            writeNumber(out, value.asNumber());
+            break;
+        case Type::BOOLEAN:
+            out += static_cast<char>((SIMPLE << 5) | (value.asBoolean() ? SIMPLE_TRUE : SIMPLE_FALSE));
+            break;
+        case Type::NULL_VALUE:
+            out += static_cast<char>((SIMPLE << 5) | SIMPLE_NULL);
+            break;
+        case Type::ARRAY: {
+            const Array& array = value.asArray();
+            writeHeader(out, ARRAY, array.size());
+            for (const auto& item : array) {
+                writeValue(out, *item);
+            }
+            break;
+        }
+        case Type::OBJECT: {
+            const Object& object = value.asObject();
+            writeHeader(out, MAP, object.size());
+            for (const auto& [key, item] : object) {
+                writeText(out, key);
+                writeValue(out, *item);
+            }
+            break;
+        }
+    }
+}
+
+// Reading. Headers are only decoded from buffers CborView::open has
+// validated, so these helpers do no bounds checks of their own.
+
+struct Header {
+    uint8_t major;
+    uint8_t info;       // low five bits
+    uint64_t argument;
+    size_t length;      // header bytes, including a float payload
+};
+
+Header decodeHeader(const uint8_t* p) {
+    Header h{static_cast<uint8_t>(p[0] >> 5), static_cast<uint8_t>(p[0] & 0x1F), 0, 1};
+    if (h.info < 24) {
+        h.argument = h.info;
+    } else if (h.info <= 27) {
+        size_t bytes = size_t(1) << (h.info - 24);
+        for (size_t i = 0; i < bytes; ++i) {
+            h.argument = (h.argument << 8) | p[1 + i];
+        }
+        h.length += bytes;
+    }
+    return h;
+}
+
+const uint8_t* skipTags(const uint8_t* p) {
+    while ((p[0] >> 5) == TAG) {
+        p += decodeHeader(p).length;
+    }
+    return p;
+}
+
+double halfToDouble(uint16_t half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+    if (exponent == 0) {
+        value = std::ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+double decodeNumber(const Header& h) {
+    switch (h.major) {
+        case UNSIGNED:
+            return static_cast<double>(h.argument);
+        case NEGATIVE:
+            return -1.0 - static_cast<double>(h.argument);
+        default:
+            break;
+    }
+    if (h.info == FLOAT16) {
+        return halfToDouble(static_cast<uint16_t>(h.argument));
+    }
+    if (h.info == FLOAT32) {
+        uint32_t bits = static_cast<uint32_t>(h.argument);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    double value;
+    std::memcpy(&value, &h.argument, sizeof(value));
+    return value;
+}
+
+bool isNumber(const Header& h) {
+    return h.major == UNSIGNED || h.major == NEGATIVE ||
+           (h.major == SIMPLE && h.info >= FLOAT16 && h.info <= FLOAT64);
+}
+
+// Emits reader Events for the item at p (iteratively), so the DOM builder
+// and the text writer share one walk.
+template <typename Handler>
+void walk(const uint8_t* p, Handler& handler) {
+    struct Level {
+        uint64_t remaining;
+        bool is_map;
+    };
+    std::vector<Level> stack;
+    Event event;
+
+    do {
+        p = skipTags(p);
+        Header h = decodeHeader(p);
+        p += h.length;
+
+        bool is_key = !stack.empty() && stack.back().is_map && stack.back().remaining % 2 == 0;
+        bool opened = false;
+        switch (h.major) {
+            case TEXT:
+                event.token = is_key ? Token::KEY : Token::STRING;
+                event.text.assign(reinterpret_cast<const char*>(p), h.argument);
+                p += h.argument;
+                break;
+            case ARRAY:
+            case MAP:
+                event.token = h.major == ARRAY ? Token::START_ARRAY : Token::START_OBJECT;
+                handler(event);
+                if (h.argument > 0) {
+                    stack.push_back({h.major == MAP ? h.argument * 2 : h.argument, h.major == MAP});
+                    opened = true;
+                } else {
+                    event.token = h.major == ARRAY ? Token::END_ARRAY : Token::END_OBJECT;
+                }
+                break;
+            default:
+                if (isNumber(h)) {
+                    event.token = Token::NUMBER;
+                    event.number = decodeNumber(h);
+                } else if (h.info == SIMPLE_NULL) {
+                    event.token = Token::NULL_VALUE;
+                } else {
+                    event.token = Token::BOOLEAN;
+                    event.boolean = h.info == SIMPLE_TRUE;
+                }
+                break;
+        }
+        if (opened) {
+            continue;
+        }
+        handler(event);
+
+        // Close every container this item completed
+        while (!stack.empty() && --stack.back().remaining == 0) {
+            event.token = stack.back().is_map ? Token::END_OBJECT : Token::END_ARRAY;
+            stack.pop_back();
+            handler(event);
+        }
+    } while (!stack.empty());
+}
+
+// Compact text in the same shape as Value::toString
+class TextWriter {
+public:
+    std::string out;
+
+    void operator()(const Event& event) {
+        switch (event.token) {
+            case Token::END_OBJECT:
+                out += '}';
+                first_.pop_back();
+                return;
+            case Token::END_ARRAY:
+                out += ']';
+                first_.pop_back();
+                return;
+            default:
+                break;
+        }
+
+        if (!first_.empty()) {
+            if (!first_.back() && !after_key_) out += ',';
+            first_.back() = false;
+        }
+        after_key_ = false;
+
+        switch (event.token) {
+            case Token::START_OBJECT: out += '{'; first_.push_back(true); break;
+            case Token::START_ARRAY: out += '['; first_.push_back(true); break;
+            case Token::KEY: out += quote(event.text); out += ':'; after_key_ = true; break;
+            case Token::STRING: out += quote(event.text); break;
+            case Token::NUMBER: out += NumberValue(event.number).toString(); break;
+            case Token::BOOLEAN: out += event.boolean ? "true" : "false"; break;
+            default: out += "null"; break;
+        }
+    }
+
+private:
+    std::vector<bool> first_;
+    bool after_key_ = false;
+};
+
+} // namespace
+
+std::string toCbor(const Value& value) {
+    std::string out;
+    writeValue(out, value);
+    return out;
+}
+
+std::shared_ptr<Value> fromCbor(const char* data, size_t size, const ParseLimits& limits) {
+    return CborView::open(data, size, limits).materialize();
+}
+
+std::string textToCbor(const std::string& text) {
+    return toCbor(*parse(text));
+}
+
+std::string cborToText(const char* data, size_t size) {
+    CborView::open(data, size);
+    TextWriter writer;
+    walk(reinterpret_cast<const uint8_t*>(data), writer);
+    return writer.out;
+}
+
+bool saveBinaryFile(const std::string& filename, const Value& value) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string bytes = toCbor(value);
+    file.write(bytes.data(), bytes.size());
+    return file.good();
+}
+
+// MappedFile implementation
+MappedFile::MappedFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Unable to stat file: " + filename);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Unable to map file: " + filename);
+        }
+        data_ = static_cast<const char*>(mapping);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+// CborView implementation
+CborView CborView::open(const char* data, size_t size, const ParseLimits& limits) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = begin + size;
+    const uint8_t* p = begin;
+
+    auto fail = [&](const std::string& message) {
+        throw ParseError(message, static_cast<size_t>(p - begin));
+    };
+    if (size > limits.max_size) {
+        fail("Input exceeds maximum size of " + std::to_string(limits.max_size) + " bytes");
+    }
+    if (size == 0) {
+        fail("Unexpected end of input");
+    }
+
+    struct Level {
+        uint64_t remaining;
+        bool is_map;
+    };
+    std::vector<Level> stack;
+
+    while (true) {
+        bool is_key = !stack.empty() && stack.back().is_map && stack.back().remaining % 2 == 0;
+        if (p >= end) {
+            fail("Unexpected end of input");
+        }
+        uint8_t info = p[0] & 0x1F;
+        if (info >= 28 && info <= 30) {
+            fail("Invalid additional information");
+        }
+        if (info == 31) {
+            fail("Indefinite-length items are not supported");
+        }
+        if (info >= 24 && static_cast<size_t>(end - p) < 1 + (size_t(1) << (info - 24))) {
+            fail("Unexpected end of input");
+        }
+        Header h = decodeHeader(p);
+        if (is_key && h.major != TEXT) {
+            fail("Object keys must be text strings");
+        }
+
+        const uint8_t* content = p + h.length;
+        uint64_t available = static_cast<uint64_t>(end - content);
+        bool opened = false;
+        switch (h.major) {
+            case UNSIGNED:
+            case NEGATIVE:
+                break;
+            case BYTES:
+                fail("Byte strings have no JSON equivalent");
+                break;
+            case TEXT:
+                if (h.argument > available) {
+                    fail("Unexpected end of input");
+                }
+                if (h.argument > limits.max_string_length) {
+                    fail("String exceeds maximum length of " + std::to_string(limits.max_string_length) + " bytes");
+                }
+                if (!utf8::isValid(reinterpret_cast<const char*>(content), h.argument)) {
+                    fail("Invalid UTF-8 in string");
+                }
+                content += h.argument;
+                break;
+            case ARRAY:
+            case MAP: {
+                // Every element takes at least one byte, which bounds the counts
+                uint64_t items = h.major == MAP ? h.argument * 2 : h.argument;
+                if (h.argument > available || items > available) {
+                    fail("Unexpected end of input");
+                }
+                if (items > 0) {
+                    if (stack.size() >= limits.max_depth) {
+                        fail("Maximum nesting depth of " + std::to_string(limits.max_depth) + " exceeded");
+                    }
+                    stack.push_back({items, h.major == MAP});
+                    opened = true;
+                }
+                break;
+            }
+            case TAG:
+                // The tagged item follows and fills this slot
+                p = content;
+                continue;
+            default:
+                if (h.info != SIMPLE_FALSE && h.info != SIMPLE_TRUE && h.info != SIMPLE_NULL && !isNumber(h)) {
+                    fail("Unsupported simple value");
+                }
+                break;
+        }
+        p = content;
+        if (opened) {
+            continue;
+        }
+        while (!stack.empty() && --stack.back().remaining == 0) {
+            stack.pop_back();
+        }
+        if (stack.empty()) {
+            break;
+        }
+    }
+
+    if (p != end) {
+        fail("Unexpected data after document");
+    }
+    return CborView(begin);
+}
+
+CborView::CborView(const uint8_t* data) : data_(skipTags(data)) {}
+
+uint64_t CborView::argument() const {
+    return decodeHeader(data_).argument;
+}
+
+const uint8_t* CborView::contentStart() const {
+    return data_ + decodeHeader(data_).length;
+}
+
+const uint8_t* CborView::end() const {
+    // Count outstanding items instead of recursing into containers
+    const uint8_t* p = data_;
+    uint64_t pending = 1;
+    while (pending > 0) {
+        pending--;
+        Header h = decodeHeader(p);
+        p += h.length;
+        switch (h.major) {
+            case TEXT: p += h.argument; break;
+            case ARRAY: pending += h.argument; break;
+            case MAP: pending += h.argument * 2; break;
+            case TAG: pending += 1; break;
+            default: break;
+        }
+    }
+    return p;
+}
+
+Type CborView::getType() const {
+    if (!valid()) {
+        return Type::NULL_VALUE;
+    }
+    Header h = decodeHeader(data_);
+    switch (h.major) {
+        case TEXT: return Type::STRING;
+        case ARRAY: return Type::ARRAY;
+        case MAP: return Type::OBJECT;
+        default: break;
+    }
+    if (isNumber(h)) return Type::NUMBER;
+    return h.info == SIMPLE_NULL ? Type::NULL_VALUE : Type::BOOLEAN;
+}
+
+std::string_view CborView::asString() const {
+    if (getType() != Type::STRING) {
+        throw std::runtime_error("Value is not a string");
+    }
+    return std::string_view(reinterpret_cast<const char*>(contentStart()), argument());
+}
+
+double CborView::asNumber() const {
+    if (getType() != Type::NUMBER) {
+        throw std::runtime_error("Value is not a number");
+    }
+    Header h = decodeHeader(data_);
+    return decodeNumber(h);
+}
+
+bool CborView::asBoolean() const {
+    if (getType() != Type::BOOLEAN) {
+        throw std::runtime_error("Value is not a boolean");
+    }
+    return (data_[0] & 0x1F) == SIMPLE_TRUE;
+}
+
+size_t CborView::size() const {
+    Type type = getType();
+    return type == Type::ARRAY || type == Type::OBJECT ? static_cast<size_t>(argument()) : 0;
+}
+
+CborView CborView::at(size_t index) const {
+    if (getType() != Type::ARRAY || index >= size()) {
+        return CborView();
+    }
+    CborView element(contentStart());
+    for (size_t i = 0; i < index; ++i) {
+        element = CborView(element.end());
+    }
+    return element;
+}
+
+CborView CborView::find(std::string_view key) const {
+    CborView found;
+    forEachMember([&](std::string_view name, CborView value) {
+        if (name == key) {
+            found = value;
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+CborView CborView::find(const Path& path) const {
+    CborView current = *this;
+    for (const auto& step : path.steps_) {
+        if (!current.valid()) {
+            break;
+        }
+        Type type = current.getType();
+        if (type == Type::OBJECT) {
+            current = current.find(step.key);
+        } else if (type == Type::ARRAY && step.index != SIZE_MAX) {
+            current = current.at(step.index);
+        } else {
+            current = CborView();
+        }
+    }
+    return current;
+}
+
+std::shared_ptr<Value> CborView::materialize() const {
+    if (!valid()) {
+        return nullptr;
+    }
+    DomBuilder builder;
+    auto feed = [&](const Event& event) { builder.handle(event); };
+    walk(data_, feed);
+    return builder.take();
+}
+
+} // namespace json
@@ -0,0 +1,572 @@
+#include "json_reader.h"
+#include "utf8.h"
+#include <stdexcept>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+
+namespace json {
+
+// Reader implementation
+Reader::Reader(bool multiple_documents)
+    : data_(buffer_.data())
+    , multiple_documents_(multiple_documents) {}
+
+Reader::Reader(const char* data, size_t size, bool multiple_documents, const ParseLimits& limits)
+    : data_(data)
+    , size_(size)
+    , finished_(true)
+    , borrowed_(true)
+    , multiple_documents_(multiple_documents)
+    , limits_(limits) {
+    checkBorrowedSize();
+}
+
+void Reader::setLimits(const ParseLimits& limits) {
+    limits_ = limits;
+    checkBorrowedSize();
+}
+
+void Reader::checkBorrowedSize() const {
+    if (borrowed_ && size_ > limits_.max_size) {
+        fail("Document exceeds maximum size of " + std::to_string(limits_.max_size) + " bytes");
+    }
+}
+
+void Reader::feed(const char* data, size_t size) {
+    if (finished_) {
+        throw std::runtime_error("Cannot feed a finished reader");
+    }
+    compact();
+    if (consumed_ + buffer_.size() + size - document_start_ > limits_.max_size) {
+        fail("Document exceeds maximum size of " + std::to_string(limits_.max_size) + " bytes");
+    }
+    buffer_.append(data, size);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+void Reader::finish() {
+    finished_ = true;
+}
+
+void Reader::compact() {
+    if (pos_ > 0 && !borrowed_) {
+        buffer_.erase(0, pos_);
+        consumed_ += pos_;
+        pos_ = 0;
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+}
+
+void Reader::fail(const std::string& what) const {
+    throw ParseError(what, offset());
+}
+
+void Reader::skipWhitespace() {
+    while (pos_ < size_) {
+        char c = data_[pos_];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            break;
+        }
+        pos_++;
+    }
+}
+
+void Reader::afterValue() {
+    if (stack_.empty()) {
+        state_ = multiple_documents_ ? State::VALUE : State::DONE;
+        document_start_ = offset();
+    } else {
+        state_ = State::COMMA_OR_END;
+    }
+}
+
+Reader::Status Reader::next(Event& event) {
+    while (true) {
+        if (partial_ == Partial::STRING) {
+            return readString(event, partial_is_key_);
+        }
+        if (partial_ == Partial::NUMBER) {
+            return readNumber(event);
+        }
+
+        skipWhitespace();
+        if (pos_ >= size_) {
+            if (!finished_) {
+                return Status::NEED_MORE;
+            }
+            if (state_ == State::DONE || (multiple_documents_ && state_ == State::VALUE && stack_.empty())) {
+                return Status::END;
+            }
+            fail("Unexpected end of input");
+        }
+
+        char c = data_[pos_];
+        switch (state_) {
+            case State::DONE:
+                fail("Unexpected data after document");
+
+            case State::VALUE:
+                return readValue(event);
+
+            case State::VALUE_OR_END_ARRAY:
+                if (c == ']') {
+                    pos_++;
+                    stack_.pop_back();
+                    event.token = Token::END_ARRAY;
+                    afterValue();
+                    return Status::EVENT;
+                }
+                return readValue(event);
+
+            case State::KEY_OR_END_OBJECT:
+                if (c == '}') {
+                    pos_++;
+                    stack_.pop_back();
+                    event.token = Token::END_OBJECT;
+                    afterValue();
+                    return Status::EVENT;
+                }
+                if (c != '"') {
+                    fail("Expected '\"'");
+                }
+                return readString(event, true);
+
+            case State::KEY:
+                if (c != '"') {
+                    fail("Expected '\"'");
+                }
+                return readString(event, true);
+
+            case State::COLON:
+                if (c != ':') {
+                    fail("Expected ':'");
+                }
+                pos_++;
+                state_ = State::VALUE;
+                continue;
+
+            case State::COMMA_OR_END: {
+                bool in_object = stack_.back() == '{';
+                if (c == ',') {
+                    pos_++;
+                    state_ = in_object ? State::KEY : State::VALUE;
+                    continue;
+                }
+                if (c == (in_object ? '}' : ']')) {
+                    pos_++;
+                    stack_.pop_back();
+                    event.token = in_object ? Token::END_OBJECT : Token::END_ARRAY;
+                    afterValue();
+                    return Status::EVENT;
+                }
+                fail(in_object ? "Expected ',' or '}'" : "Expected ',' or ']'");
+            }
+        }
+    }
+}
+
+Reader::Status Reader::skipValue(Event& event) {
+    if (!skipping_) {
+        skipping_ = true;
+        skip_depth_ = stack_.size();
+    }
+
+    while (true) {
+        Status status = next(event);
+        if (status != Status::EVENT) {
+            return status;
+        }
+        if (stack_.size() <= skip_depth_ && event.token != Token::KEY) {
+            skipping_ = false;
+            return Status::EVENT;
+        }
+    }
+}
+
+Reader::Status Reader::readValue(Event& event) {
+    char c = data_[pos_];
+    switch (c) {
+        case '{':
+            if (stack_.size() >= limits_.max_depth) {
+                fail("Maximum nesting depth of " + std::to_string(limits_.max_depth) + " exceeded");
+            }
+            pos_++;
+            stack_.push_back('{');
+            state_ = State::KEY_OR_END_OBJECT;
+            event.token = Token::START_OBJECT;
+            return Status::EVENT;
+        case '[':
+            if (stack_.size() >= limits_.max_depth) {
+                fail("Maximum nesting depth of " + std::to_string(limits_.max_depth) + " exceeded");
+            }
+            pos_++;
+            stack_.push_back('[');
+            state_ = State::VALUE_OR_END_ARRAY;
+            event.token = Token::START_ARRAY;
+            return Status::EVENT;
+        case '"':
+            return readString(event, false);
+        case 't': case 'f': case 'n':
+            return readLiteral(event);
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                partial_ = Partial::NUMBER;
+                pending_.clear();
+                return readNumber(event);
+            }
+            fail("Invalid JSON character");
+    }
+}
+
+Reader::Status Reader::readString(Event& event, bool is_key) {
+    if (partial_ == Partial::NONE) {
+        pos_++; // opening quote
+        partial_ = Partial::STRING;
+        partial_is_key_ = is_key;
+        pending_.clear();
+    }
+
+    const char* data = data_;
+    size_t size = size_;
+
+    if (skipping_ && skipString(data, size)) {
+        partial_ = Partial::NONE;
+        event.token = is_key ? Token::KEY : Token::STRING;
+        event.text.clear();
+        if (is_key) {
+            state_ = State::COLON;
+        } else {
+            afterValue();
+        }
+        return Status::EVENT;
+    }
+
+    while (!skipping_ && pos_ < size) {
+        size_t run = pos_;
+        while (run < size && data[run] != '"' && data[run] != '\\' &&
+               static_cast<unsigned char>(data[run]) >= 0x20) {
+            run++;
+        }
+        pending_.append(data + pos_, run - pos_);
+        pos_ = run;
+        if (pending_.size() > limits_.max_string_length) {
+            fail("String exceeds maximum length of " + std::to_string(limits_.max_string_length) + " bytes");
+        }
+
+        if (pos_ == size) {
+            break;
+        }
+
+        if (data[pos_] == '"') {
+            if (!utf8::isValid(pending_)) {
+                fail("Invalid UTF-8 in string");
+            }
+            pos_++;
+            partial_ = Partial::NONE;
+            event.token = is_key ? Token::KEY : Token::STRING;
+            event.text.swap(pending_);
+            if (is_key) {
+                state_ = State::COLON;
+            } else {
+                afterValue();
+            }
+            return Status::EVENT;
+        }
+
+        if (data[pos_] != '\\') {
+            fail("Unescaped control character in string");
+        }
+
+        if (!decodeEscape(pending_)) {
+            break;
+        }
+    }
+
+    if (finished_) {
+        fail("Unterminated string");
+    }
+    return Status::NEED_MORE;
+}
+
+// Skipped strings are neither decoded nor validated: memchr to each quote and
+// count the backslashes before it to tell a closing quote from an escaped one.
+// pos_ never stops inside an escape, so the count starting at pos_ is exact.
+bool Reader::skipString(const char* data, size_t size) {
+    while (pos_ < size) {
+        auto quote = static_cast<const char*>(std::memchr(data + pos_, '"', size - pos_));
+        if (!quote) {
+            // Keep a trailing unfinished escape for the next chunk
+            size_t end = size;
+            while (end > pos_ && data[end - 1] == '\\') {
+                end--;
+            }
+            pos_ = (size - end) % 2 ? size - 1 : size;
+            return false;
+        }
+
+        size_t at = quote - data;
+        size_t backslashes = 0;
+        while (at - backslashes > pos_ && data[at - backslashes - 1] == '\\') {
+            backslashes++;
+        }
+        pos_ = at + 1;
+        if (backslashes % 2 == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Reader::decodeEscape(std::string& out) {
+    if (pos_ + 1 >= size_) {
+        return false;
+    }
+
+    char c = data_[pos_ + 1];
+    if (c == 'u') {
+        return decodeUnicodeEscape(out);
+    }
+
+    pos_ += 2;
+    switch (c) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        default: fail("Invalid escape sequence");
+    }
+    return true;
+}
+
+static bool parseHex4(const char* digits, uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = digits[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+bool Reader::decodeUnicodeEscape(std::string& out) {
+    if (pos_ + 6 > size_) {
+        return false;
+    }
+
+    uint32_t unit = 0;
+    if (!parseHex4(data_ + pos_ + 2, unit)) {
+        fail("Invalid \\u escape");
+    }
+
+    if (unit >= 0xD800 && unit <= 0xDBFF) {
+        // A high surrogate needs its low half, which may not have arrived yet
+        bool lone = (pos_ + 6 < size_ && data_[pos_ + 6] != '\\') ||
+                    (pos_ + 7 < size_ && data_[pos_ + 7] != 'u');
+        if (!lone && pos_ + 12 > size_) {
+            if (!finished_) {
+                return false;
+            }
+            lone = true;
+        }
+
+        uint32_t low = 0;
+        if (!lone && parseHex4(data_ + pos_ + 8, low) && low >= 0xDC00 && low <= 0xDFFF) {
+            utf8::encode(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00), out);
+            pos_ += 12;
+            return true;
+        }
+    }
+
+    // Lone surrogates become U+FFFD inside encode()
+    utf8::encode(unit, out);
+    pos_ += 6;
+    return true;
+}
+
+// RFC 8259: -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+static bool isNumberLiteral(const std::string& text) {
+    size_t i = 0;
+    size_t n = text.size();
+    auto digits = [&]() {
+        size_t start = i;
+        while (i < n && text[i] >= '0' && text[i] <= '9') {
+            i++;
+        }
+        return i - start;
+    };
+
+    if (i < n && text[i] == '-') {
+        i++;
+    }
+    if (i < n && text[i] == '0') {
+        i++;
+    } else if (digits() == 0) {
+        return false;
+    }
+    if (i < n && text[i] == '.') {
+        i++;
+        if (digits() == 0) {
+            return false;
+        }
+    }
+    if (i < n && (text[i] == 'e' || text[i] == 'E')) {
+        i++;
+        if (i < n && (text[i] == '+' || text[i] == '-')) {
+            i++;
+        }
+        if (digits() == 0) {
+            return false;
+        }
+    }
+    return i == n;
+}
+
+Reader::Status Reader::readNumber(Event& event) {
+    while (pos_ < size_) {
+        char c = data_[pos_];
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+            pending_ += c;
+            pos_++;
+            if (pending_.size() > limits_.max_string_length) {
+                fail("Number literal too long");
+            }
+        } else {
+            break;
+        }
+    }
+
+    if (pos_ >= size_ && !finished_) {
+        return Status::NEED_MORE; // the literal may continue in the next chunk
+    }
+
+    partial_ = Partial::NONE;
+
+    if (skipping_) {
+        event.token = Token::NUMBER;
+        afterValue();
+        return Status::EVENT;
+    }
+
+    const char* first = pending_.data();
+    const char* last = first + pending_.size();
+    double value = 0.0;
+    auto result = std::from_chars(first, last, value);
+    if (!isNumberLiteral(pending_) || result.ec != std::errc() || result.ptr != last) {
+        fail("Invalid number");
+    }
+
+    event.token = Token::NUMBER;
+    event.number = value;
+    event.text.swap(pending_);
+    afterValue();
+    return Status::EVENT;
+}
+
+Reader::Status Reader::readLiteral(Event& event) {
+    const char* literal = nullptr;
+    switch (data_[pos_]) {
+        case 't': literal = "true"; break;
+        case 'f': literal = "false"; break;
+        default: literal = "null"; break;
+    }
+
+    size_t length = std::strlen(literal);
+    size_t available = std::min(length, size_ - pos_);
+    if (std::memcmp(data_ + pos_, literal, available) != 0) {
+        fail("Invalid literal");
+    }
+    if (available < length) {
+        if (finished_) {
+            fail("Invalid literal");
+        }
+        return Status::NEED_MORE;
+    }
+
+    pos_ += length;
+    if (literal[0] == 'n') {
+        event.token = Token::NULL_VALUE;
+    } else {
+        event.token = Token::BOOLEAN;
+        event.boolean = literal[0] == 't';
+    }
+    afterValue();
+    return Status::EVENT;
+}
+
+// DomBuilder implementation
+bool DomBuilder::handle(const Event& event) {
+    switch (event.token) {
+        case Token::START_OBJECT: {
+            auto value = std::make_shared<ObjectValue>();
+            attach(value);
+            stack_.push_back(value);
+            return false;
+        }
+        case Token::START_ARRAY: {
+            auto value = std::make_shared<ArrayValue>();
+            attach(value);
+            stack_.push_back(value);
+            return false;
+        }
+        case Token::END_OBJECT:
+        case Token::END_ARRAY:
+            stack_.pop_back();
+            return stack_.empty();
+        case Token::KEY:
+            key_ = event.text;
+            return false;
+        case Token::STRING:
+            attach(std::make_shared<StringValue>(event.text));
+            break;
+        case Token::NUMBER:
+            attach(std::make_shared<NumberValue>(event.number));
+            break;
+        case Token::BOOLEAN:
+            attach(std::make_shared<BooleanValue>(event.boolean));
+            break;
+        case Token::NULL_VALUE:
+            attach(std::make_shared<NullValue>());
+            break;
+    }
+    return stack_.empty();
+}
+
+void DomBuilder::attach(std::shared_ptr<Value> value) {
+    if (stack_.empty()) {
+        root_ = std::move(value);
+        return;
+    }
+
+    auto& parent = stack_.back();
+    if (parent->isObject()) {
+        std::static_pointer_cast<ObjectValue>(parent)->set(key_, std::move(value));
+    } else {
+        std::static_pointer_cast<ArrayValue>(parent)->push(std::move(value));
+    }
+}
+
+std::shared_ptr<Value> DomBuilder::take() {
+    return std::move(root_);
+}
+
+// StreamParser implementation
+std::shared_ptr<Value> StreamParser::nextDocument() {
+    while (reader_.next(event_) == Reader::Status::EVENT) {
+        if (builder_.handle(event_)) {
+            return builder_.take();
+        }
+    }
+    return nullptr;
+}
+
+} // namespace json
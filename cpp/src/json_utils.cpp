@@ -1,8 +1,14 @@
 #include "json_utils.h"
+#include "json_reader.h"
+#include "blake3.h"
 #include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
-#include <cctype>
 
 namespace json {
 
@@ -42,15 +48,97 @@ const Array& Value::asArray() const {
     return static_cast<const ArrayValue*>(this)->asArray();
 }
 
-// NumberValue implementation
-std::string NumberValue::toString() const {
-    std::ostringstream oss;
-    if (value_ == static_cast<int>(value_)) {
-        oss << static_cast<int>(value_);
+// StringValue implementation
+std::string StringValue::toString() const {
+    return quote(value_);
+}
+
+std::string quote(const std::string& text) {
+    static const char hex[] = "0123456789abcdef";
+
+    std::string out;
+    out.reserve(text.size() + 2);
+    out += '"';
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0x0F];
+                } else {
+                    out += ch;
+                }
+                break;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+size_t formatNumber(double value, char* out) {
+    if (!std::isfinite(value)) {
+        std::memcpy(out, "null", 4);
+        return 4;
+    }
+    if (value == 0) {
+        out[0] = '0';
+        return 1;
+    }
+
+    // Shortest round-trip digits and decimal exponent, e.g. "1.25e+02"
+    char buffer[NUMBER_BUFFER_SIZE];
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer), std::fabs(value), std::chars_format::scientific).ptr;
+    char* e = std::find(buffer, end, 'e');
+    char digits[20];
+    int k = 0;
+    for (char* p = buffer; p < e; ++p) {
+        if (*p != '.') digits[k++] = *p;
+    }
+    int n = std::atoi(e + 1) + 1;  // value = 0.digits * 10^n
+
+    char* w = out;
+    if (value < 0) *w++ = '-';
+    auto put = [&w](const char* text, int count) {
+        std::memcpy(w, text, count);
+        w += count;
+    };
+    if (k <= n && n <= 21) {
+        put(digits, k);
+        for (int i = k; i < n; ++i) *w++ = '0';
+    } else if (0 < n && n <= 21) {
+        put(digits, n);
+        *w++ = '.';
+        put(digits + n, k - n);
+    } else if (-6 < n && n <= 0) {
+        put("0.", 2);
+        for (int i = n; i < 0; ++i) *w++ = '0';
+        put(digits, k);
     } else {
-        oss << value_;
+        *w++ = digits[0];
+        if (k > 1) {
+            *w++ = '.';
+            put(digits + 1, k - 1);
+        }
+        *w++ = 'e';
+        *w++ = n - 1 < 0 ? '-' : '+';
+        w = std::to_chars(w, out + NUMBER_BUFFER_SIZE, std::abs(n - 1)).ptr;
     }
-    return oss.str();
+    return w - out;
+}
+
+// NumberValue implementation
+std::string NumberValue::toString() const {
+    char buffer[NUMBER_BUFFER_SIZE];
+    return std::string(buffer, formatNumber(value_, buffer));
 }
 
 // ObjectValue implementation
@@ -60,7 +148,7 @@ std::string ObjectValue::toString() const {
     bool first = true;
     for (const auto& pair : value_) {
         if (!first) oss << ",";
-        oss << "\"" << pair.first << "\":" << pair.second->toString();
+        oss << quote(pair.first) << ":" << pair.second->toString();
         first = false;
     }
     oss << "}";
@@ -81,221 +169,598 @@ std::string ArrayValue::toString() const {
     return oss.str();
 }
 
-// Simple JSON parser implementation
-class Parser {
-public:
-    Parser(const std::string& json) : json_(json), pos_(0) {}
+// Hashing
+std::atomic<uint64_t> HashCache::mutation_epoch_{IMMUTABLE + 1};
+std::atomic<bool> HashCache::cached_since_touch_{false};
 
-    std::shared_ptr<Value> parse() {
-        skipWhitespace();
-        return parseValue();
+bool HashCache::get(uint64_t epoch, Hash128& hash) const {
+    uint64_t stamp = stamp_.load(std::memory_order_acquire);
+    if (stamp != epoch) {
+        return false;
     }
+    hash.high = high_.load(std::memory_order_relaxed);
+    hash.low = low_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return stamp_.load(std::memory_order_relaxed) == stamp;
+}
 
-private:
-    std::string json_;
-    size_t pos_;
-
-    void skipWhitespace() {
-        while (pos_ < json_.length() && std::isspace(json_[pos_])) {
-            pos_++;
-        }
+void HashCache::put(uint64_t epoch, const Hash128& hash) const {
+    stamp_.store(EMPTY, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    high_.store(hash.high, std::memory_order_relaxed);
+    low_.store(hash.low, std::memory_order_relaxed);
+    stamp_.store(epoch, std::memory_order_release);
+    if (epoch != IMMUTABLE) {
+        cached_since_touch_.store(true, std::memory_order_release);
     }
+}
 
-    char peek() {
-        if (pos_ >= json_.length()) return '\0';
-        return json_[pos_];
+std::string Hash128::toHex() const {
+    static const char hex[] = "0123456789abcdef";
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        out[31 - i] = hex[(low >> (4 * i)) & 0xF];
+        out[15 - i] = hex[(high >> (4 * i)) & 0xF];
     }
+    return out;
+}
+
+namespace {
+
+// Strings at least this long are hashed (and cached) as their own node
+constexpr size_t LARGE_STRING = 1024;
+
+// Precedes a child node's digest; canonical text never contains a raw NUL
+constexpr char NODE_MARKER = '\0';
 
-    char advance() {
-        if (pos_ >= json_.length()) return '\0';
-        return json_[pos_++];
+Hash128 digest(const Blake3& hasher) {
+    uint8_t bytes[16];
+    hasher.finalize(bytes, sizeof(bytes));
+    Hash128 hash;
+    for (int i = 0; i < 8; ++i) {
+        hash.high = (hash.high << 8) | bytes[i];
+        hash.low = (hash.low << 8) | bytes[i + 8];
     }
+    return hash;
+}
 
-    std::shared_ptr<Value> parseValue() {
-        skipWhitespace();
-        char c = peek();
+// Same output as quote(), fed to the hasher in runs
+void hashQuoted(Blake3& hasher, const std::string& text) {
+    static const char hex[] = "0123456789abcdef";
+    hasher.update("\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        hasher.update(text.data() + run, i - run);
+        run = i + 1;
 
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t length = 2;
         switch (c) {
-            case '"': return parseString();
-            case '{': return parseObject();
-            case '[': return parseArray();
-            case 't': case 'f': return parseBoolean();
-            case 'n': return parseNull();
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
             default:
-                if (c == '-' || std::isdigit(c)) {
-                    return parseNumber();
-                }
-                throw std::runtime_error("Invalid JSON character");
+                std::memcpy(escape + 1, "u00", 3);
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0x0F];
+                length = 6;
+                break;
         }
+        hasher.update(escape, length);
     }
+    hasher.update(text.data() + run, text.size() - run);
+    hasher.update("\"", 1);
+}
 
-    std::shared_ptr<Value> parseString() {
-        if (advance() != '"') {
-            throw std::runtime_error("Expected '\"'");
-        }
+bool isNode(const Value& value) {
+    return value.isObject() || value.isArray() ||
+           (value.isString() && static_cast<const StringValue&>(value).text().size() >= LARGE_STRING);
+}
+
+void hashContent(Blake3& hasher, const Value& value);
+
+void hashElement(Blake3& hasher, const Value& value) {
+    if (!isNode(value)) {
+        hashContent(hasher, value);
+        return;
+    }
+    Hash128 child = hash(value);
+    uint8_t bytes[17] = {static_cast<uint8_t>(NODE_MARKER)};
+    for (int i = 0; i < 8; ++i) {
+        bytes[1 + i] = static_cast<uint8_t>(child.high >> (56 - 8 * i));
+        bytes[9 + i] = static_cast<uint8_t>(child.low >> (56 - 8 * i));
+    }
+    hasher.update(bytes, sizeof(bytes));
+}
 
-        std::string result;
-        while (pos_ < json_.length()) {
-            char c = advance();
-            if (c == '"') {
-                return std::make_shared<StringValue>(result);
+void hashContent(Blake3& hasher, const Value& value) {
+    switch (value.getType()) {
+        case Type::STRING:
+            hashQuoted(hasher, static_cast<const StringValue&>(value).text());
+            break;
+        case Type::NUMBER: {
+            char buffer[NUMBER_BUFFER_SIZE];
+            hasher.update(buffer, formatNumber(value.asNumber(), buffer));
+            break;
+        }
+        case Type::BOOLEAN:
+            hasher.update(value.asBoolean() ? "true" : "false", value.asBoolean() ? 4 : 5);
+            break;
+        case Type::NULL_VALUE:
+            hasher.update("null", 4);
+            break;
+        case Type::OBJECT: {
+            hasher.update("{", 1);
+            bool first = true;
+            for (const auto& [key, member] : value.asObject()) {
+                if (!first) hasher.update(",", 1);
+                hashQuoted(hasher, key);
+                hasher.update(":", 1);
+                hashElement(hasher, *member);
+                first = false;
             }
-            if (c == '\\') {
-                c = advance();
-                switch (c) {
-                    case '"': result += '"'; break;
-                    case '\\': result += '\\'; break;
-                    case '/': result += '/'; break;
-                    case 'b': result += '\b'; break;
-                    case 'f': result += '\f'; break;
-                    case 'n': result += '\n'; break;
-                    case 'r': result += '\r'; break;
-                    case 't': result += '\t'; break;
-                    default: result += c; break;
-                }
-            } else {
-                result += c;
+            hasher.update("}", 1);
+            break;
+        }
+        case Type::ARRAY: {
+            hasher.update("[", 1);
+            bool first = true;
+            for (const auto& element : value.asArray()) {
+                if (!first) hasher.update(",", 1);
+                hashElement(hasher, *element);
+                first = false;
             }
+            hasher.update("]", 1);
+            break;
         }
-        throw std::runtime_error("Unterminated string");
     }
+}
 
-    std::shared_ptr<Value> parseNumber() {
-        size_t start = pos_;
+} // namespace
+
+Hash128 hash(const Value& value) {
+    const HashCache* cache = nullptr;
+    uint64_t epoch = HashCache::IMMUTABLE;
+    if (value.isString() && isNode(value)) {
+        cache = &static_cast<const StringValue&>(value).hash_;
+    } else if (value.isObject()) {
+        cache = &static_cast<const ObjectValue&>(value).hash_;
+        epoch = HashCache::epoch();
+    } else if (value.isArray()) {
+        cache = &static_cast<const ArrayValue&>(value).hash_;
+        epoch = HashCache::epoch();
+    }
 
-        if (peek() == '-') advance();
+    Hash128 result;
+    if (cache && cache->get(epoch, result)) {
+        return result;
+    }
+    Blake3 hasher;
+    hashContent(hasher, value);
+    result = digest(hasher);
+    if (cache) {
+        cache->put(epoch, result);
+    }
+    return result;
+}
 
-        if (!std::isdigit(peek())) {
-            throw std::runtime_error("Invalid number");
+std::shared_ptr<Value> mergePatch(const std::shared_ptr<Value>& target, const std::shared_ptr<Value>& patch) {
+    if (!patch->isObject()) {
+        return patch;
+    }
+    Object merged;
+    if (target && target->isObject()) {
+        merged = target->asObject();
+    }
+    for (const auto& [key, value] : patch->asObject()) {
+        if (value->isNull()) {
+            merged.erase(key);
+            continue;
         }
+        auto it = merged.find(key);
+        merged[key] = mergePatch(it != merged.end() ? it->second : nullptr, value);
+    }
+    return std::make_shared<ObjectValue>(merged);
+}
 
-        while (std::isdigit(peek())) {
-            advance();
+std::shared_ptr<Value> diffPatch(const std::shared_ptr<Value>& base, const std::shared_ptr<Value>& target) {
+    if (!base || !base->isObject() || !target->isObject()) {
+        return target;
+    }
+    const Object& before = base->asObject();
+    const Object& after = target->asObject();
+    Object patch;
+    for (const auto& [key, value] : before) {
+        if (after.find(key) == after.end()) {
+            patch[key] = null();
         }
-
-        if (peek() == '.') {
-            advance();
-            while (std::isdigit(peek())) {
-                advance();
+    }
+    for (const auto& [key, value] : after) {
+        if (value->isNull()) {
+            continue;
+        }
+        auto it = before.find(key);
+        if (it == before.end()) {
+            patch[key] = value;
+        } else if (it->second != value && hash(*it->second) != hash(*value)) {
+            auto nested = diffPatch(it->second, value);
+            if (!nested->isObject() || !nested->asObject().empty()) {
+                patch[key] = nested;
             }
         }
+    }
+    return std::make_shared<ObjectValue>(patch);
+}
+
+// ParseError implementation
+static std::string describeError(const std::string& message, size_t offset, size_t line, size_t column) {
+    if (line > 0) {
+        return message + " at line " + std::to_string(line) + ", column " + std::to_string(column);
+    }
+    return message + " at offset " + std::to_string(offset);
+}
 
-        if (peek() == 'e' || peek() == 'E') {
-            advance();
-            if (peek() == '+' || peek() == '-') advance();
-            while (std::isdigit(peek())) {
-                advance();
+ParseError::ParseError(const std::string& message, size_t offset, size_t line, size_t column)
+    : std::runtime_error(describeError(message, offset, line, column))
+    , message_(message)
+    , offset_(offset)
+    , line_(line)
+    , column_(column) {}
+
+// Parsing is driven by the iterative pull reader; no recursion, so nesting
+// depth is limited only by ParseLimits.
+static std::shared_ptr<Value> parseWith(Reader& reader) {
+    DomBuilder builder;
+    Event event;
+    while (reader.next(event) == Reader::Status::EVENT) {
+        if (builder.handle(event)) {
+            // Single-document reader: anything but trailing whitespace is an error
+            if (reader.next(event) != Reader::Status::END) {
+                throw ParseError("Unexpected data after document", reader.offset());
             }
+            return builder.take();
         }
-
-        std::string number_str = json_.substr(start, pos_ - start);
-        double value = std::stod(number_str);
-        return std::make_shared<NumberValue>(value);
     }
+    throw ParseError("Unexpected end of input", reader.offset());
+}
 
-    std::shared_ptr<Value> parseBoolean() {
-        if (json_.substr(pos_, 4) == "true") {
-            pos_ += 4;
-            return std::make_shared<BooleanValue>(true);
-        } else if (json_.substr(pos_, 5) == "false") {
-            pos_ += 5;
-            return std::make_shared<BooleanValue>(false);
+static ParseError withPosition(const ParseError& error, const std::string& text) {
+    size_t end = std::min(error.offset(), text.size());
+    size_t line = 1;
+    size_t line_start = 0;
+    for (size_t i = 0; i < end; ++i) {
+        if (text[i] == '\n') {
+            line++;
+            line_start = i + 1;
         }
-        throw std::runtime_error("Invalid boolean value");
     }
+    return ParseError(error.message(), error.offset(), line, end - line_start + 1);
+}
+
+// Public interface functions
+std::shared_ptr<Value> parse(const std::string& json, const ParseLimits& limits) {
+    try {
+        Reader reader(json.data(), json.size(), false, limits);
+        return parseWith(reader);
+    } catch (const ParseError& e) {
+        throw withPosition(e, json);
+    }
+}
+
+std::shared_ptr<Value> parseFromFile(const std::string& filename, const ParseLimits& limits) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filename, ec);
+    if (!ec && size > limits.max_size) {
+        throw ParseError("File exceeds maximum size of " + std::to_string(limits.max_size) + " bytes", 0);
+    }
+
+    std::string content((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+    return parse(content, limits);
+}
+
+// Path implementation
+static uint64_t hashKey(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+Path::Path(const std::string& pointer) : pointer_(pointer) {
+    if (pointer.empty()) {
+        return;
+    }
+    if (pointer[0] != '/') {
+        throw std::runtime_error("JSON pointer must start with '/': " + pointer);
+    }
+
+    size_t pos = 1;
+    while (true) {
+        size_t end = pointer.find('/', pos);
+        if (end == std::string::npos) {
+            end = pointer.size();
+        }
 
-    std::shared_ptr<Value> parseNull() {
-        if (json_.substr(pos_, 4) == "null") {
-            pos_ += 4;
-            return std::make_shared<NullValue>();
+        Step step;
+        for (size_t i = pos; i < end; ++i) {
+            if (pointer[i] != '~') {
+                step.key += pointer[i];
+            } else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1')) {
+                step.key += pointer[++i] == '0' ? '~' : '/';
+            } else {
+                throw std::runtime_error("Invalid escape in JSON pointer: " + pointer);
+            }
         }
-        throw std::runtime_error("Invalid null value");
+        step.hash = hashKey(step.key.data(), step.key.size());
+
+        // Array indices are decimal without leading zeros
+        step.index = SIZE_MAX;
+        bool numeric = !step.key.empty() && (step.key == "0" || step.key[0] != '0') &&
+                       step.key.find_first_not_of("0123456789") == std::string::npos &&
+                       step.key.size() < 19;
+        if (numeric) {
+            step.index = std::stoull(step.key);
+        }
+
+        steps_.push_back(std::move(step));
+        if (end == pointer.size()) {
+            break;
+        }
+        pos = end + 1;
+    }
+}
+
+const std::shared_ptr<Value>* Path::child(const Value& current, size_t i) const {
+    const Step& s = steps_[i];
+    if (current.isObject()) {
+        const Object& object = current.asObject();
+        auto it = object.find(s.key);
+        return it != object.end() ? &it->second : nullptr;
+    }
+    if (current.isArray() && s.index != SIZE_MAX) {
+        const Array& array = current.asArray();
+        return s.index < array.size() ? &array[s.index] : nullptr;
     }
+    return nullptr;
+}
 
-    std::shared_ptr<Value> parseObject() {
-        if (advance() != '{') {
-            throw std::runtime_error("Expected '{'");
+const Value* Path::evaluate(const Value& root) const {
+    const Value* current = &root;
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        auto next = child(*current, i);
+        if (!next || !*next) {
+            return nullptr;
         }
+        current = next->get();
+    }
+    return current;
+}
 
-        auto obj = std::make_shared<ObjectValue>();
-        skipWhitespace();
+std::shared_ptr<Value> Path::find(const std::shared_ptr<Value>& root) const {
+    return findFrom(root, 0);
+}
 
-        if (peek() == '}') {
-            advance();
-            return obj;
+std::shared_ptr<Value> Path::findFrom(const std::shared_ptr<Value>& root, size_t first) const {
+    const std::shared_ptr<Value>* current = &root;
+    for (size_t i = first; i < steps_.size(); ++i) {
+        if (!*current) {
+            return nullptr;
+        }
+        current = child(**current, i);
+        if (!current) {
+            return nullptr;
         }
+    }
+    return *current;
+}
 
-        while (true) {
-            skipWhitespace();
-            auto key = parseString();
-            skipWhitespace();
+std::string Path::getString(const Value& root, const std::string& fallback) const {
+    const Value* value = evaluate(root);
+    return value && value->isString() ? value->asString() : fallback;
+}
 
-            if (advance() != ':') {
-                throw std::runtime_error("Expected ':'");
-            }
+double Path::getNumber(const Value& root, double fallback) const {
+    const Value* value = evaluate(root);
+    return value && value->isNumber() ? value->asNumber() : fallback;
+}
 
-            skipWhitespace();
-            auto value = parseValue();
-            obj->set(key->asString(), value);
+// Streams a document once, following only the branches some path needs.
+// Each path is tracked by a bit; a value is decoded only when a path ends
+// on it, everything else goes through Reader::skipValue.
+class Extraction {
+public:
+    Extraction(Reader& reader, const std::vector<Path>& paths)
+        : reader_(reader), paths_(paths), results_(paths.size()), remaining_(paths.size()) {}
 
-            skipWhitespace();
-            char c = advance();
-            if (c == '}') {
-                break;
-            } else if (c != ',') {
-                throw std::runtime_error("Expected ',' or '}'");
-            }
+    std::vector<std::shared_ptr<Value>> run() {
+        if (paths_.size() > 64) {
+            throw std::runtime_error("json::extract supports at most 64 paths");
+        }
+        Event event;
+        if (paths_.empty() || !nextEvent(event)) {
+            return std::move(results_);
         }
+        uint64_t all = paths_.size() == 64 ? ~0ULL : (1ULL << paths_.size()) - 1;
+        visit(event, all, 0);
+        return std::move(results_);
+    }
+
+private:
+    Reader& reader_;
+    const std::vector<Path>& paths_;
+    std::vector<std::shared_ptr<Value>> results_;
+    size_t remaining_;
+    uint64_t resolved_ = 0;  // duplicate keys resolve a path only once
+
+    bool nextEvent(Event& event) {
+        Reader::Status status = reader_.next(event);
+        if (status == Reader::Status::EVENT) {
+            return true;
+        }
+        if (status == Reader::Status::END) {
+            return false;
+        }
+        throw ParseError("Unexpected end of input", reader_.offset());
+    }
 
-        return obj;
+    void skip(Event& event) {
+        if (reader_.skipValue(event) != Reader::Status::EVENT) {
+            throw ParseError("Unexpected end of input", reader_.offset());
+        }
+    }
+
+    std::shared_ptr<Value> materialize(Event& event) {
+        DomBuilder builder;
+        while (!builder.handle(event)) {
+            if (!nextEvent(event)) {
+                throw ParseError("Unexpected end of input", reader_.offset());
+            }
+        }
+        return builder.take();
     }
 
-    std::shared_ptr<Value> parseArray() {
-        if (advance() != '[') {
-            throw std::runtime_error("Expected '['");
+    // Handles the value whose first event is `event`, at `depth` steps into
+    // every path in `active`. Returns true once every path is resolved.
+    bool visit(Event& event, uint64_t active, size_t depth) {
+        uint64_t ending = 0;
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            if ((active >> i & 1) && paths_[i].steps_.size() == depth) {
+                ending |= 1ULL << i;
+            }
         }
 
-        auto arr = std::make_shared<ArrayValue>();
-        skipWhitespace();
+        if (ending) {
+            auto value = materialize(event);
+            // Paths that continue below a materialized value are finished on the DOM
+            for (size_t i = 0; i < paths_.size(); ++i) {
+                if (!(active >> i & 1) || (resolved_ >> i & 1)) {
+                    continue;
+                }
+                resolved_ |= 1ULL << i;
+                if (ending >> i & 1) {
+                    results_[i] = value;
+                } else {
+                    results_[i] = paths_[i].findFrom(value, depth);
+                }
+                remaining_--;
+            }
+            return remaining_ == 0;
+        }
 
-        if (peek() == ']') {
-            advance();
-            return arr;
+        if (event.token == Token::START_OBJECT) {
+            return visitObject(active, depth);
+        }
+        if (event.token == Token::START_ARRAY) {
+            return visitArray(active, depth);
         }
+        return false;
+    }
 
-        while (true) {
-            skipWhitespace();
-            auto value = parseValue();
-            arr->push(value);
+    bool visitObject(uint64_t active, size_t depth) {
+        Event event;
+        while (nextEvent(event)) {
+            if (event.token == Token::END_OBJECT) {
+                return false;
+            }
 
-            skipWhitespace();
-            char c = advance();
-            if (c == ']') {
+            uint64_t hash = hashKey(event.text.data(), event.text.size());
+            uint64_t matching = 0;
+            for (size_t i = 0; i < paths_.size(); ++i) {
+                if (active >> i & 1) {
+                    const auto& step = paths_[i].steps_[depth];
+                    if (step.hash == hash && step.key == event.text) {
+                        matching |= 1ULL << i;
+                    }
+                }
+            }
+
+            if (!matching) {
+                skip(event);
+                continue;
+            }
+            if (!nextEvent(event)) {
                 break;
-            } else if (c != ',') {
-                throw std::runtime_error("Expected ',' or ']'");
+            }
+            if (visit(event, matching, depth + 1)) {
+                return true;
             }
         }
+        throw ParseError("Unexpected end of input", reader_.offset());
+    }
 
-        return arr;
+    bool visitArray(uint64_t active, size_t depth) {
+        Event event;
+        for (size_t index = 0;; ++index) {
+            uint64_t matching = 0;
+            for (size_t i = 0; i < paths_.size(); ++i) {
+                if ((active >> i & 1) && paths_[i].steps_[depth].index == index) {
+                    matching |= 1ULL << i;
+                }
+            }
+
+            if (!matching) {
+                size_t array_depth = reader_.depth();
+                skip(event);
+                if (reader_.depth() < array_depth) {
+                    return false;  // skipValue consumed the END_ARRAY
+                }
+                continue;
+            }
+            if (!nextEvent(event)) {
+                throw ParseError("Unexpected end of input", reader_.offset());
+            }
+            if (event.token == Token::END_ARRAY) {
+                return false;
+            }
+            if (visit(event, matching, depth + 1)) {
+                return true;
+            }
+        }
     }
 };
 
-// Public interface functions
-std::shared_ptr<Value> parse(const std::string& json) {
-    Parser parser(json);
-    return parser.parse();
+std::vector<std::shared_ptr<Value>> extract(const std::string& json, const std::vector<Path>& paths,
+                                            const ParseLimits& limits) {
+    try {
+        Reader reader(json.data(), json.size(), false, limits);
+        return Extraction(reader, paths).run();
+    } catch (const ParseError& e) {
+        throw withPosition(e, json);
+    }
 }
 
-std::shared_ptr<Value> parseFromFile(const std::string& filename) {
-    std::ifstream file(filename);
+std::vector<std::shared_ptr<Value>> extractFromFile(const std::string& filename, const std::vector<Path>& paths,
+                                                    const ParseLimits& limits) {
+    std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         throw std::runtime_error("Unable to open file: " + filename);
     }
 
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filename, ec);
+    if (!ec && size > limits.max_size) {
+        throw ParseError("File exceeds maximum size of " + std::to_string(limits.max_size) + " bytes", 0);
+    }
+
     std::string content((std::istreambuf_iterator<char>(file)),
                        std::istreambuf_iterator<char>());
-    return parse(content);
+    return extract(content, paths, limits);
 }
 
 bool saveToFile(const std::string& filename, std::shared_ptr<Value> value) {
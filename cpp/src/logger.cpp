@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <filesystem>
 #include <algorithm>
+#include <random>
 
 std::unique_ptr<Logger> Logger::instance_ = nullptr;
 std::mutex Logger::instance_mutex_;
@@ -24,6 +25,7 @@ Logger& Logger::getInstance() {
 }
 
 Logger::~Logger() {
+    flushSuppressed();
     if (log_file_ && log_file_->is_open()) {
         info("Logger", "Shutting down logging system");
         log_file_->close();
@@ -64,6 +66,25 @@ void Logger::enableFileOutput(bool enable) {
     file_output_ = enable;
 }
 
+void Logger::enableRateLimiting(bool enable) {
+    rate_limiting_.store(enable, std::memory_order_relaxed);
+}
+
+void Logger::setRateLimit(double messages_per_second, int burst) {
+    if (messages_per_second <= 0.0 || burst < 1) {
+        return;
+    }
+    int64_t interval = static_cast<int64_t>(1e9 / messages_per_second);
+    emission_interval_ns_.store(interval, std::memory_order_relaxed);
+    burst_tolerance_ns_.store(interval * (burst - 1), std::memory_order_relaxed);
+}
+
+void Logger::setDebugSampleRate(double probability) {
+    probability = std::clamp(probability, 0.0, 1.0);
+    debug_sample_threshold_.store(static_cast<uint32_t>(probability * 4294967295.0),
+                                  std::memory_order_relaxed);
+}
+
 void Logger::log(LogLevel level, const std::string& message) {
     log(level, "General", message);
 }
@@ -73,6 +94,18 @@ void Logger::log(LogLevel level, const std::string& component, const std::string
         return;
     }
 
+    uint64_t suppressed = 0;
+    if (!admitMessage(level, component, message, suppressed)) {
+        return;
+    }
+
+    if (suppressed > 0) {
+        writeMessage(level, component, "Suppressed " + std::to_string(suppressed) + " similar messages");
+    }
+    writeMessage(level, component, message);
+}
+
+void Logger::writeMessage(LogLevel level, const std::string& component, const std::string& message) {
     std::lock_guard<std::mutex> lock(log_mutex_);
     std::string formatted = formatMessage(level, component, message);
 
@@ -90,6 +123,129 @@ void Logger::log(LogLevel level, const std::string& component, const std::string
     }
 }
 
+uint64_t Logger::templateKey(const std::string& component, const std::string& message) {
+    // FNV-1a over the component and a digit-collapsed prefix of the message
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](unsigned char c) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    };
+
+    for (unsigned char c : component) {
+        mix(c);
+    }
+    mix(0);
+
+    bool in_digits = false;
+    size_t limit = std::min(message.size(), TEMPLATE_PREFIX);
+    for (size_t i = 0; i < limit; ++i) {
+        unsigned char c = static_cast<unsigned char>(message[i]);
+        if (c >= '0' && c <= '9') {
+            if (!in_digits) mix('#');
+            in_digits = true;
+        } else {
+            mix(c);
+            in_digits = false;
+        }
+    }
+
+    return hash | 1; // zero marks an empty slot
+}
+
+Logger::RateLimitSlot* Logger::findSlot(uint64_t key) {
+    size_t index = static_cast<size_t>(key) % RATE_LIMIT_SLOTS;
+    for (size_t probe = 0; probe < RATE_LIMIT_PROBES; ++probe) {
+        RateLimitSlot& slot = rate_slots_[(index + probe) % RATE_LIMIT_SLOTS];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key) {
+            return &slot;
+        }
+        if (current == 0) {
+            uint64_t expected = 0;
+            if (slot.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel) ||
+                expected == key) {
+                return &slot;
+            }
+        }
+    }
+
+    // No free slot nearby: take over the probed slot with the oldest
+    // theoretical arrival time, the site that has been quiet longest, so a
+    // table full of one-off templates still limits the next storm
+    RateLimitSlot* victim = &rate_slots_[index];
+    for (size_t probe = 1; probe < RATE_LIMIT_PROBES; ++probe) {
+        RateLimitSlot& slot = rate_slots_[(index + probe) % RATE_LIMIT_SLOTS];
+        if (slot.tat_ns.load(std::memory_order_relaxed) < victim->tat_ns.load(std::memory_order_relaxed)) {
+            victim = &slot;
+        }
+    }
+    uint64_t evicted = victim->key.load(std::memory_order_acquire);
+    if (evicted != key && !victim->key.compare_exchange_strong(evicted, key, std::memory_order_acq_rel)) {
+        return evicted == key ? victim : nullptr; // lost the race to another site: fail open once
+    }
+    victim->tat_ns.store(0, std::memory_order_relaxed);
+    evicted_suppressed_.fetch_add(victim->suppressed.exchange(0, std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+    return victim;
+}
+
+bool Logger::admitMessage(LogLevel level, const std::string& component, const std::string& message,
+                          uint64_t& suppressed_before) {
+    if (!rate_limiting_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    RateLimitSlot* slot = findSlot(templateKey(component, message));
+    if (!slot) {
+        return true;
+    }
+
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t interval = emission_interval_ns_.load(std::memory_order_relaxed);
+    int64_t tolerance = burst_tolerance_ns_.load(std::memory_order_relaxed);
+
+    // Generic cell rate algorithm: equivalent to a token bucket but the whole
+    // state is one timestamp, so a single CAS updates it.
+    int64_t tat = slot->tat_ns.load(std::memory_order_relaxed);
+    while (true) {
+        int64_t base = std::max(tat, now);
+        if (base - now > tolerance) {
+            break;
+        }
+        if (slot->tat_ns.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed)) {
+            suppressed_before = slot->suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Over budget: DEBUG sites are thinned by sampling, everything else waits
+    // for the bucket to refill.
+    if (level == LogLevel::DEBUG) {
+        thread_local std::minstd_rand rng(std::random_device{}());
+        uint32_t threshold = debug_sample_threshold_.load(std::memory_order_relaxed);
+        if (threshold > 0 && static_cast<uint32_t>(rng() * 2) < threshold) {
+            suppressed_before = slot->suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    slot->suppressed.fetch_add(1, std::memory_order_relaxed);
+    total_suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Logger::flushSuppressed() {
+    uint64_t pending = evicted_suppressed_.exchange(0, std::memory_order_relaxed);
+    for (auto& slot : rate_slots_) {
+        pending += slot.suppressed.exchange(0, std::memory_order_relaxed);
+    }
+    if (pending > 0) {
+        writeMessage(LogLevel::INFO, "Logger", "Suppressed " + std::to_string(pending) +
+                     " similar messages before shutdown");
+    }
+}
+
 void Logger::debug(const std::string& message) {
     log(LogLevel::DEBUG, message);
 }
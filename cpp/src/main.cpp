@@ -1,7 +1,11 @@
 #include <gtkmm.h>
+#include <glib-unix.h>
+#include <algorithm>
 #include <iostream>
 #include "claude_agent_gui.h"
 #include "logger.h"
+#include "process_spawner.h"
+#include "profiler.h"
 
 void setupLogging(int argc, char* argv[]) {
     auto& logger = Logger::getInstance();
@@ -29,6 +33,40 @@ void setupLogging(int argc, char* argv[]) {
     logger.setLogFile("claude_agent.log");
 }
 
+// --profile=SECONDS, or 0
+int profileSeconds(int argc, char* argv[]) {
+    const std::string prefix = "--profile=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) {
+            try {
+                return std::max(0, std::stoi(arg.substr(prefix.size())));
+            } catch (const std::exception&) {
+                std::cerr << "Invalid --profile value: " << arg << std::endl;
+            }
+        }
+    }
+    return 0;
+}
+
+void finishProfile() {
+    auto& profiler = Profiler::getInstance();
+    if (profiler.running()) {
+        profiler.stop();
+        profiler.writeFolded(Profiler::defaultOutputPath());
+    }
+}
+
+// SIGUSR2 starts a profile, the next one writes it out
+gboolean onProfileSignal(gpointer) {
+    if (Profiler::getInstance().running()) {
+        finishProfile();
+    } else {
+        Profiler::getInstance().start();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 void printUsage(const char* program_name) {
     std::cout << "Claude Agent Gtk - C++ GUI Application\n\n";
     std::cout << "Usage: " << program_name << " [OPTIONS]\n\n";
@@ -36,11 +74,16 @@ void printUsage(const char* program_name) {
     std::cout << "  -h, --help     Show this help message\n";
     std::cout << "  -d, --debug    Enable debug logging to console\n";
     std::cout << "  --log-level=LEVEL  Set log level (DEBUG, INFO, WARNING, ERROR, CRITICAL)\n";
-    std::cout << "  --log-file=FILE    Set log file path (default: claude_agent.log)\n\n";
+    std::cout << "  --log-file=FILE    Set log file path (default: claude_agent.log)\n";
+    std::cout << "  --profile=SECONDS  Sample CPU from startup, then write folded stacks\n";
+    std::cout << "                     (kill -USR2 <pid> toggles profiling at any time)\n\n";
     std::cout << "GTK Options are also available (use --help-gtk to see them)\n";
 }
 
 int main(int argc, char* argv[]) {
+    // Fork the spawn helper while this process is still small and single-threaded
+    ProcessSpawner::getInstance().startForkServer();
+
     // Check for help flag before creating GTK application
     for (int i = 1; i < argc; i++) {
         if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h") {
@@ -52,11 +95,24 @@ int main(int argc, char* argv[]) {
     // Setup logging first
     setupLogging(argc, argv);
 
+    int profile_seconds = profileSeconds(argc, argv);
+    if (profile_seconds > 0) {
+        Profiler::getInstance().start();
+    }
+
     LOG_INFO("Creating GTK application...");
     // Create GTK application
     auto app = Gtk::Application::create(argc, argv, "com.example.claude-agent");
     LOG_INFO("GTK application created successfully");
 
+    g_unix_signal_add(SIGUSR2, onProfileSignal, nullptr);
+    if (profile_seconds > 0) {
+        Glib::signal_timeout().connect_seconds([]() {
+            finishProfile();
+            return false;
+        }, profile_seconds);
+    }
+
     try {
         LOG_INFO("Starting Claude Agent GTK application");
         LOG_INFO("Creating ClaudeAgentGUI window...");
@@ -64,6 +120,7 @@ int main(int argc, char* argv[]) {
         LOG_INFO("ClaudeAgentGUI window created successfully");
 
         int result = app->run(window);
+        finishProfile();
         LOG_INFO("Application exiting with code " + std::to_string(result));
         return result;
     } catch (const std::exception& e) {
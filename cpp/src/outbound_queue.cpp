@@ -0,0 +1,222 @@
+#include "outbound_queue.h"
+#include "logger.h"
+#include "diagnostics.h"
+#include <algorithm>
+#include <csignal>
+
+OutboundQueue::OutboundQueue(ClaudeAgent& agent, std::function<void()> on_event)
+    : agent_(agent)
+    , on_event_(std::move(on_event))
+    , dispatcher_(&OutboundQueue::dispatch, this)
+    , preparer_(&OutboundQueue::prepare, this) {}
+
+OutboundQueue::~OutboundQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        // Not waiting for a CLI that may take minutes: it is stopped as
+        // ProcessSpawner::terminate would, and its turn is dropped
+        if (in_flight_pid_ > 0) {
+            kill(in_flight_pid_, SIGTERM);
+        }
+    }
+    wake_.notify_all();
+    dispatcher_.join();
+    preparer_.join();
+    auto messages = std::count_if(queue_.begin(), queue_.end(), [](const Item& item) { return !item.change; });
+    Diagnostics::getInstance().addQueued(-static_cast<int64_t>(messages));
+}
+
+uint64_t OutboundQueue::enqueue(const std::string& message) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        queue_.push_back({id, message, nullptr});
+    }
+    Diagnostics::getInstance().addQueued(1);
+    wake_.notify_all();
+    return id;
+}
+
+void OutboundQueue::enqueueChange(std::function<std::string()> change) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Item item{0, "", nullptr};
+        item.change = std::move(change);
+        queue_.push_back(std::move(item));
+    }
+    wake_.notify_all();
+}
+
+std::vector<OutboundQueue::Event> OutboundQueue::takeEvents() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Event> events;
+    events.swap(events_);
+    return events;
+}
+
+size_t OutboundQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + (in_flight_ ? 1 : 0);
+}
+
+void OutboundQueue::cancelAll() {
+    std::deque<Item> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A message being prepared stays until the preparer hands it over
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            if (it->preparing || it->change) {
+                ++it;
+            } else {
+                dropped.push_back(std::move(*it));
+                it = queue_.erase(it);
+            }
+        }
+        events_.erase(std::remove_if(events_.begin(), events_.end(),
+                                     [](const Event& event) { return event.kind != Event::Kind::CHANGED; }),
+                      events_.end());
+        generation_++;
+        cancelled_below_ = next_id_;
+
+        // Its answer would otherwise reach the history after a clear
+        if (in_flight_turn_) {
+            in_flight_turn_->discarded = true;
+            if (in_flight_pid_ > 0) {
+                kill(in_flight_pid_, SIGTERM);
+            }
+        }
+    }
+    Diagnostics::getInstance().addQueued(-static_cast<int64_t>(dropped.size()));
+    // Prepared children are terminated outside the lock
+    dropped.clear();
+}
+
+void OutboundQueue::dispatch() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || (!queue_.empty() && !queue_.front().preparing); });
+        if (stopping_) {
+            return;
+        }
+        Item item = std::move(queue_.front());
+        queue_.pop_front();
+        if (item.change) {
+            lock.unlock();
+            std::string result;
+            try {
+                result = item.change();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Exception while applying a queued change: " + std::string(e.what()));
+            }
+            lock.lock();
+            if (!result.empty()) {
+                events_.push_back({Event::Kind::CHANGED, 0, std::move(result)});
+                lock.unlock();
+                if (on_event_) {
+                    on_event_();
+                }
+                lock.lock();
+            }
+            continue;
+        }
+        Diagnostics::getInstance().addQueued(-1);
+        uint64_t generation = generation_;
+        if (item.id < cancelled_below_) {
+            // Was being prepared when the queue was cancelled
+            lock.unlock();
+            item.turn.reset();
+            lock.lock();
+            continue;
+        }
+        in_flight_ = true;
+        events_.push_back({Event::Kind::STARTED, item.id, ""});
+        lock.unlock();
+        wake_.notify_all();     // the preparer can start on the next message
+        if (on_event_) {
+            on_event_();
+        }
+
+        if (!item.turn) {
+            item.turn = agent_.prepareTurn(item.message);
+        }
+        lock.lock();
+        if (stopping_) {
+            return;     // the prepared child is terminated with the turn
+        }
+        if (generation != generation_) {
+            // Cancelled while its child was starting
+            in_flight_ = false;
+            lock.unlock();
+            item.turn.reset();
+            lock.lock();
+            continue;
+        }
+        in_flight_turn_ = item.turn.get();
+        in_flight_pid_ = item.turn->spawned ? item.turn->child.pid : -1;
+        lock.unlock();
+
+        std::string response;
+        try {
+            response = agent_.sendPrepared(*item.turn);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception while sending a queued message: " + std::string(e.what()));
+            response = "Error: " + std::string(e.what());
+        }
+        lock.lock();
+        in_flight_turn_ = nullptr;
+        in_flight_pid_ = -1;
+        lock.unlock();
+        item.turn.reset();
+
+        lock.lock();
+        in_flight_ = false;
+        if (generation != generation_ || stopping_) {
+            continue;
+        }
+        events_.push_back({Event::Kind::REPLIED, item.id, std::move(response)});
+        lock.unlock();
+        if (on_event_) {
+            on_event_();
+        }
+        lock.lock();
+    }
+}
+
+void OutboundQueue::prepare() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        // Only the next message, and only while another one is in flight;
+        // otherwise the dispatcher takes it straight away
+        wake_.wait(lock, [this] {
+            return stopping_ || (in_flight_ && !queue_.empty() && !queue_.front().change && !queue_.front().turn &&
+                                 !queue_.front().preparing);
+        });
+        if (stopping_) {
+            return;
+        }
+        Item& item = queue_.front();
+        item.preparing = true;
+        uint64_t id = item.id;
+        std::string message = item.message;
+
+        lock.unlock();
+        auto turn = agent_.prepareTurn(message);
+        lock.lock();
+
+        // The item is still queued: neither the dispatcher nor cancelAll()
+        // removes an item while it is being prepared
+        for (auto& queued : queue_) {
+            if (queued.id == id) {
+                queued.turn = std::move(turn);
+                queued.preparing = false;
+                break;
+            }
+        }
+        lock.unlock();
+        wake_.notify_all();
+        turn.reset();   // only set if the item went away
+        lock.lock();
+    }
+}
@@ -0,0 +1,608 @@
+#include "process_spawner.h"
+#include <map>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace {
+
+bool writeFully(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool readFully(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = ::read(fd, data, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= got;
+    }
+    return true;
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+// Wire format. Request: uint32 length, then
+// "cwd\0argc\0arg0\0...arg(argc-1)\0env0\0env1\0..." with argc in decimal.
+// Reply: SpawnReply with stdin, stdout and status fds attached on success.
+struct SpawnReply {
+    int32_t pid;
+    int32_t error;
+};
+
+constexpr int REPLY_FDS = 3;
+
+// ---- Fork server (runs in the helper process) ----
+
+int sigchld_pipe[2] = {-1, -1};
+
+void onSigchld(int) {
+    int saved = errno;
+    char c = 0;
+    (void)!::write(sigchld_pipe[1], &c, 1);
+    errno = saved;
+}
+
+// Child side of a spawn, running in a fork of the helper.
+[[noreturn]] void execChild(int stdin_fd, int stdout_fd, const char* cwd, char* const argv[],
+                            const std::vector<char*>& env) {
+    ::dup2(stdin_fd, STDIN_FILENO);
+    ::dup2(stdout_fd, STDOUT_FILENO);
+    if (cwd[0] != '\0' && ::chdir(cwd) != 0) {
+        _exit(127);
+    }
+
+    // Undo the server's (and GUI's) signal setup; ignored signals survive exec
+    struct sigaction dfl {};
+    dfl.sa_handler = SIG_DFL;
+    ::sigaction(SIGPIPE, &dfl, nullptr);
+    ::sigaction(SIGINT, &dfl, nullptr);
+    ::sigaction(SIGCHLD, &dfl, nullptr);
+    sigset_t none;
+    sigemptyset(&none);
+    ::sigprocmask(SIG_SETMASK, &none, nullptr);
+
+    // The server is single-threaded, so putenv is safe in its forked child
+    for (char* entry : env) {
+        ::putenv(entry);
+    }
+
+    ::execvp(argv[0], argv);
+    _exit(127);
+}
+
+void handleSpawnRequest(int sock, const std::string& request, std::map<pid_t, int>& status_fds) {
+    // Unpack cwd, argv and env; the buffer outlives the exec in the child
+    std::vector<char*> fields;
+    for (size_t pos = 0; pos < request.size(); pos += std::strlen(request.c_str() + pos) + 1) {
+        fields.push_back(const_cast<char*>(request.c_str() + pos));
+    }
+    const char* cwd = fields.size() > 0 ? fields[0] : "";
+    size_t argc = fields.size() > 1 ? std::strtoul(fields[1], nullptr, 10) : 0;
+    if (fields.size() < 2 || argc > fields.size() - 2) {
+        argc = 0;
+    }
+    std::vector<char*> argv(fields.begin() + (argc ? 2 : 0), fields.begin() + (argc ? 2 + argc : 0));
+    std::vector<char*> env(argc ? fields.begin() + 2 + argc : fields.end(), fields.end());
+    argv.push_back(nullptr);
+
+    SpawnReply reply{-1, 0};
+    int in[2] = {-1, -1}, out[2] = {-1, -1}, status[2] = {-1, -1};
+
+    if (argv.size() < 2) {
+        reply.error = EINVAL;
+    } else if (::pipe2(in, O_CLOEXEC) != 0 || ::pipe2(out, O_CLOEXEC) != 0 || ::pipe2(status, O_CLOEXEC) != 0) {
+        reply.error = errno;
+    } else {
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            execChild(in[0], out[1], cwd, argv.data(), env);
+        }
+        if (pid < 0) {
+            reply.error = errno;
+        } else {
+            reply.pid = pid;
+            status_fds[pid] = status[1];
+            status[1] = -1;
+        }
+    }
+
+    struct iovec iov {&reply, sizeof(reply)};
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * REPLY_FDS)];
+    if (reply.pid > 0) {
+        int fds[REPLY_FDS] = {in[1], out[0], status[0]};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    }
+    while (::sendmsg(sock, &msg, MSG_NOSIGNAL) < 0 && errno == EINTR) {}
+
+    // The client holds its own copies now (or the spawn failed)
+    for (int* fd : {&in[0], &in[1], &out[0], &out[1], &status[0], &status[1]}) {
+        closeFd(*fd);
+    }
+}
+
+void reapChildren(std::map<pid_t, int>& status_fds) {
+    char drain[64];
+    while (::read(sigchld_pipe[0], drain, sizeof(drain)) > 0) {}
+
+    int status;
+    pid_t pid;
+    while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+        auto it = status_fds.find(pid);
+        if (it != status_fds.end()) {
+            writeFully(it->second, reinterpret_cast<const char*>(&status), sizeof(status));
+            ::close(it->second);
+            status_fds.erase(it);
+        }
+    }
+}
+
+[[noreturn]] void runForkServer(int sock) {
+    ::pipe2(sigchld_pipe, O_CLOEXEC | O_NONBLOCK);
+
+    struct sigaction sa {};
+    sa.sa_handler = onSigchld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGCHLD, &sa, nullptr);
+
+    // Ctrl-C reaches the whole process group; the GUI decides when we stop
+    ::signal(SIGINT, SIG_IGN);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    std::map<pid_t, int> status_fds;
+    while (true) {
+        struct pollfd fds[2] = {{sock, POLLIN, 0}, {sigchld_pipe[0], POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            reapChildren(status_fds);
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            uint32_t length;
+            if (!readFully(sock, reinterpret_cast<char*>(&length), sizeof(length))) {
+                break;  // GUI exited or closed the socket
+            }
+            std::string request(length, '\0');
+            if (!readFully(sock, &request[0], length)) {
+                break;
+            }
+            handleSpawnRequest(sock, request, status_fds);
+        }
+    }
+
+    // Children outlive us; their status fds just close
+    _exit(0);
+}
+
+} // namespace
+
+// ---- Client side ----
+
+ProcessSpawner& ProcessSpawner::getInstance() {
+    static ProcessSpawner instance;
+    return instance;
+}
+
+ProcessSpawner::ProcessSpawner() {
+    // A child that exits before reading its stdin must not kill us with SIGPIPE;
+    // children get the default disposition back before exec.
+    ::signal(SIGPIPE, SIG_IGN);
+}
+
+ProcessSpawner::~ProcessSpawner() {
+    stopForkServer();
+}
+
+bool ProcessSpawner::startForkServer() {
+    std::lock_guard<std::mutex> lock(server_mutex_);
+    if (server_fd_ >= 0) {
+        return true;
+    }
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return false;
+    }
+
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        ::close(fds[0]);
+        runForkServer(fds[1]);
+    }
+
+    ::close(fds[1]);
+    server_fd_ = fds[0];
+    server_pid_ = pid;
+    return true;
+}
+
+void ProcessSpawner::stopForkServer() {
+    std::lock_guard<std::mutex> lock(server_mutex_);
+    closeFd(server_fd_);
+    if (server_pid_ > 0) {
+        while (::waitpid(server_pid_, nullptr, 0) < 0 && errno == EINTR) {}
+        server_pid_ = -1;
+    }
+}
+
+bool ProcessSpawner::spawn(const std::vector<std::string>& argv, ChildProcess& child,
+                           const std::vector<std::string>& env) {
+    if (argv.empty()) {
+        return false;
+    }
+    if (server_fd_ >= 0 && spawnViaServer(argv, env, child)) {
+        return true;
+    }
+    return spawnLocally(argv, env, child);
+}
+
+bool ProcessSpawner::spawnViaServer(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                                    ChildProcess& child) {
+    char cwd[PATH_MAX];
+    std::string request = ::getcwd(cwd, sizeof(cwd)) ? cwd : "";
+    request += '\0';
+    request += std::to_string(argv.size());
+    request += '\0';
+    for (const auto* list : {&argv, &env}) {
+        for (const auto& field : *list) {
+            request += field;
+            request += '\0';
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(server_mutex_);
+    if (server_fd_ < 0) {
+        return false;
+    }
+
+    uint32_t length = static_cast<uint32_t>(request.size());
+    SpawnReply reply{};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * REPLY_FDS)];
+    struct iovec iov {&reply, sizeof(reply)};
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got = -1;
+    if (writeFully(server_fd_, reinterpret_cast<const char*>(&length), sizeof(length)) &&
+        writeFully(server_fd_, request.data(), request.size())) {
+        while ((got = ::recvmsg(server_fd_, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {}
+    }
+    if (got != static_cast<ssize_t>(sizeof(reply))) {
+        // The helper is gone; fall back to in-process spawning from now on
+        closeFd(server_fd_);
+        return false;
+    }
+    if (reply.pid <= 0) {
+        errno = reply.error;
+        return false;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * REPLY_FDS)) {
+        return false;
+    }
+    int fds[REPLY_FDS];
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    child.pid = reply.pid;
+    child.stdin_fd = fds[0];
+    child.stdout_fd = fds[1];
+    child.status_fd = fds[2];
+    return true;
+}
+
+bool ProcessSpawner::spawnLocally(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                                  ChildProcess& child) {
+    int in[2], out[2];
+    if (::pipe2(in, O_CLOEXEC) != 0) {
+        return false;
+    }
+    if (::pipe2(out, O_CLOEXEC) != 0) {
+        ::close(in[0]);
+        ::close(in[1]);
+        return false;
+    }
+
+    // posix_spawn uses vfork semantics, so this does not copy our page tables either
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults, none;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigemptyset(&none);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    // Our environment with the overrides replacing same-named entries
+    std::vector<char*> envp;
+    for (char** entry = environ; *entry; ++entry) {
+        const char* equals = std::strchr(*entry, '=');
+        size_t name_length = equals ? equals - *entry + 1 : std::strlen(*entry);
+        bool overridden = std::any_of(env.begin(), env.end(), [&](const std::string& override) {
+            return override.compare(0, name_length, *entry, name_length) == 0;
+        });
+        if (!overridden) {
+            envp.push_back(*entry);
+        }
+    }
+    for (const auto& entry : env) {
+        envp.push_back(const_cast<char*>(entry.c_str()));
+    }
+    envp.push_back(nullptr);
+
+    pid_t pid;
+    int rc = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    ::close(in[0]);
+    ::close(out[1]);
+    if (rc != 0) {
+        ::close(in[1]);
+        ::close(out[0]);
+        errno = rc;
+        return false;
+    }
+
+    child.pid = pid;
+    child.stdin_fd = in[1];
+    child.stdout_fd = out[0];
+    child.status_fd = -1;
+    return true;
+}
+
+// Nearest position at or before pos that does not split a UTF-8 sequence
+static size_t utf8Boundary(const std::string& text, size_t pos) {
+    while (pos > 0 && pos < text.size() && (text[pos] & 0xC0) == 0x80) {
+        pos--;
+    }
+    return pos;
+}
+
+// Length of text without a trailing, still incomplete, UTF-8 sequence
+static size_t utf8CompletePrefix(const std::string& text) {
+    size_t start = text.size();
+    while (start > 0 && (text[start - 1] & 0xC0) == 0x80) {
+        start--;
+    }
+    if (start == 0) {
+        return text.size();
+    }
+    unsigned char lead = text[start - 1];
+    size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    return text.size() - (start - 1) < length ? start - 1 : text.size();
+}
+
+// Earliest stop sequence in output, searching only where a match could
+// involve bytes appended since the last call.
+static size_t findStopSequence(const std::string& output, size_t new_from,
+                               const std::vector<std::string>& stop_sequences) {
+    size_t found = std::string::npos;
+    for (const auto& stop : stop_sequences) {
+        if (stop.empty()) {
+            continue;
+        }
+        size_t from = new_from >= stop.size() - 1 ? new_from - (stop.size() - 1) : 0;
+        size_t at = output.find(stop, from);
+        if (at < found) {
+            found = at;
+        }
+    }
+    return found;
+}
+
+std::string ProcessSpawner::communicate(ChildProcess& child, const std::string& input,
+                                        const OutputLimits& limits, OutputEnd* end,
+                                        std::chrono::steady_clock::time_point* first_output,
+                                        const OutputCallback& on_output) {
+    std::string output;
+    size_t written = 0;
+    size_t delivered = 0;
+    OutputEnd result = OutputEnd::COMPLETE;
+
+    size_t holdback = 0;
+    for (const auto& stop : limits.stop_sequences) {
+        holdback = std::max(holdback, stop.empty() ? 0 : stop.size() - 1);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeout_ms);
+
+    if (input.empty()) {
+        closeFd(child.stdin_fd);
+    } else if (child.stdin_fd >= 0) {
+        ::fcntl(child.stdin_fd, F_SETFL, ::fcntl(child.stdin_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    char buffer[16384];
+    while (child.stdout_fd >= 0) {
+        // poll() skips negative fds, so a closed stdin or no cancel_fd never reports
+        struct pollfd fds[3] = {{child.stdout_fd, POLLIN, 0}, {child.stdin_fd, POLLOUT, 0},
+                                {limits.cancel_fd, POLLIN, 0}};
+        int wait_ms = -1;
+        if (limits.timeout_ms > 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                result = OutputEnd::TIMEOUT;
+                break;
+            }
+            wait_ms = static_cast<int>(left);
+        }
+        if (::poll(fds, 3, wait_ms) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[2].revents) {
+            result = OutputEnd::CANCELLED;
+            break;
+        }
+
+        if (fds[1].revents) {
+            ssize_t n = ::write(child.stdin_fd, input.data() + written, input.size() - written);
+            if (n > 0) {
+                written += n;
+            }
+            // Done, or the child closed its stdin (EPIPE) without reading it all
+            if (written == input.size() || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                closeFd(child.stdin_fd);
+            }
+        }
+
+        if (fds[0].revents) {
+            ssize_t n = ::read(child.stdout_fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                if (first_output && output.empty()) {
+                    *first_output = std::chrono::steady_clock::now();
+                }
+                size_t previous = output.size();
+                output.append(buffer, n);
+
+                size_t stop = findStopSequence(output, previous, limits.stop_sequences);
+                if (stop != std::string::npos && (limits.max_bytes == 0 || stop <= limits.max_bytes)) {
+                    output.resize(stop);
+                    result = OutputEnd::STOP_SEQUENCE;
+                    break;
+                }
+                if (limits.max_bytes > 0 && output.size() >= limits.max_bytes) {
+                    output.resize(utf8Boundary(output, limits.max_bytes));
+                    result = OutputEnd::BYTE_LIMIT;
+                    break;
+                }
+
+                if (on_output) {
+                    size_t safe = holdback == 0 ? utf8CompletePrefix(output)
+                                  : utf8Boundary(output, output.size() > holdback ? output.size() - holdback : 0);
+                    if (safe > delivered) {
+                        bool more = on_output(output.substr(delivered, safe - delivered));
+                        delivered = safe;
+                        if (!more) {
+                            result = OutputEnd::CANCELLED;
+                            break;
+                        }
+                    }
+                }
+            } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                closeFd(child.stdout_fd);
+            }
+        }
+    }
+
+    closeFd(child.stdin_fd);
+    if (result != OutputEnd::COMPLETE) {
+        closeFd(child.stdout_fd);
+    }
+    if (on_output && result != OutputEnd::CANCELLED && output.size() > delivered) {
+        on_output(output.substr(delivered));
+    }
+    if (end) {
+        *end = result;
+    }
+    return output;
+}
+
+bool ProcessSpawner::hasExited(const ChildProcess& child, int timeout_ms) {
+    if (child.status_fd >= 0) {
+        struct pollfd fd = {child.status_fd, POLLIN, 0};
+        return ::poll(&fd, 1, timeout_ms) > 0;
+    }
+
+    // Peek without reaping so wait() still gets the status
+    for (int waited = 0;; waited += 10) {
+        siginfo_t info{};
+        if (::waitid(P_PID, child.pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid == child.pid) {
+            return true;
+        }
+        if (waited >= timeout_ms) {
+            return false;
+        }
+        ::usleep(10000);
+    }
+}
+
+void ProcessSpawner::terminate(ChildProcess& child, int grace_ms) {
+    closeFd(child.stdin_fd);
+    closeFd(child.stdout_fd);
+    if (child.pid <= 0) {
+        return;
+    }
+    ::kill(child.pid, SIGTERM);
+    if (!hasExited(child, grace_ms)) {
+        ::kill(child.pid, SIGKILL);
+    }
+}
+
+int ProcessSpawner::wait(ChildProcess& child) {
+    closeFd(child.stdin_fd);
+    closeFd(child.stdout_fd);
+
+    int status = -1;
+    if (child.status_fd >= 0) {
+        if (!readFully(child.status_fd, reinterpret_cast<char*>(&status), sizeof(status))) {
+            status = -1;
+        }
+        closeFd(child.status_fd);
+    } else if (child.pid > 0) {
+        while (::waitpid(child.pid, &status, 0) < 0 && errno == EINTR) {}
+    }
+    child.pid = -1;
+    return status;
+}
@@ -0,0 +1,264 @@
+#include "profiler.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <gnu/libc-version.h>
+#endif
+
+namespace {
+
+// The calling thread's chunk in the current session. Plain thread_locals
+// in the executable live in static TLS, so the handler can use them.
+thread_local uint64_t tl_session = 0;
+thread_local size_t tl_chunk = 0;
+
+// Interrupted program counter, used to cut the handler's own frames
+uintptr_t interruptedPc(void* context) {
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    return static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    return static_cast<uintptr_t>(uc->uc_mcontext.pc);
+#else
+    (void)uc;
+    return 0;
+#endif
+}
+
+std::string symbolize(uintptr_t address) {
+    Dl_info info{};
+    if (dladdr(reinterpret_cast<void*>(address), &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+        return name;
+    }
+    std::ostringstream out;
+    if (info.dli_fname) {
+        std::string module = info.dli_fname;
+        out << module.substr(module.rfind('/') + 1) << "+0x" << std::hex
+            << address - reinterpret_cast<uintptr_t>(info.dli_fbase);
+    } else {
+        out << "0x" << std::hex << address;
+    }
+    return out.str();
+}
+
+} // namespace
+
+Profiler& Profiler::getInstance() {
+    static Profiler instance;
+    return instance;
+}
+
+bool Profiler::start(int hz) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (recording_) {
+        return false;
+    }
+    hz = std::clamp(hz, 1, 10000);
+
+    if (!arena_) {
+        // Untouched pages of the arena are never committed
+        arena_.reset(new uintptr_t[ARENA_WORDS]);
+        chunk_used_.reset(new std::atomic<size_t>[CHUNK_COUNT]);
+    }
+    for (size_t i = 0; i < CHUNK_COUNT; ++i) {
+        chunk_used_[i].store(0);
+    }
+    next_chunk_ = 0;
+    samples_ = 0;
+    dropped_ = 0;
+    session_++;
+
+    if (!handler_installed_) {
+        struct sigaction sa {};
+        sa.sa_sigaction = &Profiler::onSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        if (::sigaction(SIGPROF, &sa, nullptr) != 0) {
+            LOG_ERROR("Profiler: cannot install SIGPROF handler: " + std::string(strerror(errno)));
+            return false;
+        }
+        handler_installed_ = true;
+    }
+
+    // The first backtrace() loads the unwinder (dlopen of libgcc_s, malloc),
+    // which must not happen in the handler: do it here, before the timer is
+    // armed. After that, unwinding only reads memory on glibc 2.35+, which
+    // finds objects with the lock-free _dl_find_object; older versions take
+    // the loader lock and can deadlock if a sample lands inside dlopen.
+    void* warm[4];
+    backtrace(warm, 4);
+#ifdef __GLIBC__
+    if (::strverscmp(gnu_get_libc_version(), "2.35") < 0) {
+        LOG_WARNING("Profiler: glibc " + std::string(gnu_get_libc_version()) +
+                    " is older than 2.35; stack capture in the signal handler is not async-signal-safe");
+    }
+#endif
+
+    recording_ = true;
+    long interval_us = 1000000L / hz;
+    itimerval timer{};
+    timer.it_interval.tv_sec = interval_us / 1000000;
+    timer.it_interval.tv_usec = interval_us % 1000000;
+    timer.it_value = timer.it_interval;
+    if (::setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        recording_ = false;
+        LOG_ERROR("Profiler: cannot arm ITIMER_PROF: " + std::string(strerror(errno)));
+        return false;
+    }
+    LOG_INFO("Profiler started at " + std::to_string(hz) + " Hz");
+    return true;
+}
+
+void Profiler::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_) {
+        return;
+    }
+    itimerval off{};
+    ::setitimer(ITIMER_PROF, &off, nullptr);
+    recording_ = false;
+    // A handler that saw recording_ set has already counted itself
+    while (in_handler_.load() > 0) {
+        std::this_thread::yield();
+    }
+    LOG_INFO("Profiler stopped: " + std::to_string(samples_.load()) + " samples, " +
+             std::to_string(dropped_.load()) + " dropped");
+}
+
+void Profiler::onSignal(int, siginfo_t*, void* context) {
+    int saved_errno = errno;
+    Profiler& profiler = getInstance();
+    profiler.in_handler_.fetch_add(1);
+    if (profiler.recording_.load()) {
+        profiler.sample(context);
+    }
+    profiler.in_handler_.fetch_sub(1);
+    errno = saved_errno;
+}
+
+void Profiler::sample(void* context) {
+    // Handler frames come first: this function, onSignal and the signal
+    // trampoline, then the interrupted pc
+    constexpr int SKIP_LIMIT = 4;
+    void* frames[MAX_DEPTH + SKIP_LIMIT];
+    int depth = backtrace(frames, MAX_DEPTH + SKIP_LIMIT);
+    uintptr_t pc = interruptedPc(context);
+    int first = std::min(depth, 3);
+    for (int i = 0; i < std::min(depth, SKIP_LIMIT); ++i) {
+        if (reinterpret_cast<uintptr_t>(frames[i]) == pc) {
+            first = i;
+            break;
+        }
+    }
+    size_t count = static_cast<size_t>(std::min(depth - first, MAX_DEPTH));
+    if (count == 0) {
+        return;
+    }
+
+    uint64_t session = session_.load(std::memory_order_relaxed);
+    size_t used = tl_session == session ? chunk_used_[tl_chunk].load(std::memory_order_relaxed) : CHUNK_WORDS;
+    if (used + count + 1 > CHUNK_WORDS) {
+        size_t chunk = next_chunk_.fetch_add(1);
+        if (chunk >= CHUNK_COUNT) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        tl_session = session;
+        tl_chunk = chunk;
+        used = 0;
+    }
+
+    uintptr_t* out = &arena_[tl_chunk * CHUNK_WORDS + used];
+    out[0] = count;
+    for (size_t i = 0; i < count; ++i) {
+        out[1 + i] = reinterpret_cast<uintptr_t>(frames[first + i]);
+    }
+    chunk_used_[tl_chunk].store(used + count + 1, std::memory_order_release);
+    samples_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Profiler::foldedStacks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!arena_) {
+        return "";
+    }
+
+    // Identical stacks first, so each address is symbolized once
+    std::map<std::vector<uintptr_t>, size_t> stacks;
+    size_t chunks = std::min(next_chunk_.load(), CHUNK_COUNT);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        const uintptr_t* words = &arena_[chunk * CHUNK_WORDS];
+        size_t used = chunk_used_[chunk].load(std::memory_order_acquire);
+        for (size_t pos = 0; pos < used; pos += words[pos] + 1) {
+            std::vector<uintptr_t> stack(words + pos + 1, words + pos + 1 + words[pos]);
+            stacks[stack]++;
+        }
+    }
+
+    std::unordered_map<uintptr_t, std::string> names;
+    std::map<std::string, size_t> folded;
+    for (const auto& [stack, samples] : stacks) {
+        std::string line;
+        for (size_t i = stack.size(); i-- > 0;) {
+            // Callers' entries are return addresses; look up the call itself
+            uintptr_t address = i == 0 ? stack[i] : stack[i] - 1;
+            auto it = names.find(address);
+            if (it == names.end()) {
+                std::string name = symbolize(address);
+                std::replace(name.begin(), name.end(), ';', ':');
+                std::replace(name.begin(), name.end(), '\n', ' ');
+                it = names.emplace(address, std::move(name)).first;
+            }
+            if (!line.empty()) {
+                line += ';';
+            }
+            line += it->second;
+        }
+        folded[line] += samples;
+    }
+
+    std::vector<std::pair<std::string, size_t>> ordered(folded.begin(), folded.end());
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::string result;
+    for (const auto& [line, samples] : ordered) {
+        result += line + " " + std::to_string(samples) + "\n";
+    }
+    return result;
+}
+
+bool Profiler::writeFolded(const std::string& path) const {
+    std::ofstream out(path);
+    out << foldedStacks();
+    if (!out) {
+        LOG_ERROR("Profiler: cannot write " + path);
+        return false;
+    }
+    LOG_INFO("Profile written to " + path);
+    return true;
+}
+
+std::string Profiler::defaultOutputPath() {
+    return "claude_agent_profile_" + std::to_string(::getpid()) + "_" +
+           std::to_string(static_cast<long long>(std::time(nullptr))) + ".folded";
+}
@@ -0,0 +1,489 @@
+#include "syntax_highlighter.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <unordered_map>
+
+namespace highlight {
+
+namespace {
+
+// Byte classes, looked up once per byte. Bytes of multi-byte UTF-8
+// sequences count as identifier characters so non-ASCII names stay whole.
+enum CharClass : uint8_t { SPACE = 1, DIGIT = 2, IDENT_START = 4, IDENT = 8 };
+
+struct CharTable {
+    uint8_t classes[256] = {};
+
+    CharTable() {
+        for (int c = 0; c < 256; ++c) {
+            uint8_t cls = 0;
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v') {
+                cls |= SPACE;
+            }
+            if (c >= '0' && c <= '9') {
+                cls |= DIGIT | IDENT;
+            }
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80) {
+                cls |= IDENT_START | IDENT;
+            }
+            classes[c] = cls;
+        }
+    }
+
+    bool is(char c, uint8_t cls) const { return classes[static_cast<unsigned char>(c)] & cls; }
+};
+
+const CharTable CHARS;
+
+// Everything the generic scanner needs to know about a language
+struct Language {
+    std::vector<std::string> aliases;
+    std::unordered_map<std::string, TokenKind> words;
+    std::string line_comment;
+    std::string block_open;
+    std::string block_close;
+    std::string quotes;
+    std::string prefix_chars;           // string prefixes, e.g. r"" b"" in Python
+    bool comment_at_word_start = false; // shell: '#' must follow whitespace
+    bool multiline_strings = false;
+    bool raw_single_quotes = false;     // shell: no escapes in '...'
+    bool triple_quotes = false;         // Python
+    bool raw_strings = false;           // C++ R"delim(...)delim"
+    bool digit_separators = false;      // C++ 1'000'000
+    bool directives = false;            // C preprocessor
+    bool decorators = false;            // Python @name
+    bool variables = false;             // shell $name ${...}
+    bool keys = false;                  // JSON object keys
+};
+
+void addWords(Language& language, const char* list, TokenKind kind) {
+    std::istringstream words(list);
+    std::string word;
+    while (words >> word) {
+        language.words[word] = kind;
+    }
+}
+
+void addAliases(Language& language, const char* list) {
+    std::istringstream aliases(list);
+    std::string alias;
+    while (aliases >> alias) {
+        language.aliases.push_back(alias);
+    }
+}
+
+std::vector<Language> buildLanguages() {
+    std::vector<Language> table;
+
+    Language cpp;
+    addAliases(cpp, "c c++ cpp cxx cc h hpp hxx hh");
+    addWords(cpp, "alignas alignof asm auto break case catch class co_await co_return co_yield concept const "
+                  "consteval constexpr constinit const_cast continue decltype default delete do dynamic_cast "
+                  "else enum explicit export extern final for friend goto if inline mutable namespace new "
+                  "noexcept operator override private protected public register reinterpret_cast requires "
+                  "return sizeof static static_assert static_cast struct switch template this thread_local "
+                  "throw try typedef typeid typename union using virtual volatile while",
+             TokenKind::KEYWORD);
+    addWords(cpp, "bool char char8_t char16_t char32_t double float int long short signed unsigned void "
+                  "wchar_t size_t ssize_t ptrdiff_t intptr_t uintptr_t int8_t int16_t int32_t int64_t "
+                  "uint8_t uint16_t uint32_t uint64_t",
+             TokenKind::TYPE);
+    addWords(cpp, "true false nullptr NULL", TokenKind::LITERAL);
+    cpp.line_comment = "//";
+    cpp.block_open = "/*";
+    cpp.block_close = "*/";
+    cpp.quotes = "\"'";
+    cpp.prefix_chars = "LuU8";
+    cpp.raw_strings = true;
+    cpp.digit_separators = true;
+    cpp.directives = true;
+    table.push_back(std::move(cpp));
+
+    Language python;
+    addAliases(python, "python py python3 py3");
+    addWords(python, "and as assert async await break case class continue def del elif else except finally "
+                     "for from global if import in is lambda match nonlocal not or pass raise return try "
+                     "while with yield",
+             TokenKind::KEYWORD);
+    addWords(python, "bool bytearray bytes complex dict float frozenset int list object range set str tuple "
+                     "type self cls",
+             TokenKind::TYPE);
+    addWords(python, "True False None", TokenKind::LITERAL);
+    python.line_comment = "#";
+    python.quotes = "\"'";
+    python.prefix_chars = "rRbBfFuU";
+    python.triple_quotes = true;
+    python.decorators = true;
+    table.push_back(std::move(python));
+
+    Language json;
+    addAliases(json, "json jsonl geojson");
+    addWords(json, "true false null", TokenKind::LITERAL);
+    json.quotes = "\"";
+    json.keys = true;
+    table.push_back(std::move(json));
+
+    Language shell;
+    addAliases(shell, "sh bash shell zsh ksh");
+    addWords(shell, "if then else elif fi case esac for select while until do done in function time "
+                    "return exit break continue local export readonly declare typeset unset shift source",
+             TokenKind::KEYWORD);
+    addWords(shell, "alias cd echo eval exec printf pwd read set test trap ulimit umask wait", TokenKind::TYPE);
+    addWords(shell, "true false", TokenKind::LITERAL);
+    shell.line_comment = "#";
+    shell.quotes = "\"'`";
+    shell.comment_at_word_start = true;
+    shell.multiline_strings = true;
+    shell.raw_single_quotes = true;
+    shell.variables = true;
+    table.push_back(std::move(shell));
+
+    return table;
+}
+
+const Language* findLanguage(const std::string& name) {
+    static const std::vector<Language> languages = buildLanguages();
+    for (const auto& language : languages) {
+        if (std::find(language.aliases.begin(), language.aliases.end(), name) != language.aliases.end()) {
+            return &language;
+        }
+    }
+    return nullptr;
+}
+
+// Scans text[begin, end) with one language's rules, appending byte spans
+class Lexer {
+public:
+    Lexer(const Language& language, const std::string& text, size_t end, std::vector<TokenSpan>& out)
+        : lang_(language), text_(text), end_(end), out_(out) {}
+
+    void run(size_t begin) {
+        bool line_start = true;
+        size_t i = begin;
+        while (i < end_) {
+            char c = text_[i];
+            if (c == '\n') {
+                line_start = true;
+                ++i;
+                continue;
+            }
+            if (CHARS.is(c, SPACE)) {
+                ++i;
+                continue;
+            }
+            bool first_on_line = line_start;
+            line_start = false;
+
+            if (first_on_line && lang_.directives && c == '#') {
+                // Directives continue over backslash-newline
+                size_t j = lineEnd(i);
+                while (j < end_ && text_[j - 1] == '\\') {
+                    j = lineEnd(j + 1);
+                }
+                i = emit(i, j, TokenKind::PREPROCESSOR);
+            } else if (first_on_line && lang_.decorators && c == '@') {
+                size_t j = i + 1;
+                while (j < end_ && (CHARS.is(text_[j], IDENT) || text_[j] == '.')) {
+                    ++j;
+                }
+                i = emit(i, j, TokenKind::PREPROCESSOR);
+            } else if (startsWith(i, lang_.line_comment) &&
+                       (!lang_.comment_at_word_start || i == 0 || CHARS.is(text_[i - 1], SPACE))) {
+                i = emit(i, lineEnd(i), TokenKind::COMMENT);
+            } else if (startsWith(i, lang_.block_open)) {
+                size_t close = text_.find(lang_.block_close, i + lang_.block_open.size());
+                size_t j = close == std::string::npos || close >= end_ ? end_ : close + lang_.block_close.size();
+                i = emit(i, std::min(j, end_), TokenKind::COMMENT);
+            } else if (lang_.quotes.find(c) != std::string::npos) {
+                size_t j = quoted(i);
+                i = emit(i, j, lang_.keys && followedByColon(j) ? TokenKind::PROPERTY : TokenKind::STRING);
+            } else if (CHARS.is(c, DIGIT) || (c == '.' && i + 1 < end_ && CHARS.is(text_[i + 1], DIGIT))) {
+                i = emit(i, number(i), TokenKind::NUMBER);
+            } else if (lang_.variables && c == '$') {
+                i = variable(i);
+            } else if (CHARS.is(c, IDENT_START)) {
+                i = word(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    const Language& lang_;
+    const std::string& text_;
+    size_t end_;
+    std::vector<TokenSpan>& out_;
+
+    size_t emit(size_t begin, size_t end, TokenKind kind) {
+        if (end > begin) {
+            out_.push_back({begin, end, kind});
+        }
+        return end;
+    }
+
+    bool startsWith(size_t i, const std::string& token) const {
+        return !token.empty() && end_ - i >= token.size() && text_.compare(i, token.size(), token) == 0;
+    }
+
+    size_t lineEnd(size_t i) const {
+        size_t eol = text_.find('\n', i);
+        return eol == std::string::npos || eol > end_ ? end_ : eol;
+    }
+
+    size_t closing(size_t from, const std::string& token) const {
+        size_t found = text_.find(token, from);
+        return found == std::string::npos || found + token.size() > end_ ? end_ : found + token.size();
+    }
+
+    bool followedByColon(size_t i) const {
+        while (i < end_ && CHARS.is(text_[i], SPACE)) {
+            ++i;
+        }
+        return i < end_ && text_[i] == ':';
+    }
+
+    // String starting at the quote at i; returns the position after it
+    size_t quoted(size_t i) const {
+        if (lang_.triple_quotes && (startsWith(i, "\"\"\"") || startsWith(i, "'''"))) {
+            return closing(i + 3, text_.substr(i, 3));
+        }
+        char quote = text_[i];
+        bool escapes = !(lang_.raw_single_quotes && quote == '\'');
+        for (size_t j = i + 1; j < end_; ++j) {
+            char c = text_[j];
+            if (c == '\\' && escapes) {
+                ++j;
+            } else if (c == quote) {
+                return j + 1;
+            } else if (c == '\n' && !lang_.multiline_strings) {
+                return j;
+            }
+        }
+        return end_;
+    }
+
+    size_t number(size_t i) const {
+        size_t j = i + 1;
+        while (j < end_) {
+            char c = text_[j];
+            char previous = text_[j - 1];
+            if (CHARS.is(c, IDENT) || c == '.' || (c == '\'' && lang_.digit_separators)) {
+                ++j;
+            } else if ((c == '+' || c == '-') &&
+                       (previous == 'e' || previous == 'E' || previous == 'p' || previous == 'P')) {
+                ++j;
+            } else {
+                break;
+            }
+        }
+        return j;
+    }
+
+    size_t variable(size_t i) {
+        size_t j = i + 1;
+        if (j < end_ && text_[j] == '{') {
+            size_t close = text_.find('}', j);
+            j = close == std::string::npos || close >= lineEnd(j) ? lineEnd(j) : close + 1;
+        } else if (j < end_ && CHARS.is(text_[j], IDENT_START)) {
+            while (j < end_ && CHARS.is(text_[j], IDENT)) {
+                ++j;
+            }
+        } else if (j < end_ && (CHARS.is(text_[j], DIGIT) || std::string("@#?$!*-").find(text_[j]) != std::string::npos)) {
+            ++j;
+        } else {
+            return j;
+        }
+        return emit(i, j, TokenKind::VARIABLE);
+    }
+
+    size_t word(size_t i) {
+        size_t j = i + 1;
+        while (j < end_ && CHARS.is(text_[j], IDENT)) {
+            ++j;
+        }
+        size_t length = j - i;
+        bool before_quote = j < end_ && lang_.quotes.find(text_[j]) != std::string::npos;
+
+        // C++ raw string: R"delim( ... )delim", optionally with an encoding prefix
+        if (lang_.raw_strings && before_quote && text_[j] == '"' && text_[j - 1] == 'R' && length <= 3) {
+            size_t paren = text_.find('(', j + 1);
+            if (paren != std::string::npos && paren < lineEnd(j) && paren - j <= 17) {
+                std::string terminator = ")" + text_.substr(j + 1, paren - j - 1) + "\"";
+                return emit(i, closing(paren + 1, terminator), TokenKind::STRING);
+            }
+        }
+        // String prefixes such as L"", u8"", r'', rb"", f"""..."""
+        if (before_quote && length <= 2 &&
+            std::all_of(text_.begin() + static_cast<std::ptrdiff_t>(i), text_.begin() + static_cast<std::ptrdiff_t>(j),
+                        [this](char c) { return lang_.prefix_chars.find(c) != std::string::npos; })) {
+            return emit(i, quoted(j), TokenKind::STRING);
+        }
+
+        auto found = lang_.words.find(text_.substr(i, length));
+        if (found != lang_.words.end()) {
+            emit(i, j, found->second);
+        }
+        return j;
+    }
+};
+
+// Converts byte offsets to character offsets in one pass over the text
+void toCharOffsets(const std::string& text, std::vector<TokenSpan>& spans) {
+    std::vector<size_t*> offsets;
+    offsets.reserve(spans.size() * 2);
+    for (auto& span : spans) {
+        offsets.push_back(&span.begin);
+        offsets.push_back(&span.end);
+    }
+    std::sort(offsets.begin(), offsets.end(), [](const size_t* a, const size_t* b) { return *a < *b; });
+
+    size_t byte = 0;
+    size_t chars = 0;
+    for (size_t* offset : offsets) {
+        for (; byte < *offset; ++byte) {
+            if ((static_cast<unsigned char>(text[byte]) & 0xC0) != 0x80) {
+                ++chars;
+            }
+        }
+        *offset = chars;
+    }
+}
+
+} // namespace
+
+std::vector<CodeBlock> findCodeBlocks(const std::string& text) {
+    std::vector<CodeBlock> blocks;
+    CodeBlock current;
+    bool open = false;
+    char fence_char = 0;
+    size_t fence_length = 0;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) {
+            eol = text.size();
+        }
+        size_t next = eol < text.size() ? eol + 1 : eol;
+
+        // A fence is indented by at most three spaces
+        size_t i = pos;
+        while (i < eol && i - pos < 3 && text[i] == ' ') {
+            ++i;
+        }
+        char c = i < eol ? text[i] : '\0';
+        size_t run = 0;
+        if (c == '`' || c == '~') {
+            while (i + run < eol && text[i + run] == c) {
+                ++run;
+            }
+        }
+        std::string rest = run >= 3 ? text.substr(i + run, eol - i - run) : std::string();
+        size_t first = rest.find_first_not_of(" \t\r");
+
+        if (!open && run >= 3 && !(c == '`' && rest.find('`') != std::string::npos)) {
+            open = true;
+            fence_char = c;
+            fence_length = run;
+            current.language.clear();
+            if (first != std::string::npos) {
+                size_t last = rest.find_first_of(" \t\r{,", first);
+                current.language = rest.substr(first, last == std::string::npos ? last : last - first);
+                std::transform(current.language.begin(), current.language.end(), current.language.begin(),
+                               [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+            }
+            current.begin = next;
+        } else if (open && c == fence_char && run >= fence_length && first == std::string::npos) {
+            current.end = pos;
+            blocks.push_back(current);
+            open = false;
+        }
+        pos = next;
+    }
+    if (open) {
+        current.end = text.size();
+        blocks.push_back(current);
+    }
+    return blocks;
+}
+
+bool isSupported(const std::string& language) {
+    return findLanguage(language) != nullptr;
+}
+
+std::vector<TokenSpan> highlight(const std::string& text) {
+    std::vector<TokenSpan> spans;
+    for (const auto& block : findCodeBlocks(text)) {
+        if (block.end <= block.begin) {
+            continue;
+        }
+        spans.push_back({block.begin, block.end, TokenKind::CODE_BLOCK});
+        if (const Language* language = findLanguage(block.language)) {
+            Lexer(*language, text, block.end, spans).run(block.begin);
+        }
+    }
+    toCharOffsets(text, spans);
+    return spans;
+}
+
+Worker::Worker(std::function<void()> on_ready, TaskScheduler& scheduler)
+    : on_ready_(std::move(on_ready))
+    , tasks_(scheduler) {}
+
+Worker::~Worker() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    jobs_.clear();
+    // tasks_ is destroyed first and waits for a drain still running
+}
+
+void Worker::submit(uint64_t id, std::string text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back({id, std::move(text)});
+    if (!draining_) {
+        draining_ = true;
+        tasks_.run([this] { drain(); }, TaskPriority::INTERACTIVE);
+    }
+}
+
+std::vector<Worker::Result> Worker::takeResults() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Result> results;
+    results.swap(results_);
+    return results;
+}
+
+void Worker::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+    results_.clear();
+    generation_++;
+}
+
+void Worker::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_ && !jobs_.empty()) {
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        uint64_t generation = generation_;
+
+        lock.unlock();
+        Result result{job.id, highlight(job.text)};
+        lock.lock();
+
+        if (generation != generation_) {
+            continue;
+        }
+        results_.push_back(std::move(result));
+        lock.unlock();
+        if (on_ready_) {
+            on_ready_();
+        }
+        lock.lock();
+    }
+    draining_ = false;
+}
+
+}
@@ -0,0 +1,250 @@
+#include "task_scheduler.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Worker identity of the calling thread, so tasks submitted from inside a
+// task go to the worker's own deque
+thread_local TaskScheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+
+constexpr size_t NO_WORKER = static_cast<size_t>(-1);
+
+// How long a worker waiting on a group sleeps between looking for work
+constexpr auto HELP_INTERVAL = std::chrono::microseconds(200);
+
+} // namespace
+
+TaskScheduler& TaskScheduler::getInstance() {
+    static TaskScheduler instance;
+    return instance;
+}
+
+TaskScheduler::TaskScheduler(size_t workers) {
+    if (workers == 0) {
+        workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    // All deques exist before any worker starts stealing
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        workers_[i]->thread = std::thread(&TaskScheduler::run, this, i);
+    }
+    LOG_DEBUG("Task scheduler started with " + std::to_string(workers) + " workers");
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void TaskScheduler::submit(Task task, TaskPriority priority) {
+    size_t lane = static_cast<size_t>(priority);
+    if (current_scheduler == this) {
+        Worker& worker = *workers_[current_worker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.lanes[lane].push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+        shared_lanes_[lane].push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+
+    // A worker going to sleep counts itself before checking queued_, so
+    // one of the two always sees the other
+    if (sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+bool TaskScheduler::runOne() {
+    Task task;
+    if (!take(current_scheduler == this ? current_worker : NO_WORKER, task)) {
+        return false;
+    }
+    execute(task);
+    return true;
+}
+
+void TaskScheduler::setMainWakeup(std::function<void()> wakeup) {
+    std::lock_guard<std::mutex> lock(main_mutex_);
+    main_wakeup_ = std::move(wakeup);
+}
+
+void TaskScheduler::postToMain(Task task) {
+    std::function<void()> wakeup;
+    {
+        std::lock_guard<std::mutex> lock(main_mutex_);
+        main_tasks_.push_back(std::move(task));
+        wakeup = main_wakeup_;
+    }
+    if (wakeup) {
+        wakeup();
+    }
+}
+
+size_t TaskScheduler::runMainTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(main_mutex_);
+        tasks.swap(main_tasks_);
+    }
+    for (auto& task : tasks) {
+        execute(task);
+    }
+    return tasks.size();
+}
+
+void TaskScheduler::run(size_t index) {
+    current_scheduler = this;
+    current_worker = index;
+    Task task;
+    for (;;) {
+        if (take(index, task)) {
+            execute(task);
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (stopping_) {
+            return;     // after draining what was queued
+        }
+        sleeping_.fetch_add(1);
+        wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        sleeping_.fetch_sub(1);
+    }
+}
+
+bool TaskScheduler::take(size_t self, Task& task) {
+    if (queued_.load() == 0) {
+        return false;
+    }
+    for (size_t lane = 0; lane < TASK_PRIORITY_COUNT; ++lane) {
+        if (self != NO_WORKER) {
+            Worker& own = *workers_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.lanes[lane].empty()) {
+                task = std::move(own.lanes[lane].back());
+                own.lanes[lane].pop_back();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(shared_mutex_);
+            if (!shared_lanes_[lane].empty()) {
+                task = std::move(shared_lanes_[lane].front());
+                shared_lanes_[lane].pop_front();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        // Steal the oldest task, starting after ourselves so thieves spread out
+        size_t count = workers_.size();
+        size_t start = self == NO_WORKER ? 0 : self + 1;
+        for (size_t i = 0; i < count; ++i) {
+            size_t victim = (start + i) % count;
+            if (victim == self) {
+                continue;
+            }
+            Worker& other = *workers_[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.lanes[lane].empty()) {
+                task = std::move(other.lanes[lane].front());
+                other.lanes[lane].pop_front();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::execute(Task& task) {
+    try {
+        task();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Unhandled exception in background task: " + std::string(e.what()));
+    } catch (...) {
+        LOG_ERROR("Unhandled exception in background task");
+    }
+}
+
+TaskGroup::TaskGroup(TaskScheduler& scheduler, CancellationToken token)
+    : scheduler_(scheduler)
+    , token_(std::move(token))
+    , state_(std::make_shared<State>()) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Reported only to callers of wait()
+    }
+}
+
+void TaskGroup::run(TaskScheduler::Task task, TaskPriority priority) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->pending++;
+    }
+    scheduler_.submit([state = state_, token = token_, task = std::move(task)]() {
+        if (!token.isCancelled()) {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (--state->pending == 0) {
+            state->done.notify_all();
+        }
+    }, priority);
+}
+
+void TaskGroup::wait() {
+    bool on_worker = current_scheduler == &scheduler_;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            if (state_->pending == 0) {
+                break;
+            }
+        }
+        if (scheduler_.runOne()) {
+            continue;
+        }
+        // Nothing to help with: the group's tasks are running elsewhere. A
+        // worker keeps looking, as its remaining tasks may be queued behind
+        // work it has to pick up itself.
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        if (on_worker) {
+            state_->done.wait_for(lock, HELP_INTERVAL, [this] { return state_->pending == 0; });
+        } else {
+            state_->done.wait(lock, [this] { return state_->pending == 0; });
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        std::swap(error, state_->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,154 @@
+#include "transcript_index.h"
+#include <algorithm>
+#include <string_view>
+
+namespace {
+
+// A match may start in one block and end in the next. Trigrams in the first
+// OVERLAP bytes of a block are also posted to the previous block, so every
+// match starting in a block has its first OVERLAP + 2 bytes of trigrams
+// posted there; queries filter on those trigrams only.
+constexpr size_t OVERLAP = 256;
+
+char fold(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool isLead(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+}
+
+uint32_t trigramAt(const std::string& text, size_t i) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8 |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[i + 2]));
+}
+
+} // namespace
+
+size_t TranscriptIndex::add(const std::string& text) {
+    size_t id = message_starts_.size();
+    message_starts_.push_back(text_.size());
+    message_chars_.push_back(chars_);
+
+    // The separator never matches (queries cannot contain NUL), so matches
+    // stay within one message
+    text_.reserve(text_.size() + text.size() + 1);
+    for (size_t i = 0; i <= text.size(); ++i) {
+        char c = i < text.size() ? fold(text[i]) : '\0';
+        if (text_.size() % BLOCK_SIZE == 0) {
+            block_chars_.push_back(chars_);
+        }
+        text_.push_back(c);
+        chars_ += isLead(c);
+    }
+
+    for (; indexed_ + 3 <= text_.size(); ++indexed_) {
+        if (text_[indexed_] == '\0' || text_[indexed_ + 1] == '\0' || text_[indexed_ + 2] == '\0') {
+            continue;
+        }
+        Postings& postings = trigrams_[trigramAt(text_, indexed_)];
+        int64_t block = static_cast<int64_t>(indexed_ / BLOCK_SIZE);
+        if (indexed_ % BLOCK_SIZE < OVERLAP && block > 0 && postings.last_block < block - 1) {
+            postings.blocks.add(static_cast<uint32_t>(block - 1));
+            postings.last_block = block - 1;
+        }
+        if (postings.last_block < block) {
+            postings.blocks.add(static_cast<uint32_t>(block));
+            postings.last_block = block;
+        }
+    }
+    return id;
+}
+
+void TranscriptIndex::clear() {
+    text_.clear();
+    text_.shrink_to_fit();
+    message_starts_.clear();
+    message_chars_.clear();
+    block_chars_.clear();
+    trigrams_.clear();
+    chars_ = 0;
+    indexed_ = 0;
+}
+
+void TranscriptIndex::scan(const std::string& query, size_t from, size_t to, size_t& next,
+                           std::vector<size_t>& hits, size_t limit) const {
+    // Occurrences starting in [from, to), not overlapping earlier hits
+    size_t pos = std::max(from, next);
+    size_t window_end = std::min(text_.size(), to + query.size() - 1);
+    std::string_view text(text_);
+    while (hits.size() < limit && pos < to) {
+        size_t found = text.substr(0, window_end).find(query, pos);
+        if (found == std::string_view::npos || found >= to) {
+            return;
+        }
+        hits.push_back(found);
+        pos = found + query.size();
+        next = pos;
+    }
+}
+
+std::vector<TranscriptIndex::Match> TranscriptIndex::find(const std::string& query, size_t limit) const {
+    std::vector<Match> matches;
+    if (query.empty() || limit == 0 || query.find('\0') != std::string::npos) {
+        return matches;
+    }
+    std::string folded(query);
+    std::transform(folded.begin(), folded.end(), folded.begin(), fold);
+
+    std::vector<size_t> hits;
+    size_t next = 0;
+    if (folded.size() < 3) {
+        scan(folded, 0, text_.size(), next, hits, limit);
+    } else {
+        std::vector<const Bitmap*> lists;
+        size_t last = std::min(folded.size() - 3, OVERLAP);
+        for (size_t i = 0; i <= last; ++i) {
+            auto it = trigrams_.find(trigramAt(folded, i));
+            if (it == trigrams_.end()) {
+                return matches;
+            }
+            lists.push_back(&it->second.blocks);
+        }
+        std::sort(lists.begin(), lists.end(), [](const Bitmap* a, const Bitmap* b) {
+            return a->cardinality() < b->cardinality();
+        });
+        lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+        Bitmap candidates = *lists[0];
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            candidates = candidates & *lists[i];
+        }
+        for (uint32_t block : candidates.toVector()) {
+            size_t from = static_cast<size_t>(block) * BLOCK_SIZE;
+            scan(folded, from, std::min(from + BLOCK_SIZE, text_.size()), next, hits, limit);
+            if (hits.size() >= limit) {
+                break;
+            }
+        }
+    }
+
+    // Byte positions to characters: from the block's count, walking forward
+    // while consecutive hits stay within a block
+    size_t length = static_cast<size_t>(std::count_if(folded.begin(), folded.end(), isLead));
+    size_t cursor = 0;
+    uint64_t cursor_chars = 0;
+    size_t message = 0;
+    matches.reserve(hits.size());
+    for (size_t pos : hits) {
+        size_t block_start = pos / BLOCK_SIZE * BLOCK_SIZE;
+        if (cursor < block_start || cursor > pos) {
+            cursor = block_start;
+            cursor_chars = block_chars_[pos / BLOCK_SIZE];
+        }
+        for (; cursor < pos; ++cursor) {
+            cursor_chars += isLead(text_[cursor]);
+        }
+        while (message + 1 < message_starts_.size() && message_starts_[message + 1] <= pos) {
+            ++message;
+        }
+        matches.push_back({message, static_cast<size_t>(cursor_chars - message_chars_[message]), length});
+    }
+    return matches;
+}
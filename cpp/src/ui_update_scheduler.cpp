@@ -0,0 +1,143 @@
+#include "ui_update_scheduler.h"
+
+UiUpdateScheduler::UiUpdateScheduler(Gtk::TextView& view)
+    : view_(view) {
+}
+
+UiUpdateScheduler::~UiUpdateScheduler() {
+    if (tick_id_ != 0) {
+        view_.remove_tick_callback(tick_id_);
+    }
+}
+
+void UiUpdateScheduler::append(const Glib::ustring& text, Placed placed) {
+    edits_.push_back({text, std::move(placed), nullptr});
+    schedule();
+}
+
+void UiUpdateScheduler::edit(std::function<void()> change) {
+    edits_.push_back({Glib::ustring(), nullptr, std::move(change)});
+    schedule();
+}
+
+void UiUpdateScheduler::applyTags(Glib::RefPtr<Gtk::TextMark> origin, std::vector<TagRange> ranges,
+                                  bool release_origin) {
+    tag_runs_.push_back({std::move(origin), std::move(ranges), release_origin});
+    schedule();
+}
+
+void UiUpdateScheduler::scrollToEnd() {
+    scroll_pending_ = true;
+    schedule();
+}
+
+void UiUpdateScheduler::flush() {
+    run(0);
+    if (idle() && tick_id_ != 0) {
+        view_.remove_tick_callback(tick_id_);
+        tick_id_ = 0;
+    }
+}
+
+void UiUpdateScheduler::cancel() {
+    auto buffer = view_.get_buffer();
+    for (const auto& run : tag_runs_) {
+        if (run.release_origin && !run.origin->get_deleted()) {
+            buffer->delete_mark(run.origin);
+        }
+    }
+    edits_.clear();
+    tag_runs_.clear();
+    scroll_pending_ = false;
+    if (tick_id_ != 0) {
+        view_.remove_tick_callback(tick_id_);
+        tick_id_ = 0;
+    }
+}
+
+void UiUpdateScheduler::schedule() {
+    if (tick_id_ == 0) {
+        tick_id_ = view_.add_tick_callback(sigc::mem_fun(*this, &UiUpdateScheduler::onTick));
+    }
+}
+
+bool UiUpdateScheduler::onTick(const Glib::RefPtr<Gdk::FrameClock>& /* clock */) {
+    run(TAG_BUDGET);
+    if (idle()) {
+        tick_id_ = 0;
+        return false;   // removes the callback until more work arrives
+    }
+    return true;
+}
+
+void UiUpdateScheduler::run(size_t tag_budget) {
+    auto buffer = view_.get_buffer();
+    buffer->begin_user_action();
+
+    if (!edits_.empty()) {
+        applyEdits(buffer);
+        if (after_edits_) {
+            after_edits_();
+        }
+    }
+
+    while (tag_budget > 0 && !tag_runs_.empty()) {
+        auto& run = tag_runs_.front();
+        if (!run.origin->get_deleted()) {
+            int base = run.origin->get_iter().get_offset();
+            for (; run.next < run.ranges.size() && tag_budget > 0; ++run.next, --tag_budget) {
+                const auto& range = run.ranges[run.next];
+                buffer->apply_tag(range.tag, buffer->get_iter_at_offset(base + range.begin),
+                                  buffer->get_iter_at_offset(base + range.end));
+            }
+            if (run.next < run.ranges.size()) {
+                break;
+            }
+            if (run.release_origin) {
+                buffer->delete_mark(run.origin);
+            }
+        }
+        tag_runs_.pop_front();
+    }
+
+    if (scroll_pending_) {
+        if (!end_mark_) {
+            end_mark_ = buffer->create_mark(buffer->end(), false);
+        }
+        view_.scroll_to(end_mark_);
+        scroll_pending_ = false;
+    }
+
+    buffer->end_user_action();
+}
+
+void UiUpdateScheduler::applyEdits(const Glib::RefPtr<Gtk::TextBuffer>& buffer) {
+    // Callbacks may queue further edits; they run in this frame too
+    while (!edits_.empty()) {
+        if (edits_.front().change) {
+            auto change = std::move(edits_.front().change);
+            edits_.pop_front();
+            change();
+            continue;
+        }
+
+        // Consecutive appends become one insert
+        Glib::ustring text;
+        std::vector<std::pair<int, Placed>> placements;
+        int start = buffer->end().get_offset();
+        int length = 0;
+        while (!edits_.empty() && !edits_.front().change) {
+            auto& edit = edits_.front();
+            if (edit.placed) {
+                placements.emplace_back(start + length, std::move(edit.placed));
+            }
+            length += static_cast<int>(edit.text.length());
+            text += edit.text;
+            edits_.pop_front();
+        }
+        buffer->insert(buffer->end(), text);
+        for (auto& [offset, placed] : placements) {
+            placed(offset);
+        }
+    }
+}
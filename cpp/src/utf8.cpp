@@ -0,0 +1,276 @@
+#include "utf8.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_HAVE_SSSE3 1
+#endif
+
+namespace utf8 {
+
+// Length of the sequence starting at data[i] if it is valid, 0 otherwise.
+static size_t sequenceLength(const unsigned char* data, size_t i, size_t size) {
+    unsigned char lead = data[i];
+    if (lead < 0x80) {
+        return 1;
+    }
+
+    size_t length;
+    unsigned char min2 = 0x80, max2 = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) min2 = 0xA0;       // overlong
+        else if (lead == 0xED) max2 = 0x9F;  // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) min2 = 0x90;       // overlong
+        else if (lead == 0xF4) max2 = 0x8F;  // above U+10FFFF
+    } else {
+        return 0;
+    }
+
+    if (i + length > size) {
+        return 0;
+    }
+    if (data[i + 1] < min2 || data[i + 1] > max2) {
+        return 0;
+    }
+    for (size_t k = 2; k < length; ++k) {
+        if ((data[i + k] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+size_t findInvalid(const char* data, size_t size) {
+    auto bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < size) {
+        // Skip ASCII eight bytes at a time
+        if (i + 8 <= size) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        size_t length = sequenceLength(bytes, i, size);
+        if (length == 0) {
+            return i;
+        }
+        i += length;
+    }
+    return size;
+}
+
+bool isValidScalar(const char* data, size_t size) {
+    return findInvalid(data, size) == size;
+}
+
+#ifdef UTF8_HAVE_SSSE3
+// Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+// Each byte pair (previous byte, current byte) is classified through three
+// nibble lookups whose AND is non-zero exactly for the invalid combinations;
+// 3- and 4-byte sequences are checked with shifted comparisons.
+namespace {
+
+constexpr uint8_t TOO_SHORT = 1 << 0;
+constexpr uint8_t TOO_LONG = 1 << 1;
+constexpr uint8_t OVERLONG_3 = 1 << 2;
+constexpr uint8_t TOO_LARGE = 1 << 3;
+constexpr uint8_t SURROGATE = 1 << 4;
+constexpr uint8_t OVERLONG_2 = 1 << 5;
+constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+constexpr uint8_t OVERLONG_4 = 1 << 6;
+constexpr uint8_t TWO_CONTS = 1 << 7;
+constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__attribute__((target("ssse3")))
+inline __m128i lookup(__m128i table, __m128i nibbles) {
+    return _mm_shuffle_epi8(table, nibbles);
+}
+
+__attribute__((target("ssse3")))
+inline __m128i checkSpecialCases(__m128i input, __m128i prev1) {
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        static_cast<char>(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+        static_cast<char>(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+        static_cast<char>(CARRY | OVERLONG_2),
+        static_cast<char>(CARRY),
+        static_cast<char>(CARRY),
+        static_cast<char>(CARRY | TOO_LARGE),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+        static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000));
+
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    __m128i prev1_high = _mm_and_si128(_mm_srli_epi16(prev1, 4), low_mask);
+    __m128i prev1_low = _mm_and_si128(prev1, low_mask);
+    __m128i input_high = _mm_and_si128(_mm_srli_epi16(input, 4), low_mask);
+
+    return _mm_and_si128(
+        _mm_and_si128(lookup(byte_1_high_table, prev1_high), lookup(byte_1_low_table, prev1_low)),
+        lookup(byte_2_high_table, input_high));
+}
+
+__attribute__((target("ssse3")))
+inline __m128i checkBlock(__m128i input, __m128i prev_input) {
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i special_cases = checkSpecialCases(input, prev1);
+
+    // Bytes two or three after a 3/4-byte lead must be continuations
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i is_third_byte = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m128i is_fourth_byte = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m128i must23_80 = _mm_and_si128(_mm_or_si128(is_third_byte, is_fourth_byte),
+                                      _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23_80, special_cases);
+}
+
+__attribute__((target("ssse3")))
+inline __m128i isIncomplete(__m128i input) {
+    // A lead byte in the last three positions needs bytes from the next block
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm_subs_epu8(input, max_value);
+}
+
+__attribute__((target("ssse3")))
+bool isValidSsse3(const char* data, size_t size) {
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            error = _mm_or_si128(error, checkBlock(input, prev_input));
+            prev_incomplete = isIncomplete(input);
+        }
+        prev_input = input;
+    }
+
+    // Zero-padded tail; the padding also exposes sequences cut off at the end
+    alignas(16) char tail[16] = {0};
+    std::memcpy(tail, data + i, size - i);
+    __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(tail));
+    error = _mm_or_si128(error, checkBlock(input, prev_input));
+    error = _mm_or_si128(error, isIncomplete(input));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+bool cpuHasSsse3() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+} // namespace
+#endif
+
+bool isValid(const char* data, size_t size) {
+#ifdef UTF8_HAVE_SSSE3
+    if (cpuHasSsse3()) {
+        return isValidSsse3(data, size);
+    }
+#endif
+    return isValidScalar(data, size);
+}
+
+const char* implementation() {
+#ifdef UTF8_HAVE_SSSE3
+    if (cpuHasSsse3()) {
+        return "ssse3";
+    }
+#endif
+    return "scalar";
+}
+
+std::string sanitize(const std::string& text) {
+    size_t bad = findInvalid(text.data(), text.size());
+    if (bad == text.size()) {
+        return text;
+    }
+
+    auto bytes = reinterpret_cast<const unsigned char*>(text.data());
+    std::string result;
+    result.reserve(text.size() + 16);
+    result.append(text, 0, bad);
+
+    size_t i = bad;
+    while (i < text.size()) {
+        size_t length = sequenceLength(bytes, i, text.size());
+        if (length == 0) {
+            result += "\xEF\xBF\xBD";
+            i++;
+            // Swallow the continuation bytes of the broken sequence
+            while (i < text.size() && (bytes[i] & 0xC0) == 0x80) {
+                i++;
+            }
+        } else {
+            result.append(text, i, length);
+            i += length;
+        }
+    }
+    return result;
+}
+
+void encode(uint32_t code_point, std::string& out) {
+    if (code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        code_point = 0xFFFD;
+    }
+
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+} // namespace utf8
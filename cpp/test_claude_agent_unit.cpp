@@ -8,13 +8,38 @@
 #include "claude_agent.h"
 #include "logger.h"
 #include "json_utils.h"
+#include "json_reader.h"
+#include "json_cbor.h"
+#include "blake3.h"
+#include "config_history.h"
+#include "facet_index.h"
+#include "config_resolver.h"
+#include "agent_view_model.h"
+#include "syntax_highlighter.h"
+#include "transcript_index.h"
+#include "outbound_queue.h"
+#include "task_scheduler.h"
+#include "profiler.h"
+#include "diagnostics.h"
+#include "context_controller.h"
+#include "utf8.h"
+#include "process_spawner.h"
+#include "context_dedup.h"
+#include "history_index.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <cassert>
+#include <cmath>
+#include <set>
 #include <sstream>
 #include <cstdlib>
 #include <functional>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Simple test framework
 class TestFramework {
@@ -218,6 +243,29 @@ public:
         const auto& cleared_history = agent.getConversationHistory();
         tf.assert_true(cleared_history.empty(), "Conversation history should be empty after clearing");
     }
+
+    static void test_output_limits_from_config(TestFramework& tf) {
+        ClaudeAgent agent("agent_config.json", CliProvider::AUTO);
+
+        agent.setConfig(json::parse(R"({"max_tokens": 100, "stop_sequences": ["\nUser:", ""]})"));
+        OutputLimits limits = agent.getOutputLimits();
+        tf.assert_true(limits.max_bytes == 100 * ClaudeAgent::APPROX_BYTES_PER_TOKEN, "max_tokens sets the byte budget");
+        tf.assert_true(limits.stop_sequences.size() == 1 && limits.stop_sequences[0] == "\nUser:",
+                       "Empty stop sequences are dropped");
+
+        agent.setConfig(json::parse(R"({"max_tokens": 100, "max_output_bytes": 50})"));
+        tf.assert_true(agent.getOutputLimits().max_bytes == 50, "max_output_bytes can tighten the budget");
+
+        agent.setConfig(json::parse(R"({"name": "No limits"})"));
+        tf.assert_true(agent.getOutputLimits().max_bytes == 0, "No budget without max_tokens");
+        tf.assert_true(agent.getOutputLimits().timeout_ms == ClaudeAgent::DEFAULT_TIMEOUT_SECONDS * 1000,
+                       "Default turn timeout");
+
+        agent.setConfig(json::parse(R"({"timeout_seconds": 1.5})"));
+        tf.assert_true(agent.getOutputLimits().timeout_ms == 1500, "timeout_seconds sets the timeout");
+        agent.setConfig(json::parse(R"({"timeout_seconds": 0})"));
+        tf.assert_true(agent.getOutputLimits().timeout_ms == 0, "timeout_seconds 0 waits as long as the CLI runs");
+    }
 };
 
 class TestLogger {
@@ -283,6 +331,87 @@ public:
 
         tf.assert_true(true, "All special logging methods should work");
     }
+
+    static int count_lines_containing(const std::string& filepath, const std::string& needle) {
+        std::ifstream file(filepath);
+        std::string line;
+        int count = 0;
+        while (std::getline(file, line)) {
+            if (line.find(needle) != std::string::npos) count++;
+        }
+        return count;
+    }
+
+    static void test_rate_limiting(TestFramework& tf) {
+        Logger& logger = Logger::getInstance();
+        std::string log_file = "/tmp/test_rate_limit_" + std::to_string(rand()) + ".log";
+        logger.setLogFile(log_file);
+        logger.setRateLimit(20.0, 3);
+
+        // Same template, different numbers: only the burst gets through
+        for (int i = 0; i < 50; ++i) {
+            LOG_ERROR_COMP("RateTest", "Command failed with status " + std::to_string(i));
+        }
+        tf.assert_equals(3, count_lines_containing(log_file, "Command failed with status"),
+                         "Only the burst should be written");
+
+        // A different template from the same component is limited separately
+        LOG_ERROR_COMP("RateTest", "Unrelated failure");
+        tf.assert_equals(1, count_lines_containing(log_file, "Unrelated failure"),
+                         "Other templates should not be affected");
+
+        // Once the bucket refills the next message carries a summary line
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        LOG_ERROR_COMP("RateTest", "Command failed with status 99");
+        tf.assert_equals(1, count_lines_containing(log_file, "Suppressed 47 similar messages"),
+                         "Summary line should report suppressed messages");
+
+        // More one-off templates than slots: later templates still get one
+        logger.enableConsoleOutput(false);
+        for (int i = 0; i < 2000; ++i) {
+            std::string letters;
+            for (int n = i; n > 0 || letters.empty(); n /= 26) letters += static_cast<char>('a' + n % 26);
+            LOG_ERROR_COMP("RateFlood", "One-off template " + letters);
+        }
+        for (int i = 0; i < 50; ++i) {
+            LOG_ERROR_COMP("RateTest", "Storm after the table filled up " + std::to_string(i));
+        }
+        logger.enableConsoleOutput(true);
+        tf.assert_equals(3, count_lines_containing(log_file, "Storm after the table filled up"),
+                         "Templates seen after the table fills should still be limited");
+
+        logger.setRateLimit(10.0, 20);
+        std::filesystem::remove(log_file);
+    }
+
+    static void test_debug_sampling(TestFramework& tf) {
+        Logger& logger = Logger::getInstance();
+        std::string log_file = "/tmp/test_debug_sampling_" + std::to_string(rand()) + ".log";
+        logger.setLogFile(log_file);
+        logger.setLogLevel(LogLevel::DEBUG);
+        logger.setRateLimit(1.0, 1);
+
+        logger.setDebugSampleRate(1.0);
+        for (int i = 0; i < 20; ++i) {
+            LOG_DEBUG_COMP("SampleTest", "Hot loop iteration " + std::to_string(i));
+        }
+        tf.assert_equals(20, count_lines_containing(log_file, "Hot loop iteration"),
+                         "Full sampling should keep every over-limit DEBUG line");
+
+        logger.setDebugSampleRate(0.0);
+        uint64_t before = logger.getSuppressedCount();
+        for (int i = 0; i < 20; ++i) {
+            LOG_DEBUG_COMP("SampleTest", "Hot loop iteration " + std::to_string(i));
+        }
+        tf.assert_equals(20, count_lines_containing(log_file, "Hot loop iteration"),
+                         "Zero sampling should drop over-limit DEBUG lines");
+        tf.assert_true(logger.getSuppressedCount() - before == 20, "Dropped lines should be counted");
+
+        logger.setDebugSampleRate(0.01);
+        logger.setRateLimit(10.0, 20);
+        logger.setLogLevel(LogLevel::WARNING);
+        std::filesystem::remove(log_file);
+    }
 };
 
 class TestJsonUtils {
@@ -330,6 +459,740 @@ public:
             tf.assert_true(true, "Exception is acceptable for nonexistent file");
         }
     }
+
+    static void test_stream_reader_chunked(TestFramework& tf) {
+        std::string document = R"({"name": "Streamed", "values": [1, -2.5, 3e2, true, false, null],
+                                   "nested": {"empty": {}, "list": [], "text": "a \"quoted\" word"}})";
+
+        // Feed one byte at a time to exercise every token boundary
+        json::StreamParser parser(false);
+        std::shared_ptr<json::Value> result;
+        for (char c : document) {
+            parser.feed(&c, 1);
+            if (!result) result = parser.nextDocument();
+        }
+        parser.finish();
+        if (!result) result = parser.nextDocument();
+
+        tf.assert_true(result != nullptr, "Chunked input should produce a document");
+        tf.assert_equals(json::parse(document)->toString(), result->toString(),
+                         "Chunked parse should match whole-document parse");
+    }
+
+    static void test_stream_reader_line_delimited(TestFramework& tf) {
+        json::StreamParser parser;
+        parser.feed("{\"type\": \"start\"}\n{\"type\": \"del");
+        auto first = parser.nextDocument();
+        tf.assert_true(first != nullptr, "First line should be complete");
+        tf.assert_equals("start", first->asObject().at("type")->asString(), "First document content");
+        tf.assert_true(parser.nextDocument() == nullptr, "Second line is still partial");
+
+        parser.feed("ta\", \"n\": 12");
+        tf.assert_true(parser.nextDocument() == nullptr, "Number may continue in the next chunk");
+        parser.feed("3}\n");
+        auto second = parser.nextDocument();
+        tf.assert_true(second != nullptr, "Second line should complete");
+        tf.assert_equals("delta", second->asObject().at("type")->asString(), "Split string should be joined");
+        tf.assert_equals(123, static_cast<int>(second->asObject().at("n")->asNumber()), "Split number should be joined");
+
+        parser.finish();
+        tf.assert_true(parser.nextDocument() == nullptr, "Stream should end cleanly");
+    }
+
+    static void test_stream_reader_events(TestFramework& tf) {
+        json::Reader reader;
+        json::Event event;
+        reader.feed("[[1,");
+        tf.assert_true(reader.next(event) == json::Reader::Status::EVENT && event.token == json::Token::START_ARRAY, "Outer array");
+        tf.assert_true(reader.next(event) == json::Reader::Status::EVENT && event.token == json::Token::START_ARRAY, "Inner array");
+        tf.assert_equals(2, static_cast<int>(reader.depth()), "Depth should track nesting");
+        tf.assert_true(reader.next(event) == json::Reader::Status::EVENT && event.token == json::Token::NUMBER, "Number");
+        tf.assert_true(reader.next(event) == json::Reader::Status::NEED_MORE, "Reader should wait for more input");
+
+        reader.feed("]");
+        reader.finish();
+        bool threw = false;
+        try {
+            while (reader.next(event) == json::Reader::Status::EVENT) {}
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        tf.assert_true(threw, "Malformed input should throw");
+    }
+
+    static void test_json_deep_nesting(TestFramework& tf) {
+        // Far deeper than any call stack would survive with a recursive parser
+        std::string hostile(100000, '[');
+        bool depth_error = false;
+        try {
+            json::parse(hostile);
+        } catch (const json::ParseError& e) {
+            depth_error = std::string(e.what()).find("depth") != std::string::npos;
+        }
+        tf.assert_true(depth_error, "Deep nesting should be rejected with a depth error");
+
+        json::ParseLimits limits;
+        limits.max_depth = 1000;
+        std::string nested = std::string(1000, '[') + std::string(1000, ']');
+        auto value = json::parse(nested, limits);
+        tf.assert_true(value && value->isArray(), "Nesting within the limit should parse");
+    }
+
+    static void test_json_error_positions(TestFramework& tf) {
+        try {
+            json::parse("{\n  \"name\": \"x\",\n  \"count\" 3\n}");
+            tf.assert_true(false, "Missing colon should throw");
+        } catch (const json::ParseError& e) {
+            tf.assert_equals(3, static_cast<int>(e.line()), "Error line");
+            tf.assert_equals(11, static_cast<int>(e.column()), "Error column");
+            tf.assert_equals("Expected ':'", e.message(), "Error message");
+        }
+
+        json::ParseLimits limits;
+        limits.max_string_length = 8;
+        bool string_error = false;
+        try {
+            json::parse("[\"this string is too long\"]", limits);
+        } catch (const json::ParseError& e) {
+            string_error = std::string(e.what()).find("maximum length") != std::string::npos;
+        }
+        tf.assert_true(string_error, "Over-long strings should be rejected");
+
+        bool trailing_error = false;
+        try {
+            json::parse("{} {}");
+        } catch (const json::ParseError&) {
+            trailing_error = true;
+        }
+        tf.assert_true(trailing_error, "Trailing data should be rejected");
+
+        limits = json::ParseLimits();
+        limits.max_size = 16;
+        bool size_error = false;
+        try {
+            json::parse("{\"name\": \"longer than sixteen bytes\"}", limits);
+        } catch (const json::ParseError& e) {
+            size_error = std::string(e.what()).find("maximum size") != std::string::npos;
+        }
+        tf.assert_true(size_error, "Documents over max_size should be rejected");
+
+        // A raised max_size applies from the start, past the default
+        limits = json::ParseLimits();
+        limits.max_size = limits.max_string_length = json::ParseLimits().max_size * 2;
+        std::string large = "[\"" + std::string(json::ParseLimits().max_size, 'a') + "\"]";
+        bool large_ok = false;
+        try {
+            large_ok = json::parse(large, limits)->asArray()[0]->asString().size() == json::ParseLimits().max_size &&
+                       json::extract(large, {json::Path("/0")}, limits)[0] != nullptr;
+        } catch (const json::ParseError&) {
+        }
+        tf.assert_true(large_ok, "Raised max_size should allow documents over the default");
+
+        // A borrowed buffer is read in place, strings included
+        std::string text = "[\"in place\"]";
+        json::Reader reader(text.data(), text.size());
+        json::Event event;
+        reader.next(event);
+        tf.assert_true(reader.next(event) == json::Reader::Status::EVENT && event.token == json::Token::STRING &&
+                       event.text == "in place",
+                       "Borrowed reader should read strings from the caller's buffer");
+    }
+
+    static void test_json_unicode_escapes(TestFramework& tf) {
+        auto value = json::parse(R"(["caf\u00e9", "\u20AC", "\ud83d\ude00", "\ud800x", "\u0041\u0000B"])");
+        const auto& items = value->asArray();
+        tf.assert_equals("caf\xc3\xa9", items[0]->asString(), "Two-byte escape");
+        tf.assert_equals("\xe2\x82\xac", items[1]->asString(), "Three-byte escape");
+        tf.assert_equals("\xf0\x9f\x98\x80", items[2]->asString(), "Surrogate pair");
+        tf.assert_equals("\xef\xbf\xbdx", items[3]->asString(), "Lone surrogate becomes U+FFFD");
+        tf.assert_equals(std::string("A\0B", 3), items[4]->asString(), "NUL escape");
+
+        // Surrogate pair split across chunks
+        json::StreamParser parser(false);
+        parser.feed("\"\\ud83d");
+        tf.assert_true(parser.nextDocument() == nullptr, "High surrogate waits for its pair");
+        parser.feed("\\ude00\"");
+        parser.finish();
+        auto split = parser.nextDocument();
+        tf.assert_true(split != nullptr, "Split pair should complete");
+        tf.assert_equals("\xf0\x9f\x98\x80", split->asString(), "Split surrogate pair");
+    }
+
+    static void test_json_strict_grammar(TestFramework& tf) {
+        std::vector<std::pair<std::string, std::string>> invalid = {
+            {R"(["\q"])", "Invalid escape"},
+            {"[\"tab\there\"]", "control character"},
+            {"[\"line\nbreak\"]", "control character"},
+            {"[01]", "Invalid number"},
+            {"[-01]", "Invalid number"},
+            {"[1.]", "Invalid number"},
+            {"[.5]", "Invalid JSON character"},
+            {"[1e]", "Invalid number"},
+            {"[1e+]", "Invalid number"},
+            {"[-]", "Invalid number"},
+            {"[1.5e3.2]", "Invalid number"},
+        };
+        for (const auto& [text, expected] : invalid) {
+            bool rejected = false;
+            try {
+                json::parse(text);
+            } catch (const json::ParseError& e) {
+                rejected = std::string(e.what()).find(expected) != std::string::npos;
+            }
+            tf.assert_true(rejected, "Should reject " + text);
+        }
+
+        auto numbers = json::parse("[0, -0, 0.5, 10, 1e3, 1E-2, -2.5e+1]")->asArray();
+        tf.assert_equals(7, static_cast<int>(numbers.size()), "Valid numbers should parse");
+        tf.assert_true(numbers[6]->asNumber() == -25.0, "Exponent with sign");
+        tf.assert_equals("a/b\t", json::parse(R"("a\/b\t")")->asString(), "Valid escapes still decode");
+    }
+
+    static void test_json_escape_on_write(TestFramework& tf) {
+        std::string tricky = "He said \"hi\"\n\tpath C:\\x \x01 \xc3\xa9";
+        auto obj = json::object();
+        std::static_pointer_cast<json::ObjectValue>(obj)->set("key \"q\"", json::string(tricky));
+
+        std::string text = obj->toString();
+        tf.assert_true(text.find('\n') == std::string::npos, "Newlines should be escaped");
+        tf.assert_true(text.find("\\u0001") != std::string::npos, "Control characters should use \\u");
+
+        auto round_trip = json::parse(text);
+        tf.assert_equals(tricky, round_trip->asObject().at("key \"q\"")->asString(), "Value should round-trip");
+    }
+
+    static void test_utf8_validation(TestFramework& tf) {
+        std::vector<std::pair<std::string, bool>> cases = {
+            {"plain ascii text that is longer than one sixteen byte block", true},
+            {"Gr\xc3\xbc\xc3\x9f" "e \xd0\xbc\xd0\xb8\xd1\x80 \xe4\xb8\x96 \xf0\x9f\x8c\x8d", true},
+            {"overlong \xc0\xaf", false},
+            {"surrogate \xed\xa0\x80", false},
+            {"too large \xf4\x90\x80\x80", false},
+            {"truncated at the end of a long buffer \xe4\xb8", false},
+            {"stray continuation \x80 byte", false},
+        };
+        for (const auto& [text, valid] : cases) {
+            tf.assert_true(utf8::isValid(text) == valid, "SIMD validator: " + text);
+            tf.assert_true(utf8::isValidScalar(text.data(), text.size()) == valid, "Scalar validator: " + text);
+        }
+
+        tf.assert_equals("bad \xef\xbf\xbd here", utf8::sanitize("bad \xc0\xaf here"), "Sanitize replaces invalid bytes");
+
+        bool rejected = false;
+        try {
+            json::parse("{\"name\": \"\xff\xfe\"}");
+        } catch (const json::ParseError& e) {
+            rejected = std::string(e.what()).find("UTF-8") != std::string::npos;
+        }
+        tf.assert_true(rejected, "Invalid UTF-8 in a document should be rejected");
+    }
+
+    static void test_json_path(TestFramework& tf) {
+        auto doc = json::parse(R"({"name": "Agent", "conversation_starters": ["first", "second"],
+                                   "a/b": {"m~n": 7}, "nested": {"list": [{"id": 3}]}})");
+
+        tf.assert_equals("first", json::Path("/conversation_starters/0").getString(*doc, ""), "Array index step");
+        tf.assert_equals("Agent", json::Path("/name").getString(*doc, ""), "Object key step");
+        tf.assert_true(json::Path("/a~1b/m~0n").getNumber(*doc, 0) == 7, "Escaped tokens should resolve");
+        tf.assert_true(json::Path("/nested/list/0/id").getNumber(*doc, 0) == 3, "Deep path should resolve");
+        tf.assert_true(json::Path("/conversation_starters/2").evaluate(*doc) == nullptr, "Out of range index");
+        tf.assert_true(json::Path("/missing/key").evaluate(*doc) == nullptr, "Missing key");
+        tf.assert_equals("fallback", json::Path("/a~1b").getString(*doc, "fallback"), "Mistyped value uses fallback");
+        tf.assert_true(json::Path("").find(doc) == doc, "Empty pointer is the whole document");
+        tf.assert_true(json::Path("/nested/list").find(doc)->isArray(), "find shares the node");
+
+        bool rejected = false;
+        try {
+            json::Path("name");
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        tf.assert_true(rejected, "Pointer without leading slash should be rejected");
+    }
+
+    static void test_json_extract(TestFramework& tf) {
+        std::string text = R"({"instructions": "long \u00e9 text", "skip": [1, {"x": [true, null]}, "y"],
+                               "name": "Agent", "conversation_starters": ["first", {"k": 1}, "third"],
+                               "description": "Desc", "trailing": )";
+
+        std::vector<json::Path> paths = {json::Path("/name"), json::Path("/description"),
+                                         json::Path("/conversation_starters/2"), json::Path("/nope")};
+        auto values = json::extract(text + "null}", paths);
+        tf.assert_equals("Agent", values[0]->asString(), "Extract name");
+        tf.assert_equals("Desc", values[1]->asString(), "Extract description");
+        tf.assert_equals("third", values[2]->asString(), "Extract array element after skipped siblings");
+        tf.assert_true(values[3] == nullptr, "Missing path yields null");
+
+        // Stops once everything requested is found, before the truncated tail
+        auto early = json::extract(text, {json::Path("/name")});
+        tf.assert_equals("Agent", early[0]->asString(), "Extraction should stop early");
+
+        std::string complete = R"({"a": {"b": [1, 2, {"c": "deep"}]}, "d": 4})";
+        auto nested = json::extract(complete, {json::Path("/a"), json::Path("/a/b/2/c"), json::Path("/d")});
+        tf.assert_true(nested[0]->isObject(), "Prefix path is materialized");
+        tf.assert_equals("deep", nested[1]->asString(), "Path below a materialized value");
+        tf.assert_true(nested[2]->asNumber() == 4, "Sibling after materialized value");
+
+        json::Reader reader(complete.data(), complete.size());
+        json::Event event;
+        reader.next(event);  // {
+        reader.next(event);  // "a"
+        reader.skipValue(event);
+        tf.assert_true(event.token == json::Token::END_OBJECT && reader.depth() == 1, "skipValue skips a container");
+        reader.next(event);
+        tf.assert_equals("d", event.text, "Reader continues after skipped value");
+
+        // Escaped quotes and backslashes split across one-byte chunks
+        std::string escaped = R"({"s": "a\"b\\", "t": 1})";
+        json::Reader chunked;
+        size_t fed = 0;
+        auto pull = [&](auto method) {
+            json::Reader::Status status;
+            while ((status = (chunked.*method)(event)) == json::Reader::Status::NEED_MORE && fed < escaped.size()) {
+                chunked.feed(escaped.data() + fed++, 1);
+            }
+            return status;
+        };
+        pull(&json::Reader::next);       // {
+        pull(&json::Reader::next);       // "s"
+        pull(&json::Reader::skipValue);
+        pull(&json::Reader::next);
+        tf.assert_equals("t", event.text, "Chunked skip should find the closing quote");
+    }
+
+    static std::string bytes(std::initializer_list<int> values) {
+        std::string out;
+        for (int v : values) out += static_cast<char>(v);
+        return out;
+    }
+
+    static void test_cbor_encoding(TestFramework& tf) {
+        // RFC 8949 Appendix A vectors
+        tf.assert_true(json::toCbor(*json::number(100)) == bytes({0x18, 0x64}), "Small unsigned");
+        tf.assert_true(json::toCbor(*json::number(-1000)) == bytes({0x39, 0x03, 0xe7}), "Negative integer");
+        tf.assert_true(json::toCbor(*json::number(1.1)) ==
+                       bytes({0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}), "Float64");
+        tf.assert_true(json::toCbor(*json::parse(R"([1,[2,3]])")) == bytes({0x82, 0x01, 0x82, 0x02, 0x03}), "Arrays");
+        tf.assert_true(json::toCbor(*json::parse(R"({"a":1})")) == bytes({0xa1, 0x61, 0x61, 0x01}), "Maps");
+        std::string half = bytes({0xf9, 0x3c, 0x00});
+        tf.assert_true(json::fromCbor(half.data(), half.size())->asNumber() == 1.0, "Half floats decode");
+
+        std::string text = R"({"conversation_starters":["Hi","What's \"new\"?"],"flag":true,"n":-2.5,)"
+                           R"("name":"Grüße","nested":{"empty":[],"none":null,"obj":{}}})";
+        auto doc = json::parse(text);
+        std::string binary = json::toCbor(*doc);
+        tf.assert_true(binary.size() < text.size(), "Binary form should be smaller");
+        tf.assert_equals(doc->toString(), json::fromCbor(binary.data(), binary.size())->toString(), "DOM round trip");
+        tf.assert_equals(doc->toString(), json::cborToText(binary.data(), binary.size()), "Text conversion");
+        tf.assert_true(json::textToCbor(text) == binary, "textToCbor matches toCbor");
+    }
+
+    static std::string blake3Hex(const std::string& input, size_t piece) {
+        Blake3 hasher;
+        for (size_t offset = 0; offset < input.size(); offset += piece) {
+            hasher.update(input.data() + offset, std::min(piece, input.size() - offset));
+        }
+        uint8_t out[16];
+        hasher.finalize(out, sizeof(out));
+        char hex[33];
+        for (int i = 0; i < 16; ++i) snprintf(hex + 2 * i, 3, "%02x", out[i]);
+        return hex;
+    }
+
+    static void test_blake3(TestFramework& tf) {
+        // Official test vector inputs (byte i is i % 251), first 16 output bytes
+        auto input = [](size_t length) {
+            std::string text(length, '\0');
+            for (size_t i = 0; i < length; ++i) text[i] = static_cast<char>(i % 251);
+            return text;
+        };
+        const std::pair<size_t, const char*> vectors[] = {
+            {0, "af1349b9f5f9a1a6a0404dea36dcc949"},    {1, "2d3adedff11b61f14c886e35afa03673"},
+            {65, "de1e5fa0be70df6d2be8fffd0e99ceaa"},   {1024, "42214739f095a406f3fc83deb889744a"},
+            {1025, "d00278ae47eb27b34faecf67b4fe263f"}, {3073, "7124b49501012f81cc7f11ca069ec922"},
+            {8193, "bab6c09cb8ce8cf459261398d2e7aef3"}, {102400, "bc3e3d41a1146b069abffad3c0d44860"},
+        };
+        for (const auto& [length, expected] : vectors) {
+            std::string data = input(length);
+            tf.assert_equals(expected, blake3Hex(data, length + 1), "BLAKE3 of " + std::to_string(length) + " bytes");
+            tf.assert_equals(expected, blake3Hex(data, 7), "Streaming BLAKE3 of " + std::to_string(length) + " bytes");
+        }
+    }
+
+    static void test_number_format(TestFramework& tf) {
+        const std::pair<double, const char*> cases[] = {
+            {0, "0"}, {-0.0, "0"}, {42, "42"}, {-7, "-7"}, {1.5, "1.5"}, {4294967296.0, "4294967296"},
+            {0.1 + 0.2, "0.30000000000000004"}, {3.141592653589793, "3.141592653589793"},
+            {1e20, "100000000000000000000"}, {1e21, "1e+21"}, {0.000001, "0.000001"}, {1e-7, "1e-7"},
+            {-1.25e-300, "-1.25e-300"}, {9007199254740993.0, "9007199254740992"},
+        };
+        for (const auto& [value, expected] : cases) {
+            tf.assert_equals(expected, json::number(value)->toString(), std::string("Number format for ") + expected);
+        }
+        tf.assert_equals("null", json::number(std::nan(""))->toString(), "NaN has no JSON form");
+        auto parsed = json::parse("[2.718281828459045,1E3,-0.0]");
+        tf.assert_equals("[2.718281828459045,1000,0]", parsed->toString(), "Parsed numbers round-trip");
+    }
+
+    static void test_json_hash(TestFramework& tf) {
+        auto a = json::parse(R"({ "b": 1.0, "a": [1, 2e0, "x\u0041"] })");
+        auto b = json::parse(R"({"a":[1,2,"xA"],"b":1})");
+        tf.assert_true(json::hash(*a) == json::hash(*b), "Equal content hashes equal");
+        tf.assert_equals(32, static_cast<int>(json::hash(*a).toHex().size()), "Hex digest is 128 bits");
+        tf.assert_true(json::hash(*json::parse(R"({"a":[1,2,"xA"],"b":2})")) != json::hash(*b), "Values change the hash");
+        tf.assert_true(json::hash(*json::parse(R"({"a":"1"})")) != json::hash(*json::parse(R"({"a":1})")),
+                       "Types change the hash");
+        tf.assert_true(json::hash(*json::parse(R"(["a,b"])")) != json::hash(*json::parse(R"(["a","b"])")),
+                       "Escaping keeps elements apart");
+
+        // A scalar's hash is the BLAKE3 of its canonical text
+        tf.assert_equals(blake3Hex("\"a\\\"b\\n\"", 64), json::hash(*json::string("a\"b\n")).toHex(),
+                         "Strings hash their quoted text");
+
+        // Cached hashes follow mutations, including of nested containers
+        std::string instructions(4096, 'i');
+        auto config = json::object();
+        auto starters = json::array();
+        std::static_pointer_cast<json::ObjectValue>(config)->set("instructions", json::string(instructions));
+        std::static_pointer_cast<json::ObjectValue>(config)->set("conversation_starters", starters);
+        json::Hash128 before = json::hash(*config);
+        tf.assert_true(json::hash(*config) == before, "Repeated hash is stable");
+        std::static_pointer_cast<json::ArrayValue>(starters)->push(json::string("Hello"));
+        json::Hash128 after = json::hash(*config);
+        tf.assert_true(after != before, "Nested push invalidates the cached hash");
+        auto reparsed = json::parse(config->toString());
+        tf.assert_true(json::hash(*reparsed) == after, "Hash matches a fresh parse of the same content");
+    }
+
+    static void test_cbor_view(TestFramework& tf) {
+        auto doc = json::parse(R"({"name":"Agent","conversation_starters":["one","two"],"memory":5})");
+        std::string path = "/tmp/test_cbor_" + std::to_string(rand()) + ".bin";
+        tf.assert_true(json::saveBinaryFile(path, *doc), "Binary file should be written");
+
+        {
+            json::MappedFile file(path);
+            auto view = json::CborView::open(file.data(), file.size());
+            tf.assert_true(view.getType() == json::Type::OBJECT && view.size() == 3, "Root is an object");
+
+            auto second = view.find(json::Path("/conversation_starters/1"));
+            tf.assert_equals("two", std::string(second.asString()), "Path lookup in place");
+            tf.assert_true(second.asString().data() >= file.data() &&
+                           second.asString().data() < file.data() + file.size(), "Strings are views into the file");
+            tf.assert_true(view.find("memory").asNumber() == 5, "Key lookup");
+            tf.assert_true(!view.find("missing").valid() && !view.find(json::Path("/name/0")).valid(), "Missing values");
+
+            // Accessors on a missing value must not dereference it
+            auto missing = view.find("missing");
+            tf.assert_true(missing.getType() == json::Type::NULL_VALUE && missing.size() == 0 &&
+                           !missing.at(0).valid() && !missing.find("x").valid(), "Accessors on a missing value");
+            bool number_error = false;
+            try {
+                missing.asNumber();
+            } catch (const std::runtime_error&) {
+                number_error = true;
+            }
+            tf.assert_true(number_error, "asNumber on a missing value throws");
+
+            size_t members = 0;
+            view.forEachMember([&](std::string_view, json::CborView) { return ++members < 2; });
+            tf.assert_true(members == 2, "forEachMember stops early");
+            tf.assert_equals(doc->toString(), view.materialize()->toString(), "Materialized view");
+        }
+        std::filesystem::remove(path);
+
+        std::vector<std::string> malformed = {
+            "", bytes({0x18}), bytes({0x82, 0x01}), bytes({0x01, 0x02}), bytes({0x9f, 0x01, 0xff}),
+            bytes({0x42, 0x00, 0x00}), bytes({0xa1, 0x01, 0x02}), bytes({0x9b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}),
+            bytes({0x62, 0xc0, 0xaf}), bytes({0xf7}),
+        };
+        for (const auto& input : malformed) {
+            bool rejected = false;
+            try {
+                json::CborView::open(input.data(), input.size());
+            } catch (const json::ParseError&) {
+                rejected = true;
+            }
+            tf.assert_true(rejected, "Malformed CBOR should be rejected (" + std::to_string(input.size()) + " bytes)");
+        }
+    }
+};
+
+class TestProcessSpawner {
+public:
+    static std::string run(const std::vector<std::string>& argv, const std::string& input, int& status) {
+        auto& spawner = ProcessSpawner::getInstance();
+        ChildProcess child;
+        if (!spawner.spawn(argv, child)) {
+            status = -1;
+            return "";
+        }
+        std::string output = spawner.communicate(child, input);
+        status = spawner.wait(child);
+        return output;
+    }
+
+    static void test_spawn_output_and_status(TestFramework& tf) {
+        tf.assert_true(ProcessSpawner::getInstance().usingForkServer(), "Fork server should be running");
+
+        int status;
+        tf.assert_equals("hello 'world'\n", run({"echo", "hello 'world'"}, "", status), "Arguments bypass the shell");
+        tf.assert_true(status == 0, "echo should succeed");
+
+        run({"sh", "-c", "exit 3"}, "", status);
+        tf.assert_true(WIFEXITED(status) && WEXITSTATUS(status) == 3, "Exit status should be reported");
+
+        run({"/nonexistent/binary"}, "", status);
+        tf.assert_true(status != 0, "Missing binary should fail");
+    }
+
+    static void test_spawn_large_stdin(TestFramework& tf) {
+        // Larger than any pipe buffer in both directions
+        std::string input(4 * 1024 * 1024, 'x');
+        int status;
+        std::string output = run({"cat"}, input, status);
+        tf.assert_true(status == 0 && output == input, "cat should echo 4MB without deadlocking");
+
+        // Child that never reads its stdin must not hang or kill us
+        run({"true"}, input, status);
+        tf.assert_true(status == 0, "Unread stdin should be tolerated");
+    }
+
+    static void test_output_limits(TestFramework& tf) {
+        auto& spawner = ProcessSpawner::getInstance();
+
+        // Endless output: the budget stops reading and the child is killed
+        ChildProcess child;
+        OutputLimits limits;
+        limits.max_bytes = 1000;
+        OutputEnd end;
+        tf.assert_true(spawner.spawn({"yes", "token"}, child), "yes should start");
+        std::string output = spawner.communicate(child, "", limits, &end);
+        spawner.terminate(child);
+        int status = spawner.wait(child);
+        tf.assert_true(end == OutputEnd::BYTE_LIMIT && output.size() == 1000, "Output should stop at the budget");
+        tf.assert_true(WIFSIGNALED(status), "Child should be terminated");
+
+        // Stop sequence split across writes, child would otherwise run for 30s
+        limits = OutputLimits();
+        limits.stop_sequences = {"STOP"};
+        auto start = std::chrono::steady_clock::now();
+        tf.assert_true(spawner.spawn({"sh", "-c", "printf 'answer ST'; sleep 0.1; printf 'OP tail'; exec sleep 30"}, child),
+                       "sh should start");
+        output = spawner.communicate(child, "", limits, &end);
+        spawner.terminate(child);
+        spawner.wait(child);
+        tf.assert_true(end == OutputEnd::STOP_SEQUENCE, "Stop sequence should end the output");
+        tf.assert_equals("answer ", output, "Output should be cut before the stop sequence");
+        tf.assert_true(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), "Turn should be cut short");
+
+        // Environment overrides reach the child
+        tf.assert_true(spawner.spawn({"sh", "-c", "printf \"$SPAWN_TEST\""}, child, {"SPAWN_TEST=visible"}), "sh should start");
+        output = spawner.communicate(child, "");
+        spawner.wait(child);
+        tf.assert_equals("visible", output, "Environment override");
+    }
+
+    static void test_streamed_output(TestFramework& tf) {
+        auto& spawner = ProcessSpawner::getInstance();
+        ChildProcess child;
+        OutputEnd end;
+        std::vector<std::string> chunks;
+        auto collect = [&chunks](const std::string& chunk) {
+            chunks.push_back(chunk);
+            return true;
+        };
+
+        // A stop sequence split across writes is never streamed, nor is half a character
+        OutputLimits limits;
+        limits.stop_sequences = {"STOP"};
+        tf.assert_true(spawner.spawn({"sh", "-c", "printf 'caf\303'; sleep 0.1; printf '\251 ST'; sleep 0.1; "
+                                                  "printf 'OP tail'"}, child), "sh should start");
+        std::string output = spawner.communicate(child, "", limits, &end, nullptr, collect);
+        spawner.terminate(child);
+        spawner.wait(child);
+        std::string streamed;
+        for (const auto& chunk : chunks) {
+            streamed += chunk;
+            tf.assert_true(utf8::isValid(chunk), "Chunks should be whole characters");
+        }
+        tf.assert_equals("caf\xC3\xA9 ", output, "Output cut before the stop sequence");
+        tf.assert_equals(output, streamed, "Streamed chunks add up to the output");
+        tf.assert_true(chunks.size() >= 2, "Output should arrive in several chunks");
+
+        // Returning false cancels the read
+        chunks.clear();
+        tf.assert_true(spawner.spawn({"yes", "token"}, child), "yes should start");
+        output = spawner.communicate(child, "", OutputLimits(), &end, nullptr,
+                                     [](const std::string&) { return false; });
+        spawner.terminate(child);
+        spawner.wait(child);
+        tf.assert_true(end == OutputEnd::CANCELLED, "Callback should cancel the read");
+
+        // A readable cancel_fd cancels a child that never writes
+        int cancel_pipe[2];
+        tf.assert_true(::pipe(cancel_pipe) == 0, "pipe should open");
+        limits = OutputLimits();
+        limits.cancel_fd = cancel_pipe[0];
+        auto cancelled_at = std::chrono::steady_clock::now();
+        tf.assert_true(spawner.spawn({"sleep", "30"}, child), "sleep should start");
+        std::thread canceller([&cancel_pipe]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            (void)!::write(cancel_pipe[1], "x", 1);
+        });
+        output = spawner.communicate(child, "", limits, &end);
+        canceller.join();
+        spawner.terminate(child);
+        spawner.wait(child);
+        ::close(cancel_pipe[0]);
+        ::close(cancel_pipe[1]);
+        tf.assert_true(end == OutputEnd::CANCELLED, "cancel_fd should cancel the read");
+        tf.assert_true(std::chrono::steady_clock::now() - cancelled_at < std::chrono::seconds(5),
+                       "cancel_fd should not wait for output");
+
+        // A silent child runs into the timeout
+        limits = OutputLimits();
+        limits.timeout_ms = 200;
+        auto start = std::chrono::steady_clock::now();
+        tf.assert_true(spawner.spawn({"sh", "-c", "printf partial; exec sleep 30"}, child), "sh should start");
+        output = spawner.communicate(child, "", limits, &end);
+        spawner.terminate(child);
+        spawner.wait(child);
+        tf.assert_true(end == OutputEnd::TIMEOUT, "Silent child should time out");
+        tf.assert_equals("partial", output, "Output before the timeout is kept");
+        tf.assert_true(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), "Timeout should cut the turn");
+    }
+
+    static void test_spawn_without_fork_server(TestFramework& tf) {
+        auto& spawner = ProcessSpawner::getInstance();
+        spawner.stopForkServer();
+        int status;
+        tf.assert_equals("local\n", run({"echo", "local"}, "", status), "posix_spawn fallback");
+        tf.assert_true(status == 0, "Fallback exit status");
+        test_output_limits(tf);
+        tf.assert_true(spawner.startForkServer(), "Fork server should restart");
+    }
+};
+
+class TestContextDedup {
+public:
+    static std::string make_paste(size_t lines) {
+        std::string text;
+        for (size_t i = 0; i < lines; ++i) {
+            text += "    at com.example.Service.handle(Service.java:" + std::to_string(i * 7 + 13) + ") frame " +
+                    std::to_string(i * i) + "\n";
+        }
+        return text;
+    }
+
+    static void test_chunking_is_content_defined(TestFramework& tf) {
+        std::string paste = make_paste(400);
+        std::string a = "Here is the trace:\n" + paste;
+        std::string b = "Same again, with a different and longer preamble in front of it:\n\n" + paste;
+
+        auto chunks_a = dedup::chunkBoundaries(a.data(), a.size());
+        auto chunks_b = dedup::chunkBoundaries(b.data(), b.size());
+        tf.assert_true(chunks_a.back() == a.size() && chunks_b.back() == b.size(), "Last boundary is the end");
+
+        // Boundaries resynchronize: measured from the end, most cut points agree
+        size_t shift = b.size() - a.size();
+        size_t shared = 0;
+        for (size_t cut : chunks_a) {
+            if (std::find(chunks_b.begin(), chunks_b.end(), cut + shift) != chunks_b.end()) shared++;
+        }
+        tf.assert_true(shared + 2 >= chunks_a.size(), "Cut points should not depend on the prefix");
+
+        std::string multibyte;
+        for (int i = 0; i < 3000; ++i) multibyte += "\xe4\xb8\x96";
+        for (size_t cut : dedup::chunkBoundaries(multibyte.data(), multibyte.size())) {
+            tf.assert_true(cut % 3 == 0, "Cut points should not split UTF-8 sequences");
+        }
+    }
+
+    static void test_repeated_paste_replaced(TestFramework& tf) {
+        std::string paste = make_paste(400);
+        std::vector<dedup::Segment> segments = {
+            {"the Human message of turn 1", "Why does this crash?\n" + paste},
+            {"the Assistant message of turn 1", "The service handler is missing a null check."},
+            {"the Human message of turn 2", "Still failing:\n" + paste + "\nAny idea?"},
+            {"the current message", "And once more " + paste},
+        };
+        size_t before = 0;
+        for (const auto& segment : segments) before += segment.text.size();
+
+        size_t saved = dedup::deduplicate(segments);
+        size_t after = 0;
+        for (const auto& segment : segments) after += segment.text.size();
+
+        tf.assert_true(before - after == saved, "Saved bytes should be reported");
+        tf.assert_true(after < before / 2, "Repeated pastes should shrink the context substantially");
+        tf.assert_true(segments[0].text.find(paste) != std::string::npos, "First copy is kept verbatim");
+        tf.assert_true(segments[2].text.find("identical to the text in the Human message of turn 1") != std::string::npos,
+                       "Later copy references the original");
+        tf.assert_true(segments[2].text.find("Any idea?") != std::string::npos, "Surrounding text is kept");
+        tf.assert_equals("The service handler is missing a null check.", segments[1].text, "Unique text unchanged");
+    }
+
+    static void test_small_repeats_untouched(TestFramework& tf) {
+        std::string line = "Please summarize the document in three bullet points.";
+        std::vector<dedup::Segment> segments = {{"the Human message of turn 1", line}, {"the current message", line}};
+        tf.assert_true(dedup::deduplicate(segments) == 0, "Short repeats are not replaced");
+        tf.assert_equals(line, segments[1].text, "Text should be unchanged");
+    }
+};
+
+class TestHistoryIndex {
+public:
+    static HistoryIndex make_history(size_t turns) {
+        HistoryIndex index;
+        const char* topics[] = {"weather forecast for the weekend", "pasta recipe with garlic",
+                                "football scores from last night", "holiday plans in the mountains"};
+        for (size_t i = 0; i < turns; ++i) {
+            if (i == 3) {
+                index.add("How do I configure a Kubernetes ingress controller with TLS certificates?\n"
+                          "Create an Ingress resource referencing a TLS secret.");
+            } else {
+                index.add("Tell me about " + std::string(topics[i % 4]) + " number " + std::to_string(i));
+            }
+        }
+        return index;
+    }
+
+    static void test_relevant_turn_selected(TestFramework& tf) {
+        HistoryIndex index = make_history(30);
+        auto turns = index.select("My ingress TLS certificate is not picked up", 5, 2, 100000);
+
+        tf.assert_true(turns.size() == 5, "Should fill the turn limit");
+        tf.assert_true(std::find(turns.begin(), turns.end(), 3) != turns.end(), "Relevant old turn is selected");
+        tf.assert_true(std::find(turns.begin(), turns.end(), 29) != turns.end() &&
+                       std::find(turns.begin(), turns.end(), 28) != turns.end(), "Recency tail is kept");
+        tf.assert_true(std::is_sorted(turns.begin(), turns.end()), "Turns are in chronological order");
+    }
+
+    static void test_fallback_and_budget(TestFramework& tf) {
+        HistoryIndex index = make_history(30);
+        auto turns = index.select("zzz unrelated", 5, 2, 100000);
+        tf.assert_true(turns == std::vector<size_t>({25, 26, 27, 28, 29}), "No match falls back to last-N");
+
+        auto small = index.select("ingress", 5, 2, 100);
+        tf.assert_true(small.size() < 5, "Byte budget limits the selection");
+
+        index.clear();
+        tf.assert_true(index.select("ingress", 5, 2, 100000).empty(), "Cleared index selects nothing");
+    }
+
+    static void test_selection_speed(TestFramework& tf) {
+        HistoryIndex index = make_history(5000);
+        const int rounds = 200;
+        auto start = std::chrono::steady_clock::now();
+        size_t found = 0;
+        for (int i = 0; i < rounds; ++i) {
+            found += index.select("kubernetes ingress weekend pasta recipe", 10, 2, 200000).size();
+        }
+        auto per_call = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count() / rounds;
+        tf.assert_true(found == rounds * 10u, "Selections should be full");
+        tf.assert_true(per_call < 5000, "Selection over 5000 turns took " + std::to_string(per_call) + " us");
+    }
 };
 
 class TestConfigLibrary {
@@ -365,8 +1228,1105 @@ public:
     }
 };
 
+class TestConfigHistory {
+public:
+    static std::shared_ptr<json::Value> makeConfig(const std::string& name, const std::string& instructions) {
+        auto config = json::parse(TestHelpers::create_valid_config());
+        auto& fields = static_cast<json::ObjectValue&>(*config);
+        fields.set("name", json::string(name));
+        fields.set("instructions", json::string(instructions));
+        return config;
+    }
+
+    static void test_versions_and_restore(TestFramework& tf) {
+        std::string dir = "/tmp/test_config_history_" + std::to_string(rand());
+        std::string instructions;
+        for (int i = 0; i < 2000; ++i) instructions += "Line " + std::to_string(i) + " of the instructions. ";
+
+        std::vector<std::shared_ptr<json::Value>> saved;
+        {
+            ConfigHistory history(dir);
+            // Autosave after each small edit: one word replaced, Unicode included
+            std::string text = instructions;
+            for (int i = 0; i < 40; ++i) {
+                text.replace(static_cast<size_t>(i) * 1000, 4, i % 2 ? "Zeile" : "Línea");
+                saved.push_back(makeConfig("Agent", text));
+                tf.assert_true(history.record("agent.json", *saved.back()), "Each edit records a version");
+            }
+            tf.assert_true(!history.record("agent.json", *saved.back()), "Unchanged content is not recorded");
+
+            size_t full = json::toCbor(*saved.back()).size();
+            tf.assert_true(history.packSize() < full * 3 / 2, "Deltas keep 40 versions near one snapshot (" +
+                           std::to_string(history.packSize()) + " bytes)");
+
+            // Saving earlier content again adds a log entry but no object
+            uint64_t before = history.packSize();
+            tf.assert_true(history.record("agent.json", *saved[3]), "Revert is a new version");
+            tf.assert_true(history.packSize() == before, "Identical content is stored once");
+        }
+
+        // A fresh instance reads everything back from disk
+        ConfigHistory history(dir);
+        auto versions = history.list("agent.json");
+        tf.assert_true(versions.size() == 41, "All versions listed");
+        tf.assert_true(versions.front().hash == json::hash(*saved[3]), "Newest first");
+        tf.assert_equals("Agent", versions.front().name, "Log keeps the agent name");
+        for (size_t i = 0; i < saved.size(); ++i) {
+            auto restored = history.load(json::hash(*saved[i]));
+            tf.assert_true(restored && restored->toString() == saved[i]->toString(),
+                           "Version " + std::to_string(i) + " restores exactly");
+        }
+        tf.assert_true(history.load(json::Hash128{1, 2}) == nullptr, "Unknown version");
+
+        // Same file name in another directory has its own log
+        history.record(dir + "/team/agent.json", *makeConfig("Team agent", "Other"));
+        tf.assert_true(history.list(dir + "/team/agent.json").size() == 1, "Separate history per path");
+        tf.assert_true(history.list("agent.json").size() == 41, "Original history untouched");
+
+        std::filesystem::remove_all(dir);
+    }
+
+    static void test_garbage_collection(TestFramework& tf) {
+        std::string dir = "/tmp/test_config_history_" + std::to_string(rand());
+        HistoryPolicy policy;
+        policy.max_versions = 8;
+        policy.min_versions = 2;
+        policy.max_chain = 4;
+
+        ConfigHistory history(dir, policy);
+        std::vector<std::shared_ptr<json::Value>> saved;
+        for (int i = 0; i < 30; ++i) {
+            saved.push_back(makeConfig("Agent " + std::to_string(i), std::string(3000, 'a' + i % 26)));
+            history.record("agent.json", *saved.back());
+            history.record("other.json", *makeConfig("Other", "Fixed"));
+        }
+
+        auto versions = history.list("agent.json");
+        tf.assert_true(versions.size() <= policy.max_versions + policy.max_versions / 4, "Log is trimmed");
+        tf.assert_true(history.list("other.json").size() == 1, "Other logs are kept");
+        for (const auto& version : versions) {
+            tf.assert_true(history.load(version.hash) != nullptr, "Retained versions stay loadable");
+        }
+        tf.assert_true(history.load(json::hash(*saved[0])) == nullptr, "Old versions are collected");
+
+        history.collectGarbage();
+        versions = history.list("agent.json");
+        tf.assert_true(versions.size() == policy.max_versions, "Explicit collection applies the limit");
+        tf.assert_equals("Agent 29", versions.front().name, "Newest kept");
+        tf.assert_true(history.collectGarbage() == 0, "Nothing left to collect");
+
+        // A torn append (crash mid-write) is dropped on the next open
+        {
+            std::ofstream pack(dir + "/objects.pack", std::ios::binary | std::ios::app);
+            pack.write("\x40\x00\x00\x00\xa1", 5);
+        }
+        ConfigHistory reopened(dir, policy);
+        tf.assert_true(reopened.load(versions.front().hash) != nullptr, "Intact records survive a torn tail");
+        tf.assert_true(reopened.record("agent.json", *makeConfig("After crash", "x")), "Appends continue");
+        tf.assert_true(ConfigHistory(dir, policy).list("agent.json").front().name == "After crash", "Append readable");
+
+        std::filesystem::remove_all(dir);
+    }
+};
+
+class TestFacetIndex {
+public:
+    static void test_bitmap_operations(TestFramework& tf) {
+        // Dense, sparse and mixed groups, checked against std::set
+        srand(7);
+        auto fill = [](Bitmap& bitmap, std::set<uint32_t>& reference, uint32_t base, size_t count, uint32_t spread) {
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t id = base + static_cast<uint32_t>(rand()) % spread;
+                bitmap.add(id);
+                reference.insert(id);
+            }
+        };
+        Bitmap a, b;
+        std::set<uint32_t> ra, rb;
+        fill(a, ra, 0, 20000, 65536);         // bitset group
+        fill(b, rb, 0, 1000, 65536);          // array group
+        fill(a, ra, 1u << 16, 300, 65536);    // array & array
+        fill(b, rb, 1u << 16, 500, 65536);
+        fill(a, ra, 5u << 16, 3000, 65536);   // union crosses the array limit
+        fill(b, rb, 5u << 16, 3000, 65536);
+        fill(b, rb, 9u << 16, 10, 100);       // only in b
+
+        tf.assert_true(a.cardinality() == ra.size() && b.cardinality() == rb.size(), "Cardinality");
+        tf.assert_true(a.contains(*ra.begin()) && !b.contains(8u << 16), "Membership");
+
+        std::vector<uint32_t> both, either;
+        std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(both));
+        std::set_union(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(either));
+        tf.assert_true((a & b).toVector() == both, "Intersection matches reference");
+        tf.assert_true((a | b).toVector() == either, "Union matches reference");
+        tf.assert_true(a.andCardinality(b) == both.size(), "Intersection count without materializing");
+        tf.assert_true(std::vector<uint32_t>(ra.begin(), ra.end()) == a.toVector(), "Ids come out sorted");
+    }
+
+    static void test_facet_queries(TestFramework& tf) {
+        // id: category, tags
+        FacetIndex index;
+        index.add(0, "category", "Coding");
+        index.add(0, "tags", "python");
+        index.add(0, "tags", "review");
+        index.add(1, "category", "Coding");
+        index.add(1, "tags", "cpp");
+        index.add(2, "category", "Writing");
+        index.add(2, "tags", "review");
+        index.addDocument(3);  // untagged
+
+        tf.assert_true(index.evaluate({}).cardinality() == 4, "No clauses match everything");
+        tf.assert_true(index.values("tags") == std::vector<std::string>({"cpp", "python", "review"}), "Sorted values");
+
+        FacetIndex::Clause any_tags{"tags", {"python", "cpp"}, false};
+        FacetIndex::Clause all_tags{"tags", {"python", "review"}, true};
+        FacetIndex::Clause coding{"category", {"Coding"}, false};
+        tf.assert_true(index.evaluate({any_tags}).toVector() == std::vector<uint32_t>({0, 1}), "OR within a facet");
+        tf.assert_true(index.evaluate({all_tags}).toVector() == std::vector<uint32_t>({0}), "AND within a facet");
+        FacetIndex::Clause review{"tags", {"review"}, false};
+        tf.assert_true(index.evaluate({coding, review}).toVector() == std::vector<uint32_t>({0}), "Facets combine with AND");
+        tf.assert_true(index.evaluate({FacetIndex::Clause{"tags", {"missing"}, false}}).empty(), "Unknown value");
+
+        Bitmap coding_docs = index.evaluate({coding});
+        tf.assert_true(index.count(coding_docs, "tags", "review") == 1, "Live count within the filter");
+        tf.assert_true(index.count(index.all(), "tags", "review") == 2, "Live count overall");
+    }
+};
+
+class TestConfigResolver {
+public:
+    static void writeConfig(const std::string& path, const std::string& content) {
+        std::ofstream file(path);
+        file << content;
+    }
+
+    static void test_inheritance_resolution(TestFramework& tf) {
+        std::string dir = "/tmp/test_config_resolver_" + std::to_string(rand());
+        std::filesystem::create_directories(dir + "/personas");
+        std::string instructions(20000, 'x');
+        writeConfig(dir + "/base.json", R"({"name": "Base", "description": "Shared base", "instructions": ")" +
+                    instructions + R"(", "conversation_starters": ["Hi"], "limits": {"max_files": 4, "max_lines": 100}})");
+        writeConfig(dir + "/personas/tutor.json", R"({"extends": "../base", "name": "Tutor",
+            "description": null, "limits": {"max_lines": 20}})");
+        writeConfig(dir + "/personas/strict_tutor.json", R"({"extends": "tutor.json",
+            "conversation_starters": ["Quiz me"]})");
+
+        ConfigResolver resolver;
+        auto base = resolver.resolve(dir + "/base.json");
+        auto tutor = resolver.resolve(dir + "/personas/tutor.json");
+        auto strict = resolver.resolve(dir + "/personas/strict_tutor.json");
+
+        static const json::Path name_path("/name");
+        static const json::Path max_files_path("/limits/max_files");
+        static const json::Path max_lines_path("/limits/max_lines");
+        tf.assert_equals("Tutor", name_path.getString(*tutor, ""), "Override replaces a field");
+        tf.assert_true(!json::Path("/description").evaluate(*tutor), "Null removes an inherited field");
+        tf.assert_true(max_files_path.getNumber(*tutor, 0) == 4 && max_lines_path.getNumber(*tutor, 0) == 20,
+                       "Nested objects merge field by field");
+        tf.assert_equals("Tutor", name_path.getString(*strict, ""), "Grandchild inherits through its parent");
+        tf.assert_equals("Quiz me", json::Path("/conversation_starters/0").getString(*strict, ""), "Grandchild override");
+        tf.assert_true(!json::Path("/extends").evaluate(*strict), "Resolved form has no extends");
+
+        // Inherited values are shared, not copied
+        auto shared = [](const std::shared_ptr<json::Value>& config) {
+            return static_cast<const json::ObjectValue&>(*config).get("instructions").get();
+        };
+        tf.assert_true(shared(base) == shared(tutor) && shared(tutor) == shared(strict), "Instructions stored once");
+        tf.assert_equals(dir + "/base.json", resolver.baseOf(dir + "/personas/tutor.json"), "Base path is canonical");
+
+        // Callers own the top level of what they get back
+        static_cast<json::ObjectValue&>(*tutor).set("name", json::string("Edited"));
+        tf.assert_equals("Tutor", name_path.getString(*resolver.resolve(dir + "/personas/tutor.json"), ""),
+                         "Editing a result leaves the cache intact");
+
+        writeConfig(dir + "/loop_a.json", R"({"extends": "loop_b"})");
+        writeConfig(dir + "/loop_b.json", R"({"extends": "loop_a"})");
+        writeConfig(dir + "/orphan.json", R"({"extends": "missing"})");
+        for (const char* name : {"/loop_a.json", "/orphan.json"}) {
+            bool threw = false;
+            try {
+                resolver.resolve(dir + name);
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            tf.assert_true(threw, std::string("Unresolvable config rejected: ") + name);
+        }
+
+        std::filesystem::remove_all(dir);
+    }
+
+    static void test_invalidation(TestFramework& tf) {
+        std::string dir = "/tmp/test_config_resolver_" + std::to_string(rand());
+        std::filesystem::create_directories(dir);
+        writeConfig(dir + "/base.json", R"({"name": "Base", "description": "", "conversation_starters": [],
+            "instructions": "Be brief."})");
+        writeConfig(dir + "/left.json", R"({"extends": "base", "name": "Left"})");
+        writeConfig(dir + "/right.json", R"({"extends": "base", "name": "Right"})");
+        writeConfig(dir + "/other.json", R"({"name": "Other"})");
+
+        ConfigResolver resolver;
+        for (const char* name : {"/left.json", "/right.json", "/other.json"}) {
+            resolver.resolve(dir + name);
+        }
+        tf.assert_true(resolver.resolutions() == 4, "Each config resolved once");
+        resolver.resolve(dir + "/left.json");
+        tf.assert_true(resolver.resolutions() == 4, "Repeat resolution is cached");
+
+        // A base edit re-resolves the base and its descendants, nothing else
+        writeConfig(dir + "/base.json", R"({"name": "Base", "description": "", "conversation_starters": [],
+            "instructions": "Be thorough."})");
+        auto right = resolver.resolve(dir + "/right.json");
+        tf.assert_equals("Be thorough.", json::Path("/instructions").getString(*right, ""), "Base edit is seen");
+        tf.assert_true(resolver.resolutions() == 6, "Base and edited descendant re-resolved");
+        resolver.resolve(dir + "/left.json");
+        resolver.resolve(dir + "/other.json");
+        tf.assert_true(resolver.resolutions() == 7, "Sibling re-resolved, unrelated config not");
+
+        // A leaf edit leaves its base cached
+        writeConfig(dir + "/left.json", R"({"extends": "base", "name": "Left"})");
+        resolver.invalidate(dir + "/left.json");
+        resolver.resolve(dir + "/left.json");
+        resolver.resolve(dir + "/right.json");
+        tf.assert_true(resolver.resolutions() == 8, "Only the edited leaf re-resolved");
+
+        // Saving stores the differences from the base
+        auto edited = resolver.resolve(dir + "/left.json");
+        static_cast<json::ObjectValue&>(*edited).set("description", json::string("Left-handed"));
+        auto stored = resolver.derive(dir + "/left.json", dir + "/base.json", edited);
+        tf.assert_equals(R"({"description":"Left-handed","extends":"base.json","name":"Left"})", stored->toString(),
+                         "Derived form holds only overrides");
+        tf.assert_true(resolver.derive(dir + "/base.json", dir + "/base.json", edited) == edited,
+                       "A config is not derived from itself");
+
+        // The agent loads derived configs resolved and saves them derived
+        {
+            ClaudeAgent agent(dir + "/left.json");
+            tf.assert_true(agent.loadConfigFromFile(dir + "/left.json"), "Agent loads a derived config");
+            tf.assert_equals("Be thorough.", agent.getInstructions(), "Agent sees inherited instructions");
+            agent.setName("Lefty");
+            tf.assert_true(agent.saveConfig(), "Agent saves a derived config");
+        }
+        auto saved = json::parseFromFile(dir + "/left.json");
+        tf.assert_equals(R"({"extends":"base.json","name":"Lefty"})", saved->toString(),
+                         "Saved file repeats nothing from the base");
+
+        std::filesystem::remove_all(dir);
+    }
+};
+
 // Main test runner
+class TestAgentViewModel {
+public:
+    static void test_property_changes(TestFramework& tf) {
+        Observable<std::string> name;
+        std::vector<std::string> seen;
+        name.observe([&seen](const std::string& value) { seen.push_back(value); });
+
+        tf.assert_true(name.set("Tutor"), "New value notifies");
+        tf.assert_true(!name.set("Tutor"), "Same value does not");
+        tf.assert_true(name.set("Coach"), "Changed value notifies");
+        tf.assert_true(seen == std::vector<std::string>({"Tutor", "Coach"}), "Observers see each change once");
+
+        // The view model forwards only what changed on the agent
+        ClaudeAgent agent;
+        AgentViewModel model;
+        int name_changes = 0, description_changes = 0, starter_changes = 0;
+        model.name().observe([&name_changes](const std::string&) { name_changes++; });
+        model.description().observe([&description_changes](const std::string&) { description_changes++; });
+        model.starters().observe([&starter_changes](const std::vector<ListChange<std::string>>&) { starter_changes++; });
+
+        model.update(agent);
+        model.update(agent);
+        tf.assert_true(name_changes == 1 && description_changes == 1, "Unchanged agent notifies nothing");
+
+        agent.setName(agent.getName() + " (edited)");
+        int starters_before = starter_changes;
+        model.update(agent);
+        tf.assert_true(name_changes == 2 && description_changes == 1 && starter_changes == starters_before,
+                       "Only the edited property notifies");
+        tf.assert_equals(agent.getName(), model.name().get(), "View model holds the new value");
+    }
+
+    static void test_list_diff(TestFramework& tf) {
+        using Kind = ListChange<std::string>::Kind;
+        auto apply = [](std::vector<std::string> items, const std::vector<ListChange<std::string>>& changes) {
+            for (const auto& change : changes) {
+                auto position = items.begin() + static_cast<std::ptrdiff_t>(change.index);
+                if (change.kind == Kind::INSERT) {
+                    items.insert(position, change.value);
+                } else if (change.kind == Kind::REMOVE) {
+                    items.erase(position);
+                } else {
+                    *position = change.value;
+                }
+            }
+            return items;
+        };
+
+        struct Case {
+            std::vector<std::string> from, to;
+            size_t steps;
+        };
+        std::vector<Case> cases = {
+            {{"a", "b", "c"}, {"a", "b", "c"}, 0},
+            {{"a", "b", "c"}, {"x", "a", "b", "c"}, 1},
+            {{"a", "b", "c"}, {"a", "c"}, 1},
+            {{"a", "b", "c"}, {"a", "B", "c"}, 1},
+            {{"a", "b", "c", "d"}, {"b", "c", "d", "e"}, 2},
+            {{}, {"a", "b"}, 2},
+            {{"a", "b"}, {}, 2},
+            {{"a", "b", "c"}, {"c", "b", "a"}, 2},
+        };
+        for (size_t i = 0; i < cases.size(); ++i) {
+            auto changes = ObservableList<std::string>::diff(cases[i].from, cases[i].to);
+            tf.assert_true(apply(cases[i].from, changes) == cases[i].to, "Edit script " + std::to_string(i) + " applies");
+            tf.assert_true(changes.size() == cases[i].steps, "Edit script " + std::to_string(i) + " is minimal");
+        }
+
+        // Random lists: the script always reproduces the target
+        srand(11);
+        for (int round = 0; round < 200; ++round) {
+            std::vector<std::string> from, to;
+            for (int k = rand() % 8; k > 0; --k) from.push_back(std::string(1, static_cast<char>('a' + rand() % 5)));
+            for (int k = rand() % 8; k > 0; --k) to.push_back(std::string(1, static_cast<char>('a' + rand() % 5)));
+            auto changes = ObservableList<std::string>::diff(from, to);
+            tf.assert_true(apply(from, changes) == to, "Random edit script applies");
+            tf.assert_true(changes.size() <= std::max(from.size(), to.size()), "Random edit script is bounded");
+        }
+
+        ObservableList<std::string> list;
+        size_t notified = 0;
+        list.observe([&notified](const std::vector<ListChange<std::string>>& changes) { notified += changes.size(); });
+        list.set({"a", "b"});
+        tf.assert_true(!list.set({"a", "b"}), "Same list does not notify");
+        list.set({"a", "c"});
+        tf.assert_true(notified == 3, "Observers receive the edit scripts");
+    }
+};
+
+class TestSyntaxHighlighter {
+public:
+    // Text of each span of a kind (ASCII input, so characters are bytes)
+    static std::vector<std::string> tokens(const std::string& text, highlight::TokenKind kind) {
+        std::vector<std::string> found;
+        for (const auto& span : highlight::highlight(text)) {
+            if (span.kind == kind) {
+                found.push_back(text.substr(span.begin, span.end - span.begin));
+            }
+        }
+        return found;
+    }
+
+    static void test_code_blocks(TestFramework& tf) {
+        std::string text = "Intro\n```Python title\nx = 1\n```\nMiddle\n  ~~~~\ncode\n~~~\nstill code\n~~~~\n"
+                           "``` inline ``` is not a fence\n```sh\necho open";
+        auto blocks = highlight::findCodeBlocks(text);
+        tf.assert_true(blocks.size() == 3, "Three fenced blocks");
+        tf.assert_equals("python", blocks[0].language, "Language is the lower-cased first word");
+        tf.assert_equals("x = 1\n", text.substr(blocks[0].begin, blocks[0].end - blocks[0].begin), "Block content");
+        tf.assert_equals("code\n~~~\nstill code\n", text.substr(blocks[1].begin, blocks[1].end - blocks[1].begin),
+                         "A shorter fence does not close a block");
+        tf.assert_equals("", blocks[1].language, "No info string");
+        tf.assert_equals("echo open", text.substr(blocks[2].begin), "Unclosed block runs to the end");
+        tf.assert_true(blocks[2].end == text.size(), "Unclosed block end");
+
+        tf.assert_true(highlight::isSupported("cpp") && highlight::isSupported("bash") &&
+                       highlight::isSupported("json") && !highlight::isSupported("haskell"),
+                       "Supported languages");
+
+        // Offsets are characters, so multi-byte text before a block shifts them
+        std::string unicode = "Größe:\n```json\n{\"ü\": true}\n```\n";
+        auto spans = highlight::highlight(unicode);
+        tf.assert_true(!spans.empty() && spans[0].kind == highlight::TokenKind::CODE_BLOCK, "Block span first");
+        tf.assert_true(spans[0].begin == 15, "Block offset counts characters");
+        bool literal_found = false;
+        for (const auto& span : spans) {
+            if (span.kind == highlight::TokenKind::LITERAL) {
+                literal_found = span.begin == 21 && span.end == 25;
+            }
+        }
+        tf.assert_true(literal_found, "Token offsets count characters");
+
+        auto plain = highlight::highlight("```haskell\nmain = print 1\n```\n");
+        tf.assert_true(plain.size() == 1, "Unsupported language gets the block span only");
+    }
+
+    static void test_lexers(TestFramework& tf) {
+        using highlight::TokenKind;
+        std::string cpp = "```cpp\n#include <vector>\n// note \"quoted\"\nstatic const char* s = R\"x(a)\" b)x\";\n"
+                          "int n = 1'000 + 0x1Fu + 2.5e-3; /* multi\nline */ return nullptr;\n```\n";
+        tf.assert_true(tokens(cpp, TokenKind::PREPROCESSOR) == std::vector<std::string>{"#include <vector>"}, "C directive");
+        tf.assert_true(tokens(cpp, TokenKind::COMMENT) ==
+                       std::vector<std::string>({"// note \"quoted\"", "/* multi\nline */"}), "C comments");
+        tf.assert_true(tokens(cpp, TokenKind::STRING) == std::vector<std::string>{"R\"x(a)\" b)x\""}, "C++ raw string");
+        tf.assert_true(tokens(cpp, TokenKind::NUMBER) == std::vector<std::string>({"1'000", "0x1Fu", "2.5e-3"}),
+                       "C numbers");
+        tf.assert_true(tokens(cpp, TokenKind::KEYWORD) == std::vector<std::string>({"static", "const", "return"}),
+                       "C keywords");
+        tf.assert_true(tokens(cpp, TokenKind::TYPE) == std::vector<std::string>({"char", "int"}), "C types");
+        tf.assert_true(tokens(cpp, TokenKind::LITERAL) == std::vector<std::string>{"nullptr"}, "C literals");
+
+        std::string python = "```py\n@app.route\ndef f(x):  # comment\n    s = rb'raw\\d' + \"\"\"doc\n'''\"\"\"\n"
+                             "    return None if x else 'done'\n```\n";
+        tf.assert_true(tokens(python, TokenKind::PREPROCESSOR) == std::vector<std::string>{"@app.route"}, "Decorator");
+        tf.assert_true(tokens(python, TokenKind::KEYWORD) ==
+                       std::vector<std::string>({"def", "return", "if", "else"}), "Python keywords");
+        tf.assert_true(tokens(python, TokenKind::STRING) ==
+                       std::vector<std::string>({"rb'raw\\d'", "\"\"\"doc\n'''\"\"\"", "'done'"}), "Python strings");
+        tf.assert_true(tokens(python, TokenKind::COMMENT) == std::vector<std::string>{"# comment"}, "Python comment");
+
+        std::string json = "```json\n{\"name\": \"x\", \"n\" : -1.5, \"ok\": [true, null]}\n```\n";
+        tf.assert_true(tokens(json, TokenKind::PROPERTY) ==
+                       std::vector<std::string>({"\"name\"", "\"n\"", "\"ok\""}), "JSON keys");
+        tf.assert_true(tokens(json, TokenKind::STRING) == std::vector<std::string>{"\"x\""}, "JSON strings");
+        tf.assert_true(tokens(json, TokenKind::NUMBER) == std::vector<std::string>{"1.5"}, "JSON numbers");
+        tf.assert_true(tokens(json, TokenKind::LITERAL) == std::vector<std::string>({"true", "null"}), "JSON literals");
+
+        std::string shell = "```bash\n#!/bin/sh\nfor f in *.txt; do echo \"$f\" ${HOME} $1 'a\\' # end\n"
+                            "url=a#b; done\n```\n";
+        tf.assert_true(tokens(shell, TokenKind::COMMENT) == std::vector<std::string>({"#!/bin/sh", "# end"}),
+                       "Shell comments only at word start");
+        tf.assert_true(tokens(shell, TokenKind::VARIABLE) == std::vector<std::string>({"${HOME}", "$1"}),
+                       "Shell variables");
+        tf.assert_true(tokens(shell, TokenKind::STRING) == std::vector<std::string>({"\"$f\"", "'a\\'"}),
+                       "Single quotes have no escapes in shell");
+        tf.assert_true(tokens(shell, TokenKind::KEYWORD) == std::vector<std::string>({"for", "in", "do", "done"}),
+                       "Shell keywords");
+    }
+
+    static void test_worker(TestFramework& tf) {
+        std::string big = "```cpp\n";
+        for (int i = 0; i < 10000; ++i) {
+            big += "for (int i = 0; i < n; ++i) { total += values[i] * 2; } // line " + std::to_string(i) + "\n";
+        }
+        big += "```\n";
+
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t ready = 0;
+        std::vector<highlight::Worker::Result> results;
+        {
+            highlight::Worker worker([&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready++;
+                done.notify_all();
+            });
+            for (uint64_t id = 1; id <= 3; ++id) {
+                worker.submit(id, id == 2 ? big : "```json\n[1, 2]\n```\n");
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait_for(lock, std::chrono::seconds(10), [&]() { return ready == 3; });
+            lock.unlock();
+            results = worker.takeResults();
+            tf.assert_true(worker.takeResults().empty(), "Results are taken once");
+        }
+        tf.assert_true(results.size() == 3, "Every job reports");
+        tf.assert_true(results[0].id == 1 && results[1].id == 2 && results[2].id == 3, "Jobs finish in order");
+        tf.assert_true(results[1].spans.size() == 1 + 10000 * 5, "Large response fully lexed");
+        tf.assert_true(results[2].spans.size() == 3, "Small response lexed");
+
+        // Jobs still queued when the worker goes are dropped, not run
+        ready = 0;
+        {
+            highlight::Worker worker([&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready++;
+            });
+            for (uint64_t id = 1; id <= 50; ++id) {
+                worker.submit(id, big);
+            }
+        }
+        tf.assert_true(ready < 50, "Queued jobs are dropped on destruction");
+    }
+};
+
+class TestTranscriptIndex {
+public:
+    // Brute-force occurrences over the same messages, as (message, byte offset)
+    static std::vector<std::pair<size_t, size_t>> naive(const std::vector<std::string>& messages,
+                                                        const std::string& query) {
+        std::vector<std::pair<size_t, size_t>> found;
+        for (size_t m = 0; m < messages.size(); ++m) {
+            std::string text = messages[m];
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+            for (size_t pos = text.find(query); pos != std::string::npos; pos = text.find(query, pos + query.size())) {
+                found.emplace_back(m, pos);
+            }
+        }
+        return found;
+    }
+
+    static void test_search(TestFramework& tf) {
+        TranscriptIndex index;
+        tf.assert_true(index.add("[10:00:00] You: Where is the Config loader?") == 0, "First message id");
+        tf.assert_true(index.add("[10:00:05] Claude: The config loader lives in claude_agent.cpp") == 1,
+                       "Second message id");
+        index.add("[10:00:09] You: Größe der CONFIG?");
+
+        auto matches = index.find("config");
+        tf.assert_true(matches.size() == 3, "Case-insensitive matches across messages");
+        tf.assert_true(matches[0].message == 0 && matches[0].offset == 29 && matches[0].length == 6,
+                       "First match position");
+        tf.assert_true(matches[1].message == 1 && matches[1].offset == 23, "Second match position");
+        tf.assert_true(matches[2].message == 2 && matches[2].offset == 26, "Offsets count characters, not bytes");
+        tf.assert_true(index.find("größe").size() == 1 && index.find("größe")[0].length == 5,
+                       "Length counts characters");
+        tf.assert_true(index.find("config", 2).size() == 2, "Limit caps the matches");
+        tf.assert_true(index.find("loader?\n").empty(), "Absent trigram finds nothing");
+        tf.assert_true(index.find("?[10").empty(), "Matches do not span messages");
+        tf.assert_true(index.find("aa").empty() && index.find("u:").size() == 2, "Short queries scan the text");
+        tf.assert_true(index.find("").empty(), "Empty query");
+
+        TranscriptIndex repeats;
+        repeats.add("aaaaa");
+        tf.assert_true(repeats.find("aa").size() == 2 && repeats.find("aaa").size() == 1, "Matches do not overlap");
+    }
+
+    static void test_incremental(TestFramework& tf) {
+        // Messages of varied length so matches straddle block boundaries
+        std::vector<std::string> messages;
+        TranscriptIndex index;
+        uint32_t seed = 12345;
+        auto next = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+        const std::vector<std::string> words = {"needle", "Needle", "hay", "stack", "é", "ünïcode", " ", "\n", "x"};
+        bool all_agree = true;
+        for (int m = 0; m < 400; ++m) {
+            std::string text;
+            size_t count = next() % 300;
+            for (size_t w = 0; w < count; ++w) {
+                text += words[next() % words.size()];
+            }
+            messages.push_back(text);
+            index.add(text);
+            if (m % 50 == 49) {
+                for (const char* query : {"needle", "ay st", "hayhay", "é\n", "x", "needleneedlehay"}) {
+                    auto expected = naive(messages, query);
+                    auto matches = index.find(query);
+                    bool agree = expected.size() == matches.size();
+                    for (size_t i = 0; agree && i < matches.size(); ++i) {
+                        const std::string& message = messages[expected[i].first];
+                        agree = matches[i].message == expected[i].first &&
+                                matches[i].offset == static_cast<size_t>(std::count_if(
+                                    message.begin(), message.begin() + expected[i].second,
+                                    [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; }));
+                    }
+                    all_agree = all_agree && agree;
+                }
+            }
+        }
+        tf.assert_true(index.textBytes() > 20 * TranscriptIndex::BLOCK_SIZE, "Transcript spans many blocks");
+        tf.assert_true(all_agree, "Index agrees with a full scan as messages are added");
+
+        // A long transcript: rare terms are found without scanning it all
+        TranscriptIndex large;
+        std::string filler;
+        for (int i = 0; i < 200; ++i) {
+            filler += "The quick brown fox jumps over the lazy dog while the build runs. ";
+        }
+        for (int m = 0; m < 2000; ++m) {
+            large.add(m % 500 == 7 ? filler + "ticket QX-" + std::to_string(m) : filler);
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto matches = large.find("qx-1507");
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "  Searched " << large.textBytes() / (1024 * 1024) << " MB in " << elapsed << " us" << std::endl;
+        tf.assert_true(matches.size() == 1 && matches[0].message == 1507, "Rare term found");
+        tf.assert_true(large.find("qx-").size() == 4, "All occurrences found");
+
+        large.clear();
+        tf.assert_true(large.messageCount() == 0 && large.find("fox").empty(), "Clear empties the index");
+        tf.assert_true(large.add("fox") == 0 && large.find("fox").size() == 1, "Index reusable after clear");
+    }
+};
+
+class TestTaskScheduler {
+public:
+    // Parallel sum over [begin, end) by recursive splitting, waiting on
+    // nested groups from inside tasks
+    static uint64_t parallel_sum(TaskScheduler& scheduler, uint64_t begin, uint64_t end) {
+        if (end - begin <= 1000) {
+            uint64_t sum = 0;
+            for (uint64_t i = begin; i < end; ++i) {
+                sum += i;
+            }
+            return sum;
+        }
+        uint64_t middle = begin + (end - begin) / 2;
+        uint64_t left = 0;
+        TaskGroup group(scheduler);
+        group.run([&]() { left = parallel_sum(scheduler, begin, middle); });
+        uint64_t right = parallel_sum(scheduler, middle, end);
+        group.wait();
+        return left + right;
+    }
+
+    static void test_task_groups(TestFramework& tf) {
+        TaskScheduler scheduler(4);
+        tf.assert_true(scheduler.workerCount() == 4, "Worker count");
+        const uint64_t n = 2000000;
+        tf.assert_true(parallel_sum(scheduler, 0, n) == n * (n - 1) / 2, "Nested groups join correctly");
+
+        // The first exception reaches wait(); the other tasks still run
+        std::atomic<int> ran{0};
+        TaskGroup failing(scheduler);
+        for (int i = 0; i < 10; ++i) {
+            failing.run([&ran, i]() {
+                ran++;
+                if (i == 3) {
+                    throw std::runtime_error("task failed");
+                }
+            });
+        }
+        bool caught = false;
+        try {
+            failing.wait();
+        } catch (const std::runtime_error& e) {
+            caught = std::string(e.what()) == "task failed";
+        }
+        tf.assert_true(caught && ran == 10, "Exceptions are rethrown by wait()");
+
+        // Tasks queued behind a busy pool are skipped once cancelled
+        std::mutex gate_mutex;
+        std::condition_variable gate;
+        bool open = false;
+        std::atomic<int> blocked{0};
+        TaskGroup blockers(scheduler);
+        for (size_t i = 0; i < scheduler.workerCount(); ++i) {
+            blockers.run([&]() {
+                blocked++;
+                std::unique_lock<std::mutex> lock(gate_mutex);
+                gate.wait(lock, [&]() { return open; });
+            });
+        }
+        while (blocked < static_cast<int>(scheduler.workerCount())) {
+            std::this_thread::yield();
+        }
+        std::atomic<int> skipped_ran{0};
+        TaskGroup cancelled(scheduler);
+        for (int i = 0; i < 100; ++i) {
+            cancelled.run([&]() { skipped_ran++; });
+        }
+        cancelled.cancel();
+        {
+            std::lock_guard<std::mutex> lock(gate_mutex);
+            open = true;
+        }
+        gate.notify_all();
+        cancelled.wait();
+        blockers.wait();
+        tf.assert_true(skipped_ran == 0 && cancelled.token().isCancelled(), "Cancelled tasks do not run");
+    }
+
+    static void test_priorities(TestFramework& tf) {
+        TaskScheduler scheduler(1);
+        std::mutex gate_mutex;
+        std::condition_variable gate;
+        bool open = false;
+        std::atomic<bool> busy{false};
+        scheduler.submit([&]() {
+            busy = true;
+            std::unique_lock<std::mutex> lock(gate_mutex);
+            gate.wait(lock, [&]() { return open; });
+        });
+        while (!busy) {
+            std::this_thread::yield();
+        }
+
+        // Queued while the only worker is busy, so they run by lane
+        std::mutex order_mutex;
+        std::string order;
+        auto record = [&](char c) {
+            return [&order, &order_mutex, c]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order += c;
+            };
+        };
+        TaskGroup group(scheduler);
+        group.run(record('b'), TaskPriority::BACKGROUND);
+        group.run(record('n'), TaskPriority::NORMAL);
+        group.run(record('i'), TaskPriority::INTERACTIVE);
+        group.run(record('b'), TaskPriority::BACKGROUND);
+        group.run(record('i'), TaskPriority::INTERACTIVE);
+        {
+            std::lock_guard<std::mutex> lock(gate_mutex);
+            open = true;
+        }
+        gate.notify_all();
+        group.wait();
+        tf.assert_equals("iinbb", order, "Interactive before normal before background");
+
+        // Continuations posted to the main thread run when it asks for them
+        std::atomic<int> wakeups{0};
+        scheduler.setMainWakeup([&]() { wakeups++; });
+        std::thread::id main_id = std::this_thread::get_id();
+        bool on_main = false;
+        {
+            TaskGroup posting(scheduler);
+            posting.run([&]() {
+                scheduler.postToMain([&]() { on_main = std::this_thread::get_id() == main_id; });
+            });
+        }
+        tf.assert_true(wakeups == 1, "Posting wakes the main loop");
+        tf.assert_true(scheduler.runMainTasks() == 1 && on_main, "Continuation runs on the main thread");
+        tf.assert_true(scheduler.runMainTasks() == 0, "Continuations run once");
+        scheduler.setMainWakeup(nullptr);
+    }
+};
+
+class TestProfiler {
+public:
+    static uint64_t __attribute__((noinline)) burn_cpu(double seconds) {
+        uint64_t x = 1;
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < end) {
+            for (int i = 0; i < 10000; ++i) {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            }
+        }
+        return x;
+    }
+
+    static void test_sampling(TestFramework& tf) {
+        Profiler& profiler = Profiler::getInstance();
+        tf.assert_true(!profiler.running(), "Idle until started");
+        tf.assert_true(profiler.start(), "Profiler starts");
+        tf.assert_true(!profiler.start(), "Only one profile at a time");
+
+        // CPU on two threads at once, each into its own chunks
+        volatile uint64_t sink = 0;
+        std::thread other([&sink]() { sink = burn_cpu(0.3); });
+        sink = burn_cpu(0.3);
+        other.join();
+        profiler.stop();
+        tf.assert_true(!profiler.running(), "Profiler stops");
+
+        size_t samples = profiler.sampleCount();
+        tf.assert_true(samples > 10, "CPU time is sampled");
+        tf.assert_true(profiler.droppedCount() == 0, "Nothing dropped");
+
+        // Folded format: frames joined by ';', a space, then the count
+        std::istringstream folded(profiler.foldedStacks());
+        std::string line;
+        size_t total = 0;
+        bool well_formed = true;
+        while (std::getline(folded, line)) {
+            size_t space = line.rfind(' ');
+            well_formed = well_formed && space != std::string::npos && space > 0 &&
+                          line.find_first_not_of("0123456789", space + 1) == std::string::npos;
+            total += std::stoul(line.substr(space + 1));
+        }
+        tf.assert_true(well_formed && total == samples, "Folded stacks account for every sample");
+
+        // A late SIGPROF after stop() is ignored
+        raise(SIGPROF);
+        tf.assert_true(profiler.sampleCount() == samples, "No samples after stop");
+
+        std::string path = "/tmp/test_profile_" + std::to_string(rand()) + ".folded";
+        tf.assert_true(profiler.writeFolded(path) && std::filesystem::file_size(path) > 0, "Profile written");
+        std::filesystem::remove(path);
+
+        tf.assert_true(profiler.start(1000), "Restarts");
+        profiler.stop();
+        tf.assert_true(profiler.sampleCount() < samples, "Restart discards the previous profile");
+    }
+};
+
+class TestDiagnostics {
+public:
+    static void test_histogram(TestFramework& tf) {
+        bool monotonic = true;
+        for (uint64_t v = 1; v < 100000; v = v * 3 / 2 + 1) {
+            size_t bucket = Histogram::bucketOf(v);
+            monotonic = monotonic && Histogram::bucketLower(bucket) <= v && v < Histogram::bucketLower(bucket + 1);
+        }
+        tf.assert_true(monotonic, "Values fall inside their bucket");
+        tf.assert_true(Histogram::bucketOf(UINT64_MAX) == Histogram::BUCKETS - 1, "Buckets cover uint64_t");
+
+        Histogram histogram;
+        for (uint64_t v = 1; v <= 1000; ++v) {
+            histogram.record(v);
+        }
+        auto snapshot = histogram.snapshot();
+        tf.assert_true(snapshot.count == 1000 && snapshot.mean() == 500.5, "Count and mean");
+        uint64_t p50 = snapshot.percentile(0.5);
+        uint64_t p99 = snapshot.percentile(0.99);
+        tf.assert_true(p50 >= 500 && p50 <= 625, "Median within a quarter");
+        tf.assert_true(p99 >= 990 && p99 <= 1250, "p99 within a quarter");
+        tf.assert_true(Histogram().snapshot().percentile(0.5) == 0, "Empty histogram");
+    }
+
+    static void test_counters(TestFramework& tf) {
+        // The instance is process-wide, so compare against a baseline
+        Diagnostics& diagnostics = Diagnostics::getInstance();
+        auto before = diagnostics.snapshot();
+        diagnostics.turnStarted();
+        diagnostics.addQueued(2);
+        auto during = diagnostics.snapshot();
+        tf.assert_true(during.in_flight == before.in_flight + 1 && during.queued == before.queued + 2,
+                       "Gauges count up");
+        diagnostics.turnFinished(false);
+        diagnostics.addQueued(-2);
+        diagnostics.recordStall(150);
+        diagnostics.recordStall(120);
+        auto after = diagnostics.snapshot();
+        tf.assert_true(after.in_flight == before.in_flight && after.queued == before.queued, "Gauges count down");
+        tf.assert_true(after.turns == before.turns + 1 && after.failed_turns == before.failed_turns + 1,
+                       "Turns and failures counted");
+        tf.assert_true(after.stalls == before.stalls + 2 && after.longest_stall_ms >= 150, "Stalls and longest stall");
+        tf.assert_true(after.rss_bytes > 0, "RSS read");
+
+        // Resolved configs: the first lookup computes, the second is cached
+        std::string path = "/tmp/test_diagnostics_" + std::to_string(rand()) + ".json";
+        std::ofstream(path) << "{\"name\": \"Diagnostics\"}";
+        ConfigResolver resolver;
+        resolver.resolve(path);
+        resolver.resolve(path);
+        std::filesystem::remove(path);
+        auto fed = diagnostics.snapshot();
+        tf.assert_true(fed.config_misses == after.config_misses + 1 && fed.config_hits == after.config_hits + 1,
+                       "Config cache hits and misses counted");
+    }
+};
+
+class TestContextController {
+public:
+    static void test_latency_fit(TestFramework& tf) {
+        // Latency grows 10 ms per KB over a 500 ms floor; at 90% of a 1.5 s
+        // target the fit allows (1350 - 500) / 10 = 85 KB
+        ContextController controller;
+        const size_t ceiling = 200000;
+        size_t budget = controller.budget("claude", ceiling);
+        tf.assert_true(budget == ceiling, "Starts at the configured budget");
+        const size_t sizes[] = {40000, 120000, 80000, 160000, 60000, 100000, 90000, 70000};
+        for (size_t bytes : sizes) {
+            budget = controller.observe("claude", bytes, 500 + 10.0 * bytes / 1024, 1500, ceiling);
+        }
+        tf.assert_true(budget > 80000 && budget < 90000, "Fitted budget meets the target");
+        tf.assert_true(controller.budget("claude", ceiling) == budget, "Budget kept per provider");
+        tf.assert_true(controller.budget("gemini", ceiling) == ceiling, "Other providers unaffected");
+        tf.assert_true(controller.budget("claude", 50000) == 50000, "Configured budget stays the ceiling");
+    }
+
+    static void test_fixed_prefix(TestFramework& tf) {
+        // Every turn also sends a 50 KB system prompt. Latency is 500 ms plus
+        // 10 ms per KB of the whole prompt, so at 90% of a 1.5 s target the
+        // history may take (1350 - 500 - 500) / 10 = 35 KB, not the 85 KB a
+        // fit on whole prompts would allow
+        ContextController controller;
+        const size_t ceiling = 200000;
+        const size_t prefix = 50 * 1024;
+        size_t budget = ceiling;
+        const size_t histories[] = {10000, 60000, 30000, 80000, 20000, 50000, 40000, 35000};
+        for (size_t history : histories) {
+            budget = controller.observe("gemini", history, 500 + 10.0 * (prefix + history) / 1024, 1500, ceiling);
+        }
+        tf.assert_true(budget > 30000 && budget < 40000, "Budget leaves room for the fixed prefix");
+        double predicted = 500 + 10.0 * (prefix + budget) / 1024;
+        tf.assert_true(predicted <= 1500, "Turns at the budget stay inside the target");
+    }
+
+    static void test_steps(TestFramework& tf) {
+        // Latency that does not depend on prompt size: step down while over
+        // the target, by at most MAX_STEP, and back up once well under it
+        ContextController controller;
+        const size_t ceiling = 100000;
+        size_t previous = ceiling;
+        bool bounded = true;
+        for (int i = 0; i < 20; ++i) {
+            size_t budget = controller.observe("claude", 50000, 3000, 2000, ceiling);
+            bounded = bounded && budget < previous && budget * ContextController::MAX_STEP >= previous - 1;
+            previous = budget;
+            if (budget == ContextController::MIN_BUDGET) {
+                break;
+            }
+        }
+        tf.assert_true(bounded && previous == ContextController::MIN_BUDGET, "Shrinks in steps to the minimum");
+        for (int i = 0; i < 20; ++i) {
+            previous = controller.observe("claude", 50000, 500, 2000, ceiling);
+        }
+        tf.assert_true(previous == ceiling, "Grows back to the configured budget");
+
+        ClaudeAgent agent("agent_config.json", CliProvider::CLAUDE);
+        tf.assert_true(agent.getLatencyTarget() == 0 && agent.getContextBudget() == ClaudeAgent::DEFAULT_CONTEXT_BUDGET,
+                       "Fixed budget without a latency target");
+    }
+};
+
+class TestOutboundQueue {
+public:
+    // Stub Claude CLI: starts slowly, then answers with the number of
+    // previous assistant turns in the context it was given
+    static std::string create_stub_cli(double startup_seconds) {
+        std::string dir = "/tmp/test_stub_cli_" + std::to_string(rand());
+        std::filesystem::create_directory(dir);
+        std::ofstream script(dir + "/claude");
+        script << "#!/bin/sh\n"
+               << "sleep " << startup_seconds << "\n"
+               << "input=$(cat)\n"
+               << "printf 'turn %s' \"$(printf '%s\\n' \"$input\" | grep -c '^Assistant:')\"\n";
+        script.close();
+        std::filesystem::permissions(dir + "/claude", std::filesystem::perms::owner_all);
+        return dir;
+    }
+
+    static std::vector<OutboundQueue::Event> wait_for_replies(OutboundQueue& queue, std::mutex& mutex,
+                                                              std::condition_variable& woken, size_t replies) {
+        std::vector<OutboundQueue::Event> events;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        size_t replied = 0;
+        while (replied < replies && std::chrono::steady_clock::now() < deadline) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                woken.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            for (auto& event : queue.takeEvents()) {
+                replied += event.kind == OutboundQueue::Event::Kind::REPLIED;
+                events.push_back(std::move(event));
+            }
+        }
+        return events;
+    }
+
+    static void test_pipelined_turns(TestFramework& tf) {
+        const double startup = 0.4;
+        std::string stub_dir = create_stub_cli(startup);
+        std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+        setenv("PATH", (stub_dir + ":" + old_path).c_str(), 1);
+        // The fork server was forked before PATH pointed at the stub
+        ProcessSpawner::getInstance().stopForkServer();
+
+        try {
+            ClaudeAgent agent("agent_config.json", CliProvider::CLAUDE);
+            tf.assert_true(agent.initializeCli(), "Stub CLI found");
+
+            std::mutex mutex;
+            std::condition_variable woken;
+            auto diagnostics_before = Diagnostics::getInstance().snapshot();
+            auto start = std::chrono::steady_clock::now();
+            std::vector<OutboundQueue::Event> events;
+            {
+                OutboundQueue queue(agent, [&]() {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    woken.notify_all();
+                });
+                tf.assert_true(queue.enqueue("first") == 1 && queue.enqueue("second") == 2 &&
+                               queue.enqueue("third") == 3, "Messages are accepted while others are pending");
+                tf.assert_true(queue.pending() == 3, "All three pending");
+                events = wait_for_replies(queue, mutex, woken, 3);
+                tf.assert_true(queue.pending() == 0, "Nothing pending after the last reply");
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::vector<std::string> replies;
+            bool ordered = events.size() == 6;
+            for (size_t i = 0; ordered && i < events.size(); ++i) {
+                auto expected = i % 2 == 0 ? OutboundQueue::Event::Kind::STARTED : OutboundQueue::Event::Kind::REPLIED;
+                ordered = events[i].kind == expected && events[i].id == i / 2 + 1;
+                if (events[i].kind == OutboundQueue::Event::Kind::REPLIED) {
+                    replies.push_back(events[i].response);
+                }
+            }
+            tf.assert_true(ordered, "Each message starts after the previous reply, in order");
+            tf.assert_true(replies == std::vector<std::string>({"turn 0", "turn 1", "turn 2"}),
+                           "Each context includes the answers before it");
+            tf.assert_true(agent.getConversationHistory().size() == 3, "All turns recorded");
+            // Children of queued turns start while the previous one runs
+            tf.assert_true(elapsed < 2.75 * startup, "Queued turns overlap CLI startup");
+            auto diagnostics_after = Diagnostics::getInstance().snapshot();
+            tf.assert_true(diagnostics_after.ttfb_us.count == diagnostics_before.ttfb_us.count + 3 &&
+                           diagnostics_after.ttfb_us.percentile(0.5) >= 0.3 * startup * 1e6,
+                           "First-byte latency recorded per turn");
+            tf.assert_true(diagnostics_after.prespawn_used > diagnostics_before.prespawn_used,
+                           "Pre-spawned children counted");
+
+            // Queued messages are dropped on cancel; the one in flight is
+            // terminated, not reported and not recorded
+            OutboundQueue queue(agent, [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                woken.notify_all();
+            });
+            queue.enqueue("dropped 1");
+            queue.enqueue("dropped 2");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            queue.cancelAll();
+            uint64_t kept = queue.enqueue("kept");
+            events = wait_for_replies(queue, mutex, woken, 1);
+            tf.assert_true(events.size() == 2 && events[0].id == kept && events[1].id == kept,
+                           "Only the message after the cancel is answered");
+            tf.assert_true(events.size() == 2 && events[1].response == "turn 3",
+                           "The cancelled turn does not reach the next context");
+            tf.assert_true(agent.getConversationHistory().size() == 4, "The cancelled turn is not recorded");
+
+            // Changes run between turns, in order with the messages
+            queue.enqueue("before clear");
+            queue.enqueueChange([&agent]() {
+                agent.clearConversationHistory();
+                return std::string("cleared");
+            });
+            queue.enqueue("after clear");
+            events = wait_for_replies(queue, mutex, woken, 2);
+            std::vector<std::string> sequence;
+            for (const auto& event : events) {
+                if (event.kind != OutboundQueue::Event::Kind::STARTED) {
+                    sequence.push_back(event.response);
+                }
+            }
+            tf.assert_true(sequence == std::vector<std::string>({"turn 4", "cleared", "turn 0"}),
+                           "Change applied after the turn before it and before the one after");
+        } catch (...) {
+            setenv("PATH", old_path.c_str(), 1);
+            std::filesystem::remove_all(stub_dir);
+            throw;
+        }
+        setenv("PATH", old_path.c_str(), 1);
+        std::filesystem::remove_all(stub_dir);
+    }
+
+    static void test_timeout_shrinks_budget(TestFramework& tf) {
+        // A CLI that never answers within the timeout still counts as slow
+        std::string stub_dir = create_stub_cli(3);
+        std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+        setenv("PATH", (stub_dir + ":" + old_path).c_str(), 1);
+        ProcessSpawner::getInstance().stopForkServer();
+
+        try {
+            ClaudeAgent agent("agent_config.json", CliProvider::CLAUDE);
+            tf.assert_true(agent.initializeCli(), "Stub CLI found");
+            auto& fields = static_cast<json::ObjectValue&>(*agent.getConfig());
+            fields.set("timeout_seconds", json::number(0.3));
+            fields.set("latency_target_ms", json::number(100));
+
+            std::string response = agent.sendToCli("hello", false);
+            tf.assert_true(response.find("timed out") != std::string::npos, "Turn times out");
+            tf.assert_true(agent.getContextBudget() < ClaudeAgent::DEFAULT_CONTEXT_BUDGET,
+                           "Timed-out turn shrinks the context budget");
+        } catch (...) {
+            setenv("PATH", old_path.c_str(), 1);
+            std::filesystem::remove_all(stub_dir);
+            throw;
+        }
+        setenv("PATH", old_path.c_str(), 1);
+        std::filesystem::remove_all(stub_dir);
+    }
+
+    static void test_prepared_turn(TestFramework& tf) {
+        ClaudeAgent agent("agent_config.json", CliProvider::CLAUDE);
+        // No CLI detected: the turn carries no child and reports the error when sent
+        auto turn = agent.prepareTurn("hello");
+        tf.assert_true(!turn->spawned && turn->command.empty(), "Nothing spawned without a CLI");
+        tf.assert_true(agent.sendPrepared(*turn).find("CLI not available") != std::string::npos,
+                       "Missing CLI reported at send time");
+        tf.assert_true(agent.getConversationHistory().empty(), "Errors are not recorded");
+    }
+};
+
 int main() {
+    // As in the application: fork the spawn helper before any thread exists
+    ProcessSpawner::getInstance().startForkServer();
+
     std::cout << "Running C++ Claude Agent Unit Tests" << std::endl;
     std::cout << "====================================" << std::endl;
 
@@ -387,23 +2347,109 @@ int main() {
     tf.run_test("Config Directory Environment Variable", [&tf]() { TestClaudeAgent::test_config_directory_environment_variable(tf); });
     tf.run_test("CLI Provider Setting", [&tf]() { TestClaudeAgent::test_cli_provider_setting(tf); });
     tf.run_test("Conversation History", [&tf]() { TestClaudeAgent::test_conversation_history(tf); });
+    tf.run_test("Output Limits From Config", [&tf]() { TestClaudeAgent::test_output_limits_from_config(tf); });
 
     // Logger tests
     std::cout << "\n--- Logger Tests ---" << std::endl;
     tf.run_test("Logger Initialization", [&tf]() { TestLogger::test_logger_initialization(tf); });
     tf.run_test("Component Logging", [&tf]() { TestLogger::test_component_logging(tf); });
     tf.run_test("Special Logging Methods", [&tf]() { TestLogger::test_special_logging_methods(tf); });
+    tf.run_test("Log Rate Limiting", [&tf]() { TestLogger::test_rate_limiting(tf); });
+    tf.run_test("Debug Log Sampling", [&tf]() { TestLogger::test_debug_sampling(tf); });
 
     // JSON Utils tests
     std::cout << "\n--- JSON Utils Tests ---" << std::endl;
     tf.run_test("JSON Parsing - Valid", [&tf]() { TestJsonUtils::test_json_parsing_valid(tf); });
     tf.run_test("JSON Parsing - Invalid", [&tf]() { TestJsonUtils::test_json_parsing_invalid(tf); });
     tf.run_test("JSON Parsing - Nonexistent File", [&tf]() { TestJsonUtils::test_json_parsing_nonexistent_file(tf); });
+    tf.run_test("JSON Stream Reader - Chunked", [&tf]() { TestJsonUtils::test_stream_reader_chunked(tf); });
+    tf.run_test("JSON Stream Reader - Line Delimited", [&tf]() { TestJsonUtils::test_stream_reader_line_delimited(tf); });
+    tf.run_test("JSON Stream Reader - Events", [&tf]() { TestJsonUtils::test_stream_reader_events(tf); });
+    tf.run_test("JSON Parsing - Deep Nesting", [&tf]() { TestJsonUtils::test_json_deep_nesting(tf); });
+    tf.run_test("JSON Parsing - Error Positions", [&tf]() { TestJsonUtils::test_json_error_positions(tf); });
+    tf.run_test("JSON Unicode Escapes", [&tf]() { TestJsonUtils::test_json_unicode_escapes(tf); });
+    tf.run_test("JSON Strict Grammar", [&tf]() { TestJsonUtils::test_json_strict_grammar(tf); });
+    tf.run_test("JSON Escape On Write", [&tf]() { TestJsonUtils::test_json_escape_on_write(tf); });
+    tf.run_test("UTF-8 Validation", [&tf]() { TestJsonUtils::test_utf8_validation(tf); });
+    tf.run_test("JSON Path", [&tf]() { TestJsonUtils::test_json_path(tf); });
+    tf.run_test("JSON Extract", [&tf]() { TestJsonUtils::test_json_extract(tf); });
+    tf.run_test("CBOR Encoding", [&tf]() { TestJsonUtils::test_cbor_encoding(tf); });
+    tf.run_test("BLAKE3", [&tf]() { TestJsonUtils::test_blake3(tf); });
+    tf.run_test("Canonical Numbers", [&tf]() { TestJsonUtils::test_number_format(tf); });
+    tf.run_test("Content Hash", [&tf]() { TestJsonUtils::test_json_hash(tf); });
+    tf.run_test("CBOR Zero-Copy View", [&tf]() { TestJsonUtils::test_cbor_view(tf); });
+
+    // Process spawner tests
+    std::cout << "\n--- Process Spawner Tests ---" << std::endl;
+    tf.run_test("Spawn Output And Status", [&tf]() { TestProcessSpawner::test_spawn_output_and_status(tf); });
+    tf.run_test("Spawn Large Stdin", [&tf]() { TestProcessSpawner::test_spawn_large_stdin(tf); });
+    tf.run_test("Spawn Output Limits", [&tf]() { TestProcessSpawner::test_output_limits(tf); });
+    tf.run_test("Spawn Streamed Output", [&tf]() { TestProcessSpawner::test_streamed_output(tf); });
+    tf.run_test("Spawn Without Fork Server", [&tf]() { TestProcessSpawner::test_spawn_without_fork_server(tf); });
+
+    // Context dedup tests
+    std::cout << "\n--- Context Dedup Tests ---" << std::endl;
+    tf.run_test("Content Defined Chunking", [&tf]() { TestContextDedup::test_chunking_is_content_defined(tf); });
+    tf.run_test("Repeated Paste Replaced", [&tf]() { TestContextDedup::test_repeated_paste_replaced(tf); });
+    tf.run_test("Small Repeats Untouched", [&tf]() { TestContextDedup::test_small_repeats_untouched(tf); });
+
+    // History index tests
+    std::cout << "\n--- History Index Tests ---" << std::endl;
+    tf.run_test("Relevant Turn Selected", [&tf]() { TestHistoryIndex::test_relevant_turn_selected(tf); });
+    tf.run_test("Selection Fallback And Budget", [&tf]() { TestHistoryIndex::test_fallback_and_budget(tf); });
+    tf.run_test("Selection Speed", [&tf]() { TestHistoryIndex::test_selection_speed(tf); });
 
     // Config Library tests
+    std::cout << "\n--- Config History Tests ---" << std::endl;
+    tf.run_test("Versions and Restore", [&tf]() { TestConfigHistory::test_versions_and_restore(tf); });
+    tf.run_test("History Garbage Collection", [&tf]() { TestConfigHistory::test_garbage_collection(tf); });
+
+    std::cout << "\n--- Facet Index Tests ---" << std::endl;
+    tf.run_test("Bitmap Operations", [&tf]() { TestFacetIndex::test_bitmap_operations(tf); });
+    tf.run_test("Facet Queries", [&tf]() { TestFacetIndex::test_facet_queries(tf); });
+
+    std::cout << "\n--- Config Resolver Tests ---" << std::endl;
+    tf.run_test("Inheritance Resolution", [&tf]() { TestConfigResolver::test_inheritance_resolution(tf); });
+    tf.run_test("Inheritance Invalidation", [&tf]() { TestConfigResolver::test_invalidation(tf); });
+
+    std::cout << "\n--- View Model Tests ---" << std::endl;
+    tf.run_test("Property Changes", [&tf]() { TestAgentViewModel::test_property_changes(tf); });
+    tf.run_test("Starter List Diff", [&tf]() { TestAgentViewModel::test_list_diff(tf); });
+
+    std::cout << "\n--- Syntax Highlighting Tests ---" << std::endl;
+    tf.run_test("Code Block Detection", [&tf]() { TestSyntaxHighlighter::test_code_blocks(tf); });
+    tf.run_test("Language Lexers", [&tf]() { TestSyntaxHighlighter::test_lexers(tf); });
+    tf.run_test("Highlight Worker", [&tf]() { TestSyntaxHighlighter::test_worker(tf); });
+
+    std::cout << "\n--- Transcript Search Tests ---" << std::endl;
+    tf.run_test("Transcript Search", [&tf]() { TestTranscriptIndex::test_search(tf); });
+    tf.run_test("Incremental Index", [&tf]() { TestTranscriptIndex::test_incremental(tf); });
+
+    std::cout << "\n--- Task Scheduler Tests ---" << std::endl;
+    tf.run_test("Task Groups", [&tf]() { TestTaskScheduler::test_task_groups(tf); });
+    tf.run_test("Priority Lanes", [&tf]() { TestTaskScheduler::test_priorities(tf); });
+
+    std::cout << "\n--- Profiler Tests ---" << std::endl;
+    tf.run_test("Sampling Profiler", [&tf]() { TestProfiler::test_sampling(tf); });
+
+    std::cout << "\n--- Diagnostics Tests ---" << std::endl;
+    tf.run_test("Latency Histogram", [&tf]() { TestDiagnostics::test_histogram(tf); });
+    tf.run_test("Diagnostics Counters", [&tf]() { TestDiagnostics::test_counters(tf); });
+
+    std::cout << "\n--- Context Controller Tests ---" << std::endl;
+    tf.run_test("Latency Fit", [&tf]() { TestContextController::test_latency_fit(tf); });
+    tf.run_test("Latency Fit With Fixed Prefix", [&tf]() { TestContextController::test_fixed_prefix(tf); });
+    tf.run_test("Budget Steps", [&tf]() { TestContextController::test_steps(tf); });
+
     std::cout << "\n--- Config Library Tests ---" << std::endl;
     tf.run_test("Config Scanning", [&tf]() { TestConfigLibrary::test_config_scanning(tf); });
 
+    // Last: stops the fork server so children see a PATH set at run time
+    std::cout << "\n--- Outbound Queue Tests ---" << std::endl;
+    tf.run_test("Prepared Turn", [&tf]() { TestOutboundQueue::test_prepared_turn(tf); });
+    tf.run_test("Pipelined Turns", [&tf]() { TestOutboundQueue::test_pipelined_turns(tf); });
+    tf.run_test("Timeout Shrinks Budget", [&tf]() { TestOutboundQueue::test_timeout_shrinks_budget(tf); });
+
     // Print summary
     tf.print_summary();
 
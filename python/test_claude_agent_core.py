@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+Tests for the claude_agent_core extension module (the C++ core in Python).
+
+Build it first with `make python-module` in cpp/; the tests are skipped when
+the module cannot be imported. CLAUDE_AGENT_CORE_PATH can point at another
+build directory.
+"""
+
+import unittest
+import os
+import sys
+import tempfile
+import shutil
+import threading
+import time
+from unittest.mock import patch
+
+CORE_PATH = os.environ.get('CLAUDE_AGENT_CORE_PATH',
+                           os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'cpp', 'bin'))
+sys.path.insert(0, CORE_PATH)
+
+try:
+    import claude_agent_core as core
+except ImportError:
+    core = None
+
+# Stand-in for the claude CLI: answers --version, then writes its answer
+# word by word
+FAKE_CLI = """#!/bin/sh
+case "$1" in --version) echo "claude 0.0 (test)"; exit 0;; esac
+cat > /dev/null
+for word in Streamed from the core; do printf '%s ' "$word"; sleep 0.1; done
+echo
+"""
+
+
+@unittest.skipIf(core is None, "claude_agent_core not built (make python-module)")
+class TestCoreJson(unittest.TestCase):
+    """JSON through the C++ reader and writer."""
+
+    def test_round_trip(self):
+        value = {'name': 'Agent', 'starters': ['Hi', 'é'], 'memory': 5, 'temperature': 0.7,
+                 'enabled': True, 'parent': None}
+        self.assertEqual(core.json_loads(core.json_dumps(value)), value)
+
+    def test_canonical_output(self):
+        self.assertEqual(core.json_dumps({'b': 1, 'a': [True, None]}), '{"a":[true,null],"b":1}')
+
+    def test_parse_error(self):
+        with self.assertRaises(ValueError):
+            core.json_loads('{"name": ')
+
+    def test_unserializable(self):
+        with self.assertRaises(TypeError):
+            core.json_dumps({'when': object()})
+
+
+@unittest.skipIf(core is None, "claude_agent_core not built (make python-module)")
+class TestCoreRun(unittest.TestCase):
+    """The process runner."""
+
+    def test_input_and_exit_code(self):
+        self.assertEqual(core.run(['cat'], input='hello'), (0, 'hello'))
+        self.assertEqual(core.run(['sh', '-c', 'exit 3'])[0], 3)
+
+    def test_timeout(self):
+        start = time.time()
+        with self.assertRaises(TimeoutError):
+            core.run(['sleep', '5'], timeout=0.2)
+        self.assertLess(time.time() - start, 3)
+
+    def test_releases_gil(self):
+        ticks = []
+        ticker = threading.Thread(target=lambda: [ticks.append(time.sleep(0.02)) for _ in range(10)])
+        ticker.start()
+        core.run(['sleep', '0.5'])
+        ticker.join()
+        self.assertEqual(len(ticks), 10)
+
+
+@unittest.skipIf(core is None, "claude_agent_core not built (make python-module)")
+class TestCoreAgent(unittest.TestCase):
+    """ClaudeAgent against a fake CLI."""
+
+    def setUp(self):
+        self.test_dir = tempfile.mkdtemp()
+        bin_dir = os.path.join(self.test_dir, 'bin')
+        os.makedirs(bin_dir)
+        cli = os.path.join(bin_dir, 'claude')
+        with open(cli, 'w') as f:
+            f.write(FAKE_CLI)
+        os.chmod(cli, 0o755)
+
+        self.env = patch.dict(os.environ, {'CLAUDE_AGENT_CONFIG_DIR': self.test_dir,
+                                           'PATH': bin_dir + os.pathsep + os.environ.get('PATH', '')})
+        self.env.start()
+        self.agent = core.Agent('test_config.json', 'claude')
+        self.assertTrue(self.agent.initialize_cli())
+
+    def tearDown(self):
+        self.env.stop()
+        shutil.rmtree(self.test_dir)
+
+    def test_config(self):
+        self.assertEqual(self.agent.name, 'Custom AI Agent')
+        config = self.agent.config
+        config['name'] = 'Renamed'
+        self.agent.config = config
+        self.assertEqual(self.agent.name, 'Renamed')
+
+    def test_send(self):
+        self.assertEqual(self.agent.send('Hello'), 'Streamed from the core ')
+        self.assertEqual(self.agent.history(), [('Hello', 'Streamed from the core ')])
+
+    def test_stream(self):
+        stream = self.agent.stream('Hello')
+        chunks = list(stream)
+        self.assertGreater(len(chunks), 1)
+        self.assertEqual(''.join(chunks).rstrip('\n'), stream.response)
+        self.assertEqual(len(self.agent.history()), 1)
+
+    def test_stream_close(self):
+        stream = self.agent.stream('Hello')
+        next(stream)
+        stream.close()
+        self.assertTrue(stream.response.startswith('Error'))
+        self.assertEqual(self.agent.history(), [])
+
+    def test_stream_close_silent_cli(self):
+        # A CLI that has not written yet is terminated, not waited for
+        with open(os.path.join(self.test_dir, 'bin', 'claude'), 'w') as f:
+            f.write('#!/bin/sh\ncat > /dev/null\nexec sleep 30\n')
+        config = self.agent.config
+        config['timeout_seconds'] = 0
+        self.agent.config = config
+        stream = self.agent.stream('Hello')
+        time.sleep(0.2)
+        start = time.monotonic()
+        stream.close()
+        self.assertLess(time.monotonic() - start, 2)
+        self.assertTrue(stream.response.startswith('Error'))
+
+    def test_timeout(self):
+        config = self.agent.config
+        config['timeout_seconds'] = 0.15
+        self.agent.config = config
+        self.assertIn('timed out', self.agent.send('Hello'))
+
+
+if __name__ == '__main__':
+    unittest.main(verbosity=2)
@@ -55,7 +55,25 @@ if g++ -std=c++17 -Wall -Wextra -O2 -Iinclude \
     src/claude_agent.cpp \
     src/logger.cpp \
     src/json_utils.cpp \
-    -o bin/test_claude_agent_unit; then
+    src/json_reader.cpp \
+    src/json_cbor.cpp \
+    src/blake3.cpp \
+    src/utf8.cpp \
+    src/process_spawner.cpp \
+    src/context_dedup.cpp \
+    src/history_index.cpp \
+    src/config_history.cpp \
+    src/facet_index.cpp \
+    src/config_resolver.cpp \
+    src/agent_view_model.cpp \
+    src/syntax_highlighter.cpp \
+    src/transcript_index.cpp \
+    src/outbound_queue.cpp \
+    src/task_scheduler.cpp \
+    src/profiler.cpp \
+    src/diagnostics.cpp \
+    src/context_controller.cpp \
+    -o bin/test_claude_agent_unit -pthread; then
     echo "✓ Unit tests built successfully"
 else
     echo "✗ Unit tests build FAILED"
@@ -69,7 +87,25 @@ if g++ -std=c++17 -Wall -Wextra -O2 -Iinclude \
     src/claude_agent.cpp \
     src/logger.cpp \
     src/json_utils.cpp \
-    -o bin/test_config_library_functionality; then
+    src/json_reader.cpp \
+    src/json_cbor.cpp \
+    src/blake3.cpp \
+    src/utf8.cpp \
+    src/process_spawner.cpp \
+    src/context_dedup.cpp \
+    src/history_index.cpp \
+    src/config_history.cpp \
+    src/facet_index.cpp \
+    src/config_resolver.cpp \
+    src/agent_view_model.cpp \
+    src/syntax_highlighter.cpp \
+    src/transcript_index.cpp \
+    src/outbound_queue.cpp \
+    src/task_scheduler.cpp \
+    src/profiler.cpp \
+    src/diagnostics.cpp \
+    src/context_controller.cpp \
+    -o bin/test_config_library_functionality -pthread; then
     echo "✓ Config library tests built successfully"
 else
     echo "✗ Config library tests build FAILED"
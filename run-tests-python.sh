@@ -55,6 +55,17 @@ else
     TESTS_FAILED=1
 fi
 
+echo ""
+
+# Run extension module tests (skipped unless cpp/ ran make python-module)
+echo "3. Running claude_agent_core module tests..."
+if python3 test_claude_agent_core.py; then
+    echo "✓ claude_agent_core tests PASSED"
+else
+    echo "✗ claude_agent_core tests FAILED"
+    TESTS_FAILED=1
+fi
+
 echo ""
 echo "Python test run complete."
 